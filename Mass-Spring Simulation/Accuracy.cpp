@@ -0,0 +1,337 @@
+#include "stdafx.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "Benchmark.h"
+#include "Profiler.h"
+
+#define ACCURACY_SAMPLE					0.04f		// SECONDS BETWEEN COMPARISONS, AND THE LONGEST STEP OF THE SWEEP
+#define ACCURACY_LEVELS					6			// STEPS OF THE SWEEP, EACH HALF THE ONE BEFORE
+#define ACCURACY_REFERENCE_DIVISIONS	128			// REFERENCE STEPS IN A SAMPLE, FOUR TIMES FINER THAN THE FINEST SWEEP STEP
+#define ACCURACY_REFERENCE				RK5_INTEGRATOR
+#define PLOT_WIDTH						720
+#define PLOT_HEIGHT						440
+#define PLOT_MARGIN						70
+
+static const char * INTEGRATOR_COLORS [ INTEGRATOR_CNT ] = { "#1f77b4" , "#ff7f0e" , "#2ca02c" , "#d62728" , "#9467bd" , "#8c564b" };
+
+/**
+ * \brief One integrator at one step size, measured against the reference.
+ */
+struct tAccuracyRun
+{
+    int integrator;
+    float step;
+    double seconds;					// WALL TIME IN Simulate
+    double l2;						// RMS DISTANCE FROM THE REFERENCE OVER EVERY PARTICLE AND SAMPLE
+    double lInf;					// LARGEST DISTANCE FROM THE REFERENCE
+    double final;					// RMS DISTANCE AT THE LAST SAMPLE
+    double forcesPerStep;
+    bool stable;					// FALSE WHEN A POSITION WENT TO INFINITY OR NAN
+    bool pareto;
+};
+
+struct tAccuracyScene
+{
+    std::string name;
+    int particles;
+    int samples;
+    double referenceSeconds;
+    std::vector < tAccuracyRun > runs;
+};
+
+/**
+ * \brief Copies the positions of the current system to the end of a list.
+ */
+static void AppendPositions ( const CPhysEnv & env , std::vector < float > & positions )
+{
+    const tVertexStream stream = env.PositionStream ();
+    for ( int vertex = 0; vertex < stream.count; ++vertex )
+    {
+        const float * position = stream.At ( vertex );
+        positions.insert ( positions.end () , position , position + 3 );
+    }
+}
+
+/**
+ * \brief Runs a scene through an integrator, stopping at every sample for a look at the positions.
+ * \return The wall time spent stepping, without the looks.
+ */
+template < typename tLook >
+static double RunSamples ( CPhysEnv & env , const int integrator , const float step , const int stepsPerSample , const int samples , tLook look )
+{
+    env.m_IntegratorType = integrator;
+    double seconds = 0.0;
+    for ( int sample = 0; sample < samples; ++sample )
+    {
+        const auto start = std::chrono::steady_clock::now ();
+        for ( int at = 0; at < stepsPerSample; ++at )
+        {
+            PROFILE_FRAME ();
+            env.Simulate ( step , TRUE );
+        }
+        seconds += std::chrono::duration < double > ( std::chrono::steady_clock::now () - start ).count ();
+        if ( ! look ( sample ) )
+        {
+            break;
+        }
+    }
+    return seconds;
+}
+
+/**
+ * \brief Marks the runs that no other stable run beats on both time and error.
+ */
+static void MarkPareto ( std::vector < tAccuracyRun > & runs )
+{
+    std::vector < tAccuracyRun * > order;
+    for ( tAccuracyRun & run : runs )
+    {
+        run.pareto = false;
+        if ( run.stable )
+        {
+            order.push_back ( &run );
+        }
+    }
+    std::sort ( order.begin () , order.end () , [] ( const tAccuracyRun * a , const tAccuracyRun * b )
+    {
+        return a->seconds < b->seconds || ( a->seconds == b->seconds && a->l2 < b->l2 );
+    } );
+    double best = HUGE_VAL;
+    for ( tAccuracyRun * run : order )
+    {
+        if ( run->l2 < best )
+        {
+            run->pareto = true;
+            best = run->l2;
+        }
+    }
+}
+
+static tAccuracyScene MeasureScene ( const tBenchScene & scene , const float duration )
+{
+    tAccuracyScene result;
+    result.name = scene.name;
+    result.samples = std::max ( 1 , static_cast < int > ( std::ceil ( duration / ACCURACY_SAMPLE ) ) );
+    result.particles = 0;
+    result.referenceSeconds = 0.0;
+    std::vector < float > reference;
+    CPhysEnv * env = MakeScene ( scene );
+    if ( env == NULL )
+    {
+        return result;
+    }
+    result.particles = env->PositionStream ().count;
+    const std::size_t floats = static_cast < std::size_t > ( result.particles ) * 3;
+    reference.reserve ( floats * result.samples );
+    result.referenceSeconds = RunSamples ( *env , ACCURACY_REFERENCE , ACCURACY_SAMPLE / ACCURACY_REFERENCE_DIVISIONS , ACCURACY_REFERENCE_DIVISIONS ,
+        result.samples , [ & ] ( int ) { AppendPositions ( *env , reference ); return true; } );
+    delete env;
+    fprintf ( stderr , "%s: reference took %.2f s\n" , scene.name.c_str () , result.referenceSeconds );
+
+    for ( int integrator = 0; integrator < INTEGRATOR_CNT; ++integrator )
+    {
+        for ( int level = 0; level < ACCURACY_LEVELS; ++level )
+        {
+            tAccuracyRun run;
+            run.integrator = integrator;
+            run.step = ACCURACY_SAMPLE / static_cast < float > ( 1 << level );
+            run.l2 = run.lInf = run.final = 0.0;
+            run.stable = true;
+            double sumSquares = 0.0;
+            int looked = 0;
+            env = MakeScene ( scene );
+            CProfiler::Instance ().Reset ();
+            run.seconds = RunSamples ( *env , integrator , run.step , 1 << level , result.samples , [ & ] ( const int sample )
+            {
+                const tVertexStream stream = env->PositionStream ();
+                const float * expected = &reference [ floats * sample ];
+                double sampleSquares = 0.0;
+                for ( int vertex = 0; vertex < stream.count; ++vertex , expected += 3 )
+                {
+                    const float * position = stream.At ( vertex );
+                    const double dx = position [ 0 ] - expected [ 0 ] , dy = position [ 1 ] - expected [ 1 ] , dz = position [ 2 ] - expected [ 2 ];
+                    const double squared = dx * dx + dy * dy + dz * dz;
+                    sampleSquares += squared;
+                    run.lInf = std::max ( run.lInf , std::sqrt ( squared ) );
+                }
+                sumSquares += sampleSquares;
+                run.final = std::sqrt ( sampleSquares / std::max ( 1 , stream.count ) );
+                ++looked;
+                // A SYSTEM THAT BLEW UP STAYS BLOWN UP, AND THE STEPS AFTER THAT ONLY COST TIME
+                run.stable = std::isfinite ( sampleSquares ) && std::isfinite ( run.lInf );
+                return run.stable;
+            } );
+            run.l2 = std::sqrt ( sumSquares / ( static_cast < double > ( std::max ( 1 , result.particles ) ) * std::max ( 1 , looked ) ) );
+            std::vector < tProfileStats > phases , counters;
+            CProfiler::Instance ().Stats ( phases , counters );
+            run.forcesPerStep = counters [ COUNTER_FORCES ].mean;
+            delete env;
+            result.runs.push_back ( run );
+            fprintf ( stderr , "%s %s at %g s: L2 %.3g, Linf %.3g in %.3f s\n" , scene.name.c_str () , INTEGRATOR_NAMES [ integrator ] , run.step ,
+                run.l2 , run.lInf , run.seconds );
+        }
+    }
+    CProfiler::Instance ().Reset ();
+    MarkPareto ( result.runs );
+    return result;
+}
+
+static bool WriteAccuracy ( FILE * fp , const float duration , const std::vector < tAccuracyScene > & scenes )
+{
+    fprintf ( fp , "{\n  \"duration\": %g,\n  \"sample\": %g,\n  \"reference\": { \"integrator\": %s, \"step\": %g },\n  \"scenes\": [" , duration ,
+        ACCURACY_SAMPLE , JsonString ( INTEGRATOR_NAMES [ ACCURACY_REFERENCE ] ).c_str () , ACCURACY_SAMPLE / ACCURACY_REFERENCE_DIVISIONS );
+    for ( std::size_t at = 0; at < scenes.size (); ++at )
+    {
+        const tAccuracyScene & scene = scenes [ at ];
+        fprintf ( fp , "%s\n    { \"scene\": %s, \"particles\": %d, \"samples\": %d, \"referenceSeconds\": %.6f, \"runs\": [" , at > 0 ? "," : "" ,
+            JsonString ( scene.name ).c_str () , scene.particles , scene.samples , scene.referenceSeconds );
+        for ( std::size_t r = 0; r < scene.runs.size (); ++r )
+        {
+            const tAccuracyRun & run = scene.runs [ r ];
+            fprintf ( fp , "%s\n      { \"integrator\": %s, \"step\": %g, \"seconds\": %.6f, \"forceEvaluationsPerStep\": %.3f, \"stable\": %s, " ,
+                r > 0 ? "," : "" , JsonString ( INTEGRATOR_NAMES [ run.integrator ] ).c_str () , run.step , run.seconds , run.forcesPerStep ,
+                run.stable ? "true" : "false" );
+            // JSON HAS NO INFINITY, SO A RUN THAT BLEW UP HAS NO ERRORS
+            if ( run.stable )
+            {
+                fprintf ( fp , "\"l2\": %.6g, \"lInf\": %.6g, \"final\": %.6g, " , run.l2 , run.lInf , run.final );
+            }
+            else
+            {
+                fprintf ( fp , "\"l2\": null, \"lInf\": null, \"final\": null, " );
+            }
+            fprintf ( fp , "\"pareto\": %s }" , run.pareto ? "true" : "false" );
+        }
+        fprintf ( fp , "\n    ] }" );
+    }
+    fprintf ( fp , "\n  ]\n}\n" );
+    return ferror ( fp ) == 0;
+}
+
+/**
+ * \brief Plots the error of each stable run against its time on log scales, one panel for each scene, with the Pareto front over them.
+ */
+static bool WritePlot ( FILE * fp , const std::vector < tAccuracyScene > & scenes )
+{
+    const int panelWidth = PLOT_WIDTH - 2 * PLOT_MARGIN , panelHeight = PLOT_HEIGHT - 2 * PLOT_MARGIN;
+    fprintf ( fp , "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%d\" height=\"%d\" font-family=\"sans-serif\" font-size=\"11\">\n" ,
+        PLOT_WIDTH , PLOT_HEIGHT * static_cast < int > ( scenes.size () ) );
+    for ( std::size_t at = 0; at < scenes.size (); ++at )
+    {
+        const tAccuracyScene & scene = scenes [ at ];
+        double minTime = HUGE_VAL , maxTime = 0.0 , minError = HUGE_VAL , maxError = 0.0;
+        for ( const tAccuracyRun & run : scene.runs )
+        {
+            if ( run.stable && run.seconds > 0.0 && run.l2 > 0.0 )
+            {
+                minTime = std::min ( minTime , run.seconds );
+                maxTime = std::max ( maxTime , run.seconds );
+                minError = std::min ( minError , run.l2 );
+                maxError = std::max ( maxError , run.l2 );
+            }
+        }
+        fprintf ( fp , "<g transform=\"translate(%d,%d)\">\n<text x=\"%d\" y=\"-%d\" font-size=\"14\">%s, %d particles</text>\n" , PLOT_MARGIN ,
+            PLOT_MARGIN + static_cast < int > ( at ) * PLOT_HEIGHT , 0 , PLOT_MARGIN / 2 , scene.name.c_str () , scene.particles );
+        fprintf ( fp , "<rect width=\"%d\" height=\"%d\" fill=\"none\" stroke=\"#888\"/>\n" , panelWidth , panelHeight );
+        if ( maxTime <= 0.0 )
+        {
+            fprintf ( fp , "<text x=\"10\" y=\"20\">No stable runs</text>\n</g>\n" );
+            continue;
+        }
+        // WHOLE DECADES ON BOTH AXES
+        const double x0 = std::floor ( std::log10 ( minTime ) ) , x1 = std::max ( x0 + 1.0 , std::ceil ( std::log10 ( maxTime ) ) );
+        const double y0 = std::floor ( std::log10 ( minError ) ) , y1 = std::max ( y0 + 1.0 , std::ceil ( std::log10 ( maxError ) ) );
+        auto px = [ & ] ( const double seconds ) { return ( std::log10 ( seconds ) - x0 ) / ( x1 - x0 ) * panelWidth; };
+        auto py = [ & ] ( const double error ) { return panelHeight - ( std::log10 ( std::max ( error , minError ) ) - y0 ) / ( y1 - y0 ) * panelHeight; };
+        for ( double decade = x0; decade <= x1; decade += 1.0 )
+        {
+            const double x = ( decade - x0 ) / ( x1 - x0 ) * panelWidth;
+            fprintf ( fp , "<line x1=\"%.1f\" y1=\"0\" x2=\"%.1f\" y2=\"%d\" stroke=\"#ddd\"/><text x=\"%.1f\" y=\"%d\" text-anchor=\"middle\">1e%d</text>\n" ,
+                x , x , panelHeight , x , panelHeight + 15 , static_cast < int > ( decade ) );
+        }
+        for ( double decade = y0; decade <= y1; decade += 1.0 )
+        {
+            const double y = panelHeight - ( decade - y0 ) / ( y1 - y0 ) * panelHeight;
+            fprintf ( fp , "<line x1=\"0\" y1=\"%.1f\" x2=\"%d\" y2=\"%.1f\" stroke=\"#ddd\"/><text x=\"-5\" y=\"%.1f\" text-anchor=\"end\">1e%d</text>\n" ,
+                y , panelWidth , y , y + 4 , static_cast < int > ( decade ) );
+        }
+        fprintf ( fp , "<text x=\"%d\" y=\"%d\" text-anchor=\"middle\">wall time (s)</text>\n" , panelWidth / 2 , panelHeight + 32 );
+        fprintf ( fp , "<text transform=\"rotate(-90)\" x=\"-%d\" y=\"-50\" text-anchor=\"middle\">L2 position error</text>\n" , panelHeight / 2 );
+        // A LINE THROUGH THE STEPS OF EACH INTEGRATOR, THEN THE FRONT OVER THEM ALL
+        for ( int integrator = 0; integrator < INTEGRATOR_CNT; ++integrator )
+        {
+            fprintf ( fp , "<polyline fill=\"none\" stroke=\"%s\" points=\"" , INTEGRATOR_COLORS [ integrator ] );
+            for ( const tAccuracyRun & run : scene.runs )
+            {
+                if ( run.integrator == integrator && run.stable && run.seconds > 0.0 )
+                {
+                    fprintf ( fp , "%.1f,%.1f " , px ( run.seconds ) , py ( run.l2 ) );
+                }
+            }
+            fprintf ( fp , "\"/>\n" );
+            for ( const tAccuracyRun & run : scene.runs )
+            {
+                if ( run.integrator == integrator && run.stable && run.seconds > 0.0 )
+                {
+                    fprintf ( fp , "<circle cx=\"%.1f\" cy=\"%.1f\" r=\"3\" fill=\"%s\"><title>%s, step %g</title></circle>\n" , px ( run.seconds ) ,
+                        py ( run.l2 ) , INTEGRATOR_COLORS [ integrator ] , INTEGRATOR_NAMES [ integrator ] , run.step );
+                }
+            }
+            fprintf ( fp , "<rect x=\"%d\" y=\"%d\" width=\"10\" height=\"10\" fill=\"%s\"/><text x=\"%d\" y=\"%d\">%s</text>\n" , panelWidth + 8 ,
+                integrator * 16 , INTEGRATOR_COLORS [ integrator ] , panelWidth + 22 , integrator * 16 + 9 , INTEGRATOR_NAMES [ integrator ] );
+        }
+        std::vector < const tAccuracyRun * > front;
+        for ( const tAccuracyRun & run : scene.runs )
+        {
+            if ( run.pareto && run.seconds > 0.0 )
+            {
+                front.push_back ( &run );
+            }
+        }
+        std::sort ( front.begin () , front.end () , [] ( const tAccuracyRun * a , const tAccuracyRun * b ) { return a->seconds < b->seconds; } );
+        fprintf ( fp , "<polyline fill=\"none\" stroke=\"#000\" stroke-width=\"2\" stroke-dasharray=\"6,3\" points=\"" );
+        for ( const tAccuracyRun * run : front )
+        {
+            fprintf ( fp , "%.1f,%.1f " , px ( run->seconds ) , py ( run->l2 ) );
+        }
+        fprintf ( fp , "\"/>\n<text x=\"%d\" y=\"%d\">--- Pareto front</text>\n</g>\n" , panelWidth + 8 , INTEGRATOR_CNT * 16 + 9 );
+    }
+    fprintf ( fp , "</svg>\n" );
+    return ferror ( fp ) == 0;
+}
+
+int RunAccuracy ( const std::vector < tBenchScene > & scenes , const float duration , const std::string & outName , const std::string & plotName )
+{
+    std::vector < tAccuracyScene > results;
+    for ( const tBenchScene & scene : scenes )
+    {
+        tAccuracyScene result = MeasureScene ( scene , duration );
+        if ( result.particles == 0 )
+        {
+            fprintf ( stderr , "Skipping %s, it could not be read\n" , scene.file.c_str () );
+            continue;
+        }
+        results.push_back ( result );
+    }
+    FILE * fp = OpenOutput ( outName );
+    if ( fp == NULL )
+    {
+        fprintf ( stderr , "Could not write %s\n" , outName.c_str () );
+        return 1;
+    }
+    bool written = WriteAccuracy ( fp , duration , results );
+    written = CloseOutput ( fp ) && written;
+    fp = OpenOutput ( plotName );
+    if ( fp == NULL )
+    {
+        fprintf ( stderr , "Could not write %s\n" , plotName.c_str () );
+        return 1;
+    }
+    written = WritePlot ( fp , results ) && written;
+    written = CloseOutput ( fp ) && written;
+    return written ? 0 : 1;
+}
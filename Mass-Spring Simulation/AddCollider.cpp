@@ -0,0 +1,127 @@
+// AddCollider.cpp : implementation file
+//
+
+#include "stdafx.h"
+#include "clothy.h"
+#include "PhysEnv.h"
+#include "Skeleton.h"
+#include "AddCollider.h"
+
+#ifdef _DEBUG
+#define new DEBUG_NEW
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+// CAddCollider dialog
+
+
+CAddCollider::CAddCollider(int shape, t_Bone *skeleton, CWnd* pParent /*=NULL*/)
+	: CDialog(CAddCollider::IDD, pParent)
+{
+	//{{AFX_DATA_INIT(CAddCollider)
+	m_XPos = 0.0f;
+	m_YPos = 0.0f;
+	m_ZPos = 0.0f;
+	m_XPos2 = 0.0f;
+	m_YPos2 = 0.0f;
+	m_ZPos2 = 0.0f;
+	m_Size = 0.0f;
+	m_Angle = 0.0f;
+	m_Bone = 0;
+	//}}AFX_DATA_INIT
+	m_Shape = shape;
+	m_Skeleton = skeleton;
+}
+
+
+void CAddCollider::DoDataExchange(CDataExchange* pDX)
+{
+	CDialog::DoDataExchange(pDX);
+	//{{AFX_DATA_MAP(CAddCollider)
+	DDX_Text(pDX, IDC_XPOS, m_XPos);
+	DDX_Text(pDX, IDC_YPOS, m_YPos);
+	DDX_Text(pDX, IDC_ZPOS, m_ZPos);
+	DDX_Text(pDX, IDC_XPOS2, m_XPos2);
+	DDX_Text(pDX, IDC_YPOS2, m_YPos2);
+	DDX_Text(pDX, IDC_ZPOS2, m_ZPos2);
+	DDX_Text(pDX, IDC_RADIUS, m_Size);
+	DDX_Text(pDX, IDC_ANGLE, m_Angle);
+	DDX_CBIndex(pDX, IDC_BONE, m_Bone);
+	//}}AFX_DATA_MAP
+	// A CAPSULE NEEDS A RADIUS AND A MESH A SCALE, THE OFFSET OF A PLANE CAN BE ANYTHING
+	if (m_Shape == COLLIDER_CAPSULE)
+		DDV_MinMaxFloat(pDX, m_Size, 1.e-003f, 10.f);
+	if (m_Shape == COLLIDER_MESH)
+		DDV_MinMaxFloat(pDX, m_Size, 1.e-003f, 100.f);
+}
+
+
+BEGIN_MESSAGE_MAP(CAddCollider, CDialog)
+	//{{AFX_MSG_MAP(CAddCollider)
+	//}}AFX_MSG_MAP
+END_MESSAGE_MAP()
+
+/////////////////////////////////////////////////////////////////////////////
+// CAddCollider message handlers
+
+BOOL CAddCollider::OnInitDialog() 
+{
+/// Local Variables ///////////////////////////////////////////////////////////
+	CComboBox *bones = (CComboBox *)GetDlgItem(IDC_BONE);
+	t_Bone *bone;
+///////////////////////////////////////////////////////////////////////////////
+	// THE BONES GO IN BEFORE THE DATA EXCHANGE PICKS ONE, IN BoneIndex ORDER
+	bones->AddString("(None)");
+	for (int index = 1; (bone = BoneAtIndex(m_Skeleton,index)) != NULL; index++)
+		bones->AddString(bone->name);
+
+	CDialog::OnInitDialog();
+
+	// NAME THE FIELDS FOR THE SHAPE AND HIDE THE ONES IT DOES NOT USE
+	switch (m_Shape)
+	{
+	case COLLIDER_PLANE:
+		SetWindowText("Add Collision Plane");
+		SetDlgItemText(IDC_POINTLABEL, "Normal");
+		SetDlgItemText(IDC_SIZELABEL, "Offset");
+		GetDlgItem(IDC_SECONDLABEL)->ShowWindow(SW_HIDE);
+		GetDlgItem(IDC_XPOS2)->ShowWindow(SW_HIDE);
+		GetDlgItem(IDC_YPOS2)->ShowWindow(SW_HIDE);
+		GetDlgItem(IDC_ZPOS2)->ShowWindow(SW_HIDE);
+		GetDlgItem(IDC_ANGLELABEL)->ShowWindow(SW_HIDE);
+		GetDlgItem(IDC_ANGLE)->ShowWindow(SW_HIDE);
+		// THE BONES ONLY CARRY SPHERES, BOXES, CAPSULES AND MESHES
+		GetDlgItem(IDC_BONELABEL)->ShowWindow(SW_HIDE);
+		GetDlgItem(IDC_BONE)->ShowWindow(SW_HIDE);
+		break;
+	case COLLIDER_BOX:
+		SetWindowText("Add Collision Box");
+		SetDlgItemText(IDC_POINTLABEL, "Center");
+		SetDlgItemText(IDC_SECONDLABEL, "Half Size");
+		GetDlgItem(IDC_SIZELABEL)->ShowWindow(SW_HIDE);
+		GetDlgItem(IDC_RADIUS)->ShowWindow(SW_HIDE);
+		break;
+	case COLLIDER_CAPSULE:
+		SetWindowText("Add Collision Capsule");
+		SetDlgItemText(IDC_POINTLABEL, "End 1");
+		SetDlgItemText(IDC_SECONDLABEL, "End 2");
+		SetDlgItemText(IDC_SIZELABEL, "Radius");
+		GetDlgItem(IDC_ANGLELABEL)->ShowWindow(SW_HIDE);
+		GetDlgItem(IDC_ANGLE)->ShowWindow(SW_HIDE);
+		break;
+	case COLLIDER_MESH:
+		SetWindowText("Add Collision Mesh");
+		SetDlgItemText(IDC_POINTLABEL, "Position");
+		SetDlgItemText(IDC_SIZELABEL, "Scale");
+		GetDlgItem(IDC_SECONDLABEL)->ShowWindow(SW_HIDE);
+		GetDlgItem(IDC_XPOS2)->ShowWindow(SW_HIDE);
+		GetDlgItem(IDC_YPOS2)->ShowWindow(SW_HIDE);
+		GetDlgItem(IDC_ZPOS2)->ShowWindow(SW_HIDE);
+		break;
+	}
+	
+	return TRUE;  // return TRUE unless you set the focus to a control
+	              // EXCEPTION: OCX Property Pages should return FALSE
+}
@@ -0,0 +1,62 @@
+#if !defined(AFX_ADDCOLLIDER_H__5B0E7C21_3F4A_4D8E_9C61_2A7F0B8D4E13__INCLUDED_)
+#define AFX_ADDCOLLIDER_H__5B0E7C21_3F4A_4D8E_9C61_2A7F0B8D4E13__INCLUDED_
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+// AddCollider.h : header file
+//
+
+/////////////////////////////////////////////////////////////////////////////
+// CAddCollider dialog
+// One dialog for the planes, boxes, capsules and meshes. The labels follow the
+// shape, the first point is the normal, the center, the first end or where the
+// mesh goes and the second one the half size or the second end. A box, a
+// capsule or a mesh can be given in the space of a bone, and then follows it
+
+struct t_Bone;
+
+class CAddCollider : public CDialog
+{
+// Construction
+public:
+	CAddCollider(int shape, t_Bone *skeleton, CWnd* pParent = NULL);   // standard constructor
+
+// Dialog Data
+	//{{AFX_DATA(CAddCollider)
+	enum { IDD = IDD_ADDCOLLIDER };
+	float	m_XPos;
+	float	m_YPos;
+	float	m_ZPos;
+	float	m_XPos2;
+	float	m_YPos2;
+	float	m_ZPos2;
+	float	m_Size;
+	float	m_Angle;
+	int		m_Bone;
+	//}}AFX_DATA
+	int		m_Shape;				// A tColliderShapes
+	t_Bone	*m_Skeleton;			// m_Bone IS THE BoneIndex IN IT, 0 FOR NONE
+
+
+// Overrides
+	// ClassWizard generated virtual function overrides
+	//{{AFX_VIRTUAL(CAddCollider)
+	protected:
+	virtual void DoDataExchange(CDataExchange* pDX);    // DDX/DDV support
+	//}}AFX_VIRTUAL
+
+// Implementation
+protected:
+
+	// Generated message map functions
+	//{{AFX_MSG(CAddCollider)
+	virtual BOOL OnInitDialog();
+	//}}AFX_MSG
+	DECLARE_MESSAGE_MAP()
+};
+
+//{{AFX_INSERT_LOCATION}}
+// Microsoft Visual C++ will insert additional declarations immediately before the previous line.
+
+#endif // !defined(AFX_ADDCOLLIDER_H__5B0E7C21_3F4A_4D8E_9C61_2A7F0B8D4E13__INCLUDED_)
@@ -0,0 +1,682 @@
+#include "stdafx.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+#if defined(_WIN32)
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+#include "Benchmark.h"
+#include "ClothPatch.h"
+#include "IndexBuffer.h"
+#include "LoadOBJ.h"
+#include "Profiler.h"
+#include "Snapshot.h"
+#include "TextExporter.h"
+
+#define BENCH_DURATION			1.0f		// SIMULATED SECONDS FOR EACH RUN
+#define BENCH_STEP				0.01f		// THE FIXED STEP OF THE VIEW
+#define BENCH_WARMUP_STEPS		5			// STEPS RUN BEFORE THE CLOCK STARTS, TO TOUCH EVERY BUFFER ONCE
+#define BENCH_MAX_SIZE			1024
+#define BENCH_FILE				"benchmark.json"
+#define ACCURACY_FILE			"accuracy.json"
+#define ACCURACY_PLOT			"accuracy.svg"
+#define ACCURACY_SIZE			32
+#define LOADOBJ_FILE			"loadobj.json"
+#define LOADOBJ_REPEATS			10
+#define TEXT_FILE				"text.json"
+#define TEXT_SCRATCH			"text.tmp"	// WRITTEN AND REMOVED BY EACH PASS
+#define TEXT_LINES_BENCH		100000		// LINES OF EACH KIND WRITTEN BY ONE REPEAT
+
+static const int CLOTH_SIZES [] = { 10 , 32 , 64 , 128 , 256 , 512 , 1024 };
+static const char * SCENES [] = { "Test1.dps" , "Test2.dps" , "Test3.dps" };
+// IN tIntegratorTypes ORDER
+const char * INTEGRATOR_NAMES [ INTEGRATOR_CNT ] = { "Euler" , "Midpoint" , "RK4" , "RK5" , "RK4 adaptive" , "Heun" };
+
+// EVERY operator new IS COUNTED. THE SIMULATION KEEPS ITS PARTICLES AND SPRINGS IN malloc'd ARRAYS THAT ONLY CHANGE WHEN THE SYSTEM
+// DOES, SO WHAT ALLOCATES WHILE STEPPING ARE THE CONTAINERS AND TASKS, WHICH ALL GO THROUGH HERE
+static std::atomic < std::uint64_t > allocationCnt ( 0 );
+static std::atomic < std::uint64_t > allocationBytes ( 0 );
+
+void * operator new ( std::size_t size )
+{
+    allocationCnt.fetch_add ( 1 , std::memory_order_relaxed );
+    allocationBytes.fetch_add ( size , std::memory_order_relaxed );
+    for ( ;; )
+    {
+        void * block = std::malloc ( size > 0 ? size : 1 );
+        if ( block != NULL )
+        {
+            return block;
+        }
+        std::new_handler handler = std::get_new_handler ();
+        if ( handler == NULL )
+        {
+            throw std::bad_alloc ();
+        }
+        handler ();
+    }
+}
+
+void * operator new[] ( std::size_t size )
+{
+    return operator new ( size );
+}
+
+void operator delete ( void * block ) noexcept
+{
+    std::free ( block );
+}
+
+void operator delete[] ( void * block ) noexcept
+{
+    std::free ( block );
+}
+
+void operator delete ( void * block , std::size_t ) noexcept
+{
+    std::free ( block );
+}
+
+void operator delete[] ( void * block , std::size_t ) noexcept
+{
+    std::free ( block );
+}
+
+/**
+ * \brief One scene run through one integrator.
+ */
+struct tBenchResult
+{
+    std::string scene;
+    int particles;
+    int springs;
+    int integrator;
+    int steps;
+    double seconds;
+    double nsPerParticleStep;
+    double forcesPerStep;
+    double stepP50;					// MILLISECONDS, FROM THE PROFILER
+    double stepP99;
+    double logMean;					// THE DIAGNOSTICS SAMPLED EVERY FEW STEPS, INSIDE THE STEP TIMES
+    double recordMean;				// RecordFrame, THE RECORDING THE VIEW DOES AFTER EACH STEP, INSIDE THE STEP TIMES TOO
+    std::uint64_t allocations;
+    std::uint64_t allocatedBytes;
+    std::uint64_t peakRss;
+    std::vector < tProfileHardware > hardware;	// NO FRAMES UNLESS THE EVENTS WERE COUNTED
+};
+
+/**
+ * \brief The most memory the process has held so far. It only grows, so the runs go from the smallest scene up.
+ */
+static std::uint64_t PeakResidentBytes ()
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if ( ! GetProcessMemoryInfo ( GetCurrentProcess () , &counters , sizeof ( counters ) ) )
+    {
+        return 0;
+    }
+    return counters.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+    if ( getrusage ( RUSAGE_SELF , &usage ) != 0 )
+    {
+        return 0;
+    }
+#if defined(__APPLE__)
+    return static_cast < std::uint64_t > ( usage.ru_maxrss );
+#else
+    return static_cast < std::uint64_t > ( usage.ru_maxrss ) * 1024;
+#endif
+#endif
+}
+
+/**
+ * \brief Reads the simulation of a .dps file, either layout, without its visual.
+ */
+static bool LoadScene ( CPhysEnv & env , const std::string & filename )
+{
+    CSnapshotReader reader;
+    const int format = reader.Open ( filename.c_str () );
+    bool loaded = false;
+    if ( format == SNAPSHOT_CHUNKED )
+    {
+        loaded = env.LoadSnapshot ( reader ) != FALSE && ! reader.Damaged ();
+    }
+    else if ( format == SNAPSHOT_LEGACY )
+    {
+        CSnapshotCursor cursor = reader.Whole ();
+        t_Bone root;
+        t_Visual visual;
+        if ( GetLegacyBones ( cursor , root ) )
+        {
+            // THE VERTICES AND INDICES OF THE VISUAL COME BEFORE THE SIMULATION
+            GetLegacyVisual ( cursor , visual );
+            if ( visual.reuseVertices )
+            {
+                cursor.Skip ( sizeof ( float ) * visual.vSize * visual.vertexCnt );
+                cursor.Skip ( IndexSize ( visual.vertexCnt ) * visual.faceCnt * visual.vPerFace );
+            }
+            loaded = ! cursor.Failed () && env.LoadLegacy ( cursor ) != FALSE;
+        }
+    }
+    reader.Close ();
+    return loaded;
+}
+
+std::vector < tBenchScene > BenchScenes ( const std::string & sceneDir , const std::vector < int > & sizes )
+{
+    std::vector < tBenchScene > scenes;
+    for ( const char * file : SCENES )
+    {
+        scenes.push_back ( tBenchScene { file , sceneDir + "/" + file , 0 } );
+    }
+    for ( const int size : sizes )
+    {
+        char name [ 32 ];
+        sprintf ( name , "Cloth %dx%d" , size , size );
+        scenes.push_back ( tBenchScene { name , "" , size } );
+    }
+    return scenes;
+}
+
+CPhysEnv * MakeScene ( const tBenchScene & scene )
+{
+    CPhysEnv * env = new CPhysEnv;
+    if ( ! scene.file.empty () )
+    {
+        if ( ! LoadScene ( *env , scene.file ) )
+        {
+            delete env;
+            return NULL;
+        }
+        return env;
+    }
+    tClothPatch patch;
+    DefaultClothPatch ( patch );
+    patch.u = patch.v = scene.size;
+    t_Visual * visual = MakeClothVisual ( patch );
+    env->SetWorldParticles ( reinterpret_cast < tTexturedVertex * > ( visual->vertexData ) , visual->vertexCnt );
+    AddClothSprings ( *env , patch );
+    // ONLY THE PARTICLES ARE STEPPED, THE SURFACE IS NOT DRAWN
+    std::free ( visual->vertexData );
+    std::free ( visual->faceIndex );
+    std::free ( visual );
+    return env;
+}
+
+/**
+ * \brief One step the way the view takes it, recorded after the simulation and timed as one frame.
+ */
+static void StepAndRecord ( CPhysEnv & env , const float step , float & time )
+{
+    PROFILE_FRAME ();
+    env.Simulate ( step , TRUE );
+    time += step;
+    env.RecordFrame ( time );
+}
+
+/**
+ * \brief Steps a system for the duration with one integrator and reads what it cost.
+ * \note The recording the steps write is deleted at the end, only its cost is kept.
+ */
+static void RunSystem ( CPhysEnv & env , const int integrator , const float duration , const float step , tBenchResult & result )
+{
+    float time = 0.0f;
+    env.m_IntegratorType = integrator;
+    for ( int warmup = 0; warmup < BENCH_WARMUP_STEPS; ++warmup )
+    {
+        StepAndRecord ( env , step , time );
+    }
+    const int steps = std::max ( 1 , static_cast < int > ( std::ceil ( duration / step ) ) );
+    CProfiler::Instance ().Reset ();
+    const std::uint64_t allocationsBefore = allocationCnt.load () , bytesBefore = allocationBytes.load ();
+    const auto start = std::chrono::steady_clock::now ();
+    for ( int at = 0; at < steps; ++at )
+    {
+        StepAndRecord ( env , step , time );
+    }
+    const auto stop = std::chrono::steady_clock::now ();
+    result.allocations = allocationCnt.load () - allocationsBefore;
+    result.allocatedBytes = allocationBytes.load () - bytesBefore;
+    result.seconds = std::chrono::duration < double > ( stop - start ).count ();
+    result.particles = env.PositionStream ().count;
+    result.springs = env.SpringCount ();
+    result.integrator = integrator;
+    result.steps = steps;
+    result.nsPerParticleStep = result.seconds * 1e9 / ( static_cast < double > ( steps ) * std::max ( 1 , result.particles ) );
+    std::vector < tProfileStats > phases , counters;
+    CProfiler::Instance ().Stats ( phases , counters );
+    result.forcesPerStep = counters [ COUNTER_FORCES ].mean;
+    result.stepP50 = phases [ PHASE_STEP ].p50;
+    result.stepP99 = phases [ PHASE_STEP ].p99;
+    result.logMean = phases [ PHASE_LOG ].mean;
+    result.recordMean = phases [ PHASE_RECORD ].mean;
+    CProfiler::Instance ().HardwareStats ( result.hardware );
+    result.peakRss = PeakResidentBytes ();
+    env.StopRecording ();
+    if ( env.RecordingName () [ 0 ] != '\0' )
+    {
+        remove ( env.RecordingName () );
+    }
+}
+
+std::string JsonString ( const std::string & text )
+{
+    std::string quoted = "\"";
+    for ( const char c : text )
+    {
+        if ( c == '"' || c == '\\' )
+        {
+            quoted += '\\';
+        }
+        if ( static_cast < unsigned char > ( c ) >= 0x20 )
+        {
+            quoted += c;
+        }
+    }
+    return quoted + "\"";
+}
+
+FILE * OpenOutput ( const std::string & filename )
+{
+    return filename == "-" ? stdout : fopen ( filename.c_str () , "w" );
+}
+
+bool CloseOutput ( FILE * fp )
+{
+    const bool written = ferror ( fp ) == 0;
+    return fp == stdout ? fflush ( fp ) == 0 && written : fclose ( fp ) == 0 && written;
+}
+
+/**
+ * \brief Writes the events of a phase per particle for each step, null for the events not counted.
+ */
+static void WriteEvents ( FILE * fp , const tProfileHardware & stats , const double * events , const int particles )
+{
+    static const char * KEYS [ HW_EVENT_CNT ] = { "cyclesPerParticle" , "instructionsPerParticle" , "llcMissesPerParticle" , "branchMissesPerParticle" };
+    const double perParticle = 1.0 / std::max ( 1 , particles );
+    if ( stats.counted [ HW_CYCLES ] && stats.counted [ HW_INSTRUCTIONS ] && events [ HW_CYCLES ] > 0.0 )
+    {
+        fprintf ( fp , "{ \"ipc\": %.3f" , events [ HW_INSTRUCTIONS ] / events [ HW_CYCLES ] );
+    }
+    else
+    {
+        fprintf ( fp , "{ \"ipc\": null" );
+    }
+    for ( int event = 0; event < HW_EVENT_CNT; ++event )
+    {
+        if ( stats.counted [ event ] )
+        {
+            fprintf ( fp , ", \"%s\": %.4f" , KEYS [ event ] , events [ event ] * perParticle );
+        }
+        else
+        {
+            fprintf ( fp , ", \"%s\": null" , KEYS [ event ] );
+        }
+    }
+    fprintf ( fp , " }" );
+}
+
+static bool WriteResults ( FILE * fp , const float duration , const float step , const std::vector < tBenchResult > & results )
+{
+    fprintf ( fp , "{\n  \"duration\": %g,\n  \"step\": %g,\n  \"runs\": [" , duration , step );
+    for ( std::size_t at = 0; at < results.size (); ++at )
+    {
+        const tBenchResult & result = results [ at ];
+        fprintf ( fp , "%s\n    { \"scene\": %s, \"particles\": %d, \"springs\": %d, \"integrator\": %s, \"steps\": %d, \"seconds\": %.6f,"
+            " \"nsPerParticleStep\": %.3f, \"forceEvaluationsPerStep\": %.3f, \"stepMsP50\": %.6f, \"stepMsP99\": %.6f, \"logMsMean\": %.6f, \"recordMsMean\": %.6f,"
+            " \"allocations\": %llu, \"allocatedBytes\": %llu, \"peakRssBytes\": %llu, \"counters\": " ,
+            at > 0 ? "," : "" , JsonString ( result.scene ).c_str () , result.particles , result.springs ,
+            JsonString ( INTEGRATOR_NAMES [ result.integrator ] ).c_str () , result.steps , result.seconds , result.nsPerParticleStep ,
+            result.forcesPerStep , result.stepP50 , result.stepP99 , result.logMean , result.recordMean , static_cast < unsigned long long > ( result.allocations ) ,
+            static_cast < unsigned long long > ( result.allocatedBytes ) , static_cast < unsigned long long > ( result.peakRss ) );
+        if ( result.hardware.empty () || result.hardware [ PHASE_STEP ].frames == 0 )
+        {
+            fprintf ( fp , "null }" );
+            continue;
+        }
+        // EACH PHASE WITH AND WITHOUT THE PHASES INSIDE IT, SO THE INTEGRATOR CAN BE TOLD APART FROM THE FORCES IT EVALUATES. WITHOUT
+        // THE WORKERS THE PHASES THAT RUN PARALLEL LOOPS ONLY HAVE THE CHUNKS OF THIS THREAD
+        fprintf ( fp , "{\n      \"workers\": %s" , result.hardware [ PHASE_STEP ].workers ? "true" : "false" );
+        for ( std::size_t phase = 0; phase < result.hardware.size (); ++phase )
+        {
+            const tProfileHardware & stats = result.hardware [ phase ];
+            fprintf ( fp , ",\n      %s: { \"total\": " , JsonString ( stats.name ).c_str () );
+            WriteEvents ( fp , stats , stats.total , result.particles );
+            fprintf ( fp , ", \"self\": " );
+            WriteEvents ( fp , stats , stats.self , result.particles );
+            fprintf ( fp , " }" );
+        }
+        fprintf ( fp , "\n    } }" );
+    }
+    fprintf ( fp , "\n  ]\n}\n" );
+    return ferror ( fp ) == 0;
+}
+
+/**
+ * \brief Times the memory-mapped OBJ loader against the original one on a file and writes both rates.
+ * \return The exit code of the program.
+ */
+static int RunLoadObj ( const std::string & objName , const int repeats , const std::string & outName )
+{
+    std::vector < char > filename ( objName.begin () , objName.end () );
+    filename.push_back ( '\0' );
+    double legacyMBs = 0.0 , mappedMBs = 0.0;
+    if ( ! BenchmarkLoadOBJ ( filename.data () , repeats , &legacyMBs , &mappedMBs ) )
+    {
+        fprintf ( stderr , "Could not read %s\n" , objName.c_str () );
+        return 1;
+    }
+    fprintf ( stderr , "%s: %.1f MB/s before, %.1f MB/s mapped\n" , objName.c_str () , legacyMBs , mappedMBs );
+    FILE * fp = OpenOutput ( outName );
+    if ( fp == NULL )
+    {
+        fprintf ( stderr , "Could not write %s\n" , outName.c_str () );
+        return 1;
+    }
+    fprintf ( fp , "{\n  \"file\": %s,\n  \"repeats\": %d,\n  \"legacyMBs\": %.3f,\n  \"mappedMBs\": %.3f,\n  \"speedup\": %.3f\n}\n" ,
+        JsonString ( objName ).c_str () , repeats , legacyMBs , mappedMBs , legacyMBs > 0.0 ? mappedMBs / legacyMBs : 0.0 );
+    const bool written = ferror ( fp ) == 0;
+    return CloseOutput ( fp ) && written ? 0 : 1;
+}
+
+/**
+ * \brief An error line of the log the way it was written before CTextExporter, through a stream of its own.
+ */
+static void LegacyErrorLine ( std::ofstream & file , const float * values )
+{
+    std::stringstream ss;
+    ss << std::showpos << std::setprecision ( std::numeric_limits < float >::digits + 1 );
+    ss << values [ 0 ] << "," << values [ 1 ] << "," << values [ 2 ] << "," << values [ 3 ] << "," << "RK4" << '\n';
+    file << ss.rdbuf ();
+}
+
+/**
+ * \brief A particle line the way CPhysEnv::ParticleCsvLine formatted it.
+ */
+static void LegacyParticleLine ( std::ofstream & file , const tParticle & particle )
+{
+    std::stringstream ss;
+    ss << std::showpos << std::setprecision ( 10 );
+    ss << particle.pos.x << "," << particle.pos.y << "," << particle.pos.z << ",";
+    ss << particle.v.x << "," << particle.v.y << "," << particle.v.z << ",";
+    ss << particle.f.x << "," << particle.f.y << "," << particle.f.z;
+    file << ss.str () << '\n';
+}
+
+/**
+ * \brief Lines per second of one way of writing, over every repeat. write writes the lines of one repeat and returns false on failure.
+ */
+template < typename Write >
+static double LinesPerSecond ( const int repeats , Write write )
+{
+    const auto start = std::chrono::steady_clock::now ();
+    for ( int repeat = 0; repeat < repeats; ++repeat )
+    {
+        if ( ! write () )
+        {
+            return 0.0;
+        }
+    }
+    const double seconds = std::chrono::duration < double > ( std::chrono::steady_clock::now () - start ).count ();
+    remove ( TEXT_SCRATCH );
+    return seconds > 0.0 ? static_cast < double > ( TEXT_LINES_BENCH ) * repeats / seconds : 0.0;
+}
+
+/**
+ * \brief Times the stream formatting the CSV files had before against CTextExporter, for the error log and the particle dumps.
+ * \return The exit code of the program.
+ */
+static int RunText ( const int repeats , const std::string & outName )
+{
+    // VALUES OF EVERY SIGN AND MAGNITUDE, SO NEITHER WAY GETS AWAY WITH SHORT NUMBERS
+    std::vector < float > errors ( 4 * TEXT_LINES_BENCH );
+    std::vector < tParticle > particles ( TEXT_LINES_BENCH );
+    for ( int i = 0; i < TEXT_LINES_BENCH; ++i )
+    {
+        const float x = static_cast < float > ( i );
+        for ( int k = 0; k < 4; ++k )
+        {
+            errors [ 4 * i + k ] = std::sin ( x + k ) * std::pow ( 10.0f , static_cast < float > ( i % 9 - 6 ) );
+        }
+        tParticle & particle = particles [ i ];
+        std::memset ( &particle , 0 , sizeof ( particle ) );
+        MAKEVECTOR ( particle.pos , std::sin ( x ) , std::cos ( x ) , x * 1.0e-3f )
+        MAKEVECTOR ( particle.v , std::sin ( 2.0f * x ) * 0.1f , -x * 1.0e-5f , std::cos ( 3.0f * x ) )
+        MAKEVECTOR ( particle.f , -9.8f * std::cos ( x ) , std::sin ( x ) * 1.0e3f , 1.0f / ( 1.0f + x ) )
+    }
+    const double legacyErrors = LinesPerSecond ( repeats , [ & ] ()
+    {
+        std::ofstream file ( TEXT_SCRATCH , std::ios_base::out );
+        for ( int i = 0; i < TEXT_LINES_BENCH; ++i )
+        {
+            LegacyErrorLine ( file , &errors [ 4 * i ] );
+        }
+        file.close ();
+        return ! file.fail ();
+    } );
+    const double exporterErrors = LinesPerSecond ( repeats , [ & ] ()
+    {
+        CTextExporter exporter;
+        if ( ! exporter.Open ( TEXT_SCRATCH ) )
+        {
+            return false;
+        }
+        for ( int i = 0; i < TEXT_LINES_BENCH; ++i )
+        {
+            exporter.PutLine ( &errors [ 4 * i ] , 4 , "RK4" );
+        }
+        return exporter.Close ();
+    } );
+    const double legacyParticles = LinesPerSecond ( repeats , [ & ] ()
+    {
+        std::ofstream file ( TEXT_SCRATCH , std::ios_base::out );
+        for ( const tParticle & particle : particles )
+        {
+            LegacyParticleLine ( file , particle );
+        }
+        file.close ();
+        return ! file.fail ();
+    } );
+    const double exporterParticles = LinesPerSecond ( repeats , [ & ] ()
+    {
+        CTextExporter exporter;
+        if ( ! exporter.Open ( TEXT_SCRATCH ) )
+        {
+            return false;
+        }
+        exporter.PutParticles ( particles.data () , TEXT_LINES_BENCH );
+        return exporter.Close ();
+    } );
+    if ( legacyErrors <= 0.0 || exporterErrors <= 0.0 || legacyParticles <= 0.0 || exporterParticles <= 0.0 )
+    {
+        fprintf ( stderr , "Could not write %s\n" , TEXT_SCRATCH );
+        return 1;
+    }
+    fprintf ( stderr , "error lines: %.0f/s before, %.0f/s exported\nparticle lines: %.0f/s before, %.0f/s exported\n" ,
+        legacyErrors , exporterErrors , legacyParticles , exporterParticles );
+    FILE * fp = OpenOutput ( outName );
+    if ( fp == NULL )
+    {
+        fprintf ( stderr , "Could not write %s\n" , outName.c_str () );
+        return 1;
+    }
+    fprintf ( fp , "{\n  \"lines\": %d,\n  \"repeats\": %d,\n"
+        "  \"errorLines\": { \"legacyPerSecond\": %.0f, \"exporterPerSecond\": %.0f, \"speedup\": %.3f },\n"
+        "  \"particleLines\": { \"legacyPerSecond\": %.0f, \"exporterPerSecond\": %.0f, \"speedup\": %.3f }\n}\n" ,
+        TEXT_LINES_BENCH , repeats , legacyErrors , exporterErrors , exporterErrors / legacyErrors ,
+        legacyParticles , exporterParticles , exporterParticles / legacyParticles );
+    const bool written = ferror ( fp ) == 0;
+    return CloseOutput ( fp ) && written ? 0 : 1;
+}
+
+static void Usage ()
+{
+    fprintf ( stderr , "Usage: Benchmark [--duration seconds] [--step seconds] [--max-size particles] [--scenes directory] [--out file] [--counters]\n"
+        "       Benchmark --accuracy [--duration seconds] [--size particles] [--scenes directory] [--out file] [--plot file]\n"
+        "       Benchmark --obj file [--repeats count] [--out file]\n"
+        "       Benchmark --text [--repeats count] [--out file]\n"
+        "Writes the cost of each cloth size and sample scene under every integrator as JSON, to standard output with --out -.\n"
+        "With --accuracy, writes the error of every integrator over a sweep of steps against a fine reference, and plots it.\n"
+        "With --obj, writes how many MB/s the original and the memory-mapped OBJ loaders read from the file.\n"
+        "With --text, writes how many CSV lines per second the stream formatting of old and CTextExporter write.\n"
+        "With --counters, also counts processor events in each phase of the step where the system allows it. Reading them adds to the times.\n" );
+}
+
+int main ( int argc , char * argv [] )
+{
+#if defined(_WIN32)
+    // THE SIMULATION USES MFC FOR ITS DIALOGS, WHICH ARE NEVER SHOWN HERE
+    if ( ! AfxWinInit ( GetModuleHandle ( NULL ) , NULL , GetCommandLine () , 0 ) )
+    {
+        return 1;
+    }
+#endif
+    float duration = BENCH_DURATION , step = BENCH_STEP;
+    int maxSize = BENCH_MAX_SIZE , accuracySize = ACCURACY_SIZE , repeats = LOADOBJ_REPEATS;
+    bool accuracy = false , counters = false , text = false;
+    std::string sceneDir = "." , outName , plotName = ACCURACY_PLOT , objName;
+    for ( int at = 1; at < argc; ++at )
+    {
+        const bool hasValue = at + 1 < argc;
+        if ( std::strcmp ( argv [ at ] , "--accuracy" ) == 0 )
+        {
+            accuracy = true;
+        }
+        else if ( std::strcmp ( argv [ at ] , "--text" ) == 0 )
+        {
+            text = true;
+        }
+        else if ( std::strcmp ( argv [ at ] , "--counters" ) == 0 )
+        {
+            counters = true;
+        }
+        else if ( hasValue && std::strcmp ( argv [ at ] , "--duration" ) == 0 )
+        {
+            duration = static_cast < float > ( std::atof ( argv [ ++at ] ) );
+        }
+        else if ( hasValue && std::strcmp ( argv [ at ] , "--step" ) == 0 )
+        {
+            step = static_cast < float > ( std::atof ( argv [ ++at ] ) );
+        }
+        else if ( hasValue && std::strcmp ( argv [ at ] , "--max-size" ) == 0 )
+        {
+            maxSize = std::atoi ( argv [ ++at ] );
+        }
+        else if ( hasValue && std::strcmp ( argv [ at ] , "--size" ) == 0 )
+        {
+            accuracySize = std::atoi ( argv [ ++at ] );
+        }
+        else if ( hasValue && std::strcmp ( argv [ at ] , "--scenes" ) == 0 )
+        {
+            sceneDir = argv [ ++at ];
+        }
+        else if ( hasValue && std::strcmp ( argv [ at ] , "--out" ) == 0 )
+        {
+            outName = argv [ ++at ];
+        }
+        else if ( hasValue && std::strcmp ( argv [ at ] , "--plot" ) == 0 )
+        {
+            plotName = argv [ ++at ];
+        }
+        else if ( hasValue && std::strcmp ( argv [ at ] , "--obj" ) == 0 )
+        {
+            objName = argv [ ++at ];
+        }
+        else if ( hasValue && std::strcmp ( argv [ at ] , "--repeats" ) == 0 )
+        {
+            repeats = std::atoi ( argv [ ++at ] );
+        }
+        else
+        {
+            Usage ();
+            return 1;
+        }
+    }
+    if ( ! ( duration > 0.0f ) || ! ( step > 0.0f ) || accuracySize < 3 || repeats < 1 )
+    {
+        Usage ();
+        return 1;
+    }
+    if ( ! objName.empty () )
+    {
+        return RunLoadObj ( objName , repeats , outName.empty () ? LOADOBJ_FILE : outName );
+    }
+    if ( text )
+    {
+        return RunText ( repeats , outName.empty () ? TEXT_FILE : outName );
+    }
+    if ( accuracy )
+    {
+        return RunAccuracy ( BenchScenes ( sceneDir , std::vector < int > ( 1 , accuracySize ) ) , duration ,
+            outName.empty () ? ACCURACY_FILE : outName , plotName );
+    }
+
+    // THE SAMPLE SCENES ARE THE SMALLEST, SO THEY GO FIRST WHILE THE PEAK MEMORY IS STILL THEIR OWN
+    std::vector < int > sizes;
+    for ( const int size : CLOTH_SIZES )
+    {
+        if ( size <= maxSize )
+        {
+            sizes.push_back ( size );
+        }
+    }
+    // THE EVENTS ARE COUNTED ON THIS THREAD, WHICH RUNS EVERY STEP, AND ON THE WORKERS IT HANDS CHUNKS TO
+    if ( counters && ! CProfiler::CountHardware ( true ) )
+    {
+        fprintf ( stderr , "Running without processor events, %s\n" , CProfiler::HardwareError () );
+    }
+    else if ( counters && CProfiler::HardwareError () [ 0 ] != '\0' )
+    {
+        fprintf ( stderr , "Some processor events are missing, %s\n" , CProfiler::HardwareError () );
+    }
+    std::vector < tBenchResult > results;
+    for ( const tBenchScene & scene : BenchScenes ( sceneDir , sizes ) )
+    {
+        for ( int integrator = 0; integrator < INTEGRATOR_CNT; ++integrator )
+        {
+            CPhysEnv * env = MakeScene ( scene );
+            if ( env == NULL )
+            {
+                fprintf ( stderr , "Skipping %s, it could not be read\n" , scene.file.c_str () );
+                break;
+            }
+            tBenchResult result;
+            result.scene = scene.name;
+            RunSystem ( *env , integrator , duration , step , result );
+            results.push_back ( result );
+            delete env;
+            fprintf ( stderr , "%s %s: %.1f ns per particle step\n" , scene.name.c_str () , INTEGRATOR_NAMES [ integrator ] , result.nsPerParticleStep );
+        }
+    }
+    // THE PROFILER WOULD WRITE THE LAST RUN TO ITS OWN FILE AT EXIT
+    CProfiler::Instance ().Reset ();
+
+    if ( outName.empty () )
+    {
+        outName = BENCH_FILE;
+    }
+    FILE * fp = OpenOutput ( outName );
+    if ( fp == NULL )
+    {
+        fprintf ( stderr , "Could not write %s\n" , outName.c_str () );
+        return 1;
+    }
+    const bool written = WriteResults ( fp , duration , step , results );
+    return CloseOutput ( fp ) && written ? 0 : 1;
+}
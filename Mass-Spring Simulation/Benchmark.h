@@ -0,0 +1,51 @@
+#if !defined(BENCHMARK_H__INCLUDED_)
+#define BENCHMARK_H__INCLUDED_
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "PhysEnv.h"
+
+#define INTEGRATOR_CNT			6			// EVERY VALUE OF tIntegratorTypes
+
+/**
+ * \brief A system the benchmark runs: a sample .dps file, or a cloth patch of size by size particles when there is no file.
+ */
+struct tBenchScene
+{
+    std::string name;
+    std::string file;
+    int size;
+};
+
+extern const char * INTEGRATOR_NAMES [ INTEGRATOR_CNT ];
+
+/**
+ * \brief The sample scenes found in a directory, then the cloth patches of the sizes given.
+ */
+std::vector < tBenchScene > BenchScenes ( const std::string & sceneDir , const std::vector < int > & sizes );
+/**
+ * \brief A new system holding the scene, the same one each time.
+ * \return NULL when the file could not be read.
+ */
+CPhysEnv * MakeScene ( const tBenchScene & scene );
+std::string JsonString ( const std::string & text );
+/**
+ * \brief Opens a file to write, standard output for "-".
+ */
+FILE * OpenOutput ( const std::string & filename );
+bool CloseOutput ( FILE * fp );
+
+/**
+ * \brief Measures how far each integrator drifts from a reference over a sweep of step sizes, and what that accuracy costs.
+ *
+ * The reference of each scene is RK5 at ACCURACY_REFERENCE_DIVISIONS steps for every sample interval. Each integrator then runs from the
+ * same start with steps of ACCURACY_SAMPLE halved ACCURACY_LEVELS - 1 times, and the positions are compared with the reference at the end
+ * of every interval. A run costs its wall time in Simulate only. The runs no other run beats on both error and time make the Pareto
+ * front, which is written with the runs as JSON and plotted as SVG. The particles are single precision, so the errors level off where
+ * rounding takes over; RK5 at the finest step of the sweep shows where that is.
+ * \return The exit code of the program.
+ */
+int RunAccuracy ( const std::vector < tBenchScene > & scenes , float duration , const std::string & outName , const std::string & plotName );
+
+#endif // !defined(BENCHMARK_H__INCLUDED_)
@@ -0,0 +1,269 @@
+#include "stdafx.h"
+#include <algorithm>
+#include <cmath>
+#include "BoneColliders.h"
+#include "CCD.h"
+
+/**
+ * \brief The length a matrix gives to one of the unit axes, used to scale radii and half sizes.
+ */
+static float AxisScale ( const tMatrix & matrix , const int axis )
+{
+    const float * column = &matrix.m [ axis * 4 ];
+    return std::sqrt ( column [ 0 ] * column [ 0 ] + column [ 1 ] * column [ 1 ] + column [ 2 ] * column [ 2 ] );
+}
+
+/**
+ * \brief Radii can only be scaled uniformly, so use the largest scale to stay on the safe side.
+ */
+static float RadiusScale ( const tMatrix & matrix )
+{
+    return std::max ( AxisScale ( matrix , 0 ) , std::max ( AxisScale ( matrix , 1 ) , AxisScale ( matrix , 2 ) ) );
+}
+
+static tVector TransformPoint ( const tMatrix & matrix , const tVector & point )
+{
+    tVector result;
+    MultVectorByMatrix ( const_cast < tMatrix * > ( &matrix ) , const_cast < tVector * > ( &point ) , &result );
+    return result;
+}
+
+static tVector TransformDirection ( const tMatrix & matrix , const tVector & direction )
+{
+    tVector result;
+    MAKEVECTOR ( result , matrix.m [ 0 ] * direction.x + matrix.m [ 4 ] * direction.y + matrix.m [ 8 ] * direction.z ,
+                          matrix.m [ 1 ] * direction.x + matrix.m [ 5 ] * direction.y + matrix.m [ 9 ] * direction.z ,
+                          matrix.m [ 2 ] * direction.x + matrix.m [ 6 ] * direction.y + matrix.m [ 10 ] * direction.z )
+    return result;
+}
+
+static tVector Lerp ( const tVector & a , const tVector & b , const float t )
+{
+    tVector result;
+    MAKEVECTOR ( result , a.x + ( b.x - a.x ) * t , a.y + ( b.y - a.y ) * t , a.z + ( b.z - a.z ) * t )
+    return result;
+}
+
+static tVector Difference ( const tVector & a , const tVector & b )
+{
+    tVector result;
+    MAKEVECTOR ( result , a.x - b.x , a.y - b.y , a.z - b.z )
+    return result;
+}
+
+static tCollisionSphere Lerp ( const tCollisionSphere & a , const tCollisionSphere & b , const float t )
+{
+    tCollisionSphere result;
+    result.pos = Lerp ( a.pos , b.pos , t );
+    result.radius = a.radius + ( b.radius - a.radius ) * t;
+    return result;
+}
+
+/**
+ * \brief Interpolates two poses of a box. The interpolated axes are made orthonormal again, which is close enough to a proper rotation for the small turns of one frame.
+ */
+static tCollisionBox Lerp ( const tCollisionBox & a , const tCollisionBox & b , const float t )
+{
+    tCollisionBox result;
+    tVector along;
+    result.center = Lerp ( a.center , b.center , t );
+    result.halfSize = Lerp ( a.halfSize , b.halfSize , t );
+    result.axis [ 0 ] = Lerp ( a.axis [ 0 ] , b.axis [ 0 ] , t );
+    result.axis [ 1 ] = Lerp ( a.axis [ 1 ] , b.axis [ 1 ] , t );
+    NormalizeVector ( &result.axis [ 0 ] );
+    ScaleVector ( &result.axis [ 0 ] , static_cast < float > ( DotProduct ( &result.axis [ 1 ] , &result.axis [ 0 ] ) ) , &along );
+    VectorDifference ( &result.axis [ 1 ] , &along , &result.axis [ 1 ] );
+    NormalizeVector ( &result.axis [ 1 ] );
+    CrossProduct ( &result.axis [ 0 ] , &result.axis [ 1 ] , &result.axis [ 2 ] );
+    return result;
+}
+
+static tCollisionCapsule Lerp ( const tCollisionCapsule & a , const tCollisionCapsule & b , const float t )
+{
+    tCollisionCapsule result;
+    result.p1 = Lerp ( a.p1 , b.p1 , t );
+    result.p2 = Lerp ( a.p2 , b.p2 , t );
+    result.radius = a.radius + ( b.radius - a.radius ) * t;
+    return result;
+}
+
+static tCollisionSphere Transform ( const tMatrix & matrix , const tCollisionSphere & local )
+{
+    tCollisionSphere result;
+    result.pos = TransformPoint ( matrix , local.pos );
+    result.radius = local.radius * RadiusScale ( matrix );
+    return result;
+}
+
+static tCollisionBox Transform ( const tMatrix & matrix , const tCollisionBox & local )
+{
+    tCollisionBox result;
+    const float * halfSize = &local.halfSize.x;
+    float * resultHalfSize = &result.halfSize.x;
+    result.center = TransformPoint ( matrix , local.center );
+    for ( int i = 0; i < 3; ++i )
+    {
+        result.axis [ i ] = TransformDirection ( matrix , local.axis [ i ] );
+        resultHalfSize [ i ] = halfSize [ i ] * static_cast < float > ( VectorLength ( &result.axis [ i ] ) );
+        NormalizeVector ( &result.axis [ i ] );
+    }
+    return result;
+}
+
+static tCollisionCapsule Transform ( const tMatrix & matrix , const tCollisionCapsule & local )
+{
+    tCollisionCapsule result;
+    result.p1 = TransformPoint ( matrix , local.p1 );
+    result.p2 = TransformPoint ( matrix , local.p2 );
+    result.radius = local.radius * RadiusScale ( matrix );
+    return result;
+}
+
+/**
+ * \brief Adds a collider keeping the list sorted by bone, so the colliders of a bone are posed together.
+ */
+template < typename T >
+static void Attach ( std::vector < T > & list , t_Bone * bone , const T & posed )
+{
+    const auto after = std::upper_bound ( list.begin () , list.end () , bone , [] ( const t_Bone * key , const T & item ) { return key < item.bone; } );
+    list.insert ( after , posed );
+}
+
+/**
+ * \brief Poses one list of colliders. Consecutive colliders on the same bone share one lookup of the bone transform.
+ */
+template < typename T , typename Lookup >
+static void PoseList ( std::vector < T > & list , const bool keepStart , Lookup boneToRoot )
+{
+    const tMatrix * matrix = nullptr;
+    const t_Bone * bone = nullptr;
+    for ( T & item : list )
+    {
+        if ( item.bone != bone )
+        {
+            bone = item.bone;
+            matrix = &boneToRoot ( item.bone );
+        }
+        item.start = keepStart ? item.end : Transform ( *matrix , item.local );
+        item.end = Transform ( *matrix , item.local );
+    }
+}
+
+void CBoneColliders::AttachSphere ( t_Bone * bone , const tCollisionSphere & local )
+{
+    Attach ( this->spheres_ , bone , tPosed < tCollisionSphere > { bone , local , local , local } );
+    this->posed_ = false;
+}
+
+void CBoneColliders::AttachBox ( t_Bone * bone , const tCollisionBox & local )
+{
+    Attach ( this->boxes_ , bone , tPosed < tCollisionBox > { bone , local , local , local } );
+    this->posed_ = false;
+}
+
+void CBoneColliders::AttachCapsule ( t_Bone * bone , const tCollisionCapsule & local )
+{
+    Attach ( this->capsules_ , bone , tPosed < tCollisionCapsule > { bone , local , local , local } );
+    this->posed_ = false;
+}
+
+void CBoneColliders::AttachMesh ( t_Bone * bone , const int mesh , const tVector * local , const int vertexCnt , tVector * posed )
+{
+    tMeshAttachment attachment { bone , mesh , std::vector < tVector > ( local , local + vertexCnt ) , std::vector < tVector > ( vertexCnt ) };
+    // THE BONE MAY HAVE MOVED SINCE THE LAST UPDATE, SO ITS TRANSFORM IS NOT TAKEN FROM THERE
+    this->boneMatrices_.clear ();
+    const tMatrix & matrix = this->BoneToRoot ( bone );
+    for ( int i = 0; i < vertexCnt; ++i )
+    {
+        posed [ i ] = TransformPoint ( matrix , local [ i ] );
+    }
+    this->meshes_.push_back ( attachment );
+}
+
+void CBoneColliders::Clear ()
+{
+    this->spheres_.clear ();
+    this->boxes_.clear ();
+    this->capsules_.clear ();
+    this->meshes_.clear ();
+    this->boneMatrices_.clear ();
+    this->posed_ = false;
+}
+
+bool CBoneColliders::Empty () const
+{
+    return this->spheres_.empty () && this->boxes_.empty () && this->capsules_.empty ();
+}
+
+const tMatrix & CBoneColliders::BoneToRoot ( t_Bone * bone )
+{
+    const auto found = this->boneMatrices_.find ( bone );
+    if ( found != this->boneMatrices_.end () )
+    {
+        return found->second;
+    }
+    tMatrix matrix;
+    if ( bone->parent == NULL )
+    {
+        // THE ROOT IS THE SPACE OF THE SIMULATION
+        for ( int i = 0; i < 16; ++i )
+        {
+            matrix.m [ i ] = ( i % 5 == 0 ) ? 1.0f : 0.0f;
+        }
+    }
+    else
+    {
+        tMatrix local;
+        BoneLocalMatrix ( bone , &local );
+        MultMatrix ( const_cast < tMatrix * > ( &this->BoneToRoot ( bone->parent ) ) , &local , &matrix );
+    }
+    return this->boneMatrices_ [ bone ] = matrix;
+}
+
+void CBoneColliders::Update ()
+{
+    // THE BONES MAY HAVE MOVED SINCE THE LAST FRAME, SO EVERY TRANSFORM IS RECOMPUTED ONCE HERE
+    this->boneMatrices_.clear ();
+    const auto boneToRoot = [ this ] ( t_Bone * bone ) -> const tMatrix & { return this->BoneToRoot ( bone ); };
+    // A COLLIDER THAT WAS NEVER POSED STARTS WHERE IT ENDS, SO ATTACHING ONE DOES NOT MAKE IT JUMP
+    PoseList ( this->spheres_ , this->posed_ , boneToRoot );
+    PoseList ( this->boxes_ , this->posed_ , boneToRoot );
+    PoseList ( this->capsules_ , this->posed_ , boneToRoot );
+    this->posed_ = true;
+}
+
+void CBoneColliders::Pose ( const float from , const float to , tCollisionSphere * spheres , tVector * sphereMotion , tCollisionBox * boxes , tVector * boxMotion , tCollisionCapsule * capsules , tVector * capsuleMotion ) const
+{
+    for ( std::size_t i = 0; i < this->spheres_.size (); ++i )
+    {
+        const tPosed < tCollisionSphere > & item = this->spheres_ [ i ];
+        spheres [ i ] = Lerp ( item.start , item.end , to );
+        sphereMotion [ i ] = Difference ( spheres [ i ].pos , Lerp ( item.start.pos , item.end.pos , from ) );
+    }
+    for ( std::size_t i = 0; i < this->boxes_.size (); ++i )
+    {
+        const tPosed < tCollisionBox > & item = this->boxes_ [ i ];
+        boxes [ i ] = Lerp ( item.start , item.end , to );
+        boxMotion [ i ] = Difference ( boxes [ i ].center , Lerp ( item.start.center , item.end.center , from ) );
+    }
+    for ( std::size_t i = 0; i < this->capsules_.size (); ++i )
+    {
+        const tPosed < tCollisionCapsule > & item = this->capsules_ [ i ];
+        capsules [ i ] = Lerp ( item.start , item.end , to );
+        capsuleMotion [ i * 2 ] = Difference ( capsules [ i ].p1 , Lerp ( item.start.p1 , item.end.p1 , from ) );
+        capsuleMotion [ i * 2 + 1 ] = Difference ( capsules [ i ].p2 , Lerp ( item.start.p2 , item.end.p2 , from ) );
+    }
+}
+
+void CBoneColliders::MoveMeshes ( CMeshColliders & meshes )
+{
+    for ( tMeshAttachment & attachment : this->meshes_ )
+    {
+        const tMatrix & matrix = this->BoneToRoot ( attachment.bone );
+        for ( std::size_t i = 0; i < attachment.local.size (); ++i )
+        {
+            attachment.posed [ i ] = TransformPoint ( matrix , attachment.local [ i ] );
+        }
+        meshes.MoveMesh ( attachment.mesh , attachment.posed.data () );
+    }
+}
@@ -0,0 +1,122 @@
+#if !defined(BONECOLLIDERS_H__INCLUDED_)
+#define BONECOLLIDERS_H__INCLUDED_
+
+#include <unordered_map>
+#include <vector>
+#include "PhysEnv.h"
+#include "Skeleton.h"
+
+class CMeshColliders;
+
+/**
+ * \brief Collision spheres, boxes and capsules that follow bones of the skeleton.
+ *
+ * Each collider is given in the space of its bone. Update poses all of them from the bone hierarchy once per frame and keeps the pose of the previous frame,
+ * so Pose can place them anywhere in between and report how far they moved, which the collision kernel turns into a swept test and a collider velocity.
+ * All the transforms are relative to the skeleton root, which is the space the particles live in.
+ */
+class CBoneColliders
+{
+public:
+    /**
+     * \brief Attaches a sphere to a bone.
+     * \param bone The bone to follow. It must stay alive until Clear is called.
+     * \param local The sphere in bone space.
+     */
+    void AttachSphere ( t_Bone * bone , const tCollisionSphere & local );
+    /**
+     * \brief Attaches an oriented box to a bone.
+     * \param bone The bone to follow. It must stay alive until Clear is called.
+     * \param local The box in bone space. Its axes must be orthonormal.
+     */
+    void AttachBox ( t_Bone * bone , const tCollisionBox & local );
+    /**
+     * \brief Attaches a capsule to a bone.
+     * \param bone The bone to follow. It must stay alive until Clear is called.
+     * \param local The capsule in bone space.
+     */
+    void AttachCapsule ( t_Bone * bone , const tCollisionCapsule & local );
+    /**
+     * \brief Makes a collision mesh follow a bone.
+     * \param bone The bone to follow. It must stay alive until Clear is called.
+     * \param mesh The index CMeshColliders gave the mesh.
+     * \param local The vertices in bone space.
+     * \param vertexCnt The number of vertices, as many as the mesh has.
+     * \param posed Where to write the vertices where the bone is now, to add the mesh with so it does not jump on its first frame.
+     */
+    void AttachMesh ( t_Bone * bone , int mesh , const tVector * local , int vertexCnt , tVector * posed );
+    /**
+     * \brief Detaches every collider.
+     */
+    void Clear ();
+    /**
+     * \return True when no sphere, box or capsule is attached. The meshes are counted by MeshCount.
+     */
+    bool Empty () const;
+    /**
+     * \brief Poses every collider from the current state of its bone. The pose of the last update becomes the start of the frame.
+     *
+     * Each bone transform is computed once, however many colliders it carries, and the parents are shared between their children.
+     */
+    void Update ();
+    /**
+     * \brief Places the colliders part of the way through the frame and reports how far they moved since an earlier point.
+     * \param from The earlier fraction of the frame, 0 being the pose before the last update.
+     * \param to The fraction of the frame to place the colliders at, 1 being the pose of the last update.
+     * \param spheres Where to write SphereCount spheres. sphereMotion gets how far each center moved.
+     * \param boxes Where to write BoxCount boxes. boxMotion gets how far each center moved.
+     * \param capsules Where to write CapsuleCount capsules. capsuleMotion gets how far each end moved, two per capsule.
+     */
+    void Pose ( float from , float to , tCollisionSphere * spheres , tVector * sphereMotion , tCollisionBox * boxes , tVector * boxMotion , tCollisionCapsule * capsules , tVector * capsuleMotion ) const;
+    /**
+     * \brief Sends the attached meshes to where their bones are, as the end of the next frame of the meshes. Called after Update.
+     */
+    void MoveMeshes ( CMeshColliders & meshes );
+    int SphereCount () const { return static_cast < int > ( this->spheres_.size () ); }
+    int BoxCount () const { return static_cast < int > ( this->boxes_.size () ); }
+    int CapsuleCount () const { return static_cast < int > ( this->capsules_.size () ); }
+    /**
+     * \brief The bone the at-th collider of a kind follows, and the shape it was attached with in bone space. Used to save the attachments.
+     */
+    t_Bone * SphereBone ( int at ) const { return this->spheres_ [ at ].bone; }
+    const tCollisionSphere & LocalSphere ( int at ) const { return this->spheres_ [ at ].local; }
+    t_Bone * BoxBone ( int at ) const { return this->boxes_ [ at ].bone; }
+    const tCollisionBox & LocalBox ( int at ) const { return this->boxes_ [ at ].local; }
+    t_Bone * CapsuleBone ( int at ) const { return this->capsules_ [ at ].bone; }
+    const tCollisionCapsule & LocalCapsule ( int at ) const { return this->capsules_ [ at ].local; }
+    int MeshCount () const { return static_cast < int > ( this->meshes_.size () ); }
+    t_Bone * MeshBone ( int at ) const { return this->meshes_ [ at ].bone; }
+    int MeshIndex ( int at ) const { return this->meshes_ [ at ].mesh; }
+    const std::vector < tVector > & LocalMesh ( int at ) const { return this->meshes_ [ at ].local; }
+private:
+    /**
+     * \brief A collider shape in bone space with its pose at the start and at the end of the frame.
+     */
+    template < typename T >
+    struct tPosed
+    {
+        t_Bone * bone;
+        T local;
+        T start;
+        T end;
+    };
+    /**
+     * \brief A mesh in bone space. Where it is posed is kept by CMeshColliders.
+     */
+    struct tMeshAttachment
+    {
+        t_Bone * bone;
+        int mesh;
+        std::vector < tVector > local;
+        std::vector < tVector > posed;
+    };
+    const tMatrix & BoneToRoot ( t_Bone * bone );
+    std::vector < tPosed < tCollisionSphere > > spheres_;
+    std::vector < tPosed < tCollisionBox > > boxes_;
+    std::vector < tPosed < tCollisionCapsule > > capsules_;
+    std::vector < tMeshAttachment > meshes_;
+    std::unordered_map < const t_Bone * , tMatrix > boneMatrices_;
+    bool posed_ = false;
+};
+
+#endif // !defined(BONECOLLIDERS_H__INCLUDED_)
@@ -0,0 +1,637 @@
+#include "stdafx.h"
+#include <algorithm>
+#include <cmath>
+#include "CCD.h"
+#include "CollisionKernel.h"
+#include "SimdLanes.h"
+
+// SMALL VECTOR HELPERS THAT LEAVE THEIR ARGUMENTS ALONE
+
+static inline tVector Make ( const float x , const float y , const float z )
+{
+    tVector result;
+    MAKEVECTOR ( result , x , y , z )
+    return result;
+}
+
+static inline tVector Add ( const tVector & a , const tVector & b ) { return Make ( a.x + b.x , a.y + b.y , a.z + b.z ); }
+static inline tVector Sub ( const tVector & a , const tVector & b ) { return Make ( a.x - b.x , a.y - b.y , a.z - b.z ); }
+static inline tVector Scale ( const tVector & a , const float s ) { return Make ( a.x * s , a.y * s , a.z * s ); }
+static inline float Dot ( const tVector & a , const tVector & b ) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+static inline tVector Cross ( const tVector & a , const tVector & b ) { return Make ( a.y * b.z - a.z * b.y , a.z * b.x - a.x * b.z , a.x * b.y - a.y * b.x ); }
+static inline tVector Lerp ( const tVector & a , const tVector & b , const float t ) { return Make ( a.x + ( b.x - a.x ) * t , a.y + ( b.y - a.y ) * t , a.z + ( b.z - a.z ) * t ); }
+
+/**
+ * \brief The closest point of triangle abc to p, with its barycentric weights.
+ */
+static tVector ClosestPointOnTriangle ( const tVector & p , const tVector & a , const tVector & b , const tVector & c , float weights [ 3 ] )
+{
+    const tVector ab = Sub ( b , a ) , ac = Sub ( c , a ) , ap = Sub ( p , a );
+    const float d1 = Dot ( ab , ap ) , d2 = Dot ( ac , ap );
+    // VERTEX REGIONS FIRST, THEN EDGE REGIONS, THEN THE FACE
+    if ( d1 <= 0.0f && d2 <= 0.0f )
+    {
+        weights [ 0 ] = 1.0f; weights [ 1 ] = 0.0f; weights [ 2 ] = 0.0f;
+        return a;
+    }
+    const tVector bp = Sub ( p , b );
+    const float d3 = Dot ( ab , bp ) , d4 = Dot ( ac , bp );
+    if ( d3 >= 0.0f && d4 <= d3 )
+    {
+        weights [ 0 ] = 0.0f; weights [ 1 ] = 1.0f; weights [ 2 ] = 0.0f;
+        return b;
+    }
+    const float vc = d1 * d4 - d3 * d2;
+    if ( vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f )
+    {
+        const float v = d1 / ( d1 - d3 );
+        weights [ 0 ] = 1.0f - v; weights [ 1 ] = v; weights [ 2 ] = 0.0f;
+        return Add ( a , Scale ( ab , v ) );
+    }
+    const tVector cp = Sub ( p , c );
+    const float d5 = Dot ( ab , cp ) , d6 = Dot ( ac , cp );
+    if ( d6 >= 0.0f && d5 <= d6 )
+    {
+        weights [ 0 ] = 0.0f; weights [ 1 ] = 0.0f; weights [ 2 ] = 1.0f;
+        return c;
+    }
+    const float vb = d5 * d2 - d1 * d6;
+    if ( vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f )
+    {
+        const float w = d2 / ( d2 - d6 );
+        weights [ 0 ] = 1.0f - w; weights [ 1 ] = 0.0f; weights [ 2 ] = w;
+        return Add ( a , Scale ( ac , w ) );
+    }
+    const float va = d3 * d6 - d5 * d4;
+    if ( va <= 0.0f && ( d4 - d3 ) >= 0.0f && ( d5 - d6 ) >= 0.0f )
+    {
+        const float w = ( d4 - d3 ) / ( ( d4 - d3 ) + ( d5 - d6 ) );
+        weights [ 0 ] = 0.0f; weights [ 1 ] = 1.0f - w; weights [ 2 ] = w;
+        return Add ( b , Scale ( Sub ( c , b ) , w ) );
+    }
+    const float denominator = 1.0f / ( va + vb + vc );
+    const float v = vb * denominator , w = vc * denominator;
+    weights [ 0 ] = 1.0f - v - w; weights [ 1 ] = v; weights [ 2 ] = w;
+    return Add ( a , Add ( Scale ( ab , v ) , Scale ( ac , w ) ) );
+}
+
+/**
+ * \brief The closest points of segments p1q1 and p2q2, as fractions s and t along each.
+ * \return The squared distance between them.
+ */
+static float ClosestSegmentPoints ( const tVector & p1 , const tVector & q1 , const tVector & p2 , const tVector & q2 , float & s , float & t )
+{
+    const tVector d1 = Sub ( q1 , p1 ) , d2 = Sub ( q2 , p2 ) , r = Sub ( p1 , p2 );
+    const float a = Dot ( d1 , d1 ) , e = Dot ( d2 , d2 ) , f = Dot ( d2 , r );
+    const float tiny = 1e-20f;
+    if ( a <= tiny && e <= tiny )
+    {
+        s = t = 0.0f;
+    }
+    else if ( a <= tiny )
+    {
+        s = 0.0f;
+        t = std::min ( std::max ( f / e , 0.0f ) , 1.0f );
+    }
+    else
+    {
+        const float c = Dot ( d1 , r );
+        if ( e <= tiny )
+        {
+            t = 0.0f;
+            s = std::min ( std::max ( -c / a , 0.0f ) , 1.0f );
+        }
+        else
+        {
+            const float b = Dot ( d1 , d2 ) , denominator = a * e - b * b;
+            s = denominator > tiny ? std::min ( std::max ( ( b * f - c * e ) / denominator , 0.0f ) , 1.0f ) : 0.0f;
+            t = ( b * s + f ) / e;
+            if ( t < 0.0f )
+            {
+                t = 0.0f;
+                s = std::min ( std::max ( -c / a , 0.0f ) , 1.0f );
+            }
+            else if ( t > 1.0f )
+            {
+                t = 1.0f;
+                s = std::min ( std::max ( ( b - c ) / a , 0.0f ) , 1.0f );
+            }
+        }
+    }
+    const tVector between = Sub ( Add ( p1 , Scale ( d1 , s ) ) , Add ( p2 , Scale ( d2 , t ) ) );
+    return Dot ( between , between );
+}
+
+/**
+ * \brief Three vectors that each move in a straight line during the step, for COLLISION_BATCH candidates, in structure of arrays form.
+ *
+ * The four points of a candidate are coplanar when (u x v) . w is zero, which is a cubic in the time of the step.
+ */
+struct tCubicBatch
+{
+    float start [ 3 ] [ 3 ] [ COLLISION_BATCH ];	// [ VECTOR ] [ AXIS ] [ LANE ] AT THE START OF THE STEP
+    float delta [ 3 ] [ 3 ] [ COLLISION_BATCH ];	// HOW MUCH EACH CHANGES OVER THE STEP
+    float roots [ 3 ] [ COLLISION_BATCH ];			// UP TO THREE ROOTS IN [0, 1] IN INCREASING ORDER, 2 WHEN THERE IS NONE
+};
+
+static inline void SetLane ( tCubicBatch & batch , const int vector , const int lane , const tVector & start , const tVector & end )
+{
+    batch.start [ vector ] [ 0 ] [ lane ] = start.x;
+    batch.start [ vector ] [ 1 ] [ lane ] = start.y;
+    batch.start [ vector ] [ 2 ] [ lane ] = start.z;
+    batch.delta [ vector ] [ 0 ] [ lane ] = end.x - start.x;
+    batch.delta [ vector ] [ 1 ] [ lane ] = end.y - start.y;
+    batch.delta [ vector ] [ 2 ] [ lane ] = end.z - start.z;
+}
+
+struct tVector8
+{
+    tFloat8 x , y , z;
+};
+
+static inline tVector8 Load ( const float ( &v ) [ 3 ] [ COLLISION_BATCH ] )
+{
+    tVector8 result = { Load8 ( v [ 0 ] ) , Load8 ( v [ 1 ] ) , Load8 ( v [ 2 ] ) };
+    return result;
+}
+
+static inline tVector8 Cross8 ( const tVector8 & a , const tVector8 & b )
+{
+    tVector8 result = { a.y * b.z - a.z * b.y , a.z * b.x - a.x * b.z , a.x * b.y - a.y * b.x };
+    return result;
+}
+
+static inline tVector8 Add8 ( const tVector8 & a , const tVector8 & b )
+{
+    tVector8 result = { a.x + b.x , a.y + b.y , a.z + b.z };
+    return result;
+}
+
+static inline tFloat8 Dot8 ( const tVector8 & a , const tVector8 & b )
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+static inline tFloat8 Cubic8 ( const tFloat8 c [ 4 ] , const tFloat8 & t )
+{
+    return ( ( c [ 3 ] * t + c [ 2 ] ) * t + c [ 1 ] ) * t + c [ 0 ];
+}
+
+/**
+ * \brief Finds the roots in [0, 1] of the coplanarity cubic of every lane.
+ *
+ * The turning points of the cubic split [0, 1] into at most three intervals where it is monotonic. Each interval with a sign change holds exactly one root,
+ * found by bisection in all lanes at once. The lower end of the final bracket is kept, so the root never lies past the real crossing.
+ */
+static void SolveCubics ( tCubicBatch & batch )
+{
+    const tFloat8 zero = Set8 ( 0.0f ) , one = Set8 ( 1.0f ) , half = Set8 ( 0.5f ) , tiny = Set8 ( 1e-20f ) , none = Set8 ( 2.0f );
+    const tVector8 u0 = Load ( batch.start [ 0 ] ) , u1 = Load ( batch.delta [ 0 ] );
+    const tVector8 v0 = Load ( batch.start [ 1 ] ) , v1 = Load ( batch.delta [ 1 ] );
+    const tVector8 w0 = Load ( batch.start [ 2 ] ) , w1 = Load ( batch.delta [ 2 ] );
+    // (u0 + t u1) x (v0 + t v1) = x0 + t x1 + t^2 x2
+    const tVector8 x0 = Cross8 ( u0 , v0 ) , x1 = Add8 ( Cross8 ( u0 , v1 ) , Cross8 ( u1 , v0 ) ) , x2 = Cross8 ( u1 , v1 );
+    tFloat8 c [ 4 ];
+    c [ 0 ] = Dot8 ( x0 , w0 );
+    c [ 1 ] = Dot8 ( x0 , w1 ) + Dot8 ( x1 , w0 );
+    c [ 2 ] = Dot8 ( x1 , w1 ) + Dot8 ( x2 , w0 );
+    c [ 3 ] = Dot8 ( x2 , w1 );
+    // TURNING POINTS: ROOTS OF 3 c3 t^2 + 2 c2 t + c1, USING THE STABLE FORM OF THE QUADRATIC FORMULA
+    const tFloat8 a = Set8 ( 3.0f ) * c [ 3 ] , b = Set8 ( 2.0f ) * c [ 2 ] , cc = c [ 1 ];
+    const tFloat8 discriminant = b * b - Set8 ( 4.0f ) * a * cc;
+    const tFloat8 root = Sqrt8 ( Max8 ( discriminant , zero ) );
+    const tFloat8 q = Set8 ( -0.5f ) * ( b + Select8 ( Less8 ( b , zero ) , zero - root , root ) );
+    const tFloat8 absA = Max8 ( a , zero - a ) , absB = Max8 ( b , zero - b ) , absQ = Max8 ( q , zero - q );
+    const tFloat8 quadratic = Less8 ( tiny , absA );
+    const tFloat8 safeQ = Select8 ( Less8 ( absQ , tiny ) , tiny , q );
+    const tFloat8 r1 = Select8 ( quadratic , q / Select8 ( quadratic , a , one ) , zero - cc / Select8 ( Less8 ( absB , tiny ) , one , b ) );
+    const tFloat8 r2 = Select8 ( quadratic , cc / safeQ , r1 );
+    // NO TURNING POINT WHEN THE DISCRIMINANT IS NEGATIVE OR THE DERIVATIVE IS CONSTANT
+    const tFloat8 flat = Or8 ( And8 ( quadratic , Less8 ( discriminant , zero ) ) , AndNot8 ( quadratic , Less8 ( absB , tiny ) ) );
+    const tFloat8 low = Select8 ( flat , one , Min8 ( Max8 ( Min8 ( r1 , r2 ) , zero ) , one ) );
+    const tFloat8 high = Select8 ( flat , one , Min8 ( Max8 ( Max8 ( r1 , r2 ) , zero ) , one ) );
+    const tFloat8 bounds [ 4 ] = { zero , low , high , one };
+    for ( int interval = 0; interval < 3; ++interval )
+    {
+        tFloat8 lo = bounds [ interval ] , hi = bounds [ interval + 1 ];
+        tFloat8 fLo = Cubic8 ( c , lo );
+        const tFloat8 fHi = Cubic8 ( c , hi );
+        const tFloat8 bracketed = Or8 ( Less8 ( fLo * fHi , zero ) , Less8 ( fLo * fLo , tiny * tiny ) );
+        if ( Mask8 ( bracketed ) == 0 )
+        {
+            Store8 ( batch.roots [ interval ] , none );
+            continue;
+        }
+        for ( int step = 0; step < CCD_BISECTIONS; ++step )
+        {
+            const tFloat8 middle = ( lo + hi ) * half;
+            const tFloat8 fMiddle = Cubic8 ( c , middle );
+            // KEEP THE HALF WHERE THE SIGN CHANGES. A LOWER END THAT IS ALREADY A ROOT STAYS PUT
+            const tFloat8 sameSide = Less8 ( zero , fLo * fMiddle );
+            lo = Select8 ( sameSide , middle , lo );
+            fLo = Select8 ( sameSide , fMiddle , fLo );
+            hi = Select8 ( sameSide , hi , middle );
+        }
+        Store8 ( batch.roots [ interval ] , Select8 ( bracketed , lo , none ) );
+    }
+}
+
+/**
+ * \brief Which side of a surface a point comes from. Far enough from it at the start that is clear, otherwise it is the side the point moves away from.
+ */
+static inline float ApproachSide ( const float startDistance , const float relativeMotion , const float endDistance , const float depthEpsilon )
+{
+    if ( std::fabs ( startDistance ) > depthEpsilon )
+    {
+        return startDistance > 0.0f ? 1.0f : -1.0f;
+    }
+    if ( relativeMotion != 0.0f )
+    {
+        return relativeMotion < 0.0f ? 1.0f : -1.0f;
+    }
+    return endDistance >= 0.0f ? 1.0f : -1.0f;
+}
+
+/**
+ * \brief A candidate pair from the broadphase: a particle or spring and a triangle or edge of a mesh.
+ */
+struct tCandidate
+{
+    int cloth;
+    int mesh;
+    int primitive;
+};
+
+struct alignas ( 64 ) CMeshColliders::tPairResult
+{
+    bool penetrating;
+    bool colliding;
+    float impact;
+};
+
+int CMeshColliders::AddMesh ( const tVector * vertices , const int vertexCnt , const int * triangles , const int triangleCnt )
+{
+    tCollisionMesh mesh;
+    mesh.frameStart.assign ( vertices , vertices + vertexCnt );
+    mesh.frameEnd = mesh.next = mesh.stepStart = mesh.stepEnd = mesh.frameStart;
+    mesh.triangles.assign ( triangles , triangles + triangleCnt * 3 );
+    // EVERY EDGE ONCE: SORT THE (LOW, HIGH) PAIRS AND DROP THE REPEATS
+    std::vector < std::pair < int , int > > edges;
+    edges.reserve ( triangleCnt * 3 );
+    for ( int i = 0; i < triangleCnt * 3; i += 3 )
+    {
+        for ( int corner = 0; corner < 3; ++corner )
+        {
+            const int a = triangles [ i + corner ] , b = triangles [ i + ( corner + 1 ) % 3 ];
+            edges.push_back ( std::make_pair ( std::min ( a , b ) , std::max ( a , b ) ) );
+        }
+    }
+    std::sort ( edges.begin () , edges.end () );
+    edges.erase ( std::unique ( edges.begin () , edges.end () ) , edges.end () );
+    for ( const std::pair < int , int > & edge : edges )
+    {
+        mesh.edges.push_back ( edge.first );
+        mesh.edges.push_back ( edge.second );
+    }
+    this->meshes_.push_back ( mesh );
+    return static_cast < int > ( this->meshes_.size () ) - 1;
+}
+
+void CMeshColliders::MoveMesh ( const int mesh , const tVector * vertices )
+{
+    tCollisionMesh & target = this->meshes_ [ mesh ];
+    std::copy ( vertices , vertices + target.next.size () , target.next.begin () );
+}
+
+void CMeshColliders::Clear ()
+{
+    this->meshes_.clear ();
+    this->triangleBoxes_.clear ();
+    this->edgeBoxes_.clear ();
+}
+
+bool CMeshColliders::Empty () const
+{
+    return this->meshes_.empty ();
+}
+
+void CMeshColliders::Update ()
+{
+    for ( tCollisionMesh & mesh : this->meshes_ )
+    {
+        mesh.frameStart = mesh.frameEnd;
+        mesh.frameEnd = mesh.next;
+    }
+}
+
+/**
+ * \brief Grows a box to take in a point.
+ */
+static inline void Extend ( tSweptBox & box , const tVector & p )
+{
+    box.min = Make ( std::min ( box.min.x , p.x ) , std::min ( box.min.y , p.y ) , std::min ( box.min.z , p.z ) );
+    box.max = Make ( std::max ( box.max.x , p.x ) , std::max ( box.max.y , p.y ) , std::max ( box.max.z , p.z ) );
+}
+
+/**
+ * \brief The box around a set of vertices of a mesh at the start and the end of the step, grown by a margin.
+ */
+static tSweptBox SweptBox ( const tCollisionMesh & mesh , const int * vertex , const int vertexCnt , const float margin , const int meshIndex , const int primitive )
+{
+    tSweptBox box;
+    box.min = box.max = mesh.stepStart [ vertex [ 0 ] ];
+    for ( int i = 0; i < vertexCnt; ++i )
+    {
+        Extend ( box , mesh.stepStart [ vertex [ i ] ] );
+        Extend ( box , mesh.stepEnd [ vertex [ i ] ] );
+    }
+    box.min = Sub ( box.min , Make ( margin , margin , margin ) );
+    box.max = Add ( box.max , Make ( margin , margin , margin ) );
+    box.mesh = meshIndex;
+    box.primitive = primitive;
+    return box;
+}
+
+/**
+ * \brief Sorts a list of boxes by their lowest x for the sweep.
+ * \return The widest box along x.
+ */
+static float SortBoxes ( std::vector < tSweptBox > & boxes )
+{
+    float widest = 0.0f;
+    std::sort ( boxes.begin () , boxes.end () , [] ( const tSweptBox & a , const tSweptBox & b ) { return a.min.x < b.min.x; } );
+    for ( const tSweptBox & box : boxes )
+    {
+        widest = std::max ( widest , box.max.x - box.min.x );
+    }
+    return widest;
+}
+
+void CMeshColliders::Pose ( const float from , const float to , const float margin )
+{
+    this->triangleBoxes_.clear ();
+    this->edgeBoxes_.clear ();
+    for ( int m = 0; m < static_cast < int > ( this->meshes_.size () ); ++m )
+    {
+        tCollisionMesh & mesh = this->meshes_ [ m ];
+        for ( std::size_t i = 0; i < mesh.frameEnd.size (); ++i )
+        {
+            mesh.stepStart [ i ] = Lerp ( mesh.frameStart [ i ] , mesh.frameEnd [ i ] , from );
+            mesh.stepEnd [ i ] = Lerp ( mesh.frameStart [ i ] , mesh.frameEnd [ i ] , to );
+        }
+        for ( int i = 0; i < static_cast < int > ( mesh.triangles.size () ); i += 3 )
+        {
+            this->triangleBoxes_.push_back ( SweptBox ( mesh , &mesh.triangles [ i ] , 3 , margin , m , i / 3 ) );
+        }
+        for ( int i = 0; i < static_cast < int > ( mesh.edges.size () ); i += 2 )
+        {
+            this->edgeBoxes_.push_back ( SweptBox ( mesh , &mesh.edges [ i ] , 2 , margin , m , i / 2 ) );
+        }
+    }
+    this->widestTriangle_ = SortBoxes ( this->triangleBoxes_ );
+    this->widestEdge_ = SortBoxes ( this->edgeBoxes_ );
+}
+
+template < typename Visit >
+void CMeshColliders::Query ( const std::vector < tSweptBox > & boxes , const float widest , const tSweptBox & box , Visit visit ) const
+{
+    // NOTHING STARTING BEFORE min.x - widest CAN REACH min.x, AND THE SWEEP STOPS AT THE FIRST BOX STARTING AFTER max.x
+    const float first = box.min.x - widest;
+    auto item = std::lower_bound ( boxes.begin () , boxes.end () , first , [] ( const tSweptBox & b , const float x ) { return b.min.x < x; } );
+    for ( ; item != boxes.end () && item->min.x <= box.max.x; ++item )
+    {
+        if ( item->max.x >= box.min.x && item->min.y <= box.max.y && item->max.y >= box.min.y && item->min.z <= box.max.z && item->max.z >= box.min.z )
+        {
+            visit ( *item );
+        }
+    }
+}
+
+void CMeshColliders::CollideParticles ( const tParticle * previous , const tParticle * current , const int begin , const int end , const float stepTime , const float depthEpsilon , std::vector < tContact > & contacts , tPairResult & result ) const
+{
+    static thread_local std::vector < tCandidate > candidates;
+    candidates.clear ();
+    for ( int i = begin; i < end; ++i )
+    {
+        tSweptBox box;
+        box.min = box.max = previous [ i ].pos;
+        Extend ( box , current [ i ].pos );
+        this->Query ( this->triangleBoxes_ , this->widestTriangle_ , box , [ i ] ( const tSweptBox & hit )
+        {
+            candidates.push_back ( tCandidate { i , hit.mesh , hit.primitive } );
+        } );
+    }
+    tCubicBatch batch;
+    const float overStep = stepTime > 0.0f ? 1.0f / stepTime : 0.0f;
+    for ( std::size_t first = 0; first < candidates.size (); first += COLLISION_BATCH )
+    {
+        const int count = static_cast < int > ( std::min < std::size_t > ( COLLISION_BATCH , candidates.size () - first ) );
+        // (b - a) x (c - a) . (p - a) IS ZERO WHEN THE PARTICLE IS IN THE PLANE OF THE TRIANGLE
+        for ( int lane = 0; lane < COLLISION_BATCH; ++lane )
+        {
+            const tCandidate & candidate = candidates [ first + std::min ( lane , count - 1 ) ];
+            const tCollisionMesh & mesh = this->meshes_ [ candidate.mesh ];
+            const int * corner = &mesh.triangles [ candidate.primitive * 3 ];
+            const tVector & a0 = mesh.stepStart [ corner [ 0 ] ] , & a1 = mesh.stepEnd [ corner [ 0 ] ];
+            SetLane ( batch , 0 , lane , Sub ( mesh.stepStart [ corner [ 1 ] ] , a0 ) , Sub ( mesh.stepEnd [ corner [ 1 ] ] , a1 ) );
+            SetLane ( batch , 1 , lane , Sub ( mesh.stepStart [ corner [ 2 ] ] , a0 ) , Sub ( mesh.stepEnd [ corner [ 2 ] ] , a1 ) );
+            SetLane ( batch , 2 , lane , Sub ( previous [ candidate.cloth ].pos , a0 ) , Sub ( current [ candidate.cloth ].pos , a1 ) );
+        }
+        SolveCubics ( batch );
+        for ( int lane = 0; lane < count; ++lane )
+        {
+            const tCandidate & candidate = candidates [ first + lane ];
+            const tCollisionMesh & mesh = this->meshes_ [ candidate.mesh ];
+            const int * corner = &mesh.triangles [ candidate.primitive * 3 ];
+            const tVector * start = mesh.stepStart.data () , * finish = mesh.stepEnd.data ();
+            const tVector & p0 = previous [ candidate.cloth ].pos , & p1 = current [ candidate.cloth ].pos;
+            float weights [ 3 ];
+            // THE EARLIEST ROOT WHERE THE PARTICLE IS ACTUALLY ON THE TRIANGLE, NOT JUST IN ITS PLANE
+            float impact = 2.0f;
+            for ( int r = 0; r < 3 && impact > 1.0f; ++r )
+            {
+                const float t = batch.roots [ r ] [ lane ];
+                if ( t > 1.0f )
+                {
+                    continue;
+                }
+                const tVector p = Lerp ( p0 , p1 , t );
+                const tVector closest = ClosestPointOnTriangle ( p , Lerp ( start [ corner [ 0 ] ] , finish [ corner [ 0 ] ] , t ) , Lerp ( start [ corner [ 1 ] ] , finish [ corner [ 1 ] ] , t ) , Lerp ( start [ corner [ 2 ] ] , finish [ corner [ 2 ] ] , t ) , weights );
+                if ( Dot ( Sub ( p , closest ) , Sub ( p , closest ) ) <= depthEpsilon * depthEpsilon )
+                {
+                    impact = t;
+                }
+            }
+            tVector normal0 = Cross ( Sub ( start [ corner [ 1 ] ] , start [ corner [ 0 ] ] ) , Sub ( start [ corner [ 2 ] ] , start [ corner [ 0 ] ] ) );
+            tVector normal1 = Cross ( Sub ( finish [ corner [ 1 ] ] , finish [ corner [ 0 ] ] ) , Sub ( finish [ corner [ 2 ] ] , finish [ corner [ 0 ] ] ) );
+            if ( Dot ( normal1 , normal1 ) <= 1e-20f )
+            {
+                continue;	// DEGENERATE TRIANGLE
+            }
+            NormalizeVector ( &normal0 );
+            NormalizeVector ( &normal1 );
+            const tVector closest = ClosestPointOnTriangle ( p1 , finish [ corner [ 0 ] ] , finish [ corner [ 1 ] ] , finish [ corner [ 2 ] ] , weights );
+            tVector motion = Make ( 0.0f , 0.0f , 0.0f );
+            for ( int k = 0; k < 3; ++k )
+            {
+                motion = Add ( motion , Scale ( Sub ( finish [ corner [ k ] ] , start [ corner [ k ] ] ) , weights [ k ] ) );
+            }
+            const float endDistance = Dot ( normal1 , Sub ( p1 , finish [ corner [ 0 ] ] ) );
+            const float side = ApproachSide ( Dot ( normal0 , Sub ( p0 , start [ corner [ 0 ] ] ) ) , Dot ( Sub ( Sub ( p1 , p0 ) , motion ) , normal1 ) , endDistance , depthEpsilon );
+            if ( impact <= 1.0f && side * endDistance < -depthEpsilon )
+            {
+                // WENT THROUGH THE TRIANGLE AND ENDED ON THE OTHER SIDE. A LATER CANDIDATE MAY STILL HIT EARLIER, SO KEEP GOING
+                result.penetrating = true;
+                result.impact = std::min ( result.impact , impact );
+                continue;
+            }
+            if ( Dot ( Sub ( p1 , closest ) , Sub ( p1 , closest ) ) < depthEpsilon * depthEpsilon )
+            {
+                tContact contact;
+                contact.particle = candidate.cloth;
+                contact.normal = Scale ( normal1 , side );
+                contact.velocity = Scale ( motion , overStep );
+                if ( Dot ( Sub ( current [ candidate.cloth ].v , contact.velocity ) , contact.normal ) < 0.0f )
+                {
+                    contacts.push_back ( contact );
+                    result.colliding = true;
+                }
+            }
+        }
+    }
+}
+
+void CMeshColliders::CollideEdges ( const tParticle * previous , const tParticle * current , const tSpring * springs , const int begin , const int end , const float stepTime , const float depthEpsilon , std::vector < tContact > & contacts , tPairResult & result ) const
+{
+    static thread_local std::vector < tCandidate > candidates;
+    candidates.clear ();
+    for ( int i = begin; i < end; ++i )
+    {
+        // BEND SPRINGS SKIP A PARTICLE SO THEY ARE NOT EDGES OF THE CLOTH
+        if ( springs [ i ].type == BEND_SPRING )
+        {
+            continue;
+        }
+        tSweptBox box;
+        box.min = box.max = previous [ springs [ i ].p1 ].pos;
+        Extend ( box , current [ springs [ i ].p1 ].pos );
+        Extend ( box , previous [ springs [ i ].p2 ].pos );
+        Extend ( box , current [ springs [ i ].p2 ].pos );
+        this->Query ( this->edgeBoxes_ , this->widestEdge_ , box , [ i ] ( const tSweptBox & hit )
+        {
+            candidates.push_back ( tCandidate { i , hit.mesh , hit.primitive } );
+        } );
+    }
+    tCubicBatch batch;
+    const float overStep = stepTime > 0.0f ? 1.0f / stepTime : 0.0f;
+    for ( std::size_t first = 0; first < candidates.size (); first += COLLISION_BATCH )
+    {
+        const int count = static_cast < int > ( std::min < std::size_t > ( COLLISION_BATCH , candidates.size () - first ) );
+        // (p2 - p1) x (q2 - q1) . (q1 - p1) IS ZERO WHEN THE TWO EDGES ARE IN ONE PLANE
+        for ( int lane = 0; lane < COLLISION_BATCH; ++lane )
+        {
+            const tCandidate & candidate = candidates [ first + std::min ( lane , count - 1 ) ];
+            const tCollisionMesh & mesh = this->meshes_ [ candidate.mesh ];
+            const int * edge = &mesh.edges [ candidate.primitive * 2 ];
+            const tSpring & spring = springs [ candidate.cloth ];
+            const tVector & p0 = previous [ spring.p1 ].pos , & p1 = current [ spring.p1 ].pos;
+            SetLane ( batch , 0 , lane , Sub ( previous [ spring.p2 ].pos , p0 ) , Sub ( current [ spring.p2 ].pos , p1 ) );
+            SetLane ( batch , 1 , lane , Sub ( mesh.stepStart [ edge [ 1 ] ] , mesh.stepStart [ edge [ 0 ] ] ) , Sub ( mesh.stepEnd [ edge [ 1 ] ] , mesh.stepEnd [ edge [ 0 ] ] ) );
+            SetLane ( batch , 2 , lane , Sub ( mesh.stepStart [ edge [ 0 ] ] , p0 ) , Sub ( mesh.stepEnd [ edge [ 0 ] ] , p1 ) );
+        }
+        SolveCubics ( batch );
+        for ( int lane = 0; lane < count; ++lane )
+        {
+            const tCandidate & candidate = candidates [ first + lane ];
+            const tCollisionMesh & mesh = this->meshes_ [ candidate.mesh ];
+            const int * edge = &mesh.edges [ candidate.primitive * 2 ];
+            const tSpring & spring = springs [ candidate.cloth ];
+            const tVector & a0 = previous [ spring.p1 ].pos , & a1 = current [ spring.p1 ].pos;
+            const tVector & b0 = previous [ spring.p2 ].pos , & b1 = current [ spring.p2 ].pos;
+            const tVector & c0 = mesh.stepStart [ edge [ 0 ] ] , & c1 = mesh.stepEnd [ edge [ 0 ] ];
+            const tVector & d0 = mesh.stepStart [ edge [ 1 ] ] , & d1 = mesh.stepEnd [ edge [ 1 ] ];
+            float s , u;
+            float impact = 2.0f;
+            for ( int r = 0; r < 3 && impact > 1.0f; ++r )
+            {
+                const float t = batch.roots [ r ] [ lane ];
+                if ( t <= 1.0f && ClosestSegmentPoints ( Lerp ( a0 , a1 , t ) , Lerp ( b0 , b1 , t ) , Lerp ( c0 , c1 , t ) , Lerp ( d0 , d1 , t ) , s , u ) <= depthEpsilon * depthEpsilon )
+                {
+                    impact = t;
+                }
+            }
+            tVector normal0 = Cross ( Sub ( b0 , a0 ) , Sub ( d0 , c0 ) );
+            tVector normal1 = Cross ( Sub ( b1 , a1 ) , Sub ( d1 , c1 ) );
+            if ( Dot ( normal1 , normal1 ) <= 1e-20f || Dot ( normal0 , normal0 ) <= 1e-20f )
+            {
+                continue;	// PARALLEL EDGES, THE POINT AGAINST TRIANGLE TESTS COVER THEM
+            }
+            NormalizeVector ( &normal0 );
+            NormalizeVector ( &normal1 );
+            float s0 , u0;
+            ClosestSegmentPoints ( a0 , b0 , c0 , d0 , s0 , u0 );
+            const float distanceSquared = ClosestSegmentPoints ( a1 , b1 , c1 , d1 , s , u );
+            const tVector clothPoint = Lerp ( a1 , b1 , s ) , meshPoint = Lerp ( c1 , d1 , u );
+            const tVector meshMotion = Sub ( meshPoint , Lerp ( c0 , d0 , u ) );
+            const float endDistance = Dot ( normal1 , Sub ( clothPoint , meshPoint ) );
+            const float side = ApproachSide ( Dot ( normal0 , Sub ( Lerp ( a0 , b0 , s0 ) , Lerp ( c0 , d0 , u0 ) ) ) , Dot ( Sub ( Sub ( clothPoint , Lerp ( a0 , b0 , s ) ) , meshMotion ) , normal1 ) , endDistance , depthEpsilon );
+            if ( impact <= 1.0f && side * endDistance < -depthEpsilon )
+            {
+                // THE MESH EDGE SLIPPED BETWEEN THE TWO PARTICLES. A LATER CANDIDATE MAY STILL HIT EARLIER, SO KEEP GOING
+                result.penetrating = true;
+                result.impact = std::min ( result.impact , impact );
+                continue;
+            }
+            if ( distanceSquared < depthEpsilon * depthEpsilon )
+            {
+                // PUSH BOTH ENDS OF THE CLOTH EDGE THAT ARE MOVING INTO THE MESH EDGE
+                tContact contact;
+                contact.normal = Scale ( normal1 , side );
+                contact.velocity = Scale ( meshMotion , overStep );
+                const int ends [ 2 ] = { spring.p1 , spring.p2 };
+                for ( const int particle : ends )
+                {
+                    if ( Dot ( Sub ( current [ particle ].v , contact.velocity ) , contact.normal ) < 0.0f )
+                    {
+                        contact.particle = particle;
+                        contacts.push_back ( contact );
+                        result.colliding = true;
+                    }
+                }
+            }
+        }
+    }
+}
+
+int CMeshColliders::Collide ( const tParticle * previous , const tParticle * current , const int particleCnt , const tSpring * springs , const int springCnt , const float stepTime , const float depthEpsilon , CPerThreadBuffer < tContact > & contacts , float & impact ) const
+{
+    CThreadPool & pool = CThreadPool::Instance ();
+    std::vector < tPairResult > results ( pool.WorkerCount () , tPairResult { false , false , 2.0f } );
+    if ( ! this->triangleBoxes_.empty () )
+    {
+        pool.ParallelFor ( particleCnt , CCD_GRAIN , [ & ] ( const int begin , const int end , const int worker )
+        {
+            this->CollideParticles ( previous , current , begin , end , stepTime , depthEpsilon , contacts.Stream ( worker ) , results [ worker ] );
+        } );
+    }
+    if ( ! this->edgeBoxes_.empty () && springs != NULL )
+    {
+        pool.ParallelFor ( springCnt , CCD_GRAIN , [ & ] ( const int begin , const int end , const int worker )
+        {
+            this->CollideEdges ( previous , current , springs , begin , end , stepTime , depthEpsilon , contacts.Stream ( worker ) , results [ worker ] );
+        } );
+    }
+    bool penetrating = false , colliding = false;
+    impact = 2.0f;
+    for ( const tPairResult & result : results )
+    {
+        penetrating = penetrating || result.penetrating;
+        colliding = colliding || result.colliding;
+        impact = std::min ( impact , result.impact );
+    }
+    if ( penetrating )
+    {
+        return PENETRATING;
+    }
+    return colliding ? COLLIDING : NOT_COLLIDING;
+}
@@ -0,0 +1,113 @@
+#if !defined(CCD_H__INCLUDED_)
+#define CCD_H__INCLUDED_
+
+#include <vector>
+#include "PhysEnv.h"
+
+#define CCD_BISECTIONS		24			// HALVINGS OF AN INTERVAL WHEN LOOKING FOR A ROOT OF THE COPLANARITY CUBIC
+#define CCD_GRAIN			512			// PARTICLES OR SPRINGS HANDED TO A WORKER AT A TIME
+
+/**
+ * \brief A triangle mesh obstacle. The vertices can move from one frame to the next, inside a frame they move in a straight line.
+ */
+struct tCollisionMesh
+{
+    /**
+     * \brief The vertices at the start and at the end of the frame, and where the next frame should end.
+     */
+    std::vector < tVector > frameStart , frameEnd , next;
+    /**
+     * \brief The vertices at the start and at the end of the step being checked.
+     */
+    std::vector < tVector > stepStart , stepEnd;
+    /**
+     * \brief Three vertex indices per triangle.
+     */
+    std::vector < int > triangles;
+    /**
+     * \brief Two vertex indices per edge. An edge shared by two triangles is only listed once.
+     */
+    std::vector < int > edges;
+};
+
+/**
+ * \brief The box around everything a mesh triangle or edge covers during a step.
+ */
+struct tSweptBox
+{
+    tVector min , max;
+    int mesh;
+    int primitive;
+};
+
+/**
+ * \brief Continuous collision detection of the cloth against triangle meshes.
+ *
+ * Every particle is tested against the triangles and every cloth edge (structural, shear and manual springs) against the mesh edges along their whole path during the step,
+ * so nothing tunnels through a mesh however large the step is. The candidates come from a sort and sweep broadphase over swept boxes. For each candidate the time when the
+ * four points involved are coplanar is a root of a cubic, found eight candidates at a time. A crossing that ends on the other side reports a penetration together with the
+ * earliest time of impact, so the simulation can step right up to it. Ending within the depth epsilon of a mesh gives contacts, like the other colliders.
+ */
+class CMeshColliders
+{
+public:
+    /**
+     * \brief Adds a mesh.
+     * \param vertices The vertex positions.
+     * \param vertexCnt The number of vertices.
+     * \param triangles Three vertex indices per triangle.
+     * \param triangleCnt The number of triangles.
+     * \return The index of the mesh, for MoveMesh.
+     */
+    int AddMesh ( const tVector * vertices , int vertexCnt , const int * triangles , int triangleCnt );
+    /**
+     * \brief Sets where the vertices of a mesh are at the end of the next frame. Meshes that are never moved are static.
+     */
+    void MoveMesh ( int mesh , const tVector * vertices );
+    void Clear ();
+    bool Empty () const;
+    int MeshCount () const { return static_cast < int > ( this->meshes_.size () ); }
+    const tCollisionMesh & Mesh ( int mesh ) const { return this->meshes_ [ mesh ]; }
+    /**
+     * \brief Starts a frame. The end of the last frame becomes the start of this one, and the positions given to MoveMesh its end.
+     */
+    void Update ();
+    /**
+     * \brief Places the meshes for a step going from one fraction of the frame to another, and rebuilds the broadphase.
+     * \param from Where the step starts, 0 being the start of the frame.
+     * \param to Where the step ends, 1 being the end of the frame.
+     * \param margin How much to grow the boxes by, normally the depth epsilon.
+     */
+    void Pose ( float from , float to , float margin );
+    /**
+     * \brief Checks the cloth against every mesh over the step set by Pose.
+     * \param previous The particles at the start of the step.
+     * \param current The particles at the end of the step.
+     * \param particleCnt The number of particles.
+     * \param springs The springs, the structural, shear and manual ones are tested as edges.
+     * \param springCnt The number of springs.
+     * \param stepTime The length of the step, to turn the motion of a mesh into a velocity.
+     * \param depthEpsilon How far from a mesh a particle counts as touching it.
+     * \param contacts The per worker streams to append the contacts to.
+     * \param impact Set to the earliest time of impact, as a fraction of the step, when a penetration is found.
+     * \return PENETRATING, COLLIDING or NOT_COLLIDING.
+     */
+    int Collide ( const tParticle * previous , const tParticle * current , int particleCnt , const tSpring * springs , int springCnt , float stepTime , float depthEpsilon , CPerThreadBuffer < tContact > & contacts , float & impact ) const;
+private:
+    struct tPairResult;
+    void CollideParticles ( const tParticle * previous , const tParticle * current , int begin , int end , float stepTime , float depthEpsilon , std::vector < tContact > & contacts , tPairResult & result ) const;
+    void CollideEdges ( const tParticle * previous , const tParticle * current , const tSpring * springs , int begin , int end , float stepTime , float depthEpsilon , std::vector < tContact > & contacts , tPairResult & result ) const;
+    template < typename Visit >
+    void Query ( const std::vector < tSweptBox > & boxes , float widest , const tSweptBox & box , Visit visit ) const;
+    std::vector < tCollisionMesh > meshes_;
+    /**
+     * \brief The swept boxes of every triangle and every edge, sorted by their lowest x.
+     */
+    std::vector < tSweptBox > triangleBoxes_ , edgeBoxes_;
+    /**
+     * \brief The widest box along x in each list, which bounds how far back a query has to look.
+     */
+    float widestTriangle_ = 0.0f , widestEdge_ = 0.0f;
+};
+
+#endif // !defined(CCD_H__INCLUDED_)
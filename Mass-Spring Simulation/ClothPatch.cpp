@@ -0,0 +1,121 @@
+#include "stdafx.h"
+#include <GL/gl.h>
+#include "ClothPatch.h"
+#include "IndexBuffer.h"
+
+void DefaultClothPatch ( tClothPatch & patch )
+{
+    patch.u = 9;
+    patch.v = 9;
+    patch.width = 8.0f;
+    patch.height = 8.0f;
+    patch.horizontal = TRUE;
+    patch.useStruct = patch.useShear = patch.useBend = TRUE;
+    patch.structK = 4.0f;
+    patch.structD = 0.6f;
+    patch.shearK = 4.0f;
+    patch.shearD = 0.6f;
+    patch.bendK = 2.4f;
+    patch.bendD = 0.8f;
+}
+
+t_Visual * MakeClothVisual ( const tClothPatch & patch )
+{
+    const int u = patch.u , v = patch.v;
+    const long vertexCnt = static_cast < long > ( u ) * v , faceCnt = static_cast < long > ( u - 1 ) * ( v - 1 ) * 2;
+    t_Visual * visual = static_cast < t_Visual * > ( malloc ( sizeof ( t_Visual ) ) );
+    visual->reuseVertices = TRUE;
+    visual->dataFormat = GL_T2F_V3F;
+    visual->vPerFace = 3;
+    visual->vSize = 5;
+    visual->vertexData = static_cast < float * > ( malloc ( sizeof ( float ) * visual->vSize * vertexCnt ) );
+    visual->vertexCnt = vertexCnt;
+    visual->faceIndex = AllocIndices ( vertexCnt , faceCnt * visual->vPerFace );
+    visual->faceCnt = faceCnt;
+    // THE TEXTURE COORDINATES KEEP GROWING ALONG THE ROWS, AS THEY ALWAYS HAVE
+    const float sx = - ( patch.width / 2.0f ) , sy = patch.height / 2.0f;
+    const float stepx = patch.width / u , stepy = - ( patch.height / v );
+    const float tdu = 1.0f / u , tdv = 1.0f / v;
+    float tsu = 0.0f , tsv = 0.0f;
+    tTexturedVertex * vertex = reinterpret_cast < tTexturedVertex * > ( visual->vertexData );
+    for ( int row = 0; row < v; ++row , tsv += tdv )
+    {
+        for ( int column = 0; column < u; ++column , tsu += tdu , ++vertex )
+        {
+            vertex->u = tsu;
+            vertex->v = tsv;
+            vertex->x = sx + stepx * column;
+            vertex->y = patch.horizontal ? 0.0f : sy + stepy * row;
+            vertex->z = patch.horizontal ? sy + stepy * row : 0.0f;
+        }
+    }
+    // TWO TRIANGLES FOR EACH SQUARE OF THE GRID
+    long at = 0;
+    for ( int row = 0; row < v - 1; ++row )
+    {
+        for ( int column = 0; column < u - 1; ++column )
+        {
+            const long corner = static_cast < long > ( row ) * u + column;
+            SetIndex ( visual->faceIndex , vertexCnt , at++ , corner );
+            SetIndex ( visual->faceIndex , vertexCnt , at++ , corner + u );
+            SetIndex ( visual->faceIndex , vertexCnt , at++ , corner + 1 );
+            SetIndex ( visual->faceIndex , vertexCnt , at++ , corner + 1 );
+            SetIndex ( visual->faceIndex , vertexCnt , at++ , corner + u );
+            SetIndex ( visual->faceIndex , vertexCnt , at++ , corner + u + 1 );
+        }
+    }
+    return visual;
+}
+
+void AddClothSprings ( CPhysEnv & env , const tClothPatch & patch )
+{
+    const int u = patch.u , v = patch.v;
+    if ( patch.useStruct )
+    {
+        for ( int row = 0; row < v; ++row )
+        {
+            for ( int column = 0; column < u - 1; ++column )
+            {
+                env.AddSpring ( row * u + column , row * u + column + 1 , patch.structK , patch.structD , STRUCTURAL_SPRING );
+            }
+        }
+        for ( int column = 0; column < u; ++column )
+        {
+            for ( int row = 0; row < v - 1; ++row )
+            {
+                env.AddSpring ( row * u + column , ( row + 1 ) * u + column , patch.structK , patch.structD , STRUCTURAL_SPRING );
+            }
+        }
+    }
+    if ( patch.useShear )
+    {
+        for ( int row = 0; row < v - 1; ++row )
+        {
+            for ( int column = 0; column < u - 1; ++column )
+            {
+                env.AddSpring ( row * u + column , ( row + 1 ) * u + column + 1 , patch.shearK , patch.shearD , SHEAR_SPRING );
+                env.AddSpring ( ( row + 1 ) * u + column , row * u + column + 1 , patch.shearK , patch.shearD , SHEAR_SPRING );
+            }
+        }
+    }
+    if ( patch.useBend )
+    {
+        // EVERY OTHER PARTICLE, AND THE LAST TWO OF A ROW OR COLUMN ONCE MORE SO THE EDGE IS STIFF AS WELL
+        for ( int row = 0; row < v; ++row )
+        {
+            for ( int column = 0; column < u - 2; ++column )
+            {
+                env.AddSpring ( row * u + column , row * u + column + 2 , patch.bendK , patch.bendD , BEND_SPRING );
+            }
+            env.AddSpring ( row * u + u - 3 , row * u + u - 1 , patch.bendK , patch.bendD , BEND_SPRING );
+        }
+        for ( int column = 0; column < u; ++column )
+        {
+            for ( int row = 0; row < v - 2; ++row )
+            {
+                env.AddSpring ( row * u + column , ( row + 2 ) * u + column , patch.bendK , patch.bendD , BEND_SPRING );
+            }
+            env.AddSpring ( ( v - 3 ) * u + column , ( v - 1 ) * u + column , patch.bendK , patch.bendD , BEND_SPRING );
+        }
+    }
+}
@@ -0,0 +1,35 @@
+#if !defined(CLOTHPATCH_H__INCLUDED_)
+#define CLOTHPATCH_H__INCLUDED_
+
+#include "PhysEnv.h"
+#include "Skeleton.h"
+
+/**
+ * \brief A rectangular grid of particles held together by springs, as made by the New Cloth dialog.
+ */
+struct tClothPatch
+{
+    int u , v;							// PARTICLES ACROSS AND DOWN, AT LEAST 3 EACH
+    float width , height;
+    BOOL horizontal;					// LYING IN THE XZ PLANE, ELSE HANGING IN XY
+    BOOL useStruct , useShear , useBend;
+    float structK , structD;			// SPRING AND DAMPING CONSTANTS OF EACH KIND OF SPRING
+    float shearK , shearD;
+    float bendK , bendD;
+};
+
+/**
+ * \brief The patch the dialog starts with, 9 by 9 particles over 8 by 8 units.
+ */
+void DefaultClothPatch ( tClothPatch & patch );
+/**
+ * \brief The visual of a patch, two triangles for each square of the grid. Vertex i is particle i.
+ * \return A visual allocated the way LoadOBJ does, for the skeleton to free.
+ */
+t_Visual * MakeClothVisual ( const tClothPatch & patch );
+/**
+ * \brief Adds the springs of a patch to a system made from its visual.
+ */
+void AddClothSprings ( CPhysEnv & env , const tClothPatch & patch );
+
+#endif // !defined(CLOTHPATCH_H__INCLUDED_)
@@ -0,0 +1,195 @@
+#include "stdafx.h"
+#include <cmath>
+#include "ClothSurface.h"
+#include "IndexBuffer.h"
+#include "ThreadPool.h"
+
+CClothSurface::CClothSurface () : visual_ ( NULL ) , positionOffset_ ( 0 ) , normalOffset_ ( -1 )
+{
+    this->stream_.positions = NULL;
+    this->stream_.stride = sizeof ( float ) * 3;
+    this->stream_.count = 0;
+}
+
+bool CClothSurface::Attach ( t_Visual * visual )
+{
+    this->Detach ();
+    if ( visual == NULL || ! visual->reuseVertices || visual->vertexData == NULL || visual->faceIndex == NULL || visual->faceCnt <= 0 || ( visual->vPerFace != 3 && visual->vPerFace != 4 ) )
+    {
+        return false;
+    }
+    switch ( visual->dataFormat )
+    {
+    case GL_V3F: this->positionOffset_ = 0; this->normalOffset_ = -1;
+        break;
+    case GL_T2F_V3F: this->positionOffset_ = 2; this->normalOffset_ = -1;
+        break;
+    case GL_N3F_V3F: this->positionOffset_ = 3; this->normalOffset_ = 0;
+        break;
+    case GL_T2F_N3F_V3F: this->positionOffset_ = 5; this->normalOffset_ = 2;
+        break;
+    default:
+        return false;
+    }
+    // THE FACES OF EACH VERTEX WITH A COUNTING SORT, A FACE TOUCHING A VERTEX TWICE IS LISTED TWICE LIKE IT WEIGHS TWICE
+    const long vertexCnt = visual->vertexCnt , cornerCnt = visual->faceCnt * visual->vPerFace;
+    this->faceStart_.assign ( vertexCnt + 1 , 0 );
+    for ( long corner = 0; corner < cornerCnt; ++corner )
+    {
+        const unsigned long vertex = GetIndex ( visual->faceIndex , vertexCnt , corner );
+        if ( vertex >= static_cast < unsigned long > ( vertexCnt ) )
+        {
+            return false;
+        }
+        ++this->faceStart_ [ vertex + 1 ];
+    }
+    for ( long vertex = 0; vertex < vertexCnt; ++vertex )
+    {
+        this->faceStart_ [ vertex + 1 ] += this->faceStart_ [ vertex ];
+    }
+    std::vector < int > next ( this->faceStart_.begin () , this->faceStart_.end () - 1 );
+    this->vertexFaces_.resize ( cornerCnt );
+    for ( long corner = 0; corner < cornerCnt; ++corner )
+    {
+        this->vertexFaces_ [ next [ GetIndex ( visual->faceIndex , vertexCnt , corner ) ]++ ] = static_cast < int > ( corner / visual->vPerFace );
+    }
+    this->faceNormals_.resize ( visual->faceCnt );
+    this->normals_.resize ( vertexCnt );
+    this->visual_ = visual;
+    return true;
+}
+
+void CClothSurface::Detach ()
+{
+    this->visual_ = NULL;
+    this->stream_.positions = NULL;
+    this->stream_.count = 0;
+    this->faceStart_.clear ();
+    this->vertexFaces_.clear ();
+    this->faceNormals_.clear ();
+    this->normals_.clear ();
+}
+
+bool CClothSurface::Update ( const tVertexStream & stream )
+{
+    t_Visual * visual = this->visual_;
+    if ( visual == NULL || stream.count != visual->vertexCnt )
+    {
+        return false;
+    }
+    this->stream_ = stream;
+    CThreadPool & pool = CThreadPool::Instance ();
+    tVector * faceNormals = this->faceNormals_.data ();
+    const long perFace = visual->vPerFace;
+    VisitIndices ( visual->faceIndex , visual->vertexCnt , [ & ] ( const auto * indices )
+    {
+        pool.ParallelFor ( static_cast < int > ( visual->faceCnt ) , SURFACE_GRAIN , [ = ] ( const int begin , const int end , const int )
+        {
+            for ( int face = begin; face < end; ++face )
+            {
+                const auto * corner = indices + face * perFace;
+                const float * p0 = stream.At ( corner [ 0 ] ) , * p1 = stream.At ( corner [ 1 ] ) , * p2 = stream.At ( corner [ 2 ] );
+                // THE CROSS PRODUCT OF THE DIAGONALS FOR A QUAD, OF TWO EDGES FOR A TRIANGLE. EITHER IS TWICE THE AREA LONG
+                tVector a , b;
+                if ( perFace == 4 )
+                {
+                    const float * p3 = stream.At ( corner [ 3 ] );
+                    MAKEVECTOR ( a , p2 [ 0 ] - p0 [ 0 ] , p2 [ 1 ] - p0 [ 1 ] , p2 [ 2 ] - p0 [ 2 ] );
+                    MAKEVECTOR ( b , p3 [ 0 ] - p1 [ 0 ] , p3 [ 1 ] - p1 [ 1 ] , p3 [ 2 ] - p1 [ 2 ] );
+                }
+                else
+                {
+                    MAKEVECTOR ( a , p1 [ 0 ] - p0 [ 0 ] , p1 [ 1 ] - p0 [ 1 ] , p1 [ 2 ] - p0 [ 2 ] );
+                    MAKEVECTOR ( b , p2 [ 0 ] - p0 [ 0 ] , p2 [ 1 ] - p0 [ 1 ] , p2 [ 2 ] - p0 [ 2 ] );
+                }
+                MAKEVECTOR ( faceNormals [ face ] , a.y * b.z - a.z * b.y , a.z * b.x - a.x * b.z , a.x * b.y - a.y * b.x );
+            }
+        } );
+    } );
+    const int * faceStart = this->faceStart_.data ();
+    const int * vertexFaces = this->vertexFaces_.data ();
+    tVector * normals = this->normals_.data ();
+    pool.ParallelFor ( stream.count , SURFACE_GRAIN , [ = ] ( const int begin , const int end , const int )
+    {
+        for ( int vertex = begin; vertex < end; ++vertex )
+        {
+            tVector sum;
+            MAKEVECTOR ( sum , 0.0f , 0.0f , 0.0f );
+            for ( int at = faceStart [ vertex ]; at < faceStart [ vertex + 1 ]; ++at )
+            {
+                const tVector & n = faceNormals [ vertexFaces [ at ] ];
+                sum.x += n.x; sum.y += n.y; sum.z += n.z;
+            }
+            const float length = std::sqrt ( sum.x * sum.x + sum.y * sum.y + sum.z * sum.z );
+            if ( length > 0.0f )
+            {
+                sum.x /= length; sum.y /= length; sum.z /= length;
+            }
+            else
+            {
+                MAKEVECTOR ( sum , 0.0f , 1.0f , 0.0f );
+            }
+            normals [ vertex ] = sum;
+        }
+    } );
+    return true;
+}
+
+void CClothSurface::StoreInVisual () const
+{
+    t_Visual * visual = this->visual_;
+    const tVertexStream & stream = this->stream_;
+    if ( visual == NULL || stream.positions == NULL || stream.count != visual->vertexCnt )
+    {
+        return;
+    }
+    float * data = visual->vertexData;
+    const int vSize = visual->vSize , positionOffset = this->positionOffset_ , normalOffset = this->normalOffset_;
+    const tVector * normals = this->normals_.data ();
+    CThreadPool::Instance ().ParallelFor ( stream.count , SURFACE_GRAIN , [ = ] ( const int begin , const int end , const int )
+    {
+        for ( int vertex = begin; vertex < end; ++vertex )
+        {
+            float * out = data + static_cast < std::size_t > ( vertex ) * vSize;
+            const float * position = stream.At ( vertex );
+            out [ positionOffset ] = position [ 0 ];
+            out [ positionOffset + 1 ] = position [ 1 ];
+            out [ positionOffset + 2 ] = position [ 2 ];
+            if ( normalOffset >= 0 )
+            {
+                out [ normalOffset ] = normals [ vertex ].x;
+                out [ normalOffset + 1 ] = normals [ vertex ].y;
+                out [ normalOffset + 2 ] = normals [ vertex ].z;
+            }
+        }
+    } );
+}
+
+void CClothSurface::Draw () const
+{
+    const t_Visual * visual = this->visual_;
+    if ( visual == NULL || this->stream_.positions == NULL )
+    {
+        return;
+    }
+    // THE POSITIONS STRAIGHT FROM THE PARTICLES, THE NORMALS FROM THE LAST UPDATE. THE VISUAL IS NOT TOUCHED
+    glVertexPointer ( 3 , GL_FLOAT , this->stream_.stride , this->stream_.positions );
+    glEnableClientState ( GL_VERTEX_ARRAY );
+    glNormalPointer ( GL_FLOAT , 0 , this->normals_.data () );
+    glEnableClientState ( GL_NORMAL_ARRAY );
+    // BOTH SIDES OF THE CLOTH ARE SEEN, LIT BY THE DEFAULT LIGHT THAT SHINES FROM THE EYE
+    glEnable ( GL_LIGHTING );
+    glEnable ( GL_LIGHT0 );
+    glLightModeli ( GL_LIGHT_MODEL_TWO_SIDE , GL_TRUE );
+    glEnable ( GL_COLOR_MATERIAL );
+    glColorMaterial ( GL_FRONT_AND_BACK , GL_AMBIENT_AND_DIFFUSE );
+    glEnable ( GL_POLYGON_OFFSET_FILL );
+    glPolygonOffset ( 1.0f , 1.0f );
+    glColor3f ( 0.7f , 0.7f , 0.9f );
+    glDrawElements ( visual->vPerFace == 4 ? GL_QUADS : GL_TRIANGLES , static_cast < GLsizei > ( visual->faceCnt * visual->vPerFace ) , IndexType ( visual->vertexCnt ) , visual->faceIndex );
+    glDisable ( GL_POLYGON_OFFSET_FILL );
+    glDisable ( GL_COLOR_MATERIAL );
+    glDisable ( GL_LIGHTING );
+    glDisableClientState ( GL_VERTEX_ARRAY );
+    glDisableClientState ( GL_NORMAL_ARRAY );
+}
@@ -0,0 +1,60 @@
+#if !defined(CLOTHSURFACE_H__INCLUDED_)
+#define CLOTHSURFACE_H__INCLUDED_
+
+#include <vector>
+#include <GL/gl.h>
+#include "PhysEnv.h"
+#include "Skeleton.h"
+#include "VertexStream.h"
+
+#define SURFACE_GRAIN			4096		// FACES OR VERTICES HANDED TO A WORKER AT A TIME
+
+/**
+ * \brief Shows the cloth as a lit surface, the faces of its visual placed where the particles are.
+ *
+ * Particle i is vertex i of the visual. The surface is drawn with the positions where the simulation keeps them, bound as a strided
+ * attribute, so they are not copied anywhere for the display. Update only recomputes the vertex normals, in two passes on the thread pool. The first one gives every face its normal, weighted by its area. The second one gives
+ * every vertex the sum of the normals of its faces, read through a vertex to face adjacency built by Attach, so each worker only writes
+ * what it owns and no vertex is written by two faces at once. Update is meant to be called once per frame drawn, not once per step.
+ *
+ * The vertex data of the visual keeps the shape it was loaded with until StoreInVisual, which is only needed before it is saved.
+ */
+class CClothSurface
+{
+public:
+    CClothSurface ();
+    /**
+     * \brief Shows a visual, forgetting the one before. Only indexed visuals have a surface.
+     * \return False when the visual has no faces to show.
+     */
+    bool Attach ( t_Visual * visual );
+    /**
+     * \brief Forgets the visual, before it is freed.
+     */
+    void Detach ();
+    bool IsAttached () const { return this->visual_ != NULL; }
+    /**
+     * \brief Moves the surface to the particles.
+     * \return False when the particles are not those of the visual.
+     */
+    bool Update ( const tVertexStream & stream );
+    /**
+     * \brief Writes the positions and normals of the last update into the vertex data of the visual.
+     */
+    void StoreInVisual () const;
+    /**
+     * \brief Draws the surface of the last update lit from the eye, pushed back a little so the springs show on top of it.
+     */
+    void Draw () const;
+private:
+    t_Visual * visual_;
+    int positionOffset_;				// WHERE THE POSITION AND THE NORMAL ARE IN A VERTEX OF THE VISUAL, -1 FOR NO NORMAL
+    int normalOffset_;
+    std::vector < int > faceStart_;		// THE FACES OF VERTEX i ARE vertexFaces_ [ faceStart_ [ i ] ] UP TO faceStart_ [ i + 1 ]
+    std::vector < int > vertexFaces_;
+    std::vector < tVector > faceNormals_;
+    tVertexStream stream_;				// THE POSITIONS OF THE LAST UPDATE
+    std::vector < tVector > normals_;	// ONE PER VERTEX, PACKED FOR THE NORMAL ARRAY
+};
+
+#endif // !defined(CLOTHSURFACE_H__INCLUDED_)
@@ -0,0 +1,377 @@
+#include "stdafx.h"
+#include <algorithm>
+#include <cmath>
+#include "CollisionKernel.h"
+#include "SimdLanes.h"
+
+/**
+ * \brief The state of COLLISION_BATCH particles in structure of arrays form, so a coordinate of the whole batch is a single load.
+ */
+struct tParticleBatch
+{
+    float px [ COLLISION_BATCH ] , py [ COLLISION_BATCH ] , pz [ COLLISION_BATCH ];
+    float vx [ COLLISION_BATCH ] , vy [ COLLISION_BATCH ] , vz [ COLLISION_BATCH ];
+};
+
+/**
+ * \brief Copies up to COLLISION_BATCH particles into the batch. Missing lanes repeat the last particle so they never report anything the real one does not.
+ */
+static void GatherBatch ( const tParticle * first , const int count , tParticleBatch & batch )
+{
+    for ( int lane = 0; lane < COLLISION_BATCH; ++lane )
+    {
+        const tParticle * particle = &first [ lane < count ? lane : count - 1 ];
+        batch.px [ lane ] = particle->pos.x;
+        batch.py [ lane ] = particle->pos.y;
+        batch.pz [ lane ] = particle->pos.z;
+        batch.vx [ lane ] = particle->v.x;
+        batch.vy [ lane ] = particle->v.y;
+        batch.vz [ lane ] = particle->v.z;
+    }
+}
+
+/**
+ * \brief Classifies a batch against one collider from its distance and whether the particles move towards it.
+ * \return The lanes touching the collider. Lanes further inside than the epsilon are added to penetrating instead.
+ */
+static inline unsigned int Classify ( const tFloat8 & distance , const tFloat8 & approaching , const tFloat8 & epsilon , const tFloat8 & minusEpsilon , tFloat8 & penetrating )
+{
+    const tFloat8 inside = Less8 ( distance , minusEpsilon );
+    penetrating = Or8 ( penetrating , inside );
+    return Mask8 ( AndNot8 ( inside , And8 ( Less8 ( distance , epsilon ) , approaching ) ) );
+}
+
+/**
+ * \brief The point of a capsule segment closest to p, as a fraction of the way from p1 to p2.
+ */
+static float CapsuleParameter ( const tCollisionCapsule & capsule , const tVector & p )
+{
+    const float axisX = capsule.p2.x - capsule.p1.x , axisY = capsule.p2.y - capsule.p1.y , axisZ = capsule.p2.z - capsule.p1.z;
+    const float lengthSquared = axisX * axisX + axisY * axisY + axisZ * axisZ;
+    if ( lengthSquared <= 0.0f )
+    {
+        return 0.0f;
+    }
+    const float t = ( ( p.x - capsule.p1.x ) * axisX + ( p.y - capsule.p1.y ) * axisY + ( p.z - capsule.p1.z ) * axisZ ) / lengthSquared;
+    return t < 0.0f ? 0.0f : ( t > 1.0f ? 1.0f : t );
+}
+
+/**
+ * \brief The outward normal of a box at a point near its surface. Outside the box it points from the closest surface point to p, inside it is the face normal of the nearest face.
+ */
+static tVector BoxNormal ( const tCollisionBox & box , const tVector & p )
+{
+    const float * halfSize = &box.halfSize.x;
+    const float dx = p.x - box.center.x , dy = p.y - box.center.y , dz = p.z - box.center.z;
+    float local [ 3 ] , excess [ 3 ];
+    bool outside = false;
+    int nearest = 0;
+    for ( int i = 0; i < 3; ++i )
+    {
+        local [ i ] = dx * box.axis [ i ].x + dy * box.axis [ i ].y + dz * box.axis [ i ].z;
+        excess [ i ] = std::fabs ( local [ i ] ) - halfSize [ i ];
+        outside = outside || excess [ i ] > 0.0f;
+        nearest = excess [ i ] > excess [ nearest ] ? i : nearest;
+    }
+    tVector normal;
+    MAKEVECTOR ( normal , 0.0f , 0.0f , 0.0f )
+    for ( int i = 0; i < 3; ++i )
+    {
+        float amount = outside ? ( excess [ i ] > 0.0f ? excess [ i ] : 0.0f ) : ( i == nearest ? 1.0f : 0.0f );
+        amount = local [ i ] < 0.0f ? -amount : amount;
+        normal.x += box.axis [ i ].x * amount;
+        normal.y += box.axis [ i ].y * amount;
+        normal.z += box.axis [ i ].z * amount;
+    }
+    NormalizeVector ( &normal );
+    return normal;
+}
+
+/**
+ * \brief Clamps every lane to [0, 1].
+ */
+static inline tFloat8 Clamp01 ( const tFloat8 & x )
+{
+    return Min8 ( Max8 ( x , Set8 ( 0.0f ) ) , Set8 ( 1.0f ) );
+}
+
+/**
+ * \brief How far a collider moved during the step, or NULL if it did not move.
+ */
+static inline const tVector * Moved ( const tVector * motion )
+{
+    return ( motion != NULL && ( motion->x != 0.0f || motion->y != 0.0f || motion->z != 0.0f ) ) ? motion : NULL;
+}
+
+/**
+ * \brief The velocity of a collider point over the step, zero when there is no motion.
+ */
+static inline tVector ColliderVelocity ( const tVector * motion , const int index , const float overStep )
+{
+    tVector velocity;
+    MAKEVECTOR ( velocity , 0.0f , 0.0f , 0.0f )
+    if ( motion != NULL )
+    {
+        MAKEVECTOR ( velocity , motion [ index ].x * overStep , motion [ index ].y * overStep , motion [ index ].z * overStep )
+    }
+    return velocity;
+}
+
+/**
+ * \brief The squared distance from the origin to the closest point of the segments starting at (ax, ay, az) and going along (dx, dy, dz).
+ */
+static inline tFloat8 SegmentDistanceSquared ( const tFloat8 & ax , const tFloat8 & ay , const tFloat8 & az , const tFloat8 & dx , const tFloat8 & dy , const tFloat8 & dz )
+{
+    const tFloat8 length = Max8 ( dx * dx + dy * dy + dz * dz , Set8 ( 1e-20f ) );
+    const tFloat8 s = Clamp01 ( ( Set8 ( 0.0f ) - ( ax * dx + ay * dy + az * dz ) ) / length );
+    const tFloat8 cx = ax + s * dx , cy = ay + s * dy , cz = az + s * dz;
+    return cx * cx + cy * cy + cz * cz;
+}
+
+/**
+ * \brief The squared distance between the segments q0 + s (dx, dy, dz) and a capsule segment, for s and t in [0, 1].
+ * \param rx Start of the first segments minus the start of the capsule segment.
+ * \param e The squared length of the capsule segment, which must not be 0.
+ */
+static inline tFloat8 SegmentSegmentDistanceSquared ( const tFloat8 & rx , const tFloat8 & ry , const tFloat8 & rz , const tFloat8 & dx , const tFloat8 & dy , const tFloat8 & dz , const tFloat8 & ax , const tFloat8 & ay , const tFloat8 & az , const float e )
+{
+    const tFloat8 zero = Set8 ( 0.0f ) , one = Set8 ( 1.0f ) , tiny = Set8 ( 1e-20f );
+    const tFloat8 a = dx * dx + dy * dy + dz * dz;
+    const tFloat8 b = dx * ax + dy * ay + dz * az;
+    const tFloat8 c = dx * rx + dy * ry + dz * rz;
+    const tFloat8 f = ax * rx + ay * ry + az * rz;
+    const tFloat8 safeA = Max8 ( a , tiny );
+    // CLOSEST POINTS OF THE INFINITE LINES, s CLAMPED TO THE FIRST SEGMENT. PARALLEL LINES START AT s = 0
+    const tFloat8 denominator = a * Set8 ( e ) - b * b;
+    tFloat8 s = Select8 ( Less8 ( tiny , denominator ) , Clamp01 ( ( b * f - c * Set8 ( e ) ) / Max8 ( denominator , tiny ) ) , zero );
+    tFloat8 t = ( b * s + f ) * Set8 ( 1.0f / e );
+    // WHEN t FALLS OFF THE CAPSULE SEGMENT CLAMP IT AND FIND s AGAIN FOR THAT END
+    s = Select8 ( Less8 ( t , zero ) , Clamp01 ( ( zero - c ) / safeA ) , Select8 ( Less8 ( one , t ) , Clamp01 ( ( b - c ) / safeA ) , s ) );
+    t = Clamp01 ( t );
+    const tFloat8 cx = rx + s * dx - t * ax , cy = ry + s * dy - t * ay , cz = rz + s * dz - t * az;
+    return cx * cx + cy * cy + cz * cz;
+}
+
+int CollideParticles ( const tParticle * system , const int begin , const int end , const tCollisionScene & scene , std::vector < tContact > & contacts )
+{
+    // ONE CONTACT MASK PER COLLIDER FOR THE CURRENT BATCH. KEPT PER THREAD SO IT ONLY GROWS ONCE
+    static thread_local std::vector < unsigned char > masks;
+    const int sphereFirst = scene.planeCnt;
+    const int boxFirst = sphereFirst + scene.sphereCnt;
+    const int capsuleFirst = boxFirst + scene.boxCnt;
+    const int colliderCnt = capsuleFirst + scene.capsuleCnt;
+    if ( static_cast < int > ( masks.size () ) < colliderCnt )
+    {
+        masks.resize ( colliderCnt );
+    }
+    const bool anyMotion = scene.previous != NULL && scene.stepTime > 0.0f && ( scene.sphereMotion != NULL || scene.boxMotion != NULL || scene.capsuleMotion != NULL );
+    const float overStep = anyMotion ? 1.0f / scene.stepTime : 0.0f;
+    const tFloat8 zero = Set8 ( 0.0f );
+    const tFloat8 epsilon = Set8 ( scene.depthEpsilon );
+    const tFloat8 minusEpsilon = Set8 ( -scene.depthEpsilon );
+    const std::size_t contactsBefore = contacts.size ();
+    tParticleBatch batch , previous;
+    for ( int first = begin; first < end; first += COLLISION_BATCH )
+    {
+        const int count = end - first < COLLISION_BATCH ? end - first : COLLISION_BATCH;
+        const unsigned int liveLanes = ( 1u << count ) - 1;
+        GatherBatch ( &system [ first ] , count , batch );
+        if ( anyMotion )
+        {
+            GatherBatch ( &scene.previous [ first ] , count , previous );
+        }
+        const tFloat8 px = Load8 ( batch.px ) , py = Load8 ( batch.py ) , pz = Load8 ( batch.pz );
+        const tFloat8 vx = Load8 ( batch.vx ) , vy = Load8 ( batch.vy ) , vz = Load8 ( batch.vz );
+        tFloat8 penetrating = Less8 ( zero , zero );
+        unsigned int anyContact = 0;
+        // PLANES: ax + by + cz + d IS THE SIGNED DISTANCE, THE NORMAL POINTS INTO THE WORLD
+        for ( int i = 0; i < scene.planeCnt; ++i )
+        {
+            const tCollisionPlane & plane = scene.planes [ i ];
+            const tFloat8 nx = Set8 ( plane.normal.x ) , ny = Set8 ( plane.normal.y ) , nz = Set8 ( plane.normal.z );
+            const tFloat8 distance = px * nx + py * ny + pz * nz + Set8 ( plane.d );
+            const tFloat8 approaching = Less8 ( vx * nx + vy * ny + vz * nz , zero );
+            const unsigned int touching = Classify ( distance , approaching , epsilon , minusEpsilon , penetrating ) & liveLanes;
+            masks [ i ] = static_cast < unsigned char > ( touching );
+            anyContact |= touching;
+        }
+        // SPHERES: THE SQUARED DISTANCE MINUS THE SQUARED RADIUS, AS IN THE SCALAR TEST.
+        // THE NORMAL IS ONLY NEEDED FOR ITS SIGN AGAINST THE VELOCITY SO IT IS NOT NORMALIZED HERE
+        for ( int i = 0; i < scene.sphereCnt; ++i )
+        {
+            const tCollisionSphere & sphere = scene.spheres [ i ];
+            const tFloat8 dx = px - Set8 ( sphere.pos.x ) , dy = py - Set8 ( sphere.pos.y ) , dz = pz - Set8 ( sphere.pos.z );
+            const tFloat8 radiusSquared = Set8 ( sphere.radius * sphere.radius );
+            const tFloat8 distance = dx * dx + dy * dy + dz * dz - radiusSquared;
+            tFloat8 rvx = vx , rvy = vy , rvz = vz;
+            const tVector * motion = anyMotion ? Moved ( scene.sphereMotion ? &scene.sphereMotion [ i ] : NULL ) : NULL;
+            if ( motion != NULL )
+            {
+                // MOVE THE START OF THE PARTICLE'S PATH BY THE MOTION OF THE SPHERE, THEN THE SPHERE CAN BE TESTED WHERE IT ENDS
+                const tFloat8 ax = Load8 ( previous.px ) + Set8 ( motion->x - sphere.pos.x ) , ay = Load8 ( previous.py ) + Set8 ( motion->y - sphere.pos.y ) , az = Load8 ( previous.pz ) + Set8 ( motion->z - sphere.pos.z );
+                penetrating = Or8 ( penetrating , Less8 ( SegmentDistanceSquared ( ax , ay , az , dx - ax , dy - ay , dz - az ) - radiusSquared , minusEpsilon ) );
+                rvx = vx - Set8 ( motion->x * overStep );
+                rvy = vy - Set8 ( motion->y * overStep );
+                rvz = vz - Set8 ( motion->z * overStep );
+            }
+            const tFloat8 approaching = Less8 ( dx * rvx + dy * rvy + dz * rvz , zero );
+            const unsigned int touching = Classify ( distance , approaching , epsilon , minusEpsilon , penetrating ) & liveLanes;
+            masks [ sphereFirst + i ] = static_cast < unsigned char > ( touching );
+            anyContact |= touching;
+        }
+        // BOXES: WORK IN THE BOX FRAME WHERE IT IS AXIS ALIGNED. excess IS HOW FAR PAST EACH PAIR OF FACES THE PARTICLE IS,
+        // THE DISTANCE IS THE LENGTH OF THE POSITIVE PART OUTSIDE AND THE LARGEST (NEGATIVE) EXCESS INSIDE
+        for ( int i = 0; i < scene.boxCnt; ++i )
+        {
+            const tCollisionBox & box = scene.boxes [ i ];
+            const tFloat8 dx = px - Set8 ( box.center.x ) , dy = py - Set8 ( box.center.y ) , dz = pz - Set8 ( box.center.z );
+            const float * halfSize = &box.halfSize.x;
+            const tVector * motion = anyMotion ? Moved ( scene.boxMotion ? &scene.boxMotion [ i ] : NULL ) : NULL;
+            tFloat8 rvx = vx , rvy = vy , rvz = vz;
+            tFloat8 sx , sy , sz;
+            if ( motion != NULL )
+            {
+                rvx = vx - Set8 ( motion->x * overStep );
+                rvy = vy - Set8 ( motion->y * overStep );
+                rvz = vz - Set8 ( motion->z * overStep );
+                sx = Load8 ( previous.px ) + Set8 ( motion->x - box.center.x );
+                sy = Load8 ( previous.py ) + Set8 ( motion->y - box.center.y );
+                sz = Load8 ( previous.pz ) + Set8 ( motion->z - box.center.z );
+            }
+            tFloat8 excess [ 3 ] , along [ 3 ];
+            // THE SWEPT TEST CLIPS THE RELATIVE PATH AGAINST THE SLABS OF THE BOX SHRUNK BY THE EPSILON
+            tFloat8 enter = Set8 ( -1.0f ) , leave = Set8 ( 2.0f );
+            for ( int a = 0; a < 3; ++a )
+            {
+                const tFloat8 ax = Set8 ( box.axis [ a ].x ) , ay = Set8 ( box.axis [ a ].y ) , az = Set8 ( box.axis [ a ].z );
+                const tFloat8 local = dx * ax + dy * ay + dz * az;
+                const tFloat8 localV = rvx * ax + rvy * ay + rvz * az;
+                const tFloat8 negative = Less8 ( local , zero );
+                excess [ a ] = Select8 ( negative , zero - local , local ) - Set8 ( halfSize [ a ] );
+                // THE VELOCITY ALONG THE OUTWARD DIRECTION OF THIS AXIS ON THE PARTICLE'S SIDE
+                along [ a ] = Select8 ( negative , zero - localV , localV );
+                if ( motion != NULL )
+                {
+                    const tFloat8 start = sx * ax + sy * ay + sz * az;
+                    const tFloat8 delta = local - start;
+                    // A PATH ALONG THE SLAB GETS A HUGE BUT FINITE PARAMETER RANGE INSTEAD OF A DIVISION BY ZERO
+                    const tFloat8 safeDelta = Select8 ( Less8 ( Max8 ( delta , zero - delta ) , Set8 ( 1e-12f ) ) , Set8 ( 1e-12f ) , delta );
+                    const tFloat8 slab = Set8 ( std::max ( halfSize [ a ] - scene.depthEpsilon , 0.0f ) );
+                    const tFloat8 t1 = ( zero - slab - start ) / safeDelta , t2 = ( slab - start ) / safeDelta;
+                    enter = Max8 ( enter , Min8 ( t1 , t2 ) );
+                    leave = Min8 ( leave , Max8 ( t1 , t2 ) );
+                }
+            }
+            if ( motion != NULL )
+            {
+                penetrating = Or8 ( penetrating , And8 ( Less8 ( enter , leave ) , And8 ( Less8 ( enter , Set8 ( 1.0f ) ) , Less8 ( zero , leave ) ) ) );
+            }
+            const tFloat8 ox = Max8 ( excess [ 0 ] , zero ) , oy = Max8 ( excess [ 1 ] , zero ) , oz = Max8 ( excess [ 2 ] , zero );
+            const tFloat8 outsideSquared = ox * ox + oy * oy + oz * oz;
+            const tFloat8 largest = Max8 ( excess [ 0 ] , Max8 ( excess [ 1 ] , excess [ 2 ] ) );
+            const tFloat8 distance = Sqrt8 ( outsideSquared ) + Min8 ( largest , zero );
+            const tFloat8 outsideSpeed = ox * along [ 0 ] + oy * along [ 1 ] + oz * along [ 2 ];
+            const tFloat8 insideSpeed = Select8 ( Less8 ( excess [ 0 ] , largest ) , Select8 ( Less8 ( excess [ 1 ] , largest ) , along [ 2 ] , along [ 1 ] ) , along [ 0 ] );
+            const tFloat8 approaching = Less8 ( Select8 ( Less8 ( zero , outsideSquared ) , outsideSpeed , insideSpeed ) , zero );
+            const unsigned int touching = Classify ( distance , approaching , epsilon , minusEpsilon , penetrating ) & liveLanes;
+            masks [ boxFirst + i ] = static_cast < unsigned char > ( touching );
+            anyContact |= touching;
+        }
+        // CAPSULES: A SPHERE TEST AGAINST THE CLOSEST POINT OF THE SEGMENT, FOUND BY CLAMPING THE PROJECTION TO [0, 1]
+        for ( int i = 0; i < scene.capsuleCnt; ++i )
+        {
+            const tCollisionCapsule & capsule = scene.capsules [ i ];
+            const float axisX = capsule.p2.x - capsule.p1.x , axisY = capsule.p2.y - capsule.p1.y , axisZ = capsule.p2.z - capsule.p1.z;
+            const float lengthSquared = axisX * axisX + axisY * axisY + axisZ * axisZ;
+            const tFloat8 ax = Set8 ( axisX ) , ay = Set8 ( axisY ) , az = Set8 ( axisZ );
+            const tFloat8 rx = px - Set8 ( capsule.p1.x ) , ry = py - Set8 ( capsule.p1.y ) , rz = pz - Set8 ( capsule.p1.z );
+            const tFloat8 t = Clamp01 ( ( rx * ax + ry * ay + rz * az ) * Set8 ( lengthSquared > 0.0f ? 1.0f / lengthSquared : 0.0f ) );
+            const tFloat8 dx = rx - t * ax , dy = ry - t * ay , dz = rz - t * az;
+            const tFloat8 radiusSquared = Set8 ( capsule.radius * capsule.radius );
+            const tFloat8 distance = dx * dx + dy * dy + dz * dz - radiusSquared;
+            tFloat8 rvx = vx , rvy = vy , rvz = vz;
+            const tVector * motion = anyMotion && scene.capsuleMotion != NULL ? &scene.capsuleMotion [ i * 2 ] : NULL;
+            if ( motion != NULL && ( Moved ( &motion [ 0 ] ) != NULL || Moved ( &motion [ 1 ] ) != NULL ) )
+            {
+                // THE ENDS CAN MOVE DIFFERENTLY, SO USE THE MOTION OF THE POINT CLOSEST TO THE PARTICLE FOR BOTH THE SWEEP AND THE VELOCITY
+                const tFloat8 mx = Set8 ( motion [ 0 ].x ) + t * Set8 ( motion [ 1 ].x - motion [ 0 ].x );
+                const tFloat8 my = Set8 ( motion [ 0 ].y ) + t * Set8 ( motion [ 1 ].y - motion [ 0 ].y );
+                const tFloat8 mz = Set8 ( motion [ 0 ].z ) + t * Set8 ( motion [ 1 ].z - motion [ 0 ].z );
+                const tFloat8 sx = Load8 ( previous.px ) + mx - Set8 ( capsule.p1.x ) , sy = Load8 ( previous.py ) + my - Set8 ( capsule.p1.y ) , sz = Load8 ( previous.pz ) + mz - Set8 ( capsule.p1.z );
+                const tFloat8 swept = lengthSquared > 0.0f ? SegmentSegmentDistanceSquared ( sx , sy , sz , rx - sx , ry - sy , rz - sz , ax , ay , az , lengthSquared ) : SegmentDistanceSquared ( sx , sy , sz , rx - sx , ry - sy , rz - sz );
+                penetrating = Or8 ( penetrating , Less8 ( swept - radiusSquared , minusEpsilon ) );
+                const tFloat8 overStep8 = Set8 ( overStep );
+                rvx = vx - mx * overStep8;
+                rvy = vy - my * overStep8;
+                rvz = vz - mz * overStep8;
+            }
+            const tFloat8 approaching = Less8 ( dx * rvx + dy * rvy + dz * rvz , zero );
+            const unsigned int touching = Classify ( distance , approaching , epsilon , minusEpsilon , penetrating ) & liveLanes;
+            masks [ capsuleFirst + i ] = static_cast < unsigned char > ( touching );
+            anyContact |= touching;
+        }
+        // ONCE ANY PARTICLE PENETRATES THE WHOLE STEP IS RETRIED SO THE CONTACTS DO NOT MATTER
+        if ( Mask8 ( penetrating ) & liveLanes )
+        {
+            contacts.resize ( contactsBefore );
+            return PENETRATING;
+        }
+        // WRITE THE CONTACTS OUT PER PARTICLE SO THEY STAY NEXT TO EACH OTHER
+        for ( int lane = 0; anyContact != 0; ++lane , anyContact >>= 1 )
+        {
+            if ( ( anyContact & 1 ) == 0 )
+            {
+                continue;
+            }
+            const unsigned int bit = 1u << lane;
+            tContact contact;
+            tVector position;
+            contact.particle = first + lane;
+            MAKEVECTOR ( position , batch.px [ lane ] , batch.py [ lane ] , batch.pz [ lane ] )
+            for ( int i = 0; i < scene.planeCnt; ++i )
+            {
+                if ( masks [ i ] & bit )
+                {
+                    contact.normal = scene.planes [ i ].normal;
+                    MAKEVECTOR ( contact.velocity , 0.0f , 0.0f , 0.0f )
+                    contacts.push_back ( contact );
+                }
+            }
+            for ( int i = 0; i < scene.sphereCnt; ++i )
+            {
+                if ( masks [ sphereFirst + i ] & bit )
+                {
+                    const tCollisionSphere & sphere = scene.spheres [ i ];
+                    MAKEVECTOR ( contact.normal , position.x - sphere.pos.x , position.y - sphere.pos.y , position.z - sphere.pos.z )
+                    NormalizeVector ( &contact.normal );
+                    contact.velocity = ColliderVelocity ( anyMotion ? scene.sphereMotion : NULL , i , overStep );
+                    contacts.push_back ( contact );
+                }
+            }
+            for ( int i = 0; i < scene.boxCnt; ++i )
+            {
+                if ( masks [ boxFirst + i ] & bit )
+                {
+                    contact.normal = BoxNormal ( scene.boxes [ i ] , position );
+                    contact.velocity = ColliderVelocity ( anyMotion ? scene.boxMotion : NULL , i , overStep );
+                    contacts.push_back ( contact );
+                }
+            }
+            for ( int i = 0; i < scene.capsuleCnt; ++i )
+            {
+                if ( masks [ capsuleFirst + i ] & bit )
+                {
+                    const tCollisionCapsule & capsule = scene.capsules [ i ];
+                    const float t = CapsuleParameter ( capsule , position );
+                    MAKEVECTOR ( contact.normal , position.x - ( capsule.p1.x + t * ( capsule.p2.x - capsule.p1.x ) ) , position.y - ( capsule.p1.y + t * ( capsule.p2.y - capsule.p1.y ) ) , position.z - ( capsule.p1.z + t * ( capsule.p2.z - capsule.p1.z ) ) )
+                    NormalizeVector ( &contact.normal );
+                    const tVector start = ColliderVelocity ( anyMotion ? scene.capsuleMotion : NULL , i * 2 , overStep );
+                    const tVector end = ColliderVelocity ( anyMotion ? scene.capsuleMotion : NULL , i * 2 + 1 , overStep );
+                    MAKEVECTOR ( contact.velocity , start.x + t * ( end.x - start.x ) , start.y + t * ( end.y - start.y ) , start.z + t * ( end.z - start.z ) )
+                    contacts.push_back ( contact );
+                }
+            }
+        }
+    }
+    return contacts.size () > contactsBefore ? COLLIDING : NOT_COLLIDING;
+}
@@ -0,0 +1,70 @@
+#if !defined(COLLISIONKERNEL_H__INCLUDED_)
+#define COLLISIONKERNEL_H__INCLUDED_
+
+#include <vector>
+#include "PhysEnv.h"
+
+#define COLLISION_BATCH		8		// PARTICLES TESTED TOGETHER BY THE KERNEL
+
+/**
+ * \brief Everything the collision kernel tests the particles against.
+ */
+struct tCollisionScene
+{
+    /**
+     * \brief The boundary planes, always tested.
+     */
+    const tCollisionPlane * planes;
+    int planeCnt;
+    /**
+     * \brief The collision spheres. Set sphereCnt to 0 to skip them.
+     */
+    const tCollisionSphere * spheres;
+    int sphereCnt;
+    /**
+     * \brief The oriented boxes. Particles are kept outside of them.
+     */
+    const tCollisionBox * boxes;
+    int boxCnt;
+    /**
+     * \brief The capsules. Particles are kept outside of them.
+     */
+    const tCollisionCapsule * capsules;
+    int capsuleCnt;
+    /**
+     * \brief How far each sphere center, box center and capsule end (two per capsule) moved during the step, or NULL when none of them moved.
+     *
+     * A moving collider is also tested along the path of each particle relative to it, so it cannot pass through a particle within one step, and the contacts carry its velocity.
+     * The sweep only follows the translation, the rotation of a box during the step is left to the usual time subdivision.
+     */
+    const tVector * sphereMotion;
+    const tVector * boxMotion;
+    const tVector * capsuleMotion;
+    /**
+     * \brief The particles at the start of the step and its length. Only used when something moved.
+     */
+    const tParticle * previous;
+    float stepTime;
+    /**
+     * \brief How far from a surface a particle counts as touching it. Further inside than this is a penetration.
+     *
+     * Planes and boxes compare it with the signed distance. Spheres and capsules compare it with the squared distance to the center (or center segment) minus the squared radius, like the original sphere test.
+     */
+    float depthEpsilon;
+};
+
+/**
+ * \brief Tests a range of particles against every collider of a scene, COLLISION_BATCH particles at a time.
+ *
+ * For each batch the kernel computes, in one pass over the colliders, a contact mask per collider and a penetration summary for the whole batch.
+ * Contacts are only written out when the batch has no penetration, per particle, in the order planes, spheres, boxes and capsules.
+ * \param system The particles.
+ * \param begin The first particle to test.
+ * \param end One past the last particle to test.
+ * \param scene The colliders to test against.
+ * \param contacts Where to append the contacts found.
+ * \return PENETRATING as soon as a batch has a penetration, COLLIDING if any contact was appended, NOT_COLLIDING otherwise.
+ */
+int CollideParticles ( const tParticle * system , int begin , int end , const tCollisionScene & scene , std::vector < tContact > & contacts );
+
+#endif // !defined(COLLISIONKERNEL_H__INCLUDED_)
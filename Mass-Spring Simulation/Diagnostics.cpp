@@ -0,0 +1,186 @@
+#include "stdafx.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include "Diagnostics.h"
+#include "PhysEnv.h"
+#include "SimdLanes.h"
+#include "ThreadPool.h"
+
+/**
+ * \brief The sum of the lanes, in double precision.
+ */
+static double SumLanes ( const tFloat8 & a )
+{
+    float lanes [ DIAGNOSTICS_BATCH ];
+    Store8 ( lanes , a );
+    double sum = 0.0;
+    for ( int lane = 0; lane < DIAGNOSTICS_BATCH; ++lane )
+    {
+        sum += lanes [ lane ];
+    }
+    return sum;
+}
+
+static float MaxLanes ( const tFloat8 & a )
+{
+    float lanes [ DIAGNOSTICS_BATCH ];
+    Store8 ( lanes , a );
+    return *std::max_element ( lanes , lanes + DIAGNOSTICS_BATCH );
+}
+
+// THE LANES OF A PARTICLE LOADED AS IT IS STORED
+#define LANE_POSITION			0
+#define LANE_VELOCITY			3
+#define LANE_FORCE				6			// ONLY X AND Y, Z IS PAST THE LAST LANE
+
+static_assert ( offsetof ( tParticle , v ) == LANE_VELOCITY * sizeof ( float ) && offsetof ( tParticle , f ) == LANE_FORCE * sizeof ( float ) , "the particle is loaded into lanes as it is stored" );
+
+/**
+ * \brief Adds one particle to a set of sums.
+ */
+static inline void AddParticle ( const tParticle & particle , tFloat8 & sum , tFloat8 & weighted , tFloat8 & squared , float & forceZ )
+{
+    const tFloat8 state = Load8 ( &particle.pos.x );
+    // A PINNED PARTICLE HAS AN INFINITE MASS AND TAKES NO PART IN THE ENERGY OR THE MOMENTUM
+    const tFloat8 momentum = Set8 ( particle.oneOverM > 0.0f ? 1.0f / particle.oneOverM : 0.0f ) * state;
+    sum = sum + state;
+    weighted = weighted + momentum;
+    squared = squared + momentum * state;
+    forceZ += particle.f.z;
+}
+
+void CDiagnostics::SumParticles ( const tParticle * system , const int begin , const int end , const tVector * gravity , tPartial & partial )
+{
+    // THE LANES RUN ACROSS THE FIELDS OF A PARTICLE RATHER THAN ACROSS PARTICLES, SO NOTHING HAS TO BE GATHERED. TWO PARTICLES ARE
+    // TAKEN AT A TIME INTO TWO SETS OF SUMS SO AN ADDITION DOES NOT WAIT ON THE ONE BEFORE
+    const tFloat8 zero = Set8 ( 0.0f );
+    tFloat8 sumA = zero , weightedA = zero , squaredA = zero , sumB = zero , weightedB = zero , squaredB = zero;
+    float forceZA = 0.0f , forceZB = 0.0f;
+    int index = begin;
+    for ( ; index + 1 < end; index += 2 )
+    {
+        AddParticle ( system [ index ] , sumA , weightedA , squaredA , forceZA );
+        AddParticle ( system [ index + 1 ] , sumB , weightedB , squaredB , forceZB );
+    }
+    if ( index < end )
+    {
+        AddParticle ( system [ index ] , sumA , weightedA , squaredA , forceZA );
+    }
+    float lanes [ 3 ] [ DIAGNOSTICS_BATCH ];
+    Store8 ( lanes [ 0 ] , sumA + sumB );
+    Store8 ( lanes [ 1 ] , weightedA + weightedB );
+    Store8 ( lanes [ 2 ] , squaredA + squaredB );
+    partial.kinetic = 0.0;
+    for ( int axis = 0; axis < 3; ++axis )
+    {
+        partial.position [ axis ] = lanes [ 0 ] [ LANE_POSITION + axis ];
+        partial.velocity [ axis ] = lanes [ 0 ] [ LANE_VELOCITY + axis ];
+        partial.momentum [ axis ] = lanes [ 1 ] [ LANE_VELOCITY + axis ];
+        partial.kinetic += 0.5 * lanes [ 2 ] [ LANE_VELOCITY + axis ];
+    }
+    // THE MASS WEIGHTED POSITIONS ARE IN THE POSITION LANES. GRAVITY PULLS ALONG G, SO THE POTENTIAL FALLS THAT WAY
+    const float * weightedPosition = &lanes [ 1 ] [ LANE_POSITION ];
+    partial.gravity = gravity ? - ( static_cast < double > ( gravity->x ) * weightedPosition [ 0 ] + static_cast < double > ( gravity->y ) * weightedPosition [ 1 ] + static_cast < double > ( gravity->z ) * weightedPosition [ 2 ] ) : 0.0;
+    partial.force [ 0 ] = lanes [ 0 ] [ LANE_FORCE ];
+    partial.force [ 1 ] = lanes [ 0 ] [ LANE_FORCE + 1 ];
+    partial.force [ 2 ] = static_cast < double > ( forceZA ) + forceZB;
+}
+
+void CDiagnostics::SumSprings ( const tParticle * system , const tSpring * springs , const int begin , const int end , tPartial & partial )
+{
+    float dx [ DIAGNOSTICS_BLOCK ] , dy [ DIAGNOSTICS_BLOCK ] , dz [ DIAGNOSTICS_BLOCK ];
+    float rest [ DIAGNOSTICS_BLOCK ] , overRest [ DIAGNOSTICS_BLOCK ] , ks [ DIAGNOSTICS_BLOCK ];
+    const tFloat8 zero = Set8 ( 0.0f );
+    tFloat8 sumEnergy = zero , maxStrain = zero;
+    for ( int first = begin; first < end; first += DIAGNOSTICS_BLOCK )
+    {
+        const int count = std::min ( end - first , DIAGNOSTICS_BLOCK );
+        for ( int at = 0; at < count; ++at )
+        {
+            const tSpring & spring = springs [ first + at ];
+            const tVector & p1 = system [ spring.p1 ].pos;
+            const tVector & p2 = system [ spring.p2 ].pos;
+            dx [ at ] = p1.x - p2.x;
+            dy [ at ] = p1.y - p2.y;
+            dz [ at ] = p1.z - p2.z;
+            rest [ at ] = spring.restLen;
+            // A SPRING WITHOUT A REST LENGTH HAS NO STRAIN
+            overRest [ at ] = spring.restLen > 0.0f ? 1.0f / spring.restLen : 0.0f;
+            ks [ at ] = spring.Ks;
+        }
+        // THE LANES PAST THE LAST SPRING HAVE NO LENGTH, NO REST LENGTH AND NO STIFFNESS, SO NEITHER ENERGY NOR STRAIN
+        const int lanes = ( count + DIAGNOSTICS_BATCH - 1 ) / DIAGNOSTICS_BATCH * DIAGNOSTICS_BATCH;
+        for ( int at = count; at < lanes; ++at )
+        {
+            dx [ at ] = dy [ at ] = dz [ at ] = rest [ at ] = overRest [ at ] = ks [ at ] = 0.0f;
+        }
+        for ( int at = 0; at < lanes; at += DIAGNOSTICS_BATCH )
+        {
+            const tFloat8 x = Load8 ( &dx [ at ] ) , y = Load8 ( &dy [ at ] ) , z = Load8 ( &dz [ at ] );
+            const tFloat8 stretch = Sqrt8 ( x * x + y * y + z * z ) - Load8 ( &rest [ at ] );
+            sumEnergy = sumEnergy + Load8 ( &ks [ at ] ) * stretch * stretch;
+            maxStrain = Max8 ( maxStrain , Max8 ( stretch , zero - stretch ) * Load8 ( &overRest [ at ] ) );
+        }
+    }
+    partial.spring = 0.5 * SumLanes ( sumEnergy );
+    partial.maxStrain = MaxLanes ( maxStrain );
+}
+
+void CDiagnostics::Compute ( const tParticle * system , const int particleCnt , const tSpring * springs , const int springCnt , const tVector * gravity , tDiagnostics & diagnostics )
+{
+    const int particleRuns = ( particleCnt + DIAGNOSTICS_GRAIN - 1 ) / DIAGNOSTICS_GRAIN;
+    const int springRuns = ( springCnt + DIAGNOSTICS_GRAIN - 1 ) / DIAGNOSTICS_GRAIN;
+    const int runs = std::max ( particleRuns , springRuns );
+    this->partials_.resize ( runs );
+    tPartial * partials = this->partials_.data ();
+    // RUN I SUMS THE I-TH RUN OF PARTICLES AND THE I-TH RUN OF SPRINGS, WHICHEVER OF THEM EXIST
+    auto body = [ = ] ( const int begin , const int end , const int )
+    {
+        for ( int run = begin; run < end; ++run )
+        {
+            tPartial & partial = partials [ run ];
+            const int first = run * DIAGNOSTICS_GRAIN;
+            SumParticles ( system , std::min ( first , particleCnt ) , std::min ( first + DIAGNOSTICS_GRAIN , particleCnt ) , gravity , partial );
+            SumSprings ( system , springs , std::min ( first , springCnt ) , std::min ( first + DIAGNOSTICS_GRAIN , springCnt ) , partial );
+        }
+    };
+    if ( runs >= DIAGNOSTICS_PARALLEL )
+    {
+        CThreadPool::Instance ().ParallelFor ( runs , 1 , body );
+    }
+    else
+    {
+        body ( 0 , runs , 0 );
+    }
+    double position [ 3 ] = {} , velocity [ 3 ] = {} , force [ 3 ] = {} , momentum [ 3 ] = {};
+    double kinetic = 0.0 , gravityEnergy = 0.0 , springEnergy = 0.0;
+    float maxStrain = 0.0f;
+    for ( int run = 0; run < runs; ++run )
+    {
+        const tPartial & partial = partials [ run ];
+        for ( int axis = 0; axis < 3; ++axis )
+        {
+            position [ axis ] += partial.position [ axis ];
+            velocity [ axis ] += partial.velocity [ axis ];
+            force [ axis ] += partial.force [ axis ];
+            momentum [ axis ] += partial.momentum [ axis ];
+        }
+        kinetic += partial.kinetic;
+        gravityEnergy += partial.gravity;
+        springEnergy += partial.spring;
+        maxStrain = std::max ( maxStrain , partial.maxStrain );
+    }
+    const double overCnt = particleCnt > 0 ? 1.0 / particleCnt : 0.0;
+    diagnostics.kineticEnergy = kinetic;
+    diagnostics.gravityEnergy = gravityEnergy;
+    diagnostics.springEnergy = springEnergy;
+    diagnostics.totalEnergy = kinetic + gravityEnergy + springEnergy;
+    MAKEVECTOR ( diagnostics.momentum , static_cast < float > ( momentum [ 0 ] ) , static_cast < float > ( momentum [ 1 ] ) , static_cast < float > ( momentum [ 2 ] ) );
+    MAKEVECTOR ( diagnostics.centroid , static_cast < float > ( position [ 0 ] * overCnt ) , static_cast < float > ( position [ 1 ] * overCnt ) , static_cast < float > ( position [ 2 ] * overCnt ) );
+    MAKEVECTOR ( diagnostics.meanVelocity , static_cast < float > ( velocity [ 0 ] * overCnt ) , static_cast < float > ( velocity [ 1 ] * overCnt ) , static_cast < float > ( velocity [ 2 ] * overCnt ) );
+    MAKEVECTOR ( diagnostics.meanForce , static_cast < float > ( force [ 0 ] * overCnt ) , static_cast < float > ( force [ 1 ] * overCnt ) , static_cast < float > ( force [ 2 ] * overCnt ) );
+    diagnostics.maxStrain = maxStrain;
+    diagnostics.particleCnt = particleCnt;
+    diagnostics.springCnt = springCnt;
+}
@@ -0,0 +1,70 @@
+#if !defined(DIAGNOSTICS_H__INCLUDED_)
+#define DIAGNOSTICS_H__INCLUDED_
+
+#include <vector>
+#include "MathDefs.h"
+
+#define DIAGNOSTICS_BATCH		8			// SPRINGS SUMMED TOGETHER, ONE PER LANE
+#define DIAGNOSTICS_BLOCK		64			// SPRINGS GATHERED INTO LANES AT A TIME
+#define DIAGNOSTICS_GRAIN		4096		// PARTICLES OR SPRINGS IN ONE PARTIAL SUM
+#define DIAGNOSTICS_PARALLEL	4			// PARTIAL SUMS A SYSTEM NEEDS BEFORE THEY ARE HANDED TO THE POOL
+#define DIAGNOSTICS_EVERY		10			// STEPS BETWEEN TWO SAMPLES TAKEN BY THE SIMULATION
+
+struct tParticle;
+struct tSpring;
+
+/**
+ * \brief The state of a particle system summed up, to watch whether a run stays stable.
+ *
+ * The energies and the momentum only count particles of finite mass. The means count every particle, as the logged values always have.
+ */
+struct tDiagnostics
+{
+    double kineticEnergy;
+    double gravityEnergy;			// POTENTIAL OF THE GRAVITY, ZERO AT THE ORIGIN
+    double springEnergy;			// POTENTIAL OF THE SPRINGS, ZERO AT THEIR REST LENGTH
+    double totalEnergy;
+    tVector momentum;
+    tVector centroid;				// MEAN POSITION
+    tVector meanVelocity;
+    tVector meanForce;
+    float maxStrain;				// LARGEST CHANGE OF LENGTH OF A SPRING OVER ITS REST LENGTH
+    int particleCnt;
+    int springCnt;
+};
+
+/**
+ * \brief Sums up a particle system and its springs in a single traversal of each.
+ *
+ * Both lists are cut into runs of DIAGNOSTICS_GRAIN items, and each run is summed in single precision lanes into its own partial sum.
+ * A particle is loaded whole, one field per lane, since it is stored as consecutive floats. The springs are gathered DIAGNOSTICS_BATCH at
+ * a time, one per lane, as their ends are anywhere in the system. The partial sums are added up in order and in double precision at the end, so the result is the same
+ * whichever worker took a run. Large systems hand the runs to the thread pool.
+ */
+class CDiagnostics
+{
+public:
+    /**
+     * \brief Sums up a system.
+     * \param system The particles.
+     * \param particleCnt How many there are.
+     * \param springs The springs between them.
+     * \param springCnt How many there are, 0 to skip the springs when only the particle sums are wanted.
+     * \param gravity The acceleration of gravity, or NULL when it is off.
+     * \param diagnostics Where to write the result.
+     */
+    void Compute ( const tParticle * system , int particleCnt , const tSpring * springs , int springCnt , const tVector * gravity , tDiagnostics & diagnostics );
+private:
+    // PADDED SO TWO WORKERS NEVER WRITE TO THE SAME CACHE LINE
+    struct alignas ( 64 ) tPartial
+    {
+        double position [ 3 ] , velocity [ 3 ] , force [ 3 ] , momentum [ 3 ];
+        double kinetic , gravity , spring;
+        float maxStrain;
+    };
+    static void SumParticles ( const tParticle * system , int begin , int end , const tVector * gravity , tPartial & partial );
+    static void SumSprings ( const tParticle * system , const tSpring * springs , int begin , int end , tPartial & partial );
+    std::vector < tPartial > partials_;		// KEPT BETWEEN CALLS SO SAMPLING DOES NOT ALLOCATE
+};
+
+#endif // !defined(DIAGNOSTICS_H__INCLUDED_)
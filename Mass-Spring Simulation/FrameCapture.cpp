@@ -0,0 +1,302 @@
+#include "stdafx.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include "FrameCapture.h"
+
+static const unsigned char WORLD_COLOR [ 3 ] = { 255 , 255 , 255 };
+static const unsigned char SPRING_COLOR [ 3 ] = { 0 , 204 , 204 };
+static const unsigned char PARTICLE_COLOR [ 3 ] = { 204 , 204 , 0 };
+
+/**
+ * \brief The window at its start: the camera CAPTURE_DISTANCE back from the world, seen through gluPerspective.
+ */
+static void DefaultView ( const float aspect , tMatrix * modelView , tMatrix * projection )
+{
+    std::memset ( modelView->m , 0 , sizeof ( modelView->m ) );
+    modelView->m [ 0 ] = modelView->m [ 5 ] = modelView->m [ 10 ] = modelView->m [ 15 ] = 1.0f;
+    modelView->m [ 14 ] = -CAPTURE_DISTANCE;
+    const float f = 1.0f / std::tan ( CAPTURE_FOV * 0.5f * 3.14159265f / 180.0f );
+    std::memset ( projection->m , 0 , sizeof ( projection->m ) );
+    projection->m [ 0 ] = f / aspect;
+    projection->m [ 5 ] = f;
+    projection->m [ 10 ] = ( CAPTURE_FAR + CAPTURE_NEAR ) / ( CAPTURE_NEAR - CAPTURE_FAR );
+    projection->m [ 11 ] = -1.0f;
+    projection->m [ 14 ] = 2.0f * CAPTURE_FAR * CAPTURE_NEAR / ( CAPTURE_NEAR - CAPTURE_FAR );
+}
+
+CFrameCapture::CFrameCapture () : width_ ( CAPTURE_WIDTH ) , height_ ( CAPTURE_HEIGHT ) , nextTime_ ( -1.0 ) , due_ ( 0 ) , frames_ ( 0 ) , springGeneration_ ( 0 ) , failed_ ( false )
+{
+    this->pattern_ [ 0 ] = '\0';
+    DefaultView ( static_cast < float > ( CAPTURE_WIDTH ) / CAPTURE_HEIGHT , &this->modelView_ , &this->projection_ );
+}
+
+CFrameCapture::~CFrameCapture ()
+{
+    this->Close ();
+}
+
+bool CFrameCapture::Open ( const char * pattern , const int width , const int height )
+{
+    this->Close ();
+    if ( width <= 0 || height <= 0 || std::strlen ( pattern ) >= CAPTURE_NAME_SIZE )
+    {
+        return false;
+    }
+    std::strcpy ( this->pattern_ , pattern );
+    this->width_ = width;
+    this->height_ = height;
+    tMatrix modelView;
+    DefaultView ( static_cast < float > ( width ) / height , &modelView , &this->projection_ );
+    this->pixels_.resize ( 3 * static_cast < std::size_t > ( width ) * height );
+    this->depth_.resize ( static_cast < std::size_t > ( width ) * height );
+    this->ring_.Slots ().resize ( CAPTURE_SLOTS );
+    for ( tFrame & frame : this->ring_.Slots () )
+    {
+        frame.springGeneration = -1;
+    }
+    this->nextTime_ = -1.0;
+    this->due_ = 0;
+    this->frames_ = 0;
+    this->failed_ = false;
+    this->ring_.Start ( RECORDER_DROP , [ this ] ( tFrame & frame ) { this->WriteFrame ( frame ); } );
+    return true;
+}
+
+int CFrameCapture::Capture ( const float time , const tVertexStream & stream , const tSpring * springs , const int springCnt , const tVector & worldSize )
+{
+    if ( ! this->ring_.Running () )
+    {
+        return 0;
+    }
+    if ( this->nextTime_ < 0.0 )
+    {
+        this->nextTime_ = time;
+    }
+    if ( time < this->nextTime_ )
+    {
+        return 0;
+    }
+    // A STEP LONGER THAN A FRAME COVERS SEVERAL, ONLY THE LAST ONE IS WORTH DRAWING
+    const int index = this->due_;
+    while ( time >= this->nextTime_ )
+    {
+        ++this->due_;
+        this->nextTime_ += 1.0 / CAPTURE_RATE;
+    }
+    tFrame * frame = this->ring_.Acquire ();
+    if ( frame == NULL )
+    {
+        return 0;
+    }
+    // THE ONLY WORK LEFT ON THE SIMULATION THREAD, THE VECTORS KEEP THEIR ROOM FROM ONE FRAME TO THE NEXT
+    frame->positions.resize ( stream.count );
+    for ( int i = 0; i < stream.count; ++i )
+    {
+        const float * position = stream.At ( i );
+        MAKEVECTOR ( frame->positions [ i ] , position [ 0 ] , position [ 1 ] , position [ 2 ] );
+    }
+    if ( frame->springGeneration != this->springGeneration_ || frame->edges.size () != 2 * static_cast < std::size_t > ( springCnt ) )
+    {
+        frame->edges.resize ( 2 * static_cast < std::size_t > ( springCnt ) );
+        for ( int i = 0; i < springCnt; ++i )
+        {
+            frame->edges [ 2 * i ] = springs [ i ].p1;
+            frame->edges [ 2 * i + 1 ] = springs [ i ].p2;
+        }
+        frame->springGeneration = this->springGeneration_;
+    }
+    for ( int column = 0; column < 4; ++column )
+    {
+        for ( int row = 0; row < 4; ++row )
+        {
+            float sum = 0.0f;
+            for ( int k = 0; k < 4; ++k )
+            {
+                sum += this->projection_.m [ k * 4 + row ] * this->modelView_.m [ column * 4 + k ];
+            }
+            frame->view [ column * 4 + row ] = sum;
+        }
+    }
+    frame->worldSize = worldSize;
+    frame->index = index;
+    this->ring_.Publish ();
+    ++this->frames_;
+    return 1;
+}
+
+bool CFrameCapture::Close ()
+{
+    if ( ! this->ring_.Running () )
+    {
+        return true;
+    }
+    this->ring_.Stop ();
+    return ! this->failed_;
+}
+
+void CFrameCapture::Project ( const float view [ 16 ] , const tVector & position , tScreen * screen ) const
+{
+    float clip [ 4 ];
+    for ( int row = 0; row < 4; ++row )
+    {
+        clip [ row ] = view [ row ] * position.x + view [ 4 + row ] * position.y + view [ 8 + row ] * position.z + view [ 12 + row ];
+    }
+    if ( ! ( clip [ 3 ] > 0.0f ) )
+    {
+        screen->x = screen->y = 0.0f;
+        screen->z = -1.0f;
+        return;
+    }
+    screen->x = ( clip [ 0 ] / clip [ 3 ] + 1.0f ) * 0.5f * this->width_;
+    screen->y = ( 1.0f - clip [ 1 ] / clip [ 3 ] ) * 0.5f * this->height_;
+    screen->z = ( clip [ 2 ] / clip [ 3 ] + 1.0f ) * 0.5f;
+}
+
+void CFrameCapture::Plot ( const int x , const int y , const float z , const unsigned char color [ 3 ] )
+{
+    if ( x < 0 || y < 0 || x >= this->width_ || y >= this->height_ || z < 0.0f || z > 1.0f )
+    {
+        return;
+    }
+    const std::size_t at = static_cast < std::size_t > ( y ) * this->width_ + x;
+    // GL_LEQUAL, AS THE WINDOW TESTS DEPTH
+    if ( z <= this->depth_ [ at ] )
+    {
+        this->depth_ [ at ] = z;
+        std::memcpy ( &this->pixels_ [ 3 * at ] , color , 3 );
+    }
+}
+
+void CFrameCapture::DrawLine ( tScreen a , tScreen b , const unsigned char color [ 3 ] )
+{
+    // A LINE WITH AN END BEHIND THE EYE IS LEFT OUT RATHER THAN CLIPPED
+    if ( a.z < 0.0f || b.z < 0.0f )
+    {
+        return;
+    }
+    // CUT THE LINE TO THE IMAGE FIRST, SO A LINE FROM FAR OUTSIDE DOES NOT STEP THROUGH PIXELS NEVER SEEN
+    float from = 0.0f , to = 1.0f;
+    const float dx = b.x - a.x , dy = b.y - a.y;
+    const float p [ 4 ] = { -dx , dx , -dy , dy };
+    const float q [ 4 ] = { a.x , this->width_ - 1.0f - a.x , a.y , this->height_ - 1.0f - a.y };
+    for ( int edge = 0; edge < 4; ++edge )
+    {
+        if ( p [ edge ] == 0.0f )
+        {
+            if ( q [ edge ] < 0.0f )
+            {
+                return;
+            }
+            continue;
+        }
+        const float t = q [ edge ] / p [ edge ];
+        if ( p [ edge ] < 0.0f )
+        {
+            from = std::max ( from , t );
+        }
+        else
+        {
+            to = std::min ( to , t );
+        }
+    }
+    if ( from > to )
+    {
+        return;
+    }
+    const float dz = b.z - a.z;
+    tScreen start = { a.x + from * dx , a.y + from * dy , a.z + from * dz };
+    tScreen end = { a.x + to * dx , a.y + to * dy , a.z + to * dz };
+    const float sx = end.x - start.x , sy = end.y - start.y , sz = end.z - start.z;
+    const int steps = static_cast < int > ( std::ceil ( std::max ( std::fabs ( sx ) , std::fabs ( sy ) ) ) );
+    // TWO PIXELS WIDE ACROSS THE LINE, AS glLineWidth IN THE WINDOW
+    const bool across = std::fabs ( sx ) >= std::fabs ( sy );
+    for ( int step = 0; step <= steps; ++step )
+    {
+        const float t = steps > 0 ? static_cast < float > ( step ) / steps : 0.0f;
+        const int x = static_cast < int > ( start.x + t * sx + 0.5f ) , y = static_cast < int > ( start.y + t * sy + 0.5f );
+        const float z = start.z + t * sz;
+        this->Plot ( x , y , z , color );
+        this->Plot ( across ? x : x + 1 , across ? y + 1 : y , z , color );
+    }
+}
+
+void CFrameCapture::DrawPoint ( const tScreen & p , const unsigned char color [ 3 ] )
+{
+    if ( p.z < 0.0f )
+    {
+        return;
+    }
+    const int left = static_cast < int > ( std::floor ( p.x - CAPTURE_POINT_SIZE * 0.5f + 0.5f ) );
+    const int top = static_cast < int > ( std::floor ( p.y - CAPTURE_POINT_SIZE * 0.5f + 0.5f ) );
+    if ( left >= this->width_ || top >= this->height_ || left + CAPTURE_POINT_SIZE <= 0 || top + CAPTURE_POINT_SIZE <= 0 )
+    {
+        return;
+    }
+    for ( int y = top; y < top + CAPTURE_POINT_SIZE; ++y )
+    {
+        for ( int x = left; x < left + CAPTURE_POINT_SIZE; ++x )
+        {
+            this->Plot ( x , y , p.z , color );
+        }
+    }
+}
+
+/**
+ * \brief Draws a frame and writes it out, on the writer thread.
+ */
+void CFrameCapture::WriteFrame ( const tFrame & frame )
+{
+    std::fill ( this->pixels_.begin () , this->pixels_.end () , 0 );
+    std::fill ( this->depth_.begin () , this->depth_.end () , 1.0f );
+    // THE EDGES OF THE WORLD THE WINDOW DRAWS, THE FLOOR AND THE LIT SURFACE ARE LEFT OUT
+    const float hx = frame.worldSize.x / 2.0f , hy = frame.worldSize.y / 2.0f , hz = frame.worldSize.z / 2.0f;
+    const float box [ 8 ] [ 6 ] =
+    {
+        { -hx , hy , -hz , hx , hy , -hz } , { hx , hy , -hz , hx , hy , hz } , { hx , hy , hz , -hx , hy , hz } ,
+        { -hx , hy , hz , -hx , hy , -hz } , { -hx , hy , -hz , -hx , -hy , -hz } , { hx , hy , -hz , hx , -hy , -hz } ,
+        { hx , hy , hz , hx , -hy , hz } , { -hx , hy , hz , -hx , -hy , hz }
+    };
+    for ( const float * edge : box )
+    {
+        tVector from , to;
+        tScreen a , b;
+        MAKEVECTOR ( from , edge [ 0 ] , edge [ 1 ] , edge [ 2 ] );
+        MAKEVECTOR ( to , edge [ 3 ] , edge [ 4 ] , edge [ 5 ] );
+        this->Project ( frame.view , from , &a );
+        this->Project ( frame.view , to , &b );
+        this->DrawLine ( a , b , WORLD_COLOR );
+    }
+    const int particleCnt = static_cast < int > ( frame.positions.size () );
+    this->screen_.resize ( particleCnt );
+    for ( int i = 0; i < particleCnt; ++i )
+    {
+        this->Project ( frame.view , frame.positions [ i ] , &this->screen_ [ i ] );
+    }
+    for ( std::size_t i = 0; i + 1 < frame.edges.size (); i += 2 )
+    {
+        const int p1 = frame.edges [ i ] , p2 = frame.edges [ i + 1 ];
+        if ( p1 >= 0 && p2 >= 0 && p1 < particleCnt && p2 < particleCnt )
+        {
+            this->DrawLine ( this->screen_ [ p1 ] , this->screen_ [ p2 ] , SPRING_COLOR );
+        }
+    }
+    for ( int i = 0; i < particleCnt; ++i )
+    {
+        this->DrawPoint ( this->screen_ [ i ] , PARTICLE_COLOR );
+    }
+    char name [ CAPTURE_NAME_SIZE + 32 ];
+    std::snprintf ( name , sizeof ( name ) , this->pattern_ , frame.index );
+    FILE * fp = fopen ( name , "wb" );
+    if ( fp == NULL )
+    {
+        this->failed_ = true;
+        return;
+    }
+    const bool written = fprintf ( fp , "P6\n%d %d\n255\n" , this->width_ , this->height_ ) > 0 && fwrite ( this->pixels_.data () , 1 , this->pixels_.size () , fp ) == this->pixels_.size ();
+    if ( fclose ( fp ) != 0 || ! written )
+    {
+        this->failed_ = true;
+    }
+}
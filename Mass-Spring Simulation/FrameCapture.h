@@ -0,0 +1,100 @@
+#if !defined(FRAMECAPTURE_H__INCLUDED_)
+#define FRAMECAPTURE_H__INCLUDED_
+
+#include <vector>
+#include "PhysEnv.h"
+#include "SlotRing.h"
+#include "VertexStream.h"
+
+#define CAPTURE_SLOTS			2			// FRAMES WAITING TO BE DRAWN, ONE BEING FILLED WHILE THE OTHER IS WRITTEN
+#define CAPTURE_RATE			30.0f		// FRAMES PER SECOND OF SIMULATED TIME
+#define CAPTURE_WIDTH			640
+#define CAPTURE_HEIGHT			480
+#define CAPTURE_POINT_SIZE		8			// PIXELS ACROSS A PARTICLE, AS glPointSize IN THE WINDOW
+#define CAPTURE_FOV				10.0f		// THE PERSPECTIVE AND STARTING DISTANCE OF THE WINDOW
+#define CAPTURE_NEAR			1.0f
+#define CAPTURE_FAR				2000.0f
+#define CAPTURE_DISTANCE		100.0f
+#define CAPTURE_NAME_SIZE		512
+
+/**
+ * \brief Writes the simulation as a sequence of PPM images without a window or an OpenGL context, for machines that have neither.
+ *
+ * Capture samples the simulation at a fixed rate of simulated time and only copies the positions and the springs into a ring of
+ * CAPTURE_SLOTS frames, with the view of the moment. A slot keeps its springs until they change. A thread of its own draws each frame with a small rasterizer on the CPU, the world
+ * box, the springs and the particles in the colors of the window with a depth buffer, and writes it out. The ring drops a frame that finds
+ * it full, so the simulation never waits for the images, and a dropped frame leaves a gap in the numbering.
+ *
+ * The camera is the one the window starts with until SetView moves it. The perspective is that of the window, for the shape of the images.
+ */
+class CFrameCapture
+{
+public:
+    CFrameCapture ();
+    ~CFrameCapture ();
+    CFrameCapture ( const CFrameCapture & other ) = delete;
+    CFrameCapture & operator= ( const CFrameCapture & other ) = delete;
+    /**
+     * \brief Starts a sequence, ending the one before.
+     * \param pattern The name of each image, with a single %d for its number, like "frame%05d.ppm".
+     * \return False when the size is not positive.
+     */
+    bool Open ( const char * pattern , int width , int height );
+    /**
+     * \brief The camera the next frames are seen from, as the modelview matrix the window draws with.
+     */
+    void SetView ( const tMatrix & modelView ) { this->modelView_ = modelView; }
+    /**
+     * \brief Copies the springs again with the next frames. Called whenever a spring is added, removed or changed.
+     */
+    void Invalidate () { ++this->springGeneration_; }
+    /**
+     * \brief Adds a frame when time reaches the next one due. The first call starts the clock of the sequence.
+     * \param worldSize The size of the world box drawn around the particles.
+     * \return The number of frames added, 0 or 1.
+     */
+    int Capture ( float time , const tVertexStream & stream , const tSpring * springs , int springCnt , const tVector & worldSize );
+    /**
+     * \brief Writes the frames still waiting.
+     * \return False when an image could not be written.
+     */
+    bool Close ();
+    bool IsOpen () const { return this->ring_.Running (); }
+    int Frames () const { return this->frames_; }
+    int Dropped () const { return this->ring_.Dropped (); }
+private:
+    struct tFrame
+    {
+        std::vector < tVector > positions;
+        std::vector < int > edges;				// THE TWO PARTICLES OF EACH SPRING
+        int springGeneration;					// THE SPRINGS THE EDGES WERE COPIED FROM
+        float view [ 16 ];						// PROJECTION TIMES MODELVIEW, COLUMN MAJOR LIKE OPENGL
+        tVector worldSize;
+        int index;
+    };
+    struct tScreen
+    {
+        float x , y , z;						// PIXELS FROM THE TOP LEFT AND DEPTH FROM 0 TO 1, z NEGATIVE BEHIND THE EYE
+    };
+    void WriteFrame ( const tFrame & frame );
+    void Project ( const float view [ 16 ] , const tVector & position , tScreen * screen ) const;
+    void DrawLine ( tScreen a , tScreen b , const unsigned char color [ 3 ] );
+    void DrawPoint ( const tScreen & p , const unsigned char color [ 3 ] );
+    void Plot ( int x , int y , float z , const unsigned char color [ 3 ] );
+    char pattern_ [ CAPTURE_NAME_SIZE ];
+    int width_;
+    int height_;
+    tMatrix modelView_;
+    tMatrix projection_;
+    double nextTime_;							// WHEN THE NEXT FRAME IS DUE, NEGATIVE BEFORE THE FIRST ONE
+    int due_;									// FRAMES DUE SO FAR, DROPPED OR NOT
+    int frames_;								// FRAMES HANDED TO THE WRITER
+    int springGeneration_;
+    bool failed_;
+    std::vector < tScreen > screen_;			// ONLY USED BY THE WRITER
+    std::vector < unsigned char > pixels_;		// RGB, TOP ROW FIRST
+    std::vector < float > depth_;
+    CSlotRing < tFrame > ring_;					// LAST, SO ITS WRITER STOPS BEFORE THE REST GOES
+};
+
+#endif // !defined(FRAMECAPTURE_H__INCLUDED_)
@@ -0,0 +1,174 @@
+#include "stdafx.h"
+#include <cstdio>
+#include <cstring>
+#include "HardwareCounters.h"
+#if defined(__linux__)
+#include <cerrno>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+const char * HW_EVENT_NAMES [ HW_EVENT_CNT ] = { "cycles" , "instructions" , "LLC misses" , "branch misses" };
+
+CHardwareCounters::CHardwareCounters ()
+{
+    for ( int event = 0; event < HW_EVENT_CNT; ++event )
+    {
+        this->fds_ [ event ] = -1;
+        this->slots_ [ event ] = -1;
+    }
+    this->leader_ = -1;
+    this->eventCnt_ = 0;
+    this->error_ [ 0 ] = '\0';
+}
+
+CHardwareCounters::~CHardwareCounters ()
+{
+    this->Close ();
+}
+
+#if defined(__linux__)
+
+/**
+ * \brief Opens one event of a thread (0 for the calling one), on whichever processor it runs, into the group of leader (-1 to start a group).
+ * \return The file of the event, -1 with errno set when it cannot be counted.
+ */
+static int OpenEvent ( const int event , const long thread , const int leader )
+{
+    static const std::uint64_t CONFIGS [ HW_EVENT_CNT ] = { PERF_COUNT_HW_CPU_CYCLES , PERF_COUNT_HW_INSTRUCTIONS , PERF_COUNT_HW_CACHE_MISSES , PERF_COUNT_HW_BRANCH_MISSES };
+    struct perf_event_attr attr;
+    std::memset ( &attr , 0 , sizeof ( attr ) );
+    attr.size = sizeof ( attr );
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = CONFIGS [ event ];
+    // THE LEADER STARTS STOPPED AND TAKES THE WHOLE GROUP WITH IT WHEN ENABLED. IT IS PINNED SO THE GROUP IS NEVER SHARED OUT WITH
+    // OTHER USERS OF THE COUNTERS, WHICH WOULD LEAVE GAPS IN THE COUNTS; A GROUP THAT LOSES ITS COUNTERS CAN NO LONGER BE READ INSTEAD
+    attr.disabled = leader < 0 ? 1 : 0;
+    attr.pinned = leader < 0 ? 1 : 0;
+    // USER SPACE ONLY, WHICH IS ALL THE SIMULATION DOES AND WHAT perf_event_paranoid 2 STILL ALLOWS
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    return static_cast < int > ( syscall ( SYS_perf_event_open , &attr , static_cast < pid_t > ( thread ) , -1 , leader , 0 ) );
+}
+
+long CHardwareCounters::ThreadId ()
+{
+    return static_cast < long > ( syscall ( SYS_gettid ) );
+}
+
+bool CHardwareCounters::Open ( const long thread )
+{
+    this->Close ();
+    int firstErrno = 0;
+    char missing [ 96 ] = "";
+    for ( int event = 0; event < HW_EVENT_CNT; ++event )
+    {
+        const int fd = OpenEvent ( event , thread , this->leader_ );
+        if ( fd < 0 )
+        {
+            // A VIRTUAL MACHINE OFTEN HAS THE CYCLES BUT NOT THE CACHE EVENTS, SO ONE MISSING EVENT DOES NOT STOP THE OTHERS
+            firstErrno = firstErrno != 0 ? firstErrno : errno;
+            std::strcat ( missing , missing [ 0 ] != '\0' ? ", " : "" );
+            std::strcat ( missing , HW_EVENT_NAMES [ event ] );
+            continue;
+        }
+        this->fds_ [ event ] = fd;
+        this->slots_ [ event ] = this->eventCnt_++;
+        if ( this->leader_ < 0 )
+        {
+            this->leader_ = fd;
+        }
+    }
+    if ( this->leader_ < 0 )
+    {
+        std::snprintf ( this->error_ , sizeof ( this->error_ ) , "perf_event_open failed: %s%s" , std::strerror ( firstErrno ) ,
+            firstErrno == EACCES || firstErrno == EPERM ? " (see /proc/sys/kernel/perf_event_paranoid)" : "" );
+        return false;
+    }
+    if ( ioctl ( this->leader_ , PERF_EVENT_IOC_RESET , PERF_IOC_FLAG_GROUP ) != 0 || ioctl ( this->leader_ , PERF_EVENT_IOC_ENABLE , PERF_IOC_FLAG_GROUP ) != 0 )
+    {
+        const int failure = errno;
+        this->Close ();
+        std::snprintf ( this->error_ , sizeof ( this->error_ ) , "the counters could not be started: %s" , std::strerror ( failure ) );
+        return false;
+    }
+    if ( missing [ 0 ] != '\0' )
+    {
+        std::snprintf ( this->error_ , sizeof ( this->error_ ) , "not counted: %s (%s)" , missing , std::strerror ( firstErrno ) );
+    }
+    return true;
+}
+
+void CHardwareCounters::Close ()
+{
+    // THE MEMBERS GO FIRST, THE GROUP ENDS WITH ITS LEADER
+    for ( int event = HW_EVENT_CNT - 1; event >= 0; --event )
+    {
+        if ( this->fds_ [ event ] >= 0 && this->fds_ [ event ] != this->leader_ )
+        {
+            close ( this->fds_ [ event ] );
+        }
+    }
+    if ( this->leader_ >= 0 )
+    {
+        close ( this->leader_ );
+    }
+    for ( int event = 0; event < HW_EVENT_CNT; ++event )
+    {
+        this->fds_ [ event ] = -1;
+        this->slots_ [ event ] = -1;
+    }
+    this->leader_ = -1;
+    this->eventCnt_ = 0;
+    this->error_ [ 0 ] = '\0';
+}
+
+bool CHardwareCounters::Read ( std::uint64_t counts [ HW_EVENT_CNT ] ) const
+{
+    if ( this->leader_ < 0 )
+    {
+        return false;
+    }
+    // THE NUMBER OF EVENTS, THEN A VALUE FOR EACH EVENT IN THE ORDER THEY JOINED. A PINNED GROUP THAT LOST ITS COUNTERS READS NOTHING
+    std::uint64_t group [ 1 + HW_EVENT_CNT ];
+    const ssize_t size = static_cast < ssize_t > ( ( 1 + this->eventCnt_ ) * sizeof ( std::uint64_t ) );
+    if ( read ( this->leader_ , group , sizeof ( group ) ) != size || group [ 0 ] != static_cast < std::uint64_t > ( this->eventCnt_ ) )
+    {
+        return false;
+    }
+    for ( int event = 0; event < HW_EVENT_CNT; ++event )
+    {
+        const int slot = this->slots_ [ event ];
+        counts [ event ] = slot < 0 ? 0 : group [ 1 + slot ];
+    }
+    return true;
+}
+
+#else
+
+long CHardwareCounters::ThreadId ()
+{
+    return 0;
+}
+
+bool CHardwareCounters::Open ( long )
+{
+    this->Close ();
+    std::snprintf ( this->error_ , sizeof ( this->error_ ) , "hardware counters are only read on Linux" );
+    return false;
+}
+
+void CHardwareCounters::Close ()
+{
+    this->error_ [ 0 ] = '\0';
+}
+
+bool CHardwareCounters::Read ( std::uint64_t * ) const
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,74 @@
+#if !defined(HARDWARECOUNTERS_H__INCLUDED_)
+#define HARDWARECOUNTERS_H__INCLUDED_
+
+#include <cstdint>
+
+enum tHardwareEvents
+{
+    HW_CYCLES,
+    HW_INSTRUCTIONS,
+    HW_LLC_MISSES,			// LAST LEVEL CACHE MISSES, THE LOADS THAT WENT TO MEMORY
+    HW_BRANCH_MISSES,
+    HW_EVENT_CNT
+};
+
+extern const char * HW_EVENT_NAMES [ HW_EVENT_CNT ];
+
+/**
+ * \brief The processor event counters of one thread, read all at once.
+ *
+ * On Linux every event is opened with perf_event_open for the thread and user space only, in one group, so a single read returns all
+ * of them over the same stretch of time. Any thread of the process can read the group, not only the one counted. An event the processor or the kernel does not offer is left out of the group and
+ * reads as 0. When none can be opened, as in most containers or where perf_event_paranoid forbids it, Open fails and Error says why.
+ * Other systems have no counters.
+ */
+class CHardwareCounters
+{
+public:
+    CHardwareCounters ();
+    ~CHardwareCounters ();
+    CHardwareCounters ( const CHardwareCounters & other ) = delete;
+    CHardwareCounters & operator= ( const CHardwareCounters & other ) = delete;
+    /**
+     * \brief Opens and starts the counters of a thread, as ThreadId gives it, or of the calling thread with 0.
+     * \return False when no event could be counted.
+     */
+    bool Open ( long thread = 0 );
+    void Close ();
+    bool IsOpen () const
+    {
+        return this->leader_ >= 0;
+    }
+    /**
+     * \brief Whether an event is in the group, so its reads mean something.
+     */
+    bool Has ( const int event ) const
+    {
+        return this->slots_ [ event ] >= 0;
+    }
+    /**
+     * \brief The counts since Open.
+     * \return False when the counters could not be read, leaving counts alone. That is also the case once the group lost the processor
+     * counters to another user, rather than returning counts with gaps in them.
+     */
+    bool Read ( std::uint64_t counts [ HW_EVENT_CNT ] ) const;
+    /**
+     * \brief Why the last Open failed, or which events it left out.
+     */
+    const char * Error () const
+    {
+        return this->error_;
+    }
+    /**
+     * \brief The id the system knows the calling thread by, for another thread to Open its counters. 0 where there are no counters.
+     */
+    static long ThreadId ();
+private:
+    int fds_ [ HW_EVENT_CNT ];			// -1 FOR AN EVENT NOT COUNTED
+    int slots_ [ HW_EVENT_CNT ];		// WHERE EACH EVENT COMES IN A READ OF THE GROUP, -1 WHEN NOT COUNTED
+    int leader_;						// THE FIRST EVENT OPENED, THE OTHERS JOIN ITS GROUP
+    int eventCnt_;
+    char error_ [ 160 ];
+};
+
+#endif // !defined(HARDWARECOUNTERS_H__INCLUDED_)
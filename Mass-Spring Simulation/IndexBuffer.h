@@ -0,0 +1,88 @@
+#if !defined(INDEXBUFFER_H__INCLUDED_)
+#define INDEXBUFFER_H__INCLUDED_
+
+#include <cstddef>
+#include <cstdlib>
+#include <GL/gl.h>
+
+#define INDEX16_VERTEX_LIMIT	65536L		// MOST VERTICES A 16 BIT INDEX CAN REACH
+
+/**
+ * \brief The OpenGL type of each index width.
+ */
+template < typename Index >
+struct tIndexTraits;
+
+template <>
+struct tIndexTraits < unsigned short >
+{
+    static const GLenum type = GL_UNSIGNED_SHORT;
+};
+
+template <>
+struct tIndexTraits < unsigned int >
+{
+    static const GLenum type = GL_UNSIGNED_INT;
+};
+
+/**
+ * \brief Index buffers are as narrow as the vertex count allows: 16 bits up to INDEX16_VERTEX_LIMIT vertices, which halves the memory and cache
+ * traffic of every small mesh, and 32 bits past it. The width is never stored, it always follows from the vertex count of the visual.
+ */
+inline bool WideIndices ( const long vertexCnt )
+{
+    return vertexCnt > INDEX16_VERTEX_LIMIT;
+}
+
+inline std::size_t IndexSize ( const long vertexCnt )
+{
+    return WideIndices ( vertexCnt ) ? sizeof ( unsigned int ) : sizeof ( unsigned short );
+}
+
+inline GLenum IndexType ( const long vertexCnt )
+{
+    return WideIndices ( vertexCnt ) ? tIndexTraits < unsigned int >::type : tIndexTraits < unsigned short >::type;
+}
+
+/**
+ * \brief Allocates an index buffer with malloc, so it is released with free like the rest of a visual.
+ */
+inline void * AllocIndices ( const long vertexCnt , const long indexCnt )
+{
+    return std::malloc ( IndexSize ( vertexCnt ) * indexCnt );
+}
+
+/**
+ * \brief Calls visit with the buffer as a pointer to the right index type, for loops that should not test the width on every index.
+ */
+template < typename Visit >
+inline void VisitIndices ( void * indices , const long vertexCnt , Visit visit )
+{
+    if ( WideIndices ( vertexCnt ) )
+    {
+        visit ( static_cast < unsigned int * > ( indices ) );
+    }
+    else
+    {
+        visit ( static_cast < unsigned short * > ( indices ) );
+    }
+}
+
+inline void SetIndex ( void * indices , const long vertexCnt , const long at , const unsigned long value )
+{
+    if ( WideIndices ( vertexCnt ) )
+    {
+        static_cast < unsigned int * > ( indices ) [ at ] = static_cast < unsigned int > ( value );
+    }
+    else
+    {
+        static_cast < unsigned short * > ( indices ) [ at ] = static_cast < unsigned short > ( value );
+    }
+}
+
+inline unsigned long GetIndex ( const void * indices , const long vertexCnt , const long at )
+{
+    return WideIndices ( vertexCnt ) ? static_cast < const unsigned int * > ( indices ) [ at ] : static_cast < const unsigned short * > ( indices ) [ at ];
+}
+
+#endif // !defined(INDEXBUFFER_H__INCLUDED_)
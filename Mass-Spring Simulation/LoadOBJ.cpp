@@ -1,7 +1,10 @@
 #include "stdafx.h"
 #include <GL/gl.h>
 #include <GL/glu.h>
+#include <chrono>
 #include "loadOBJ.h"
+#include "ObjParser.h"
+#include "IndexBuffer.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 // Function:	ParseString
@@ -140,17 +143,125 @@ void HandleFace(CStringArray *words,t_faceIndex *face)
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Procedure:	LoadOBJ
+// Procedure:	BuildVisual
+// Purpose:		Lays out the data read from an OBJ file the way the visual
+//				wants it
+// Arguments:	The visual, load flags and the vertices, normals, texture
+//				coordinates and faces read from the file
+// Notes:		Shared by both loaders so they always build the same visual
+///////////////////////////////////////////////////////////////////////////////		
+static void BuildVisual(t_Visual *visual, int flags, const tVector *vertex, long vCnt, const tVector *normal, long nCnt,
+						const tVector *texture, long tCnt, const t_faceIndex *face, long fCnt)
+{
+/// Local Variables ///////////////////////////////////////////////////////////
+	int loop,loop2;
+	float *data;
+///////////////////////////////////////////////////////////////////////////////
+	// THIS IS BAD.  THINGS RUN NICER IF ALL THE POLYGONS HAVE THE SAME VERTEX COUNTS
+	// ASSUME ALL HAVE THE SAME AS THE FIRST.  IT SHOULD TESSELATE QUADS TO TRIS IF
+	// THERE ARE SOME TRIS,  BUT I KNOW MY DATABASE SO I MAKE MY LIFE EASIER
+	if (fCnt == 0 || (face[0].flags & FACE_TYPE_TRI)> 0) visual->vPerFace = 3;
+	else visual->vPerFace = 4;
+
+	if (nCnt > 0 && (flags & LOADOBJ_VERTEXONLY) == 0)
+	{
+		if (tCnt > 0)
+		{
+			visual->dataFormat = GL_T2F_N3F_V3F;
+			visual->vSize = 8;					// 2 texture, 3 normal, 3 vertex
+		}
+		else
+		{
+			visual->dataFormat = GL_N3F_V3F;
+			visual->vSize = 6;					// 3 floats for normal, 3 for vertex
+		}
+	}
+	else
+	{
+		visual->dataFormat = GL_V3F;
+		visual->vSize = 3;					// 3 floats for vertex
+	}
+	visual->faceCnt = fCnt;
+	if ((flags & LOADOBJ_REUSEVERTICES) > 0)
+	{
+		visual->reuseVertices = TRUE;
+		visual->vertexData = (float *)malloc(sizeof(float) * visual->vSize * vCnt);
+		visual->vertexCnt = vCnt;
+		visual->faceIndex = AllocIndices(vCnt, fCnt * visual->vPerFace);
+		if ((flags & LOADOBJ_VERTEXONLY) > 0)		// COPY VERTEX DATA
+		{
+			memcpy(visual->vertexData,vertex,sizeof(float) * visual->vSize * vCnt);
+		}
+		else		// SHOULD HANDLE CASE WHERE THERE IS NORMALS AND TEXTURE COORDS
+		{
+			visual->vertexData = NULL;		// TODO: I DON'T WANT TO DEAL WITH IT
+		}
+	}
+	else
+	{
+		visual->reuseVertices = FALSE;
+		visual->vertexData = (float *)malloc(sizeof(float) * visual->vSize * fCnt * visual->vPerFace);
+		visual->vertexCnt = fCnt * visual->vPerFace;
+		visual->faceIndex = NULL;
+	}
+
+	data = visual->vertexData;
+	for (loop = 0; loop < fCnt; loop++)
+	{
+		// ERROR CHECKING TO MAKE SURE 
+		if ((face[loop].flags & FACE_TYPE_TRI)> 0 && visual->vPerFace == 4)
+			::MessageBox(NULL,"Face Vertex Count does not match","ERROR",MB_OK);
+		if ((face[loop].flags & FACE_TYPE_QUAD)> 0 && visual->vPerFace == 3)
+			::MessageBox(NULL,"Face Vertex Count does not match","ERROR",MB_OK);
+
+		// IF I DON'T WANT TO REUSE VERTICES, FILL IT ALL OUT
+		if ((flags & LOADOBJ_REUSEVERTICES) == 0)
+		{
+			for (loop2 = 0; loop2 < visual->vPerFace; loop2++)
+			{
+				// ALL FACE INDICES ARE 1 BASED INSTEAD OF 0
+				if (tCnt > 0)	// IF TEXTURE COORDS WRITE OUT THOSE
+				{
+					*data++ = texture[face[loop].t[loop2] - 1].u;
+					*data++ = texture[face[loop].t[loop2] - 1].v;
+				}
+				if (nCnt > 0)	// IF THERE ARE NORMALS WRITE THOSE OUT
+				{
+					*data++ = normal[face[loop].n[loop2] - 1].x;
+					*data++ = normal[face[loop].n[loop2] - 1].y;
+					*data++ = normal[face[loop].n[loop2] - 1].z;
+				}
+				*data++ = vertex[face[loop].v[loop2] - 1].x;	// SAVE OUT VERTICES
+				*data++ = vertex[face[loop].v[loop2] - 1].y;
+				*data++ = vertex[face[loop].v[loop2] - 1].z;
+			}
+		}
+	}
+
+	// REUSE VERTICES SO JUST FILL OUT THE INDEX STRUCTURE, AS WIDE AS THE VERTEX COUNT NEEDS
+	if ((flags & LOADOBJ_REUSEVERTICES) > 0)
+	{
+		VisitIndices(visual->faceIndex, vCnt, [visual, face, fCnt](auto *indexData)
+		{
+			for (long loop = 0; loop < fCnt; loop++)
+				for (int loop2 = 0; loop2 < visual->vPerFace; loop2++)
+					*indexData++ = face[loop].v[loop2] - 1;
+		});
+	}
+}
+///// BuildVisual /////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Procedure:	LoadOBJLegacy
 // Purpose:		Load an OBJ file into the current bone visual
 // Arguments:	Name of 0BJ file and pointer to bone, flags of what to load
-// Notes:		Not an Official OBJ loader as it doesn't handle more then
-//				3 vertex polygons or multiple objects per file.
-//				Current flags are only (NULL, LOADOBJ_VERTEXONLY,LOADOBJ_REUSEVERTICES)
+// Notes:		The original two pass fgets loader, kept to check and time
+//				LoadOBJ against.  Lines longer than MAX_STRINGLENGTH are cut.
 ///////////////////////////////////////////////////////////////////////////////		
-BOOL LoadOBJ(char *filename,t_Visual *visual, int flags)
+BOOL LoadOBJLegacy(char *filename,t_Visual *visual, int flags)
 {
 /// Local Variables ///////////////////////////////////////////////////////////
-	int loop,loop2,cnt;
+	int cnt;
 	char buffer[MAX_STRINGLENGTH];
 	CStringArray words;
 	CString temp;
@@ -159,8 +270,6 @@ BOOL LoadOBJ(char *filename,t_Visual *visual, int flags)
 	long vPos = 0, nPos = 0, tPos = 0, fPos = 0;
 	tVector *vertex = NULL,*normal = NULL,*texture = NULL;
 	t_faceIndex *face = NULL;
-	float *data;
-	unsigned short *indexData;
 ///////////////////////////////////////////////////////////////////////////////
 	fp = fopen(filename,"r");
 	if (fp != NULL)
@@ -256,91 +365,7 @@ BOOL LoadOBJ(char *filename,t_Visual *visual, int flags)
 				words.RemoveAll();		// CLEAR WORD BUFFER
 			}
 
-			// THIS IS BAD.  THINGS RUN NICER IF ALL THE POLYGONS HAVE THE SAME VERTEX COUNTS
-			// ASSUME ALL HAVE THE SAME AS THE FIRST.  IT SHOULD TESSELATE QUADS TO TRIS IF
-			// THERE ARE SOME TRIS,  BUT I KNOW MY DATABASE SO I MAKE MY LIFE EASIER
-			if ((face[0].flags & FACE_TYPE_TRI)> 0) visual->vPerFace = 3;
-			else visual->vPerFace = 4;
-
-			if (nCnt > 0 && (flags & LOADOBJ_VERTEXONLY) == 0)
-			{
-				if (tCnt > 0)
-				{
-					visual->dataFormat = GL_T2F_N3F_V3F;
-					visual->vSize = 8;					// 2 texture, 3 normal, 3 vertex
-				}
-				else
-				{
-					visual->dataFormat = GL_N3F_V3F;
-					visual->vSize = 6;					// 3 floats for normal, 3 for vertex
-				}
-			}
-			else
-			{
-				visual->dataFormat = GL_V3F;
-				visual->vSize = 3;					// 3 floats for vertex
-			}
-			visual->faceCnt = fPos;
-			if ((flags & LOADOBJ_REUSEVERTICES) > 0)
-			{
-				visual->reuseVertices = TRUE;
-				visual->vertexData = (float *)malloc(sizeof(float) * visual->vSize * vPos);
-				visual->vertexCnt = vPos;
-				visual->faceIndex = (unsigned short *)malloc(sizeof(unsigned short) * fPos * visual->vPerFace);
-				if ((flags & LOADOBJ_VERTEXONLY) > 0)		// COPY VERTEX DATA
-				{
-					memcpy(visual->vertexData,vertex,sizeof(float) * visual->vSize * vPos);
-				}
-				else		// SHOULD HANDLE CASE WHERE THERE IS NORMALS AND TEXTURE COORDS
-				{
-					visual->vertexData = NULL;		// TODO: I DON'T WANT TO DEAL WITH IT
-				}
-			}
-			else
-			{
-				visual->reuseVertices = FALSE;
-				visual->vertexData = (float *)malloc(sizeof(float) * visual->vSize * fPos * visual->vPerFace);
-				visual->vertexCnt = fPos * visual->vPerFace;
-				visual->faceIndex = NULL;
-			}
-
-			data = visual->vertexData;
-			indexData = visual->faceIndex;
-			for (loop = 0; loop < fPos; loop++)
-			{
-				// ERROR CHECKING TO MAKE SURE 
-				if ((face[loop].flags & FACE_TYPE_TRI)> 0 && visual->vPerFace == 4)
-					::MessageBox(NULL,"Face Vertex Count does not match","ERROR",MB_OK);
-				if ((face[loop].flags & FACE_TYPE_QUAD)> 0 && visual->vPerFace == 3)
-					::MessageBox(NULL,"Face Vertex Count does not match","ERROR",MB_OK);
-
-				for (loop2 = 0; loop2 < visual->vPerFace; loop2++)
-				{
-					// IF I DON'T WANT TO REUSE VERTICES, FILL IT ALL OUT
-					if ((flags & LOADOBJ_REUSEVERTICES) == 0)
-					{
-						// ALL FACE INDICES ARE 1 BASED INSTEAD OF 0
-						if (tCnt > 0)	// IF TEXTURE COORDS WRITE OUT THOSE
-						{
-							*data++ = texture[face[loop].t[loop2] - 1].u;
-							*data++ = texture[face[loop].t[loop2] - 1].v;
-						}
-						if (nCnt > 0)	// IF THERE ARE NORMALS WRITE THOSE OUT
-						{
-							*data++ = normal[face[loop].n[loop2] - 1].x;
-							*data++ = normal[face[loop].n[loop2] - 1].y;
-							*data++ = normal[face[loop].n[loop2] - 1].z;
-						}
-						*data++ = vertex[face[loop].v[loop2] - 1].x;	// SAVE OUT VERTICES
-						*data++ = vertex[face[loop].v[loop2] - 1].y;
-						*data++ = vertex[face[loop].v[loop2] - 1].z;
-					}
-					else	// REUSE VERTICES SO JUST FILL OUT THE INDEX STRUCTURE
-					{
-						*indexData++ = face[loop].v[loop2] - 1;
-					}
-				}
-			}
+			BuildVisual(visual,flags,vertex,vPos,normal,nPos,texture,tPos,face,fPos);
 
 			if (vertex) free(vertex);
 			if (normal) free(normal);
@@ -353,4 +378,84 @@ BOOL LoadOBJ(char *filename,t_Visual *visual, int flags)
 	else
 		return FALSE;
 	return TRUE;
-}
\ No newline at end of file
+}
+//// LoadOBJLegacy ////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Procedure:	LoadOBJ
+// Purpose:		Load an OBJ file into the current bone visual
+// Arguments:	Name of 0BJ file and pointer to bone, flags of what to load
+// Notes:		Not an Official OBJ loader as it doesn't handle more then
+//				4 vertex polygons or multiple objects per file.
+//				Current flags are only (NULL, LOADOBJ_VERTEXONLY,LOADOBJ_REUSEVERTICES)
+//				The file is mapped and read in a single pass by CObjParser,
+//				split across the thread pool when it is large
+///////////////////////////////////////////////////////////////////////////////		
+BOOL LoadOBJ(char *filename,t_Visual *visual, int flags)
+{
+/// Local Variables ///////////////////////////////////////////////////////////
+	CObjParser parser;
+	char buffer[MAX_STRINGLENGTH];
+///////////////////////////////////////////////////////////////////////////////
+	if (!parser.Load(filename))
+		return FALSE;
+
+	const tObjMesh& mesh = parser.Mesh();
+	if (mesh.vertices.size() > 0)
+	{
+		if (mesh.largeFaceCnt > 0)
+		{
+			sprintf(buffer,"%d faces have more than 4 vertices\nSubstituting Tris",mesh.largeFaceCnt);
+			::MessageBox(NULL,buffer,"ERROR",MB_OK);
+		}
+		if (mesh.materialLib.length() > 0)
+			ParseMaterialLib(mesh.materialLib.c_str(),visual);
+
+		BuildVisual(visual,flags,mesh.vertices.data(),(long)mesh.vertices.size(),
+			mesh.normals.data(),(long)mesh.normals.size(),
+			mesh.textures.data(),(long)mesh.textures.size(),
+			mesh.faces.data(),(long)mesh.faces.size());
+	}
+	return TRUE;
+}
+//// LoadOBJ //////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Procedure:	BenchmarkLoadOBJ
+// Purpose:		Times LoadOBJ against the original loader
+// Arguments:	Name of OBJ file, how many loads to time and where to put the
+//				throughput of each loader in MB/s
+// Notes:		Both load vertices only into index arrays, like the
+//				application does
+///////////////////////////////////////////////////////////////////////////////		
+BOOL BenchmarkLoadOBJ(char *filename, int repeats, double *legacyMBs, double *mappedMBs)
+{
+/// Local Variables ///////////////////////////////////////////////////////////
+	CMappedFile file;
+	double		megabytes;
+	t_Visual	visual;
+	int			loop, pass;
+	BOOL		(*loader[2])(char *, t_Visual *, int) = { LoadOBJLegacy, LoadOBJ };
+	double		*result[2] = { legacyMBs, mappedMBs };
+///////////////////////////////////////////////////////////////////////////////
+	if (!file.Open(filename) || repeats < 1)
+		return FALSE;
+	megabytes = (double)file.Size() / (1024.0 * 1024.0);
+	file.Close();
+
+	for (pass = 0; pass < 2; pass++)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (loop = 0; loop < repeats; loop++)
+		{
+			memset(&visual, 0, sizeof(visual));
+			loader[pass](filename, &visual, LOADOBJ_VERTEXONLY | LOADOBJ_REUSEVERTICES);
+			if (visual.vertexData) free(visual.vertexData);
+			if (visual.faceIndex) free(visual.faceIndex);
+		}
+		std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+		*result[pass] = seconds.count() > 0.0 ? (megabytes * repeats) / seconds.count() : 0.0;
+	}
+	return TRUE;
+}
+//// BenchmarkLoadOBJ /////////////////////////////////////////////////////////
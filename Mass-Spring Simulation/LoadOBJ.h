@@ -26,5 +26,7 @@ typedef struct
 #include "Skeleton.h"
 
 BOOL LoadOBJ(char *filename,t_Visual *visual, int flags);
+BOOL LoadOBJLegacy(char *filename,t_Visual *visual, int flags);
+BOOL BenchmarkLoadOBJ(char *filename, int repeats, double *legacyMBs, double *mappedMBs);
 
 #endif // !defined(LoadOBJ_H__INCLUDED_)
@@ -60,6 +60,13 @@ BEGIN_MESSAGE_MAP(CMainFrame, CFrameWnd)
 	ON_COMMAND(ID_FILE_NEWSYSTEM, OnFileNewsystem)
 	ON_COMMAND(ID_SIMULATION_SETTIMINGPROPERTIES, OnSimulationSettimingproperties)
 	ON_COMMAND(ID_SIMULATION_ADDCOLLISIONSPHERE, OnSimulationAddcollisionsphere)
+	ON_COMMAND(ID_SIMULATION_ADDCOLLISIONPLANE, OnSimulationAddcollisionplane)
+	ON_COMMAND(ID_SIMULATION_ADDCOLLISIONBOX, OnSimulationAddcollisionbox)
+	ON_COMMAND(ID_SIMULATION_ADDCOLLISIONCAPSULE, OnSimulationAddcollisioncapsule)
+	ON_COMMAND(ID_SIMULATION_ADDCOLLISIONMESH, OnSimulationAddcollisionmesh)
+	ON_COMMAND(ID_FILE_EXPORTTRAJECTORY, OnFileExporttrajectory)
+	ON_COMMAND(ID_FILE_EXPORTRECORDINGOBJ, OnFileExportrecordingobj)
+	ON_COMMAND(ID_FILE_EXPORTPARTICLES, OnFileExportparticles)
 	//}}AFX_MSG_MAP
 	ON_COMMAND(ID_INTEGRATOR_HEUN, &CMainFrame::OnIntegratorHeun)
 	ON_UPDATE_COMMAND_UI(ID_INTEGRATOR_HEUN, &CMainFrame::OnUpdateIntegratorHeun)
@@ -221,7 +228,7 @@ void CMainFrame::OnFileNewsystem()
 
 void CMainFrame::OnFileOpen() 
 {
-	char szFilter[] = "DPS files (*.dps)|*.dps|OBJ files (*.obj)|*.obj||";  // WILL INCLUDE Biovision Hierarchy BVH (*.bvh)|*.bvh|
+	char szFilter[] = "DPS files (*.dps)|*.dps|OBJ files (*.obj)|*.obj|Trajectories (*.trj)|*.trj||";  // WILL INCLUDE Biovision Hierarchy BVH (*.bvh)|*.bvh|
 	CFileDialog	dialog( TRUE, ".obj", NULL, OFN_HIDEREADONLY | OFN_OVERWRITEPROMPT, szFilter, this);
 	CString name;		
 	if (dialog.DoModal())
@@ -243,6 +250,33 @@ void CMainFrame::OnFileSave()
 	}
 }
 
+// Write the errors recorded with each frame of a trajectory as CSV
+void CMainFrame::OnFileExporttrajectory() 
+{
+	char szFilter[] = "Trajectories (*.trj)|*.trj||";
+	CFileDialog	dialog( TRUE, ".trj", NULL, OFN_HIDEREADONLY, szFilter, this);
+	if (dialog.DoModal() == IDOK)
+		m_OGLView.ExportRecording(dialog.GetFileName( ),dialog.GetFileTitle( ));
+}
+
+// Write each frame of a trajectory as an OBJ file, the cloth loaded giving the faces
+void CMainFrame::OnFileExportrecordingobj() 
+{
+	char szFilter[] = "Trajectories (*.trj)|*.trj||";
+	CFileDialog	dialog( TRUE, ".trj", NULL, OFN_HIDEREADONLY, szFilter, this);
+	if (dialog.DoModal() == IDOK)
+		m_OGLView.ExportRecordingObj(dialog.GetFileName( ),dialog.GetFileTitle( ));
+}
+
+// Write the particles as they are now as CSV
+void CMainFrame::OnFileExportparticles() 
+{
+	char szFilter[] = "CSV files (*.csv)|*.csv||";
+	CFileDialog	dialog( FALSE, ".csv", NULL, OFN_HIDEREADONLY | OFN_OVERWRITEPROMPT, szFilter, this);
+	if (dialog.DoModal() == IDOK)
+		m_OGLView.ExportParticles(dialog.GetFileName( ));
+}
+
 void CMainFrame::OnSimulationRunning() 
 {
 	m_OGLView.HandleKeyUp('R');
@@ -436,6 +470,36 @@ void CMainFrame::OnSimulationAddcollisionsphere()
 	m_OGLView.Invalidate(TRUE);
 }
 
+// Add a plane, box or capsule to the physical simulation
+void CMainFrame::OnSimulationAddcollisionplane() 
+{
+	m_OGLView.AddCollider(COLLIDER_PLANE);
+	m_OGLView.Invalidate(TRUE);
+}
+
+void CMainFrame::OnSimulationAddcollisionbox() 
+{
+	m_OGLView.AddCollider(COLLIDER_BOX);
+	m_OGLView.Invalidate(TRUE);
+}
+
+void CMainFrame::OnSimulationAddcollisioncapsule() 
+{
+	m_OGLView.AddCollider(COLLIDER_CAPSULE);
+	m_OGLView.Invalidate(TRUE);
+}
+
+void CMainFrame::OnSimulationAddcollisionmesh() 
+{
+	char szFilter[] = "OBJ files (*.obj)|*.obj||";
+	CFileDialog	dialog( TRUE, ".obj", NULL, OFN_HIDEREADONLY, szFilter, this);
+	if (dialog.DoModal() == IDOK)
+	{
+		m_OGLView.AddCollisionMesh(dialog.GetFileName( ));
+		m_OGLView.Invalidate(TRUE);
+	}
+}
+
 void CMainFrame::OnIntegratorHeun()
 {
 	m_OGLView.m_PhysEnv.m_IntegratorType = HEUN_INTEGRATOR;
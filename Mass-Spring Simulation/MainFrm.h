@@ -92,6 +92,13 @@ protected:
 	afx_msg void OnFileNewsystem();
 	afx_msg void OnSimulationSettimingproperties();
 	afx_msg void OnSimulationAddcollisionsphere();
+	afx_msg void OnSimulationAddcollisionplane();
+	afx_msg void OnSimulationAddcollisionbox();
+	afx_msg void OnSimulationAddcollisioncapsule();
+	afx_msg void OnSimulationAddcollisionmesh();
+	afx_msg void OnFileExporttrajectory();
+	afx_msg void OnFileExportrecordingobj();
+	afx_msg void OnFileExportparticles();
 	//}}AFX_MSG
 	DECLARE_MESSAGE_MAP()
 public:
@@ -26,6 +26,28 @@ void MultVectorByMatrix(tMatrix *mat, tVector *v,tVector *result)
 }
 //// MultVectorByMatrix //////////////////////////////////////////////////////
 
+///////////////////////////////////////////////////////////////////////////////
+// Function:	MultMatrix
+// Purpose:		Multiplies two 4x4 Matrices in OpenGL Format
+// Arguments:	Matrix a, Matrix b, and result Matrix = a * b
+// Notes:		Like glMultMatrix, b is applied to a vector first. The result
+//				must not be one of the inputs
+///////////////////////////////////////////////////////////////////////////////
+void MultMatrix(tMatrix *a, tMatrix *b, tMatrix *result)
+{
+	for (int col = 0; col < 4; col++)
+	{
+		for (int row = 0; row < 4; row++)
+		{
+			result->m[(col * 4) + row] = (a->m[row] * b->m[(col * 4)]) +
+										 (a->m[4 + row] * b->m[(col * 4) + 1]) +
+										 (a->m[8 + row] * b->m[(col * 4) + 2]) +
+										 (a->m[12 + row] * b->m[(col * 4) + 3]);
+		}
+	}
+}
+//// MultMatrix ///////////////////////////////////////////////////////////////
+
 
 /* returns squared length of input vector */    
 double VectorSquaredLength(tVector *v) 
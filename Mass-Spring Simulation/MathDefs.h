@@ -80,6 +80,7 @@ typedef struct
 #define MAKEVECTOR(a,vx,vy,vz)	a.x = vx; a.y = vy; a.z = vz;
 
 void	MultVectorByMatrix(tMatrix *mat, tVector *v,tVector *result);
+void	MultMatrix(tMatrix *a, tMatrix *b, tMatrix *result);
 double	VectorSquaredLength(tVector *v); 
 double	VectorLength(tVector *v); 
 void	NormalizeVector(tVector *v); 
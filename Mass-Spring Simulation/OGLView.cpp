@@ -2,12 +2,19 @@
 
 #include "stdafx.h"
 #include <mmsystem.h>
+#include <fstream>
 #include <tuple>
 #include "Clothy.h"
 #include "OGLView.h"
 #include "LoadOBJ.h"
+#include "IndexBuffer.h"
+#include "SceneCache.h"
+#include "Snapshot.h"
 #include "TimeProps.h"
+#include "AddCollider.h"
 #include "NewCloth.h"
+#include "ClothPatch.h"
+#include "Profiler.h"
 using namespace std;
 
 #ifdef _DEBUG
@@ -18,6 +25,7 @@ static char THIS_FILE[] = __FILE__;
 
 /// Application Definitions ///////////////////////////////////////////////////
 #define ROTATE_SPEED		1.0		// SPEED OF ROTATION
+#define LATENCY_FRAMES		30		// FRAMES AVERAGED FOR EACH LATENCY READING
 ///////////////////////////////////////////////////////////////////////////////
 
 /// Global Variables //////////////////////////////////////////////////////////
@@ -31,6 +39,8 @@ COGLView::COGLView()
 	// INITIALIZE THE MODE KEYS
 	m_DrawGeometry = TRUE;
 	m_SimRunning = FALSE;
+	m_Replaying = FALSE;
+	m_ReplayClock = 0.0f;
 	m_CurBone = NULL;
 	ResetBone(&m_Skeleton, NULL);
 	m_Skeleton.id = -1;
@@ -43,14 +53,23 @@ COGLView::COGLView()
 	m_MaxTimeStep = 0.01f;
 
 	m_FrameCnt = 0;
+	m_StepPending = FALSE;
+	m_LatencySum = 0.0;
+	m_LatencyMax = 0.0;
+	m_LatencyFrames = 0;
 
 	m_PickX = -1;
 	m_PickY = -1;
+	memset(m_Viewport, 0, sizeof(m_Viewport));
+	m_ptrStatusBar = NULL;
 	m_hDC = NULL;
 }
 
 COGLView::~COGLView()
 {
+	// THE INDICES OF A CACHED CLOTH GO WITH THE MAPPING, NOT THE SKELETON
+	if (m_Skeleton.childCnt > 0 && m_SceneCache.Maps(m_Skeleton.children->visuals->faceIndex))
+		m_Skeleton.children->visuals->faceIndex = NULL;
 	DestroySkeleton(&m_Skeleton);
 	m_hDC = NULL;
 }
@@ -198,6 +217,8 @@ GLvoid COGLView::resize( GLsizei width, GLsizei height )
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
     gluPerspective(10.0, aspect, 1.0, 2000.0);
+	glGetFloatv(GL_PROJECTION_MATRIX, m_Projection.m);
+	glGetIntegerv(GL_VIEWPORT, m_Viewport);
     glMatrixMode(GL_MODELVIEW);
 }    
 
@@ -287,6 +308,17 @@ void COGLView::RunSim()
 	else
 		Time = GetTime() * m_TimeIterations;
 
+	if (m_Replaying)
+	{
+		// PLAYBACK FOLLOWS THE CLOCK, FRAMES RECORDED BETWEEN TWO DRAWS ARE SKIPPED
+		if (m_SimRunning)
+		{
+			m_ReplayClock += Time - m_LastTime;
+			m_LastTime = Time;
+			ShowReplayFrame(m_Replay.FrameAt(m_ReplayClock));
+		}
+		return;
+	}
 	if (m_SimRunning)
 	{
 		while(m_LastTime < Time)
@@ -297,15 +329,23 @@ void COGLView::RunSim()
 				DeltaTime = m_MaxTimeStep;
 			}
 
-	 		m_PhysEnv.Simulate(DeltaTime,m_SimRunning);
-			m_LastTime += DeltaTime;
-            const auto error = m_PhysEnv.CalculateError ( true );
-            m_PhysEnv.OutputErrorToCsV ( error , m_LastTime );
+			// BONE COLLIDERS FOLLOW THE ANIMATION, PLAYED FOR THE SIMULATED TIME OF THE STEP
+			if (m_PhysEnv.HasBoneColliders())
+				BoneAdvanceTime(&m_Skeleton,DeltaTime,TRUE);
+			{
+				PROFILE_FRAME();		// THE RECORDING IS PART OF THE STEP'S COST
+	 			m_PhysEnv.Simulate(DeltaTime,m_SimRunning);
+				m_LastTime += DeltaTime;
+				m_PhysEnv.RecordFrame(m_LastTime);
+			}
+			m_StepDone = std::chrono::steady_clock::now();
+			m_StepPending = TRUE;
 		}
 		m_LastTime = Time;
 	}
 	else
 	{
+		PROFILE_FRAME();
 		m_PhysEnv.Simulate(DeltaTime,m_SimRunning);
 	}
 }
@@ -331,9 +371,9 @@ GLvoid COGLView::drawModel(t_Bone *curBone)
 		{
 			// HANDLE EITHER QUADS OR TRIS
 			if (curBone->visuals[0].vPerFace == 3)
-				glDrawElements(GL_TRIANGLES,curBone->visuals[0].faceCnt * 3,GL_UNSIGNED_SHORT,curBone->visuals[0].faceIndex);
+				glDrawElements(GL_TRIANGLES,curBone->visuals[0].faceCnt * 3,IndexType(curBone->visuals[0].vertexCnt),curBone->visuals[0].faceIndex);
 			else
-				glDrawElements(GL_QUADS,curBone->visuals[0].faceCnt * 4,GL_UNSIGNED_SHORT,curBone->visuals[0].faceIndex);
+				glDrawElements(GL_QUADS,curBone->visuals[0].faceCnt * 4,IndexType(curBone->visuals[0].vertexCnt),curBone->visuals[0].faceIndex);
 		}
 		else
 		{
@@ -391,10 +431,15 @@ GLvoid COGLView::drawScene(GLvoid)
 	*/
 
 	if (m_PickX > -1)
-		m_PhysEnv.GetNearestPoint(m_PickX,m_PickY);
+		m_PhysEnv.GetNearestPoint(m_PickX,m_PickY,&m_Skeleton.matrix,&m_Projection,m_Viewport);
+	m_PhysEnv.SetCaptureView(&m_Skeleton.matrix);
 
 	RunSim();
 
+	// THE SURFACE ONLY FOLLOWS THE PARTICLES IN FRAMES THAT GET DRAWN
+	if (m_DrawGeometry && m_Surface.Update(m_PhysEnv.PositionStream()))
+		m_Surface.Draw();
+
 	m_PhysEnv.RenderWorld();		// DRAW THE SIMULATION
 
 	glPopMatrix();
@@ -402,12 +447,46 @@ GLvoid COGLView::drawScene(GLvoid)
 
     if (m_hDC)
 		SwapBuffers(m_hDC);
+	MeasureLatency();
 
 	m_PickX = -1;
 	m_PickY = -1;
 }
 // 	drawScene
 
+///////////////////////////////////////////////////////////////////////////////
+// Procedure:	MeasureLatency
+// Purpose:		Times from the end of the last step to the frame being on
+//				screen, shown in the status bar every LATENCY_FRAMES frames
+// Notes:		Called after SwapBuffers, which follows the glFinish, so the
+//				time includes the drawing but not the wait for the monitor
+///////////////////////////////////////////////////////////////////////////////
+void COGLView::MeasureLatency()
+{
+/// Local Variables ///////////////////////////////////////////////////////////
+	std::chrono::duration<double, std::milli> latency;
+	char	message[80];
+///////////////////////////////////////////////////////////////////////////////
+	if (!m_StepPending)
+		return;
+	m_StepPending = FALSE;
+	latency = std::chrono::steady_clock::now() - m_StepDone;
+	m_LatencySum += latency.count();
+	if (latency.count() > m_LatencyMax)
+		m_LatencyMax = latency.count();
+	if (++m_LatencyFrames < LATENCY_FRAMES)
+		return;
+	if (m_ptrStatusBar)
+	{
+		sprintf(message,"Step to screen %.2f ms, worst %.2f ms",m_LatencySum / m_LatencyFrames,m_LatencyMax);
+		m_ptrStatusBar->SetPaneText(0,message);
+	}
+	m_LatencySum = 0.0;
+	m_LatencyMax = 0.0;
+	m_LatencyFrames = 0;
+}
+// 	MeasureLatency
+
 void COGLView::OnDestroy() 
 {
 	CWnd::OnDestroy();
@@ -483,6 +562,8 @@ void COGLView::HandleKeyDown(UINT nChar)
 void COGLView::HandleKeyUp(UINT nChar) 
 {
 	tVector userforce;
+	if (m_Replaying && ReplayKey(nChar))
+		return;
 	switch (nChar)
 	{
 	case 13:
@@ -690,18 +771,21 @@ void COGLView::OnLButtonDblClk(UINT nFlags, CPoint point)
 ///////////////////////////////////////////////////////////////////////////////		
 void COGLView::NewSystem()
 {
+	StopReplay();
 	m_PhysEnv.FreeSystem();
 	m_SimRunning = FALSE;
+	m_Surface.Detach();
 	if (m_Skeleton.childCnt > 0)
 	{
 		if (m_Skeleton.children->visuals->vertexData)
 			free(m_Skeleton.children->visuals->vertexData);
-		if (m_Skeleton.children->visuals->faceIndex)
+		if (m_Skeleton.children->visuals->faceIndex && !m_SceneCache.Maps(m_Skeleton.children->visuals->faceIndex))
 			free(m_Skeleton.children->visuals->faceIndex);
 		free(m_Skeleton.children->visuals);
 		free(m_Skeleton.children);
 		m_Skeleton.childCnt = 0;
 	}
+	m_SceneCache.Close();
 	drawScene();
 }
 
@@ -712,81 +796,336 @@ void COGLView::NewSystem()
 void COGLView::LoadFile(CString file1,CString baseName,CString ext) 
 {
 /// Local Variables ///////////////////////////////////////////////////////////
-	t_Bone	*children;
 	t_Visual *visual;
-	FILE	*fp;
+	tSceneView	scene;
+	tSceneStamp	stamp;
+	CString	cacheName;
+	BOOL	stamped, loaded = FALSE;
+	CSnapshotReader	reader;
+	int		format;
 ///////////////////////////////////////////////////////////////////////////////
 	ext.MakeUpper();
 	if (ext == "OBJ")
 	{
 		visual = (t_Visual *)malloc(sizeof(t_Visual));
 		NewSystem();	// CLEAR WHAT DATA IS THERE
+		// A CACHE NEXT TO THE OBJ HOLDS THE SCENE BUILT THE FIRST TIME IT WAS LOADED
+		cacheName = file1 + SCENE_CACHE_EXT;
+		stamped = file1.GetLength() > 0 && SourceStamp((LPCTSTR)file1, stamp);
+		if (stamped && m_SceneCache.Open((LPCTSTR)cacheName, stamp) && m_SceneCache.View().visual != NULL)
+		{
+			// THE SURFACE WRITES THE PARTICLES INTO THE VERTICES, SO THE VISUAL GETS ITS OWN COPY OF THEM.
+			// THE INDICES ARE ONLY READ, SO THEY ARE DRAWN FROM THE MAPPING, WHICH STAYS OPEN WITH THE SYSTEM
+			*visual = *m_SceneCache.View().visual;
+			visual->vertexData = (float *)malloc(sizeof(float) * visual->vSize * visual->vertexCnt);
+			memcpy(visual->vertexData, m_SceneCache.View().visual->vertexData, sizeof(float) * visual->vSize * visual->vertexCnt);
+			m_PhysEnv.ImportScene(&m_SceneCache.View());
+			loaded = TRUE;
+		}
 		// I WANT TO LOAD JUST THE VERTICES AND PUT THEM IN A INDEXED FORMAT
-		if (file1.GetLength() > 0 && LoadOBJ((char *)(LPCTSTR)file1 ,visual,
+		else if (file1.GetLength() > 0 && LoadOBJ((char *)(LPCTSTR)file1 ,visual,
 				LOADOBJ_VERTEXONLY | LOADOBJ_REUSEVERTICES))
 		{
 			// INFORM THE PHYSICAL SIMULATION OF THE PARTICLES
 			m_PhysEnv.SetWorldParticles((tTexturedVertex *)visual->vertexData,visual->vertexCnt);
-			if (m_Skeleton.childCnt > 0)
+			if (stamped)
 			{
-				if (m_Skeleton.children->visuals->faceIndex != NULL)
-					free(m_Skeleton.children->visuals->faceIndex);
-				free(m_Skeleton.children->visuals);
-				free(m_Skeleton.children->visuals->vertexData);
-				free(m_Skeleton.children);
-				m_Skeleton.childCnt = 0;
+				// A CACHE THAT CAN NOT BE WRITTEN ONLY MEANS THE NEXT LOAD PARSES AGAIN. ONE THAT CAN IS MAPPED
+				// RIGHT AWAY, SO THE SYSTEM KEEPS THE MESH AS LOADED FOR UpdateSceneCache LIKE AFTER A CACHE HIT
+				m_SceneCache.Close();	// ONE WITH NO VISUAL IS REPLACED
+				m_PhysEnv.ExportScene(&scene);
+				scene.visual = visual;
+				if (WriteSceneCache((LPCTSTR)cacheName, scene, stamp) && m_SceneCache.Open((LPCTSTR)cacheName, stamp) &&
+					m_SceneCache.View().visual != NULL && m_SceneCache.View().visual->faceIndex != NULL)
+				{
+					free(visual->faceIndex);
+					visual->faceIndex = m_SceneCache.View().visual->faceIndex;
+				}
+				else
+					m_SceneCache.Close();
 			}
-			children = (t_Bone *)malloc(sizeof(t_Bone));
-			m_CurBone = &children[m_Skeleton.childCnt];
-			ResetBone(m_CurBone,&m_Skeleton);
-			strcpy(m_CurBone->name,(LPCTSTR)baseName);
-			m_CurBone->visuals = visual;
-			m_CurBone->visualCnt = 1;
-			m_Skeleton.childCnt = 1;
-			m_Skeleton.children = children;
+			loaded = TRUE;
+		}
+		if (loaded && m_SceneCache.IsOpen())
+		{
+			m_SceneSource = file1;
+			m_SceneStamp = stamp;
 		}
+		if (loaded)
+			SetClothBone(visual,baseName);
 		else
 		{
+			m_SceneCache.Close();
 			MessageBox("Must Be A Valid OBJ File","Error",MB_OK);
 			free(visual);
 		}
 	}
+	else if (ext == "TRJ")	// PLAY BACK A RECORDING OF THE SYSTEM LOADED
+	{
+		if (file1.GetLength())
+			StartReplay(file1);
+	}
 	else	// LOAD SIM SYSTEM
 	{
 		if (file1.GetLength())
 		{
-			fp = fopen(file1,"rb");
-			if (fp != NULL)
+			format = reader.Open(file1);
+			if (format == SNAPSHOT_CHUNKED || format == SNAPSHOT_LEGACY)	// A SIMULATION CUT SHORT IS NOT LOADED
 			{
 				NewSystem();	// CLEAR WHAT DATA IS THERE
-				fread(&m_Skeleton,sizeof(t_Bone),1,fp);
-				if (m_Skeleton.childCnt > 0)
-				{
-					m_Skeleton.children = (t_Bone *)malloc(sizeof(t_Bone));
-					fread(m_Skeleton.children,sizeof(t_Bone),1,fp);
-					if (m_Skeleton.children->visualCnt > 0)
-					{
-						m_Skeleton.children->visuals = (t_Visual *)malloc(sizeof(t_Visual));
-						visual = m_Skeleton.children->visuals;
-						fread(visual,sizeof(t_Visual),1,fp);
-						if (visual->reuseVertices)
-						{
-							visual->vertexData = (float *)malloc(sizeof(float) * visual->vSize * visual->vertexCnt);
-							visual->faceIndex = (unsigned short *)malloc(sizeof(unsigned short) * visual->faceCnt * visual->vPerFace);
-							fread(visual->vertexData,sizeof(float),visual->vSize * visual->vertexCnt,fp);
-							fread(visual->faceIndex,sizeof(unsigned short),visual->faceCnt * visual->vPerFace,fp);
-						}
-						// SAVE THE PHYSICAL SIMULATION OF THE PARTICLES
-						m_PhysEnv.LoadData(fp);
-					}
-				}
-				fclose(fp);
+				if (format == SNAPSHOT_CHUNKED)
+					loaded = LoadSnapshot(reader,baseName) && !reader.Damaged();	// A DAMAGED CHUNK READS AS A MISSING ONE
+				else
+					loaded = LoadLegacy(reader,baseName);
+				if (!loaded)
+					NewSystem();	// DROP WHAT WAS READ BEFORE THE ERROR
 			}
+			reader.Close();
+			if (!loaded)
+				MessageBox("Must Be A Valid Simulation File","Error",MB_OK);
 		}
 	}
 
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Procedure:	StartReplay
+// Purpose:		Plays back a recording of the system loaded instead of
+//				simulating it
+// Notes:		The recording under way is ended first, so the file being
+//				recorded can be played back
+///////////////////////////////////////////////////////////////////////////////		
+void COGLView::StartReplay(CString file1)
+{
+	StopReplay();
+	m_PhysEnv.StopRecording();
+	if (m_Replay.Open(file1) && m_PhysEnv.ReplayFrame(&m_Replay,0))
+	{
+		m_Replaying = TRUE;
+		m_ReplayClock = m_Replay.FrameTime(0);
+		m_LastTime = GetTime() * m_TimeIterations;
+	}
+	else
+	{
+		m_Replay.Close();
+		MessageBox("Must Be A Recording Of The Loaded System","Error",MB_OK);
+	}
+}
+
+void COGLView::StopReplay()
+{
+	m_Replaying = FALSE;
+	m_Replay.Close();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Procedure:	ExportRecording
+// Purpose:		Writes the errors of every frame of a recording to a CSV
+//				file of the same name
+// Notes:		The recording under way is ended first, it may be the one
+///////////////////////////////////////////////////////////////////////////////		
+void COGLView::ExportRecording(CString file1,CString baseName)
+{
+	m_PhysEnv.StopRecording();
+	if (!ExportTrajectoryCsv(file1,baseName + ".csv"))
+		MessageBox("Could Not Export The Whole Recording","Error",MB_OK);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Procedure:	ExportRecordingObj
+// Purpose:		Writes every frame of a recording as an OBJ file named after
+//				it, baseName_0000.obj on
+// Notes:		The faces are those of the cloth loaded, when the recording
+//				is of it. The recording under way is ended first
+///////////////////////////////////////////////////////////////////////////////		
+void COGLView::ExportRecordingObj(CString file1,CString baseName)
+{
+/// Local Variables ///////////////////////////////////////////////////////////
+	t_Visual *visual = NULL;
+///////////////////////////////////////////////////////////////////////////////
+	m_PhysEnv.StopRecording();
+	if (m_Skeleton.childCnt > 0 && m_Skeleton.children->visualCnt > 0)
+		visual = m_Skeleton.children->visuals;
+	if (!ExportTrajectoryObj(file1,baseName,visual))
+		MessageBox("Could Not Export The Whole Recording","Error",MB_OK);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Procedure:	ExportParticles
+// Purpose:		Writes the particles of the system as they are to a CSV file
+///////////////////////////////////////////////////////////////////////////////		
+void COGLView::ExportParticles(CString file1)
+{
+	if (!m_PhysEnv.ExportParticles(file1))
+		MessageBox("Could Not Export The Particles","Error",MB_OK);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Procedure:	ShowReplayFrame
+// Purpose:		Puts a recorded frame in the system that gets drawn
+// Notes:		A frame that can not be decoded ends the replay
+///////////////////////////////////////////////////////////////////////////////		
+void COGLView::ShowReplayFrame(int frame)
+{
+	if (frame < 0)
+		frame = 0;
+	if (frame >= m_Replay.FrameCount())
+		frame = m_Replay.FrameCount() - 1;
+	if (!m_PhysEnv.ReplayFrame(&m_Replay,frame))
+		StopReplay();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Procedure:	ReplayKey
+// Purpose:		Scrubs through the replay
+// Arguments:	Key released
+// Notes:		LEFT/RIGHT STEP A FRAME, DOWN/UP A TENTH OF THE RECORDING,
+//				HOME/END GO TO THE ENDS. 'T' LEAVES THE REPLAY AND RESETS
+// Returns:		TRUE when the key was used by the replay
+///////////////////////////////////////////////////////////////////////////////		
+BOOL COGLView::ReplayKey(UINT nChar)
+{
+/// Local Variables ///////////////////////////////////////////////////////////
+	int frame = m_Replay.Current();
+	int jump = m_Replay.FrameCount() / 10 + 1;
+///////////////////////////////////////////////////////////////////////////////
+	switch (nChar)
+	{
+	case VK_LEFT: frame--;
+		break;
+	case VK_RIGHT: frame++;
+		break;
+	case VK_DOWN: frame -= jump;
+		break;
+	case VK_UP: frame += jump;
+		break;
+	case VK_HOME: frame = 0;
+		break;
+	case VK_END: frame = m_Replay.FrameCount() - 1;
+		break;
+	case 'T':
+		StopReplay();
+		return FALSE;
+	default:
+		return FALSE;
+	}
+	ShowReplayFrame(frame);
+	if (m_Replaying)
+		m_ReplayClock = m_Replay.FrameTime(m_Replay.Current());
+	if (!m_SimRunning)
+		Invalidate(TRUE);
+	return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Procedure:	SetClothBone
+// Purpose:		Hangs the visual of the cloth from the skeleton
+// Arguments:	Visual to attach, it belongs to the bone from now on
+///////////////////////////////////////////////////////////////////////////////		
+void COGLView::SetClothBone(t_Visual *visual,CString name)
+{
+/// Local Variables ///////////////////////////////////////////////////////////
+	t_Bone	*children;
+///////////////////////////////////////////////////////////////////////////////
+	children = (t_Bone *)malloc(sizeof(t_Bone));
+	m_CurBone = &children[0];
+	ResetBone(m_CurBone,&m_Skeleton);
+	strncpy(m_CurBone->name,(LPCTSTR)name,sizeof(m_CurBone->name) - 1);
+	m_CurBone->name[sizeof(m_CurBone->name) - 1] = '\0';
+	m_CurBone->visuals = visual;
+	m_CurBone->visualCnt = 1;
+	m_Skeleton.childCnt = 1;
+	m_Skeleton.children = children;
+	m_Surface.Attach(visual);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Procedure:	GetVisualArrays
+// Purpose:		Reads the vertices and indices of a visual
+// Arguments:	Cursors on each array, they may be the same one
+// Returns:		FALSE when the arrays do not fit in the file, nothing is
+//				left allocated then
+///////////////////////////////////////////////////////////////////////////////		
+static BOOL GetVisualArrays(CSnapshotCursor &vertices,CSnapshotCursor &indices,t_Visual *visual)
+{
+/// Local Variables ///////////////////////////////////////////////////////////
+	std::uint64_t	floatCnt = (std::uint64_t)visual->vSize * visual->vertexCnt;
+	std::uint64_t	indexCnt = (std::uint64_t)visual->faceCnt * visual->vPerFace;
+///////////////////////////////////////////////////////////////////////////////
+	if (!visual->reuseVertices)
+		return TRUE;
+	if (visual->vSize < 0 || visual->vertexCnt < 0 || visual->faceCnt < 0 || visual->vPerFace < 0 ||
+		!vertices.Has(floatCnt,sizeof(float)))
+		return FALSE;
+	visual->vertexData = (float *)malloc(sizeof(float) * floatCnt);
+	vertices.GetWords(visual->vertexData,sizeof(float) * floatCnt,sizeof(float));
+	if (!indices.Has(indexCnt,IndexSize(visual->vertexCnt)))
+	{
+		free(visual->vertexData);
+		visual->vertexData = NULL;
+		return FALSE;
+	}
+	visual->faceIndex = AllocIndices(visual->vertexCnt,(long)indexCnt);
+	indices.GetWords(visual->faceIndex,IndexSize(visual->vertexCnt) * indexCnt,IndexSize(visual->vertexCnt));
+	return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Procedure:	LoadSnapshot
+// Purpose:		Reads a simulation saved by SaveFile
+// Notes:		A file saved without a cloth only has the skeleton
+///////////////////////////////////////////////////////////////////////////////		
+BOOL COGLView::LoadSnapshot(CSnapshotReader &reader,CString baseName)
+{
+/// Local Variables ///////////////////////////////////////////////////////////
+	CSnapshotCursor	root = reader.Chunk(SNAPSHOT_ROOT);
+	CSnapshotCursor	bone = reader.Chunk(SNAPSHOT_BONE);
+	CSnapshotCursor	info = reader.Chunk(SNAPSHOT_VISUAL);
+	CSnapshotCursor	vertices = reader.Chunk(SNAPSHOT_VERTICES);
+	CSnapshotCursor	indices = reader.Chunk(SNAPSHOT_INDICES);
+	t_Visual *visual;
+///////////////////////////////////////////////////////////////////////////////
+	if (root.Failed())
+		return FALSE;
+	GetBone(root,m_Skeleton);
+	if (bone.Failed())
+		return TRUE;
+	visual = (t_Visual *)malloc(sizeof(t_Visual));
+	GetVisual(info,*visual);
+	if (info.Failed() || !GetVisualArrays(vertices,indices,visual))
+	{
+		free(visual);
+		return FALSE;
+	}
+	SetClothBone(visual,baseName);
+	GetBone(bone,*m_CurBone);
+	return m_PhysEnv.LoadSnapshot(reader) && m_PhysEnv.LoadBoneColliders(reader,&m_Skeleton);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Procedure:	LoadLegacy
+// Purpose:		Reads a .dps file from before snapshots
+// Notes:		The bone of the cloth was never saved, it gets the file name
+///////////////////////////////////////////////////////////////////////////////		
+BOOL COGLView::LoadLegacy(CSnapshotReader &reader,CString baseName)
+{
+/// Local Variables ///////////////////////////////////////////////////////////
+	CSnapshotCursor	cursor = reader.Whole();
+	t_Visual *visual;
+///////////////////////////////////////////////////////////////////////////////
+	if (!GetLegacyBones(cursor,m_Skeleton))
+		return !cursor.Failed();
+	visual = (t_Visual *)malloc(sizeof(t_Visual));
+	GetLegacyVisual(cursor,*visual);
+	if (cursor.Failed() || !GetVisualArrays(cursor,cursor,visual))
+	{
+		free(visual);
+		return FALSE;
+	}
+	SetClothBone(visual,baseName);
+	return m_PhysEnv.LoadLegacy(cursor);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Procedure:	SaveFiles
 // Purpose:		Saves the Particle System 
@@ -795,32 +1134,95 @@ void COGLView::SaveFile(CString file1,CString baseName)
 {
 /// Local Variables ///////////////////////////////////////////////////////////
 	t_Visual *visual;
-	FILE	*fp;
+	CSnapshotWriter	writer;
+	std::uint64_t	floatCnt, indexCnt;
 ///////////////////////////////////////////////////////////////////////////////
-	if (file1.GetLength() > 0)
+	if (file1.GetLength() > 0 && writer.Open(file1))
 	{
-		fp = fopen(file1,"wb");
-		if (fp != NULL)
+		PutBone(writer,SNAPSHOT_ROOT,m_Skeleton);
+		if (m_Skeleton.childCnt > 0 && m_Skeleton.children->visualCnt > 0)
 		{
-			fwrite(&m_Skeleton,sizeof(t_Bone),1,fp);
-			if (m_Skeleton.childCnt > 0)
+			PutBone(writer,SNAPSHOT_BONE,*m_Skeleton.children);
+			visual = m_Skeleton.children->visuals;
+			// THE SURFACE IS DRAWN FROM THE PARTICLES, THE VISUAL ONLY GETS THEIR SHAPE NOW
+			if (m_Surface.Update(m_PhysEnv.PositionStream()))
+				m_Surface.StoreInVisual();
+			PutVisual(writer,*visual);
+			if (visual->reuseVertices)
 			{
-				fwrite(&m_Skeleton.children,sizeof(t_Bone),1,fp);
-				if (m_Skeleton.children->visualCnt > 0)
-				{
-					visual = m_Skeleton.children->visuals;
-					fwrite(visual,sizeof(t_Visual),1,fp);
-					if (visual->reuseVertices)
-					{
-						fwrite(visual->vertexData,sizeof(float),visual->vSize * visual->vertexCnt,fp);
-						fwrite(visual->faceIndex,sizeof(unsigned short),visual->faceCnt * visual->vPerFace,fp);
-					}
-					// SAVE THE PHYSICAL SIMULATION OF THE PARTICLES
-					m_PhysEnv.SaveData(fp);
-				}
+				floatCnt = (std::uint64_t)visual->vSize * visual->vertexCnt;
+				indexCnt = (std::uint64_t)visual->faceCnt * visual->vPerFace;
+				writer.BeginChunk(SNAPSHOT_VERTICES,sizeof(float) * floatCnt);
+				writer.PutWords(visual->vertexData,sizeof(float) * floatCnt,sizeof(float));
+				writer.EndChunk();
+				writer.BeginChunk(SNAPSHOT_INDICES,IndexSize(visual->vertexCnt) * indexCnt);
+				writer.PutWords(visual->faceIndex,IndexSize(visual->vertexCnt) * indexCnt,IndexSize(visual->vertexCnt));
+				writer.EndChunk();
 			}
-			fclose(fp);
+			// SAVE THE PHYSICAL SIMULATION OF THE PARTICLES
+			m_PhysEnv.SaveSnapshot(writer);
+			m_PhysEnv.SaveBoneColliders(writer,&m_Skeleton);
 		}
+		if (!writer.Close())
+			MessageBox("Could Not Save The Simulation","Error",MB_OK);
+		else
+			UpdateSceneCache();
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Procedure:	UpdateSceneCache
+// Purpose:		Writes the springs of a system loaded from an OBJ into the
+//				cache of the OBJ, so the next load of it has them too
+// Notes:		The mesh is taken from the cache as it is, the visual holds
+//				the simulated shape by now. The new cache is written beside
+//				the old one, which stays mapped until it is replaced, and
+//				the cloth draws its indices from a copy in between. A cache
+//				that can not be replaced only means the springs are not
+//				kept with the mesh
+///////////////////////////////////////////////////////////////////////////////
+void COGLView::UpdateSceneCache()
+{
+/// Local Variables ///////////////////////////////////////////////////////////
+	tSceneView	scene;
+	tSceneStamp	stamp;
+	CString		cacheName, tempName;
+	t_Visual	*visual;
+	void		*indices;
+///////////////////////////////////////////////////////////////////////////////
+	// AN OBJ CHANGED SINCE IT WAS LOADED NO LONGER MATCHES THE SPRINGS
+	if (!m_SceneCache.IsOpen() || m_Skeleton.childCnt == 0 || !SourceStamp((LPCTSTR)m_SceneSource, stamp) ||
+		stamp.size != m_SceneStamp.size || stamp.time != m_SceneStamp.time)
+		return;
+	cacheName = m_SceneSource + SCENE_CACHE_EXT;
+	tempName = cacheName + ".tmp";
+	m_PhysEnv.ExportScene(&scene);
+	if (scene.particleCnt != m_SceneCache.View().particleCnt)
+		return;
+	scene.particles = m_SceneCache.View().particles;
+	scene.visual = m_SceneCache.View().visual;
+	if (!WriteSceneCache((LPCTSTR)tempName, scene, stamp))
+		return;
+	visual = m_Skeleton.children->visuals;
+	indices = NULL;
+	if (m_SceneCache.Maps(visual->faceIndex))
+	{
+		indices = AllocIndices(visual->vertexCnt, visual->faceCnt * visual->vPerFace);
+		memcpy(indices, visual->faceIndex, IndexSize(visual->vertexCnt) * visual->faceCnt * visual->vPerFace);
+		visual->faceIndex = indices;
+	}
+	m_SceneCache.Close();
+	remove((LPCTSTR)cacheName);
+	if (rename((LPCTSTR)tempName, (LPCTSTR)cacheName) != 0)
+	{
+		remove((LPCTSTR)tempName);
+		return;
+	}
+	if (m_SceneCache.Open((LPCTSTR)cacheName, stamp) && indices != NULL &&
+		m_SceneCache.View().visual != NULL && m_SceneCache.View().visual->faceIndex != NULL)
+	{
+		visual->faceIndex = m_SceneCache.View().visual->faceIndex;
+		free(indices);
 	}
 }
 
@@ -854,6 +1256,150 @@ void COGLView::OnSetVertexProperties()
 	m_PhysEnv.SetVertexProperties();		
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Procedure:	AddCollider
+// Purpose:		Asks for a collision plane, box or capsule and adds it
+// Arguments:	The tColliderShapes to add
+// Notes:		A box or capsule given a bone is in the space of that bone
+//				and follows it
+///////////////////////////////////////////////////////////////////////////////		
+void COGLView::AddCollider(int shape)
+{
+/// Local Variables ///////////////////////////////////////////////////////////
+	CAddCollider dialog(shape,&m_Skeleton);
+	tVector	point,second,axis[3];
+	float	angle;
+	t_Bone	*bone;
+	tCollisionBox		box;
+	tCollisionCapsule	capsule;
+///////////////////////////////////////////////////////////////////////////////
+	// START FROM SOMETHING THE CLOTH FALLS ON
+	switch (shape)
+	{
+	case COLLIDER_PLANE:
+		dialog.m_YPos = 1.0f;
+		dialog.m_Size = 3.0f;
+		break;
+	case COLLIDER_BOX:
+		dialog.m_YPos = -3.0f;
+		dialog.m_XPos2 = dialog.m_YPos2 = dialog.m_ZPos2 = 1.0f;
+		break;
+	case COLLIDER_CAPSULE:
+		dialog.m_XPos = -2.0f;
+		dialog.m_YPos = -3.0f;
+		dialog.m_XPos2 = 2.0f;
+		dialog.m_YPos2 = -3.0f;
+		dialog.m_Size = 0.5f;
+		break;
+	}
+	if (dialog.DoModal() != IDOK)
+		return;
+
+	MAKEVECTOR(point,dialog.m_XPos,dialog.m_YPos,dialog.m_ZPos)
+	MAKEVECTOR(second,dialog.m_XPos2,dialog.m_YPos2,dialog.m_ZPos2)
+	bone = BoneAtIndex(&m_Skeleton,dialog.m_Bone);
+	switch (shape)
+	{
+	case COLLIDER_PLANE:
+		m_PhysEnv.AddCollisionPlane(&point,dialog.m_Size);
+		break;
+	case COLLIDER_BOX:
+		// THE BOX IS TURNED ABOUT THE Y AXIS ONLY
+		angle = (float)DEGTORAD(dialog.m_Angle);
+		MAKEVECTOR(axis[0],(float)cos(angle),0.0f,-(float)sin(angle))
+		MAKEVECTOR(axis[1],0.0f,1.0f,0.0f)
+		CrossProduct(&axis[0],&axis[1],&axis[2]);
+		if (dialog.m_Bone > 0 && bone != NULL)
+		{
+			box.center = point;
+			box.halfSize = second;
+			box.axis[0] = axis[0];
+			box.axis[1] = axis[1];
+			box.axis[2] = axis[2];
+			m_PhysEnv.AttachCollisionBox(bone,&box);
+		}
+		else
+			m_PhysEnv.AddCollisionBox(&point,&second,axis);
+		break;
+	case COLLIDER_CAPSULE:
+		if (dialog.m_Bone > 0 && bone != NULL)
+		{
+			capsule.p1 = point;
+			capsule.p2 = second;
+			capsule.radius = dialog.m_Size;
+			m_PhysEnv.AttachCollisionCapsule(bone,&capsule);
+		}
+		else
+			m_PhysEnv.AddCollisionCapsule(&point,&second,dialog.m_Size);
+		break;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Procedure:	AddCollisionMesh
+// Purpose:		Loads an OBJ file as a triangle mesh the cloth collides with
+// Arguments:	Name of the OBJ file
+// Notes:		The collider dialog places, scales and turns the mesh about
+//				Y. Given a bone the mesh is in the space of that bone and
+//				follows it. Quads are split in two triangles
+///////////////////////////////////////////////////////////////////////////////		
+void COGLView::AddCollisionMesh(CString file1)
+{
+/// Local Variables ///////////////////////////////////////////////////////////
+	CAddCollider dialog(COLLIDER_MESH,&m_Skeleton);
+	t_Visual	visual;
+	tVector		axis[3],*point;
+	float		angle;
+	t_Bone		*bone;
+	std::vector<tVector>	vertices;
+	std::vector<int>		triangles;
+///////////////////////////////////////////////////////////////////////////////
+	memset(&visual,0,sizeof(visual));
+	if (!LoadOBJ((char *)(LPCTSTR)file1,&visual,LOADOBJ_VERTEXONLY | LOADOBJ_REUSEVERTICES) ||
+		visual.faceCnt == 0 || visual.vertexData == NULL)
+	{
+		free(visual.vertexData);
+		free(visual.faceIndex);
+		MessageBox("Could Not Load The Mesh","Error",MB_OK);
+		return;
+	}
+	dialog.m_Size = 1.0f;
+	if (dialog.DoModal() == IDOK)
+	{
+		// THE MESH IS TURNED ABOUT THE Y AXIS ONLY, LIKE A BOX
+		angle = (float)DEGTORAD(dialog.m_Angle);
+		MAKEVECTOR(axis[0],(float)cos(angle),0.0f,-(float)sin(angle))
+		MAKEVECTOR(axis[1],0.0f,1.0f,0.0f)
+		CrossProduct(&axis[0],&axis[1],&axis[2]);
+		vertices.resize(visual.vertexCnt);
+		for (int loop = 0; loop < visual.vertexCnt; loop++)
+		{
+			point = (tVector *)&visual.vertexData[loop * visual.vSize];
+			MAKEVECTOR(vertices[loop],
+				dialog.m_XPos + dialog.m_Size * (point->x * axis[0].x + point->y * axis[1].x + point->z * axis[2].x),
+				dialog.m_YPos + dialog.m_Size * (point->x * axis[0].y + point->y * axis[1].y + point->z * axis[2].y),
+				dialog.m_ZPos + dialog.m_Size * (point->x * axis[0].z + point->y * axis[1].z + point->z * axis[2].z))
+		}
+		for (long face = 0; face < visual.faceCnt; face++)
+		{
+			long first = face * visual.vPerFace;
+			for (int corner = 2; corner < visual.vPerFace; corner++)
+			{
+				triangles.push_back((int)GetIndex(visual.faceIndex,visual.vertexCnt,first));
+				triangles.push_back((int)GetIndex(visual.faceIndex,visual.vertexCnt,first + corner - 1));
+				triangles.push_back((int)GetIndex(visual.faceIndex,visual.vertexCnt,first + corner));
+			}
+		}
+		bone = BoneAtIndex(&m_Skeleton,dialog.m_Bone);
+		if (dialog.m_Bone > 0 && bone != NULL)
+			m_PhysEnv.AttachCollisionMesh(bone,vertices.data(),(int)vertices.size(),triangles.data(),(int)triangles.size() / 3);
+		else
+			m_PhysEnv.AddCollisionMesh(vertices.data(),(int)vertices.size(),triangles.data(),(int)triangles.size() / 3);
+	}
+	free(visual.vertexData);
+	free(visual.faceIndex);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Procedure:	CreateClothPatch
 // Purpose:		Creates a System to Represent a Cloth Patch
@@ -862,158 +1408,48 @@ void COGLView::OnSetVertexProperties()
 void COGLView::CreateClothPatch() 
 {
 /// Local Variables ///////////////////////////////////////////////////////////
-	t_Bone	*children;
 	t_Visual *visual;
-	int		fPos,vPos,l1,l2;
-	tTexturedVertex *vertex;
-	float	sx,sy,stepx,stepy;
-	BOOL	orientHoriz = TRUE;
-	int		u = 9, v = 9;
-	float	w = 8.0f, h = 8.0,tsu,tsv,tdu,tdv;
-	float	SstK = 4.0f,SstD = 0.6f;  //SstK = 2.5f,SstD = 1.2f;
-	float	SshK = 4.0f,SshD = 0.6f;
-	float	SflK = 2.4f,SflD = 0.8f;
+	tClothPatch	patch;
 	NewCloth	dialog;
 ///////////////////////////////////////////////////////////////////////////////
-	dialog.m_StructCoef = SstK;
-	dialog.m_StructDamp = SstD;
-	dialog.m_ShearCoef = SshK;
-	dialog.m_ShearDamp = SshD;
-	dialog.m_BendCoef = SflK;
-	dialog.m_BendDamp = SflD;
-	dialog.m_USize = u;
-	dialog.m_VSize = v;
-	dialog.m_Vertical = !orientHoriz;
-	dialog.m_UseStruct = TRUE;
-	dialog.m_UseShear = TRUE;
-	dialog.m_UseBend = TRUE;
+	DefaultClothPatch(patch);
+	dialog.m_StructCoef = patch.structK;
+	dialog.m_StructDamp = patch.structD;
+	dialog.m_ShearCoef = patch.shearK;
+	dialog.m_ShearDamp = patch.shearD;
+	dialog.m_BendCoef = patch.bendK;
+	dialog.m_BendDamp = patch.bendD;
+	dialog.m_USize = patch.u;
+	dialog.m_VSize = patch.v;
+	dialog.m_Vertical = !patch.horizontal;
+	dialog.m_UseStruct = patch.useStruct;
+	dialog.m_UseShear = patch.useShear;
+	dialog.m_UseBend = patch.useBend;
 	if (dialog.DoModal())
 	{
 		NewSystem();	// CLEAR WHAT DATA IS THERE
-		SstK = dialog.m_StructCoef;
-		SstD = dialog.m_StructDamp;
-		SshK = dialog.m_ShearCoef;
-		SshK = dialog.m_ShearDamp;
-		SflK = dialog.m_BendCoef;
-		SflD = dialog.m_BendDamp;
-		u = dialog.m_USize;
-		v = dialog.m_VSize;
-		orientHoriz = !dialog.m_Vertical;
-
-		sx = -(w / 2.0f);
-		sy = (h / 2.0f);
-		stepx = w / (float)u;
-		stepy = -(h / (float)v);
-
-		tsu = 0.0f;
-		tsv = 0.0f;
-		tdu = 1.0f / (float)u;
-		tdv = 1.0f / (float)v;
-
-		fPos = (u - 1) * (v - 1) * 2;		// FACE COUNT
-		vPos = u * v;
-		visual = (t_Visual *)malloc(sizeof(t_Visual));
-
-		visual->reuseVertices = TRUE;
-		visual->dataFormat = GL_T2F_V3F;
-		visual->vPerFace = 3;
-		visual->vSize = 5;					// 3 floats for vertex
-		visual->vertexData = (float *)malloc(sizeof(float) * visual->vSize * vPos);
-		visual->vertexCnt = vPos;
-		visual->faceIndex = (unsigned short *)malloc(sizeof(unsigned short) * fPos * visual->vPerFace);
-		visual->faceCnt = fPos;
-		
-		// SET THE VERTICES
-		vertex = (tTexturedVertex *)visual->vertexData;
-		for (l1 = 0; l1 < v; l1++,tsv+=tdv)
-			for (l2 = 0; l2 < u; l2++,tsu+=tdu)
-			{
-				vertex->u = tsu;
-				vertex->v = tsv;
-
-				vertex->x = sx + (stepx * l2);
-				if (orientHoriz)
-				{
-					vertex->z = sy + (stepy * l1);
-					vertex->y = 0.0f;
-				}
-				else
-				{
-					vertex->y = sy + (stepy * l1);
-					vertex->z = 0.0f;
-				}
-				vertex++;
-			}
+		patch.structK = dialog.m_StructCoef;
+		patch.structD = dialog.m_StructDamp;
+		patch.shearK = dialog.m_ShearCoef;
+		patch.shearD = dialog.m_ShearDamp;
+		patch.bendK = dialog.m_BendCoef;
+		patch.bendD = dialog.m_BendDamp;
+		patch.u = dialog.m_USize;
+		patch.v = dialog.m_VSize;
+		patch.horizontal = !dialog.m_Vertical;
+		patch.useStruct = dialog.m_UseStruct;
+		patch.useShear = dialog.m_UseShear;
+		patch.useBend = dialog.m_UseBend;
+
+		visual = MakeClothVisual(patch);
 
 		// INFORM THE PHYSICAL SIMULATION OF THE PARTICLES
 		m_PhysEnv.SetWorldParticles((tTexturedVertex *)visual->vertexData,visual->vertexCnt);
 
-		if (m_Skeleton.childCnt > 0)
-		{
-			if (m_Skeleton.children->visuals->faceIndex != NULL)
-				free(m_Skeleton.children->visuals->faceIndex);
-			free(m_Skeleton.children->visuals);
-			free(m_Skeleton.children->visuals->vertexData);
-			free(m_Skeleton.children);
-			m_Skeleton.childCnt = 0;
-		}
-		children = (t_Bone *)malloc(sizeof(t_Bone));
-		m_CurBone = &children[m_Skeleton.childCnt];
-		ResetBone(m_CurBone,&m_Skeleton);
-		strcpy(m_CurBone->name,"Cloth");
-		m_CurBone->visuals = visual;
-		m_CurBone->visualCnt = 1;
-		m_Skeleton.childCnt = 1;
-		m_Skeleton.children = children;
-
-		if (dialog.m_UseStruct)
-		{
-			// Horizontal
-			for (l1 = 0; l1 < v; l1++)	// v
-				for (l2 = 0; l2 < (u - 1); l2++)
-				{
-					m_PhysEnv.AddSpring((l1 * u) + l2,(l1 * u) + l2 + 1,SstK,SstD,STRUCTURAL_SPRING);
-				}
-
-			// Vertical
-			for (l1 = 0; l1 < (u); l1++)	
-				for (l2 = 0; l2 < (v - 1); l2++)
-				{
-					m_PhysEnv.AddSpring((l2 * u) + l1,((l2 + 1) * u) + l1,SstK,SstD,STRUCTURAL_SPRING);
-				}
-		}
-
-		if (dialog.m_UseShear)
-		{
-			// Shearing Springs
-			for (l1 = 0; l1 < (v - 1); l1++)	
-				for (l2 = 0; l2 < (u - 1); l2++)
-				{
-					m_PhysEnv.AddSpring((l1 * u) + l2,((l1 + 1) * u) + l2 + 1,SshK,SshD,SHEAR_SPRING);
-					m_PhysEnv.AddSpring(((l1 + 1) * u) + l2,(l1 * u) + l2 + 1,SshK,SshD,SHEAR_SPRING);
-				}
-		}
+		// NewSystem ALREADY FREED THE OLD CLOTH
+		SetClothBone(visual,"Cloth");
 
-		if (dialog.m_UseBend)
-		{
-			// Bend Springs
-			for (l1 = 0; l1 < (v); l1++)	
-			{
-				for (l2 = 0; l2 < (u - 2); l2++)
-				{
-					m_PhysEnv.AddSpring((l1 * u) + l2,(l1 * u) + l2 + 2,SflK,SflD,BEND_SPRING);
-				}
-				m_PhysEnv.AddSpring((l1 * u) + (u - 3),(l1 * u) + (u - 1),SflK,SflD,BEND_SPRING);
-			}
-			for (l1 = 0; l1 < (u); l1++)	
-			{
-				for (l2 = 0; l2 < (v - 2); l2++)
-				{
-					m_PhysEnv.AddSpring((l2 * u) + l1,((l2 + 2) * u) + l1,SflK,SflD,BEND_SPRING);
-				}
-				m_PhysEnv.AddSpring(((v - 3) * u) + l1,((v - 1) * u) + l1,SflK,SflD,BEND_SPRING);
-			}
-		}
+		AddClothSprings(m_PhysEnv,patch);
 	}
 
 }
@@ -11,9 +11,13 @@
 
 #include <GL/gl.h>
 #include <GL/glu.h>
+#include <chrono>
 
 #include "Skeleton.h"
 #include "PhysEnv.h"
+#include "TrajectoryPlayer.h"
+#include "ClothSurface.h"
+#include "SceneCache.h"
 /////////////////////////////////////////////////////////////////////////////
 // COGLView window
 
@@ -43,6 +47,17 @@ public:
 	float	m_LastTime;
 
 	CPhysEnv		m_PhysEnv;
+	CTrajectoryPlayer	m_Replay;		// RECORDING PLAYED BACK IN PLACE OF THE SIMULATION
+	BOOL	m_Replaying;
+	float	m_ReplayClock;			// RECORDED TIME BEING SHOWN
+	CClothSurface	m_Surface;		// THE CLOTH DRAWN AS A LIT SURFACE
+	CSceneCache	m_SceneCache;		// THE CACHE OF THE OBJ LOADED, MAPPED WHILE THE CLOTH DRAWS ITS INDICES
+	CString	m_SceneSource;			// THE OBJ THE CACHE WAS BUILT FROM
+	tSceneStamp	m_SceneStamp;
+	std::chrono::steady_clock::time_point	m_StepDone;	// WHEN THE LAST STEP OF THE FRAME ENDED
+	BOOL	m_StepPending;			// A STEP HAS ENDED THAT IS NOT ON SCREEN YET
+	double	m_LatencySum, m_LatencyMax;	// END OF STEP TO SCREEN, IN MS, OVER THE FRAMES SINCE THE LAST REPORT
+	int		m_LatencyFrames;
 // Operations
 public:
 	BOOL	SetupPixelFormat(HDC hdc);
@@ -52,6 +67,8 @@ public:
 	void	OnSimulationSetsimproperties();
 	void	OnSetTimeProperties();
 	void	OnSetVertexProperties();
+	void	AddCollider(int shape);
+	void	AddCollisionMesh(CString file1);
 	GLvoid	resize( GLsizei width, GLsizei height );
 	void	GetGLInfo();
 	void	HandleKeyUp(UINT nChar);
@@ -61,9 +78,21 @@ public:
 	void	NewSystem();
 	void	LoadFile(CString file1,CString baseName,CString ext);
 	void	SaveFile(CString file1,CString baseName);
+	void	UpdateSceneCache();
+	void	SetClothBone(t_Visual *visual,CString name);
+	BOOL	LoadSnapshot(CSnapshotReader &reader,CString baseName);
+	BOOL	LoadLegacy(CSnapshotReader &reader,CString baseName);
 	void	CreateClothPatch();
 	void	RunSim();
+	void	StartReplay(CString file1);
+	void	ExportRecording(CString file1,CString baseName);
+	void	ExportRecordingObj(CString file1,CString baseName);
+	void	ExportParticles(CString file1);
+	void	StopReplay();
+	void	ShowReplayFrame(int frame);
+	BOOL	ReplayKey(UINT nChar);
 	float	GetTime( void );
+	void	MeasureLatency();
 
 // Overrides
 	// ClassWizard generated virtual function overrides
@@ -82,6 +111,8 @@ protected:
 	int		m_PickX, m_PickY;
 	int		m_ScreenWidth;
 	int		m_ScreenHeight;
+	tMatrix	m_Projection;		// THE PROJECTION AND VIEWPORT SET BY resize, FOR PICKING
+	int		m_Viewport[4];
 	//{{AFX_MSG(COGLView)
 	afx_msg int OnCreate(LPCREATESTRUCT lpCreateStruct);
 	afx_msg void OnDestroy();
@@ -0,0 +1,461 @@
+#include "stdafx.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include "ObjParser.h"
+#include "Skeleton.h"
+#include "ThreadPool.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+CMappedFile::~CMappedFile ()
+{
+    this->Close ();
+}
+
+#ifdef _WIN32
+
+bool CMappedFile::Open ( const char * filename )
+{
+    this->Close ();
+    HANDLE file = ::CreateFileA ( filename , GENERIC_READ , FILE_SHARE_READ , NULL , OPEN_EXISTING , FILE_FLAG_SEQUENTIAL_SCAN , NULL );
+    if ( file == INVALID_HANDLE_VALUE )
+    {
+        return false;
+    }
+    LARGE_INTEGER size;
+    if ( ! ::GetFileSizeEx ( file , &size ) )
+    {
+        ::CloseHandle ( file );
+        return false;
+    }
+    this->file_ = file;
+    // A MAPPING OF AN EMPTY FILE CAN NOT BE MADE, AN EMPTY RANGE IS ENOUGH
+    if ( size.QuadPart == 0 )
+    {
+        return true;
+    }
+    HANDLE mapping = ::CreateFileMappingA ( file , NULL , PAGE_READONLY , 0 , 0 , NULL );
+    const void * view = mapping != NULL ? ::MapViewOfFile ( mapping , FILE_MAP_READ , 0 , 0 , 0 ) : NULL;
+    if ( view == NULL )
+    {
+        if ( mapping != NULL )
+        {
+            ::CloseHandle ( mapping );
+        }
+        this->Close ();
+        return false;
+    }
+    this->mapping_ = mapping;
+    this->data_ = static_cast < const char * > ( view );
+    this->size_ = static_cast < std::size_t > ( size.QuadPart );
+    return true;
+}
+
+void CMappedFile::Close ()
+{
+    if ( this->data_ != nullptr )
+    {
+        ::UnmapViewOfFile ( this->data_ );
+    }
+    if ( this->mapping_ != nullptr )
+    {
+        ::CloseHandle ( this->mapping_ );
+    }
+    if ( this->file_ != nullptr )
+    {
+        ::CloseHandle ( this->file_ );
+    }
+    this->data_ = nullptr;
+    this->size_ = 0;
+    this->mapping_ = this->file_ = nullptr;
+}
+
+#else
+
+bool CMappedFile::Open ( const char * filename )
+{
+    this->Close ();
+    const int file = ::open ( filename , O_RDONLY );
+    if ( file < 0 )
+    {
+        return false;
+    }
+    struct stat status;
+    if ( ::fstat ( file , &status ) != 0 )
+    {
+        ::close ( file );
+        return false;
+    }
+    if ( status.st_size > 0 )
+    {
+        void * view = ::mmap ( nullptr , static_cast < std::size_t > ( status.st_size ) , PROT_READ , MAP_PRIVATE , file , 0 );
+        if ( view == MAP_FAILED )
+        {
+            ::close ( file );
+            return false;
+        }
+        ::madvise ( view , static_cast < std::size_t > ( status.st_size ) , MADV_SEQUENTIAL );
+        this->data_ = static_cast < const char * > ( view );
+        this->size_ = static_cast < std::size_t > ( status.st_size );
+    }
+    // THE MAPPING STAYS VALID AFTER THE DESCRIPTOR IS CLOSED
+    ::close ( file );
+    return true;
+}
+
+void CMappedFile::Close ()
+{
+    if ( this->data_ != nullptr )
+    {
+        ::munmap ( const_cast < char * > ( this->data_ ) , this->size_ );
+    }
+    this->data_ = nullptr;
+    this->size_ = 0;
+}
+
+#endif
+
+static inline bool IsBlank ( const char c )
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline const char * SkipBlanks ( const char * p , const char * end )
+{
+    while ( p < end && IsBlank ( *p ) )
+    {
+        ++p;
+    }
+    return p;
+}
+
+/**
+ * \brief The end of the word starting at p: the next blank, end of line or end of the text.
+ */
+static inline const char * WordEnd ( const char * p , const char * end )
+{
+    while ( p < end && ! IsBlank ( *p ) && *p != '\n' )
+    {
+        ++p;
+    }
+    return p;
+}
+
+/**
+ * \brief The start of the next line.
+ */
+static inline const char * NextLine ( const char * p , const char * end )
+{
+    const void * newline = std::memchr ( p , '\n' , static_cast < std::size_t > ( end - p ) );
+    return newline != nullptr ? static_cast < const char * > ( newline ) + 1 : end;
+}
+
+/**
+ * \brief Reads the next number of a line. A missing or broken number reads as 0, like atof did.
+ * \return Where reading should go on.
+ */
+static inline const char * ReadFloat ( const char * p , const char * end , float & value )
+{
+    p = SkipBlanks ( p , end );
+    // from_chars DOES NOT TAKE A LEADING +
+    if ( p < end && *p == '+' )
+    {
+        ++p;
+    }
+    const std::from_chars_result result = std::from_chars ( p , end , value );
+    if ( result.ec != std::errc () )
+    {
+        value = 0.0f;
+        return WordEnd ( p , end );
+    }
+    return result.ptr;
+}
+
+static inline bool WordIs ( const char * begin , const char * end , const char * word )
+{
+    const std::size_t length = std::strlen ( word );
+    return static_cast < std::size_t > ( end - begin ) == length && std::memcmp ( begin , word , length ) == 0;
+}
+
+/**
+ * \brief Reads one index of a face corner, leaving 0 when it is empty.
+ *
+ * Relative indices count back from the number of elements read so far in the chunk, so they still need the elements of the chunks before added.
+ * Those set their bit in relative.
+ */
+static inline const char * ReadIndex ( const char * p , const char * end , const std::size_t count , long & index , int & relative , const int bit )
+{
+    index = 0;
+    const std::from_chars_result result = std::from_chars ( p , end , index );
+    if ( index < 0 )
+    {
+        index += static_cast < long > ( count ) + 1;
+        relative |= 1 << bit;
+    }
+    return result.ec == std::errc () ? result.ptr : p;
+}
+
+/**
+ * \brief Reads the corners of a face line, each one v, v/t, v//n or v/t/n.
+ */
+static void ReadFace ( const char * p , const char * end , tObjMesh & mesh , std::vector < std::pair < int , int > > & relativeFaces )
+{
+    t_faceIndex face;
+    std::memset ( &face , 0 , sizeof ( face ) );
+    int corners = 0 , relative = 0;
+    bool texture = false , normal = false;
+    for ( p = SkipBlanks ( p , end ); p < end && *p != '\n'; p = SkipBlanks ( p , end ) )
+    {
+        const char * word = WordEnd ( p , end );
+        if ( corners < 4 )
+        {
+            long v , t = 0 , n = 0;
+            p = ReadIndex ( p , word , mesh.vertices.size () , v , relative , corners * 3 );
+            if ( p < word && *p == '/' )
+            {
+                p = ReadIndex ( p + 1 , word , mesh.textures.size () , t , relative , corners * 3 + 1 );
+                if ( p < word && *p == '/' )
+                {
+                    ReadIndex ( p + 1 , word , mesh.normals.size () , n , relative , corners * 3 + 2 );
+                }
+            }
+            face.v [ corners ] = v;
+            face.t [ corners ] = t;
+            face.n [ corners ] = n;
+            texture = t != 0;
+            normal = n != 0;
+        }
+        ++corners;
+        p = word;
+    }
+    // THE LAST CORNER DECIDES WHETHER THERE ARE TEXTURES AND NORMALS, AS IT ALWAYS HAS
+    face.flags = ( texture ? FACE_TYPE_TEXTURE : 0 ) | ( normal ? FACE_TYPE_NORMAL : 0 );
+    if ( corners == 4 )
+    {
+        face.flags |= FACE_TYPE_QUAD;
+    }
+    else
+    {
+        // LARGER FACES ARE CUT DOWN TO A TRIANGLE
+        face.flags |= FACE_TYPE_TRI;
+        if ( corners > 4 )
+        {
+            ++mesh.largeFaceCnt;
+        }
+    }
+    if ( relative != 0 )
+    {
+        relativeFaces.push_back ( std::make_pair ( static_cast < int > ( mesh.faces.size () ) , relative ) );
+    }
+    mesh.faces.push_back ( face );
+}
+
+bool CObjParser::Load ( const char * filename )
+{
+    CMappedFile file;
+    if ( ! file.Open ( filename ) )
+    {
+        return false;
+    }
+    this->Parse ( file.Begin () , file.End () );
+    return true;
+}
+
+void CObjParser::ParseChunk ( const char * begin , const char * end , tObjMesh & mesh , std::vector < std::pair < int , int > > & relativeFaces )
+{
+    relativeFaces.clear ();
+    mesh.vertices.clear ();
+    mesh.normals.clear ();
+    mesh.textures.clear ();
+    mesh.faces.clear ();
+    mesh.materialLib.clear ();
+    mesh.largeFaceCnt = 0;
+    for ( const char * line = begin; line < end; line = NextLine ( line , end ) )
+    {
+        const char * p = SkipBlanks ( line , end );
+        const char * word = WordEnd ( p , end );
+        if ( p == word )
+        {
+            continue;
+        }
+        tVector value;
+        if ( word - p == 1 && *p == 'v' )
+        {
+            p = ReadFloat ( word , end , value.x );
+            p = ReadFloat ( p , end , value.y );
+            ReadFloat ( p , end , value.z );
+            mesh.vertices.push_back ( value );
+        }
+        else if ( word - p == 1 && *p == 'f' )
+        {
+            ReadFace ( word , end , mesh , relativeFaces );
+        }
+        else if ( WordIs ( p , word , "vn" ) )
+        {
+            p = ReadFloat ( word , end , value.x );
+            p = ReadFloat ( p , end , value.y );
+            ReadFloat ( p , end , value.z );
+            mesh.normals.push_back ( value );
+        }
+        else if ( WordIs ( p , word , "vt" ) )
+        {
+            p = ReadFloat ( word , end , value.u );
+            ReadFloat ( p , end , value.v );
+            value.w = 0.0f;
+            mesh.textures.push_back ( value );
+        }
+        else if ( WordIs ( p , word , "mtllib" ) )
+        {
+            p = SkipBlanks ( word , end );
+            mesh.materialLib.assign ( p , WordEnd ( p , end ) );
+        }
+    }
+}
+
+/**
+ * \brief Where a chunk of the text should end: just after the first end of line at or past a target.
+ */
+static const char * ChunkEnd ( const char * target , const char * end )
+{
+    return target >= end ? end : NextLine ( target , end );
+}
+
+/**
+ * \brief Copies the elements of a chunk to their place in the whole mesh.
+ */
+template < typename T >
+static inline void Place ( const std::vector < T > & from , std::vector < T > & to , const std::size_t offset )
+{
+    if ( ! from.empty () )
+    {
+        std::memcpy ( &to [ offset ] , from.data () , from.size () * sizeof ( T ) );
+    }
+}
+
+void CObjParser::Parse ( const char * begin , const char * end )
+{
+    CThreadPool & pool = CThreadPool::Instance ();
+    const std::size_t size = static_cast < std::size_t > ( end - begin );
+    const int chunkCnt = static_cast < int > ( std::min < std::size_t > ( pool.WorkerCount () * OBJ_CHUNKS_PER_WORKER , std::max < std::size_t > ( size / OBJ_MIN_CHUNK , 1 ) ) );
+    tObjMesh & mesh = this->mesh_;
+    if ( this->chunks_.empty () )
+    {
+        this->chunks_.resize ( 1 );
+    }
+    if ( chunkCnt == 1 )
+    {
+        // A SINGLE CHUNK STARTS AT THE FIRST ELEMENT, SO ITS RELATIVE INDICES ARE ALREADY RIGHT
+        this->ParseChunk ( begin , end , mesh , this->chunks_ [ 0 ].relativeFaces );
+        return;
+    }
+    // CUT THE TEXT AT LINE ENDS INTO CHUNKS OF ABOUT THE SAME SIZE AND PARSE THEM ALL AT ONCE
+    if ( static_cast < int > ( this->chunks_.size () ) < chunkCnt )
+    {
+        this->chunks_.resize ( chunkCnt );
+    }
+    this->cuts_.resize ( chunkCnt + 1 );
+    this->cuts_ [ 0 ] = begin;
+    for ( int c = 1; c < chunkCnt; ++c )
+    {
+        this->cuts_ [ c ] = std::max ( this->cuts_ [ c - 1 ] , ChunkEnd ( begin + size * c / chunkCnt , end ) );
+    }
+    this->cuts_ [ chunkCnt ] = end;
+    pool.ParallelFor ( chunkCnt , 1 , [ this ] ( const int first , const int last , const int )
+    {
+        for ( int c = first; c < last; ++c )
+        {
+            this->ParseChunk ( this->cuts_ [ c ] , this->cuts_ [ c + 1 ] , this->chunks_ [ c ].mesh , this->chunks_ [ c ].relativeFaces );
+        }
+    } );
+    // PREFIX SUMS GIVE EACH CHUNK ITS OFFSET IN EVERY LIST
+    this->offsets_.resize ( chunkCnt + 1 );
+    this->offsets_ [ 0 ] = tOffsets { 0 , 0 , 0 , 0 };
+    mesh.materialLib.clear ();
+    mesh.largeFaceCnt = 0;
+    for ( int c = 0; c < chunkCnt; ++c )
+    {
+        const tObjMesh & part = this->chunks_ [ c ].mesh;
+        const tOffsets & at = this->offsets_ [ c ];
+        this->offsets_ [ c + 1 ] = tOffsets { at.vertex + part.vertices.size () , at.normal + part.normals.size () , at.texture + part.textures.size () , at.face + part.faces.size () };
+        mesh.largeFaceCnt += part.largeFaceCnt;
+        if ( ! part.materialLib.empty () )
+        {
+            mesh.materialLib = part.materialLib;
+        }
+    }
+    const tOffsets & total = this->offsets_ [ chunkCnt ];
+    mesh.vertices.resize ( total.vertex );
+    mesh.normals.resize ( total.normal );
+    mesh.textures.resize ( total.texture );
+    mesh.faces.resize ( total.face );
+    pool.ParallelFor ( chunkCnt , 1 , [ this , &mesh ] ( const int first , const int last , const int )
+    {
+        for ( int c = first; c < last; ++c )
+        {
+            const tChunk & chunk = this->chunks_ [ c ];
+            const tOffsets & at = this->offsets_ [ c ];
+            Place ( chunk.mesh.vertices , mesh.vertices , at.vertex );
+            Place ( chunk.mesh.normals , mesh.normals , at.normal );
+            Place ( chunk.mesh.textures , mesh.textures , at.texture );
+            Place ( chunk.mesh.faces , mesh.faces , at.face );
+            // RELATIVE INDICES WERE ONLY RESOLVED WITHIN THE CHUNK
+            const long shift [ 3 ] = { static_cast < long > ( at.vertex ) , static_cast < long > ( at.texture ) , static_cast < long > ( at.normal ) };
+            for ( const std::pair < int , int > & relative : chunk.relativeFaces )
+            {
+                t_faceIndex & face = mesh.faces [ at.face + relative.first ];
+                for ( int corner = 0; corner < 4; ++corner )
+                {
+                    long * index [ 3 ] = { &face.v [ corner ] , &face.t [ corner ] , &face.n [ corner ] };
+                    for ( int element = 0; element < 3; ++element )
+                    {
+                        if ( relative.second & ( 1 << ( corner * 3 + element ) ) )
+                        {
+                            *index [ element ] += shift [ element ];
+                        }
+                    }
+                }
+            }
+        }
+    } );
+}
+
+bool ParseMaterialLib ( const char * filename , t_Visual * visual )
+{
+    CMappedFile file;
+    strcpy ( visual->map , "" );
+    if ( ! file.Open ( filename ) )
+    {
+        return false;
+    }
+    const char * end = file.End ();
+    for ( const char * line = file.Begin (); line < end; line = NextLine ( line , end ) )
+    {
+        const char * p = SkipBlanks ( line , end );
+        const char * word = WordEnd ( p , end );
+        tVector * color = WordIs ( p , word , "Ka" ) ? &visual->Ka : WordIs ( p , word , "Kd" ) ? &visual->Kd : WordIs ( p , word , "Ks" ) ? &visual->Ks : nullptr;
+        if ( color != nullptr )
+        {
+            p = ReadFloat ( word , end , color->r );
+            p = ReadFloat ( p , end , color->g );
+            ReadFloat ( p , end , color->b );
+        }
+        else if ( WordIs ( p , word , "Ns" ) )
+        {
+            ReadFloat ( word , end , visual->Ns );
+        }
+        else if ( WordIs ( p , word , "map_Kd" ) )
+        {
+            p = SkipBlanks ( word , end );
+            const std::size_t length = std::min < std::size_t > ( WordEnd ( p , end ) - p , sizeof ( visual->map ) - 1 );
+            std::memcpy ( visual->map , p , length );
+            visual->map [ length ] = '\0';
+        }
+    }
+    return true;
+}
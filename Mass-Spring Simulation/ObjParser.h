@@ -0,0 +1,115 @@
+#if !defined(OBJPARSER_H__INCLUDED_)
+#define OBJPARSER_H__INCLUDED_
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+#include "MathDefs.h"
+#include "LoadOBJ.h"
+
+#define OBJ_MIN_CHUNK			( 1 << 20 )		// SMALLEST PIECE OF A FILE WORTH PARSING ON ITS OWN THREAD
+#define OBJ_CHUNKS_PER_WORKER	4				// MORE CHUNKS THAN WORKERS EVENS OUT THE LOAD
+
+/**
+ * \brief A read only view of a whole file, mapped into memory.
+ *
+ * The file is closed and unmapped when the object goes away. An empty file opens fine and gives an empty range.
+ */
+class CMappedFile
+{
+public:
+    CMappedFile () = default;
+    ~CMappedFile ();
+    CMappedFile ( const CMappedFile & other ) = delete;
+    CMappedFile & operator= ( const CMappedFile & other ) = delete;
+    /**
+     * \brief Maps a file, closing the one mapped before.
+     * \return False when the file can not be opened or mapped.
+     */
+    bool Open ( const char * filename );
+    void Close ();
+    const char * Begin () const { return this->data_; }
+    const char * End () const { return this->data_ + this->size_; }
+    std::size_t Size () const { return this->size_; }
+private:
+    const char * data_ = nullptr;
+    std::size_t size_ = 0;
+#ifdef _WIN32
+    void * file_ = nullptr;
+    void * mapping_ = nullptr;
+#endif
+};
+
+/**
+ * \brief Everything read from an OBJ file, in the order of the file. Face indices are 1 based like in the file, 0 when a face leaves that element out.
+ */
+struct tObjMesh
+{
+    std::vector < tVector > vertices;
+    std::vector < tVector > normals;
+    std::vector < tVector > textures;		// u AND v, w IS ALWAYS 0
+    std::vector < t_faceIndex > faces;
+    /**
+     * \brief The file named by the last mtllib line, empty when there is none.
+     */
+    std::string materialLib;
+    /**
+     * \brief Faces with more than four vertices. Only their first three are kept.
+     */
+    int largeFaceCnt = 0;
+};
+
+/**
+ * \brief A single pass OBJ reader working straight on the mapped file.
+ *
+ * Lines are split in place with pointers into the mapping and the numbers are read with std::from_chars, so reading a line never allocates and
+ * there is no limit on its length. Only the lists of the mesh grow, geometrically, and they keep their capacity when the parser is reused.
+ * Negative (relative) face indices are turned into absolute ones.
+ *
+ * A large file is cut at line ends into chunks parsed at the same time by the thread pool, each into its own lists. Prefix sums over the list sizes
+ * then give every chunk its place in the whole mesh, and the chunks are copied there in parallel.
+ */
+class CObjParser
+{
+public:
+    /**
+     * \brief Maps a file and parses it.
+     * \return False when the file can not be opened.
+     */
+    bool Load ( const char * filename );
+    /**
+     * \brief Parses OBJ text held in memory. The mesh of the previous parse is replaced.
+     */
+    void Parse ( const char * begin , const char * end );
+    const tObjMesh & Mesh () const { return this->mesh_; }
+private:
+    /**
+     * \brief What one chunk read, and the faces with relative indices as (face, one bit per index) pairs.
+     */
+    struct tChunk
+    {
+        tObjMesh mesh;
+        std::vector < std::pair < int , int > > relativeFaces;
+    };
+    /**
+     * \brief Where a chunk goes in each list of the whole mesh.
+     */
+    struct tOffsets
+    {
+        std::size_t vertex , normal , texture , face;
+    };
+    void ParseChunk ( const char * begin , const char * end , tObjMesh & mesh , std::vector < std::pair < int , int > > & relativeFaces );
+    tObjMesh mesh_;
+    std::vector < tChunk > chunks_;
+    std::vector < const char * > cuts_;
+    std::vector < tOffsets > offsets_;
+};
+
+/**
+ * \brief Reads the colors, shininess and texture map of an MTL file into a visual, the same way LoadOBJ always has.
+ * \return False when the file can not be opened.
+ */
+bool ParseMaterialLib ( const char * filename , t_Visual * visual );
+
+#endif // !defined(OBJPARSER_H__INCLUDED_)
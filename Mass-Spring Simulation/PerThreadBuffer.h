@@ -0,0 +1,106 @@
+#if !defined(PERTHREADBUFFER_H__INCLUDED_)
+#define PERTHREADBUFFER_H__INCLUDED_
+
+#include <cstring>
+#include <vector>
+#include "ThreadPool.h"
+
+/**
+ * \brief A set of growable append-only streams, one per pool worker, that are gathered into one contiguous array once the parallel phase is over.
+ *
+ * Each worker only ever appends to its own stream so no locks are needed while filling. The streams keep their capacity between uses so after the first few steps filling them does not allocate.
+ * Items appended by one worker stay in the order they were appended, and the streams are laid out one after the other by Merge.
+ */
+template < typename T >
+class CPerThreadBuffer
+{
+    // PADDED SO TWO WORKERS NEVER WRITE TO THE SAME CACHE LINE WHEN GROWING THEIR STREAMS
+    struct alignas ( 64 ) tStream
+    {
+        std::vector < T > items;
+    };
+    std::vector < tStream > streams_;
+    std::vector < T > merged_;
+public:
+    /**
+     * \brief Empties every stream and makes sure there is one stream for each of the given number of workers.
+     * \param workerCount The number of workers that will be appending.
+     */
+    void Reset ( const int workerCount )
+    {
+        if ( static_cast < int > ( this->streams_.size () ) < workerCount )
+        {
+            this->streams_.resize ( workerCount );
+        }
+        for ( tStream & stream : this->streams_ )
+        {
+            stream.items.clear ();
+        }
+        this->merged_.clear ();
+    }
+    /**
+     * \brief The stream owned by a worker. Only that worker may touch it until Merge is called.
+     */
+    std::vector < T > & Stream ( const int worker )
+    {
+        return this->streams_ [ worker ].items;
+    }
+    /**
+     * \brief Lays out all the streams one after the other into a single array. Each stream is copied to its own offset, found by a prefix sum over the stream sizes.
+     */
+    void Merge ()
+    {
+        const int streamCount = static_cast < int > ( this->streams_.size () );
+        std::vector < std::size_t > offsets ( streamCount + 1 , 0 );
+        for ( int i = 0; i < streamCount; ++i )
+        {
+            offsets [ i + 1 ] = offsets [ i ] + this->streams_ [ i ].items.size ();
+        }
+        this->merged_.resize ( offsets [ streamCount ] );
+        T * merged = this->merged_.data ();
+        const auto copyStreams = [ this , &offsets , merged ] ( const int begin , const int end , int )
+        {
+            for ( int i = begin; i < end; ++i )
+            {
+                const std::vector < T > & items = this->streams_ [ i ].items;
+                if ( ! items.empty () )
+                {
+                    std::memcpy ( static_cast < void * > ( merged + offsets [ i ] ) , static_cast < const void * > ( items.data () ) , items.size () * sizeof ( T ) );
+                }
+            }
+        };
+        // ONLY WORTH WAKING THE POOL WHEN THERE IS A LOT TO COPY
+        if ( offsets [ streamCount ] * sizeof ( T ) > ( 1 << 20 ) )
+        {
+            CThreadPool::Instance ().ParallelFor ( streamCount , 1 , copyStreams );
+        }
+        else
+        {
+            copyStreams ( 0 , streamCount , 0 );
+        }
+    }
+    /**
+     * \brief The merged items. Only valid after Merge.
+     */
+    T * Data ()
+    {
+        return this->merged_.data ();
+    }
+    /**
+     * \brief The number of merged items. Only valid after Merge.
+     */
+    int Size () const
+    {
+        return static_cast < int > ( this->merged_.size () );
+    }
+    /**
+     * \brief Releases all the memory held by the streams.
+     */
+    void Free ()
+    {
+        std::vector < tStream > ().swap ( this->streams_ );
+        std::vector < T > ().swap ( this->merged_ );
+    }
+};
+
+#endif // !defined(PERTHREADBUFFER_H__INCLUDED_)
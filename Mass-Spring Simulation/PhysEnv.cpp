@@ -5,9 +5,9 @@
 #include <assert.h>
 #include <math.h>
 
+#include <algorithm>
 #include <cmath>
 #include <tuple>
-#include <iomanip>
 #include "Clothy.h"
 #include "PhysEnv.h"
 #include "SimProps.h"
@@ -15,6 +15,19 @@
 #include "AddSpher.h"
 
 #include "System.h"
+#include "CollisionKernel.h"
+#include "BoneColliders.h"
+#include "CCD.h"
+#include "SceneCache.h"
+#include "Snapshot.h"
+#include "TrajectoryRecorder.h"
+#include "TrajectoryPlayer.h"
+#include "PointCache.h"
+#include "FrameCapture.h"
+#include "SpringRenderer.h"
+#include "PickTree.h"
+#include "Profiler.h"
+#include "TextExporter.h"
 
 #ifdef _DEBUG
 #define new DEBUG_NEW
@@ -41,9 +54,10 @@ CPhysEnv::CPhysEnv()
 	for (int i = 0; i < 5; i++)
 		m_TempSys[i] = NULL;
 	m_ParticleCnt = 0;
-	m_Contact = NULL;
+	m_ContactCnt = 0;
 	m_Spring = NULL;
 	m_SpringCnt = 0;
+	m_SpringCapacity = 0;
 	m_MouseForceActive = FALSE;
 
 	m_UseGravity = TRUE;
@@ -69,8 +83,8 @@ CPhysEnv::CPhysEnv()
 	m_WorldSizeY = 15.0f;
 	m_WorldSizeZ = 15.0f;
 
-	m_CollisionPlane = (tCollisionPlane*)malloc(sizeof(tCollisionPlane) * 6);
-	m_CollisionPlaneCnt = 6;
+	m_CollisionPlane = (tCollisionPlane*)malloc(sizeof(tCollisionPlane) * WORLD_PLANE_CNT);
+	m_CollisionPlaneCnt = WORLD_PLANE_CNT;
 
 	// MAKE THE TOP PLANE (CEILING)
 	MAKEVECTOR(m_CollisionPlane[0].normal, 0.0f, -1.0f, 0.0f)
@@ -96,9 +110,30 @@ CPhysEnv::CPhysEnv()
 	MAKEVECTOR(m_CollisionPlane[5].normal, 0.0f, 0.0f, 1.0f)
 		m_CollisionPlane[5].d = m_WorldSizeZ / 2.0f;
 
+	m_Sphere = NULL;
 	m_SphereCnt = 0;
-    testFile.open ( testFileName , ios_base::out );    
-
+	m_Box = NULL;
+	m_BoxCnt = 0;
+	m_Capsule = NULL;
+	m_CapsuleCnt = 0;
+	m_BoneColliders = new CBoneColliders;
+	m_ScenePrevious = NULL;
+	m_SceneStepTime = 0.0f;
+	m_MeshColliders = new CMeshColliders;
+	m_MeshPrevious = NULL;
+	m_ImpactTime = 2.0f;
+	m_Recorder = new CTrajectoryRecorder;
+	m_RecordedFrames = 0;
+	m_RecordingNumber = 0;
+	m_RecordingName[0] = '\0';
+	m_PointCache = new CPointCacheWriter;
+	m_FrameCapture = new CFrameCapture;
+	m_SpringRenderer = new CSpringRenderer;
+	m_PickTree = new CPickTree;
+	m_Diagnostics = new CDiagnostics;
+	memset(&m_LastDiagnostics, 0, sizeof(m_LastDiagnostics));
+	m_DiagnosticsInterval = DIAGNOSTICS_EVERY;
+	m_StepsSinceDiagnostics = 0;
 }
 
 CPhysEnv::~CPhysEnv()
@@ -114,24 +149,192 @@ CPhysEnv::~CPhysEnv()
 		if (m_TempSys[i])
 			free(m_TempSys[i]);
 	}
-	if (m_Contact)
-		free(m_Contact);
 	free(m_CollisionPlane);
 	free(m_Spring);
 
 	free(m_Sphere);
+	free(m_Box);
+	free(m_Capsule);
+	delete m_BoneColliders;
+	delete m_MeshColliders;
+	delete m_Recorder;
+	delete m_PointCache;
+	delete m_FrameCapture;
+	delete m_SpringRenderer;
+	delete m_PickTree;
+	delete m_Diagnostics;
+}
 
-    if ( testFile.is_open () )
-    {
-        testFile.flush ();
-        testFile.close ();
-    }
+///////////////////////////////////////////////////////////////////////////////
+// Function:	DrawSpheres
+// Purpose:		Draws a list of collision spheres
+///////////////////////////////////////////////////////////////////////////////
+static void DrawSpheres(const tCollisionSphere* sphere, int sphereCnt)
+{
+	for (int loop = 0; loop < sphereCnt; loop++)
+	{
+		glPushMatrix();
+		glTranslatef(sphere[loop].pos.x, sphere[loop].pos.y, sphere[loop].pos.z);
+		glScalef(sphere[loop].radius, sphere[loop].radius, sphere[loop].radius);
+		glCallList(OGL_AXIS_DLIST);
+		glPopMatrix();
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Function:	DrawBoxes
+// Purpose:		Draws a list of collision boxes in wireframe
+///////////////////////////////////////////////////////////////////////////////
+static void DrawBoxes(const tCollisionBox* box, int boxCnt)
+{
+	if (boxCnt <= 0)
+		return;
+	glBegin(GL_LINES);
+	for (int loop = 0; loop < boxCnt; loop++)
+	{
+		tVector corner[8];
+		// CORNER i IS ON THE POSITIVE SIDE OF AXIS a WHEN BIT a OF i IS SET
+		for (int i = 0; i < 8; i++)
+		{
+			corner[i] = box[loop].center;
+			for (int a = 0; a < 3; a++)
+			{
+				float extent = (&box[loop].halfSize.x)[a] * ((i >> a) & 1 ? 1.0f : -1.0f);
+				corner[i].x += box[loop].axis[a].x * extent;
+				corner[i].y += box[loop].axis[a].y * extent;
+				corner[i].z += box[loop].axis[a].z * extent;
+			}
+		}
+		// AN EDGE JOINS EVERY PAIR OF CORNERS THAT DIFFER IN ONE BIT
+		for (int i = 0; i < 8; i++)
+		{
+			for (int a = 0; a < 3; a++)
+			{
+				if ((i >> a) & 1)
+					continue;
+				glVertex3fv((float*)&corner[i]);
+				glVertex3fv((float*)&corner[i | (1 << a)]);
+			}
+		}
+	}
+	glEnd();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Function:	DrawCapsules
+// Purpose:		Draws a list of collision capsules as their center segment
+//				with the end caps drawn like the spheres
+///////////////////////////////////////////////////////////////////////////////
+static void DrawCapsules(const tCollisionCapsule* capsule, int capsuleCnt)
+{
+	for (int loop = 0; loop < capsuleCnt; loop++)
+	{
+		glBegin(GL_LINES);
+		glVertex3fv((float*)&capsule[loop].p1);
+		glVertex3fv((float*)&capsule[loop].p2);
+		glEnd();
+		tCollisionSphere caps[2];
+		caps[0].pos = capsule[loop].p1;
+		caps[1].pos = capsule[loop].p2;
+		caps[0].radius = caps[1].radius = capsule[loop].radius;
+		DrawSpheres(caps, 2);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Function:	DrawMeshes
+// Purpose:		Draws the edges of the collision meshes where the last step
+//				left them
+///////////////////////////////////////////////////////////////////////////////
+static void DrawMeshes(const CMeshColliders* meshes)
+{
+	glBegin(GL_LINES);
+	for (int loop = 0; loop < meshes->MeshCount(); loop++)
+	{
+		const tCollisionMesh& mesh = meshes->Mesh(loop);
+		for (int edge = 0; edge < (int)mesh.edges.size(); edge++)
+			glVertex3fv((float*)&mesh.stepEnd[mesh.edges[edge]]);
+	}
+	glEnd();
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Function:	PositionStream
+// Purpose:		Hands the positions of the particles to the renderers
+// Notes:		The renderers read the particles where they are, stepping over
+//				the rest of each particle. Only the spring renderer packs the
+//				positions, for the card. Only good until the system is
+//				replaced, so ask every frame
+///////////////////////////////////////////////////////////////////////////////
+tVertexStream CPhysEnv::PositionStream() const
+{
+/// Local Variables ///////////////////////////////////////////////////////////
+	tVertexStream	stream;
+///////////////////////////////////////////////////////////////////////////////
+	stream.positions = m_CurrentSys ? &m_CurrentSys->pos.x : NULL;
+	stream.stride = sizeof(tParticle);
+	stream.count = m_CurrentSys ? m_ParticleCnt : 0;
+	return stream;
+}
+////// PositionStream //////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Function:	SpringCount
+// Purpose:		Number of springs in the system, for reports
+///////////////////////////////////////////////////////////////////////////////
+int CPhysEnv::SpringCount() const
+{
+	return m_SpringCnt;
+}
+////// SpringCount /////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Function:	Diagnostics
+// Purpose:		Energy, momentum, centroid and strain of the system as last
+//				sampled by Simulate
+// Notes:		All zero until the first sample of a system
+///////////////////////////////////////////////////////////////////////////////
+const tDiagnostics & CPhysEnv::Diagnostics() const
+{
+	return m_LastDiagnostics;
+}
+////// Diagnostics /////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Function:	SetDiagnosticsInterval
+// Purpose:		How often Simulate samples the diagnostics
+// Arguments:	Successful steps between two samples, 0 to stop sampling
+///////////////////////////////////////////////////////////////////////////////
+void CPhysEnv::SetDiagnosticsInterval(int steps)
+{
+	m_DiagnosticsInterval = std::max(steps, 0);
+	m_StepsSinceDiagnostics = 0;
+}
+////// SetDiagnosticsInterval //////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Function:	SetCaptureView
+// Purpose:		Sees the captured frames from the camera of the window
+// Arguments:	Modelview matrix the world is drawn with
+// Notes:		Without a window the frames keep the starting camera
+///////////////////////////////////////////////////////////////////////////////
+void CPhysEnv::SetCaptureView(tMatrix *modelView)
+{
+	m_FrameCapture->SetView(*modelView);
+}
+////// SetCaptureView //////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Function:	RenderWorld
+// Purpose:		Draws the world box, the springs and the particles
+// Notes:		The positions go to the card once per frame and each type of
+//				spring is a single draw call, see CSpringRenderer
+///////////////////////////////////////////////////////////////////////////////
 void CPhysEnv::RenderWorld()
 {
-	tParticle* tempParticle;
-	tSpring* tempSpring;
+/// Local Variables ///////////////////////////////////////////////////////////
+	bool	show[SPRING_TYPE_CNT];
+///////////////////////////////////////////////////////////////////////////////
 
 	// FIRST DRAW THE WORLD CONTAINER  
 	glColor3f(1.0f, 1.0f, 1.0f);
@@ -170,147 +373,85 @@ void CPhysEnv::RenderWorld()
 
 	if (m_ParticleSys)
 	{
+		if ((m_Spring && m_DrawSprings) || m_DrawVertices)
+			m_SpringRenderer->Upload(PositionStream());
 		if (m_Spring && m_DrawSprings)
 		{
-			glBegin(GL_LINES);
+			// MANUAL SPRINGS ARE ALWAYS SHOWN, THE CLOTH ONES WHEN ASKED FOR
+			show[MANUAL_SPRING] = true;
+			show[STRUCTURAL_SPRING] = m_DrawStructural != FALSE;
+			show[SHEAR_SPRING] = m_DrawShear != FALSE;
+			show[BEND_SPRING] = m_DrawBend != FALSE;
 			glColor3f(0.0f, 0.8f, 0.8f);
-			tempSpring = m_Spring;
-			for (int loop = 0; loop < m_SpringCnt; loop++)
-			{
-				// Only draw normal springs or the cloth "structural" ones
-				if ((tempSpring->type == MANUAL_SPRING) ||
-					(tempSpring->type == STRUCTURAL_SPRING && m_DrawStructural) ||
-					(tempSpring->type == SHEAR_SPRING && m_DrawShear) ||
-					(tempSpring->type == BEND_SPRING && m_DrawBend))
-				{
-					glVertex3fv((float*)&m_CurrentSys[tempSpring->p1].pos);
-					glVertex3fv((float*)&m_CurrentSys[tempSpring->p2].pos);
-				}
-				tempSpring++;
-			}
+			m_SpringRenderer->DrawSprings(m_Spring, m_SpringCnt, show);
 			if (m_MouseForceActive)	// DRAW MOUSESPRING FORCE
 			{
+				glBegin(GL_LINES);
+				glColor3f(0.8f, 0.0f, 0.8f);
 				if (m_Pick[0] > -1)
 				{
-					glColor3f(0.8f, 0.0f, 0.8f);
 					glVertex3fv((float*)&m_CurrentSys[m_Pick[0]].pos);
 					glVertex3fv((float*)&m_MouseDragPos[0]);
 				}
 				if (m_Pick[1] > -1)
 				{
-					glColor3f(0.8f, 0.0f, 0.8f);
 					glVertex3fv((float*)&m_CurrentSys[m_Pick[1]].pos);
 					glVertex3fv((float*)&m_MouseDragPos[1]);
 				}
+				glEnd();
 			}
-			glEnd();
 		}
 		if (m_DrawVertices)
 		{
+			glColor3f(0.8f, 0.8f, 0.0f);
+			m_SpringRenderer->DrawPoints();
+			// THE PICKED POINTS GO OVER THE OTHERS, THE DEPTH TEST LETS EQUAL DEPTHS THROUGH
 			glBegin(GL_POINTS);
-			tempParticle = m_CurrentSys;
-			for (int loop = 0; loop < m_ParticleCnt; loop++)
+			if (m_Pick[0] > -1)
+			{
+				glColor3f(0.0f, 0.8f, 0.0f);
+				glVertex3fv((float*)&m_CurrentSys[m_Pick[0]].pos);
+			}
+			if (m_Pick[1] > -1 && m_Pick[1] != m_Pick[0])
 			{
-				if (loop == m_Pick[0])
-					glColor3f(0.0f, 0.8f, 0.0f);
-				else if (loop == m_Pick[1])
-					glColor3f(0.8f, 0.0f, 0.0f);
-				else
-					glColor3f(0.8f, 0.8f, 0.0f);
-				glVertex3fv((float*)&tempParticle->pos);
-				tempParticle++;
+				glColor3f(0.8f, 0.0f, 0.0f);
+				glVertex3fv((float*)&m_CurrentSys[m_Pick[1]].pos);
 			}
 			glEnd();
 		}
 	}
 
-	if (m_SphereCnt > 0 && m_CollisionActive)
+	if (m_CollisionActive)
 	{
 		glColor3f(0.5f, 0.0f, 0.0f);
-		for (int loop = 0; loop < m_SphereCnt; loop++)
+		DrawSpheres(m_Sphere, m_SphereCnt);
+		DrawBoxes(m_Box, m_BoxCnt);
+		DrawCapsules(m_Capsule, m_CapsuleCnt);
+		// THE BONE COLLIDERS ARE AT THE END OF THE SCENE LISTS, WHERE THE LAST STEP PUT THEM
+		if (!m_BoneColliders->Empty() && (int)m_SceneSphere.size() >= m_SphereCnt &&
+			(int)m_SceneBox.size() >= m_BoxCnt && (int)m_SceneCapsule.size() >= m_CapsuleCnt)
 		{
-			glPushMatrix();
-			glTranslatef(m_Sphere[loop].pos.x, m_Sphere[loop].pos.y, m_Sphere[loop].pos.z);
-			glScalef(m_Sphere[loop].radius, m_Sphere[loop].radius, m_Sphere[loop].radius);
-			glCallList(OGL_AXIS_DLIST);
-			glPopMatrix();
+			DrawSpheres(m_SceneSphere.data() + m_SphereCnt, (int)m_SceneSphere.size() - m_SphereCnt);
+			DrawBoxes(m_SceneBox.data() + m_BoxCnt, (int)m_SceneBox.size() - m_BoxCnt);
+			DrawCapsules(m_SceneCapsule.data() + m_CapsuleCnt, (int)m_SceneCapsule.size() - m_CapsuleCnt);
 		}
+		DrawMeshes(m_MeshColliders);
 	}
 }
 
-void CPhysEnv::GetNearestPoint(int x, int y)
-{
-	/// Local Variables ///////////////////////////////////////////////////////////
-	float* feedBuffer;
-	int hitCount;
-	tParticle* tempParticle;
-	int loop;
-	///////////////////////////////////////////////////////////////////////////////
-		// INITIALIZE A PLACE TO PUT ALL THE FEEDBACK INFO (3 DATA, 1 TAG, 2 TOKENS)
-	feedBuffer = (float*)malloc(sizeof(GLfloat) * m_ParticleCnt * 6);
-	// TELL OPENGL ABOUT THE BUFFER
-	glFeedbackBuffer(m_ParticleCnt * 6, GL_3D, feedBuffer);
-	(void)glRenderMode(GL_FEEDBACK);	// SET IT IN FEEDBACK MODE
-
-	tempParticle = m_CurrentSys;
-	for (loop = 0; loop < m_ParticleCnt; loop++)
-	{
-		// PASS THROUGH A MARKET LETTING ME KNOW WHAT VERTEX IT WAS
-		glPassThrough((float)loop);
-		// SEND THE VERTEX
-		glBegin(GL_POINTS);
-		glVertex3fv((float*)&tempParticle->pos);
-		glEnd();
-		tempParticle++;
-	}
-	hitCount = glRenderMode(GL_RENDER); // HOW MANY HITS DID I GET
-	//fout<<"hit count "<<hitCount<,endl;
-
-	CompareBuffer(hitCount, feedBuffer, (float)x, (float)y);		// CHECK THE HIT 
-	free(feedBuffer);		// GET RID OF THE MEMORY
-}
-
 ///////////////////////////////////////////////////////////////////////////////
-// Function:	CompareBuffer
-// Purpose:		Check the feedback buffer to see if anything is hit
-// Arguments:	Number of hits, pointer to buffer, point to test
+// Function:	GetNearestPoint
+// Purpose:		Picks the particle drawn nearest to a point of the window
+// Arguments:	Point in window coordinates, matrices and viewport it is drawn with
+// Notes:		Done on the CPU with CPickTree, nothing goes through OpenGL
 ///////////////////////////////////////////////////////////////////////////////
-void CPhysEnv::CompareBuffer(int size, float* buffer, float x, float y)
+void CPhysEnv::GetNearestPoint(int x, int y, tMatrix *modelView, tMatrix *projection, int *viewport)
 {
 	/// Local Variables ///////////////////////////////////////////////////////////
-	GLint count;
-	GLfloat token, point[3];
-	int loop, currentVertex, result = -1;
-	long nearest = -1, dist;
+	int result;
 	///////////////////////////////////////////////////////////////////////////////
-	count = size;
-	while (count)
-	{
-		token = buffer[size - count];	// CHECK THE TOKEN
-		count--;
-		if (token == GL_PASS_THROUGH_TOKEN)	// VERTEX MARKER
-		{
-			currentVertex = (int)buffer[size - count]; // WHAT VERTEX
-			count--;
-		}
-		else if (token == GL_POINT_TOKEN)
-		{
-			// THERE ARE THREE ELEMENTS TO A POINT TOKEN
-			for (loop = 0; loop < 3; loop++)
-			{
-				point[loop] = buffer[size - count];
-				count--;
-			}
-			dist = ((x - point[0]) * (x - point[0])) + ((y - point[1]) * (y - point[1]));
-			if (result == -1 || dist < nearest)
-			{
-				nearest = dist;
-				result = currentVertex;
-			}
-		}
-	}
-
-	if (nearest < 50.0f)
+	result = m_PickTree->Pick(m_CurrentSys, m_ParticleCnt, (float)x, (float)y, *modelView, *projection, viewport);
+	if (result > -1)
 	{
 		if (m_Pick[0] == -1)
 			m_Pick[0] = result;
@@ -323,30 +464,7 @@ void CPhysEnv::CompareBuffer(int size, float* buffer, float x, float y)
 		}
 	}
 }
-////// CompareBuffer //////////////////////////////////////////////////////////
-std::string CPhysEnv::ParticleCsvLine ( tParticle * particle )
-{
-    std::stringstream ss;
-    ss << std::showpos << std::setprecision ( 10 );
-    ss << particle->pos.x;
-    ss << ",";
-    ss << particle->pos.y;
-    ss << ",";
-    ss << particle->pos.z;
-    ss << ",";
-    ss << particle->v.x;
-    ss << ",";
-    ss << particle->v.y;
-    ss << ",";
-    ss << particle->v.z;
-    ss << ",";
-    ss << particle->f.x;
-    ss << ",";
-    ss << particle->f.y;
-    ss << ",";
-    ss << particle->f.z;
-    return ss.str ();
-}
+////// GetNearestPoint ////////////////////////////////////////////////////////
 //std::tuple < float , float , float > CPhysEnv::CalculateError ( bool reverse ) const
 //{
 //    if ( ! OUTPUT_TO_FILE )
@@ -463,7 +581,13 @@ std::string CPhysEnv::ParticleCsvLine ( tParticle * particle )
 //        forceRelativeApproximateError
 //    };
 //}
-std::tuple < float , float , float > CPhysEnv::CalculateError ( bool reverse ) const
+/**
+ * \brief The lengths of the mean position, velocity and force of the current particles, logged with each frame.
+ *
+ * These follow the state of the system but are not an error, since there is nothing to compare with here. The error of an integrator
+ * against a fine reference is measured by Benchmark --accuracy.
+ */
+std::tuple < float , float , float > CPhysEnv::CalculateError () const
 {
     if ( ! OUTPUT_TO_FILE )
     {
@@ -473,49 +597,13 @@ std::tuple < float , float , float > CPhysEnv::CalculateError ( bool reverse ) c
             0
         };
     }
-    tParticle* target;
-    tParticle* current;
-    if ( reverse )
-    {
-        current = m_TargetSys;
-        target = m_CurrentSys;
-    }
-    else
-    {
-        current = m_CurrentSys;
-        target = m_TargetSys;
-    }
-    float posX = 0.0f;
-    float posY = 0.0f;
-    float posZ = 0.0f;
-    for ( int i = 0; i < this->m_ParticleCnt; ++i )
-    {
-        posX += current [ i ].pos.x;
-        posY += current [ i ].pos.y;
-        posZ += current [ i ].pos.z;
-    }
-    float averagePosition = std::sqrt ( std::pow ( posX / m_ParticleCnt , 2 ) + std::pow ( posY / m_ParticleCnt , 2 ) + std::pow ( posZ / m_ParticleCnt , 2 ) );
-    /* Calculate average error for velocities over all the particles and dimensions */
-    float vX = 0.0f;
-    float vY = 0.0f;
-    float vZ = 0.0f;
-    for ( int i = 0; i < this->m_ParticleCnt; ++i )
-    {
-        vX += current [ i ].v.x;
-        vY += current [ i ].v.y;
-        vZ += current [ i ].v.z;
-    }
-    float averageVelocity = std::sqrt ( std::pow ( vX / m_ParticleCnt , 2 ) + std::pow ( vY / m_ParticleCnt , 2 ) + std::pow ( vZ / m_ParticleCnt , 2 ) );
-    float fX = 0.0f;
-    float fY = 0.0f;
-    float fZ = 0.0f;
-    for ( int i = 0; i < this->m_ParticleCnt; ++i )
-    {
-        fX += current [ i ].f.x;
-        fY += current [ i ].f.y;
-        fZ += current [ i ].f.z;
-    }
-    float averageForce = std::sqrt ( std::pow ( fX / m_ParticleCnt , 2 ) + std::pow ( fY / m_ParticleCnt , 2 ) + std::pow ( fZ / m_ParticleCnt , 2 ) );
+    // ONE PASS OVER THE PARTICLES FOR THE THREE MEANS. WITHOUT SPRINGS AND GRAVITY THE ENERGIES ARE LEFT OUT, SO THE SPRING PASS OF THE
+    // SAMPLED DIAGNOSTICS IS NOT PAID ON EVERY RECORDED FRAME
+    tDiagnostics diagnostics;
+    m_Diagnostics->Compute ( m_CurrentSys , m_ParticleCnt , NULL , 0 , NULL , diagnostics );
+    const float averagePosition = VectorLength ( &diagnostics.centroid );
+    const float averageVelocity = VectorLength ( &diagnostics.meanVelocity );
+    const float averageForce = VectorLength ( &diagnostics.meanForce );
     /* Return the result as a tuple */
     return {
         averagePosition ,
@@ -523,42 +611,150 @@ std::tuple < float , float , float > CPhysEnv::CalculateError ( bool reverse ) c
         averageForce
     };
 }
-void CPhysEnv::OutputErrorToCsV ( std::tuple < float , float , float > error , float time )
-{
-    std::stringstream ss;
-    ss << std::showpos << std::setprecision ( std::numeric_limits < float >::digits + 1 );
-    ss << std::get < 0 > ( error );
-    ss << ",";
-    ss << std::get < 1 > ( error );
-    ss << ",";
-    ss << std::get < 2 > ( error );
-    ss << ",";
-    ss << time;
-    ss << ",";
-    switch ( m_IntegratorType )
-    {
-        case EULER_INTEGRATOR: ss << "EULER";
-            break;
-        case MIDPOINT_INTEGRATOR: ss << "MIDPOINT";
-            break;
-        case HEUN_INTEGRATOR: ss << "HEUN";
-            break;
-        case RK4_INTEGRATOR: ss << "RK4";
-            break;
-        case RK5_INTEGRATOR: ss << "RK5";
-            break;
-        case RK4_ADAPTIVE_INTEGRATOR: ss << "RK4_ADAPTIVE";
-            break;
-        default: ss << "DEFAULT";
-    }
-    ss << '\n';
-    testFile << ss.rdbuf ();
 
+///////////////////////////////////////////////////////////////////////////////
+// Function:	RecordFrame
+// Purpose:		Hands the state after a step to the trajectory recorder,
+//				the point cache and the frame capture
+// Arguments:	Simulation time of the step
+// Notes:		All of them write on their own thread, so all this does on
+//				the simulation thread is measure the error and copy the
+//				particles. A new recording starts with each new system.
+//				The particles are in the order of the OBJ vertices, so
+//				the cache needs no map back to them. The caller opens the
+//				profile frame around the step and this, as it does for
+//				Simulate
+///////////////////////////////////////////////////////////////////////////////
+void CPhysEnv::RecordFrame(float time)
+{
+	/// Local Variables ///////////////////////////////////////////////////////////
+	tTrajectoryFrame	frame;
+	tVector				worldSize;
+	///////////////////////////////////////////////////////////////////////////////
+	PROFILE_SCOPE(PHASE_RECORD);
+	if (m_ParticleCnt == 0)
+		return;
+	if (OUTPUT_POINT_CACHE && (m_PointCache->IsOpen() || m_PointCache->Open(pointCacheFileName, m_ParticleCnt, m_ParticleCnt, NULL)))
+		m_PointCache->Capture(time, m_CurrentSys);
+	if (OUTPUT_FRAMES && (m_FrameCapture->IsOpen() || m_FrameCapture->Open(frameFileName, CAPTURE_WIDTH, CAPTURE_HEIGHT)))
+	{
+		MAKEVECTOR(worldSize, m_WorldSizeX, m_WorldSizeY, m_WorldSizeZ);
+		m_FrameCapture->Capture(time, PositionStream(), m_Spring, m_SpringCnt, worldSize);
+	}
+	if (!OUTPUT_TO_FILE)
+		return;
+	if (!m_Recorder->IsOpen() && !m_Recorder->Open(NextRecordingName(), m_ParticleCnt))
+		return;
+	const auto error = CalculateError();	// THE PARTICLES RECORDED BELOW
+	frame.index = m_RecordedFrames++;
+	frame.time = time;
+	frame.integrator = m_IntegratorType;
+	frame.error[0] = std::get<0>(error);
+	frame.error[1] = std::get<1>(error);
+	frame.error[2] = std::get<2>(error);
+	m_Recorder->Record(frame, m_CurrentSys);
 }
-void CPhysEnv::SetWorldParticles(tTexturedVertex* coords, int particleCnt)
+////// RecordFrame /////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Function:	NextRecordingName
+// Purpose:		Names the file of a new recording
+// Notes:		The files are numbered, and a name already on disk is
+//				skipped, so a recording never replaces another one. That
+//				includes one kept from an earlier run of the program
+///////////////////////////////////////////////////////////////////////////////
+const char *CPhysEnv::NextRecordingName()
 {
-	tParticle* tempParticle;
+	/// Local Variables ///////////////////////////////////////////////////////////
+	FILE	*fp;
+	///////////////////////////////////////////////////////////////////////////////
+	for (;;)
+	{
+		sprintf(m_RecordingName, trajectoryFileName, m_RecordingNumber);
+		fp = fopen(m_RecordingName, "rb");
+		if (fp == NULL)
+			return m_RecordingName;
+		fclose(fp);
+		m_RecordingNumber++;
+	}
+}
+////// NextRecordingName ///////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Function:	StopRecording
+// Purpose:		Ends the recording, point cache and frame capture under
+//				way so their files can be read
+// Notes:		The next recorded frame starts new files
+///////////////////////////////////////////////////////////////////////////////
+void CPhysEnv::StopRecording()
+{
+	m_Recorder->Close();
+	m_PointCache->Close();
+	m_FrameCapture->Close();
+	m_RecordedFrames = 0;
+}
+////// StopRecording ///////////////////////////////////////////////////////////
 
+///////////////////////////////////////////////////////////////////////////////
+// Function:	RecordingName
+// Purpose:		The file of the last recording started, empty before any
+///////////////////////////////////////////////////////////////////////////////
+const char *CPhysEnv::RecordingName() const
+{
+	return m_RecordingName;
+}
+////// RecordingName ///////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Function:	ReplayFrame
+// Purpose:		Shows a recorded frame instead of a simulated one
+// Arguments:	Player of the recording, frame to show
+// Notes:		The recording has to be of this system. Both buffers get
+//				the frame, so simulating again goes on from it
+///////////////////////////////////////////////////////////////////////////////
+BOOL CPhysEnv::ReplayFrame(CTrajectoryPlayer *player, int frame)
+{
+	if (player->ParticleCount() != m_ParticleCnt || !player->Seek(frame))
+		return FALSE;
+	player->Apply(m_CurrentSys);
+	memcpy(m_TargetSys, m_CurrentSys, sizeof(tParticle) * m_ParticleCnt);
+	return TRUE;
+}
+////// ReplayFrame /////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Function:	ExportParticles
+// Purpose:		Writes the system as it is to a CSV file, a line per
+//				particle with its position, velocity and force
+// Arguments:	File to write
+// Notes:		The forces are evaluated for the state written, the ones a
+//				step leaves behind can be those of a stage of the integrator
+// Returns:		FALSE when the file could not be written
+///////////////////////////////////////////////////////////////////////////////
+BOOL CPhysEnv::ExportParticles(const char *filename)
+{
+	/// Local Variables ///////////////////////////////////////////////////////////
+	CTextExporter	exporter;
+	///////////////////////////////////////////////////////////////////////////////
+	if (!exporter.Open(filename))
+		return FALSE;
+	if (m_ParticleCnt > 0)
+	{
+		ComputeForces(m_CurrentSys);
+		exporter.PutParticles(m_CurrentSys, m_ParticleCnt);
+	}
+	return exporter.Close();
+}
+////// ExportParticles /////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+// Function:	AllocateSystem
+// Purpose:		Replaces the particle buffers with ones for a new count
+// Notes:		The contents are left for the caller to fill
+///////////////////////////////////////////////////////////////////////////////
+void CPhysEnv::AllocateSystem(int particleCnt)
+{
+	// THE RECORDING OF THE OLD SYSTEM ENDS WITH IT
+	StopRecording();
 	if (m_ParticleSys[0])
 		free(m_ParticleSys[0]);
 	if (m_ParticleSys[1])
@@ -570,8 +766,6 @@ void CPhysEnv::SetWorldParticles(tTexturedVertex* coords, int particleCnt)
 		if (m_TempSys[i])
 			free(m_TempSys[i]);
 	}
-	if (m_Contact)
-		free(m_Contact);
 	// THE SYSTEM IS DOUBLE BUFFERED TO MAKE THINGS EASIER
 	m_CurrentSys = (tParticle*)malloc(sizeof(tParticle) * particleCnt);
 	m_TargetSys = (tParticle*)malloc(sizeof(tParticle) * particleCnt);
@@ -581,11 +775,22 @@ void CPhysEnv::SetWorldParticles(tTexturedVertex* coords, int particleCnt)
 	{
 		m_TempSys[i] = (tParticle*)malloc(sizeof(tParticle) * particleCnt);
 	}
+	m_ParticleSys[0] = m_CurrentSys;
+	m_ParticleSys[1] = m_TargetSys;
 	m_ParticleCnt = particleCnt;
+	m_PickTree->Invalidate();		// THE NEW PARTICLES ARE GROUPED AT THE NEXT PICK
 
-	// MULTIPLIED PARTICLE COUNT * 2 SINCE THEY CAN COLLIDE WITH MULTIPLE WALLS
-	m_Contact = (tContact*)malloc(sizeof(tContact) * particleCnt * 2);
+	// THE CONTACT STREAMS GROW ON DEMAND SINCE A PARTICLE CAN TOUCH ANY NUMBER OF WALLS AND SPHERES
+	m_Contact.Reset(CThreadPool::Instance().WorkerCount());
 	m_ContactCnt = 0;
+}
+////// AllocateSystem //////////////////////////////////////////////////////////
+
+void CPhysEnv::SetWorldParticles(tTexturedVertex* coords, int particleCnt)
+{
+	tParticle* tempParticle;
+
+	AllocateSystem(particleCnt);
 
 	tempParticle = m_CurrentSys;
 	for (int loop = 0; loop < particleCnt; loop++)
@@ -602,9 +807,6 @@ void CPhysEnv::SetWorldParticles(tTexturedVertex* coords, int particleCnt)
 	memcpy(m_TargetSys, m_CurrentSys, sizeof(tParticle) * particleCnt);
 	// COPY THE SYSTEM TO THE RESET BUFFER ALSO
 	memcpy(m_ParticleSys[2], m_CurrentSys, sizeof(tParticle) * particleCnt);
-
-	m_ParticleSys[0] = m_CurrentSys;
-	m_ParticleSys[1] = m_TargetSys;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -638,79 +840,518 @@ void CPhysEnv::FreeSystem()
 			m_TempSys[i] = NULL;	// RESET BUFFER
 		}
 	}
-	if (m_Contact)
-	{
-		free(m_Contact);
-		m_Contact = NULL;
-	}
+	m_Contact.Free();
+	m_ContactCnt = 0;
 	if (m_Spring)
 	{
 		free(m_Spring);
 		m_Spring = NULL;
 	}
 	m_SpringCnt = 0;
+	m_SpringCapacity = 0;
+	m_SpringRenderer->Invalidate();
+	m_FrameCapture->Invalidate();
 	m_ParticleCnt = 0;
+	memset(&m_LastDiagnostics, 0, sizeof(m_LastDiagnostics));
+	m_StepsSinceDiagnostics = 0;
+	StopRecording();
+	// THE BONES GO AWAY WITH THE SYSTEM, AND THE MESHES THAT MAY FOLLOW THEM
+	m_BoneColliders->Clear();
+	m_MeshColliders->Clear();
 }
 ////// FreeSystem //////////////////////////////////////////////////////////////
 
-void CPhysEnv::LoadData(FILE* fp)
-{
-	fread(&m_UseGravity, sizeof(BOOL), 1, fp);
-	fread(&m_UseDamping, sizeof(BOOL), 1, fp);
-	fread(&m_UserForceActive, sizeof(BOOL), 1, fp);
-	fread(&m_Gravity, sizeof(tVector), 1, fp);
-	fread(&m_UserForce, sizeof(tVector), 1, fp);
-	fread(&m_UserForceMag, sizeof(float), 1, fp);
-	fread(&m_Kd, sizeof(float), 1, fp);
-	fread(&m_Kr, sizeof(float), 1, fp);
-	fread(&m_Ksh, sizeof(float), 1, fp);
-	fread(&m_Ksd, sizeof(float), 1, fp);
-	fread(&m_ParticleCnt, sizeof(int), 1, fp);
-	m_CurrentSys = (tParticle*)malloc(sizeof(tParticle) * m_ParticleCnt);
-	m_TargetSys = (tParticle*)malloc(sizeof(tParticle) * m_ParticleCnt);
-	m_ParticleSys[2] = (tParticle*)malloc(sizeof(tParticle) * m_ParticleCnt);
-	for (int i = 0; i < 5; i++)
+// EVERY RECORD IS STORED AS ITS 4 BYTE FIELDS IN ORDER, THE SAME WAY THE OLD
+// 32 BIT FILES HAVE THEM, SO THE STRUCTURES MUST NOT HAVE ANY PADDING
+static_assert(sizeof(tParticle) == 10 * 4, "tParticle is stored as 10 words");
+static_assert(sizeof(tSpring) == 6 * 4, "tSpring is stored as 6 words");
+static_assert(sizeof(tCollisionPlane) == 4 * 4, "tCollisionPlane is stored as 4 words");
+static_assert(sizeof(tCollisionSphere) == 4 * 4, "tCollisionSphere is stored as 4 words");
+static_assert(sizeof(tCollisionBox) == 15 * 4, "tCollisionBox is stored as 15 words");
+static_assert(sizeof(tCollisionCapsule) == 7 * 4, "tCollisionCapsule is stored as 7 words");
+static_assert(sizeof(tVector) == 3 * 4, "tVector is stored as 3 words");
+
+#define PARAMS_RECORD_SIZE	(3 * 4 + 2 * 12 + 5 * 4 + 3 * 4)	// FLAGS, FORCES, CONSTANTS, INTEGRATOR AND PICKS
+
+// TAG IN FRONT OF THE EXTRA COLLIDERS IN OLD FILES. THE OLDEST END RIGHT AFTER THE SPHERES
+static const char COLLIDER_TAG[4] = { 'C', 'O', 'L', 'D' };
+#define COLLIDER_VERSION	1
+
+///////////////////////////////////////////////////////////////////////////////
+// Function:	PutRecords
+// Purpose:		Writes a counted list of records as one chunk
+///////////////////////////////////////////////////////////////////////////////
+static void PutRecords(CSnapshotWriter& writer, std::uint32_t tag, const void* records, size_t size, int count)
+{
+	writer.BeginChunk(tag, 4 + (std::uint64_t)size * count);
+	writer.PutI32(count);
+	writer.PutWords(records, size * count, 4);
+	writer.EndChunk();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Function:	GetRecords
+// Purpose:		Reads a counted list of records
+// Arguments:	Cursor on the count, record size, count read
+// Returns:		The records in a malloc'd list, NULL with a count of 0 when
+//				the list is empty or does not fit in what is left
+///////////////////////////////////////////////////////////////////////////////
+static void* GetRecords(CSnapshotCursor& cursor, size_t size, int& count)
+{
+	/// Local Variables ///////////////////////////////////////////////////////////
+	void	*records;
+	///////////////////////////////////////////////////////////////////////////////
+	count = cursor.GetI32();
+	if (count <= 0 || !cursor.Has(count, size))
 	{
-		m_TempSys[i] = (tParticle*)malloc(sizeof(tParticle) * m_ParticleCnt);
+		if (count != 0)
+			cursor.Fail();
+		count = 0;
+		return NULL;
 	}
-	m_ParticleSys[0] = m_CurrentSys;
-	m_ParticleSys[1] = m_TargetSys;
-	m_Contact = (tContact*)malloc(sizeof(tContact) * m_ParticleCnt);
-	fread(m_ParticleSys[0], sizeof(tParticle), m_ParticleCnt, fp);
-	fread(m_ParticleSys[1], sizeof(tParticle), m_ParticleCnt, fp);
-	fread(m_ParticleSys[2], sizeof(tParticle), m_ParticleCnt, fp);
-	fread(&m_SpringCnt, sizeof(int), 1, fp);
-	m_Spring = (tSpring*)malloc(sizeof(tSpring) * (m_SpringCnt));
-	fread(m_Spring, sizeof(tSpring), m_SpringCnt, fp);
-	fread(m_Pick, sizeof(int), 2, fp);
-	fread(&m_SphereCnt, sizeof(int), 1, fp);
-	m_Sphere = (tCollisionSphere*)malloc(sizeof(tCollisionSphere) * (m_SphereCnt));
-	fread(m_Sphere, sizeof(tCollisionSphere), m_SphereCnt, fp);
-}
-
-void CPhysEnv::SaveData(FILE* fp)
-{
-	fwrite(&m_UseGravity, sizeof(BOOL), 1, fp);
-	fwrite(&m_UseDamping, sizeof(BOOL), 1, fp);
-	fwrite(&m_UserForceActive, sizeof(BOOL), 1, fp);
-	fwrite(&m_Gravity, sizeof(tVector), 1, fp);
-	fwrite(&m_UserForce, sizeof(tVector), 1, fp);
-	fwrite(&m_UserForceMag, sizeof(float), 1, fp);
-	fwrite(&m_Kd, sizeof(float), 1, fp);
-	fwrite(&m_Kr, sizeof(float), 1, fp);
-	fwrite(&m_Ksh, sizeof(float), 1, fp);
-	fwrite(&m_Ksd, sizeof(float), 1, fp);
-	fwrite(&m_ParticleCnt, sizeof(int), 1, fp);
-	fwrite(m_ParticleSys[0], sizeof(tParticle), m_ParticleCnt, fp);
-	fwrite(m_ParticleSys[1], sizeof(tParticle), m_ParticleCnt, fp);
-	fwrite(m_ParticleSys[2], sizeof(tParticle), m_ParticleCnt, fp);
-	fwrite(&m_SpringCnt, sizeof(int), 1, fp);
-	fwrite(m_Spring, sizeof(tSpring), m_SpringCnt, fp);
-	fwrite(m_Pick, sizeof(int), 2, fp);
-	fwrite(&m_SphereCnt, sizeof(int), 1, fp);
-	fwrite(m_Sphere, sizeof(tCollisionSphere), m_SphereCnt, fp);
+	records = malloc(size * count);
+	cursor.GetWords(records, size * count, 4);
+	return records;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Function:	GetParams
+// Purpose:		Reads the simulation settings in the order they were always saved
+///////////////////////////////////////////////////////////////////////////////
+void CPhysEnv::GetParams(CSnapshotCursor& cursor)
+{
+	m_UseGravity = cursor.GetI32();
+	m_UseDamping = cursor.GetI32();
+	m_UserForceActive = cursor.GetI32();
+	m_Gravity = cursor.GetVector();
+	m_UserForce = cursor.GetVector();
+	m_UserForceMag = cursor.GetF32();
+	m_Kd = cursor.GetF32();
+	m_Kr = cursor.GetF32();
+	m_Ksh = cursor.GetF32();
+	m_Ksd = cursor.GetF32();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Function:	GetParticles
+// Purpose:		Reads the particle count and the current, target and reset
+//				buffers, which follow each other in old and new files alike
+///////////////////////////////////////////////////////////////////////////////
+BOOL CPhysEnv::GetParticles(CSnapshotCursor& cursor)
+{
+	/// Local Variables ///////////////////////////////////////////////////////////
+	int		particleCnt = cursor.GetI32();
+	///////////////////////////////////////////////////////////////////////////////
+	if (particleCnt < 0 || !cursor.Has(3 * (std::uint64_t)particleCnt, sizeof(tParticle)))
+		return FALSE;
+	AllocateSystem(particleCnt);
+	for (int i = 0; i < 3; i++)
+		cursor.GetWords(m_ParticleSys[i], sizeof(tParticle) * particleCnt, 4);
+	return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Function:	SetUserPlanes
+// Purpose:		Replaces the user planes after the world walls
+///////////////////////////////////////////////////////////////////////////////
+void CPhysEnv::SetUserPlanes(tCollisionPlane* planes, int planeCnt)
+{
+	m_CollisionPlane = (tCollisionPlane*)realloc(m_CollisionPlane, sizeof(tCollisionPlane) * (WORLD_PLANE_CNT + planeCnt));
+	if (planeCnt > 0)
+		memcpy(&m_CollisionPlane[WORLD_PLANE_CNT], planes, sizeof(tCollisionPlane) * planeCnt);
+	m_CollisionPlaneCnt = WORLD_PLANE_CNT + planeCnt;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Function:	LoadLegacy
+// Purpose:		Reads the system from an old .dps file
+// Arguments:	Cursor right after the visual arrays
+// Notes:		The old files are raw 32 bit structures, but every one of them
+//				is made of 4 byte fields so they read the same as the chunks.
+//				The extra collider block is only in the later ones
+///////////////////////////////////////////////////////////////////////////////
+BOOL CPhysEnv::LoadLegacy(CSnapshotCursor& cursor)
+{
+	/// Local Variables ///////////////////////////////////////////////////////////
+	char	tag[4];
+	int		userPlaneCnt;
+	tCollisionPlane	*userPlanes;
+	///////////////////////////////////////////////////////////////////////////////
+	GetParams(cursor);
+	if (!GetParticles(cursor))
+		return FALSE;
+	free(m_Spring);
+	m_Spring = (tSpring*)GetRecords(cursor, sizeof(tSpring), m_SpringCnt);
+	m_SpringCapacity = m_SpringCnt;
+	m_SpringRenderer->Invalidate();
+	m_FrameCapture->Invalidate();
+	m_Pick[0] = cursor.GetI32();
+	m_Pick[1] = cursor.GetI32();
+	free(m_Sphere);
+	m_Sphere = (tCollisionSphere*)GetRecords(cursor, sizeof(tCollisionSphere), m_SphereCnt);
+
+	free(m_Box);
+	m_Box = NULL;
+	m_BoxCnt = 0;
+	free(m_Capsule);
+	m_Capsule = NULL;
+	m_CapsuleCnt = 0;
+	SetUserPlanes(NULL, 0);
+	if (cursor.Has(1, 8))
+	{
+		cursor.GetBytes(tag, 4);
+		if (memcmp(tag, COLLIDER_TAG, 4) == 0 && cursor.GetI32() == COLLIDER_VERSION)
+		{
+			userPlanes = (tCollisionPlane*)GetRecords(cursor, sizeof(tCollisionPlane), userPlaneCnt);
+			SetUserPlanes(userPlanes, userPlaneCnt);
+			free(userPlanes);
+			m_Box = (tCollisionBox*)GetRecords(cursor, sizeof(tCollisionBox), m_BoxCnt);
+			m_Capsule = (tCollisionCapsule*)GetRecords(cursor, sizeof(tCollisionCapsule), m_CapsuleCnt);
+		}
+	}
+	ValidatePicks();
+	return !cursor.Failed();
+}
+////// LoadLegacy //////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Function:	LoadSnapshot
+// Purpose:		Reads the system from the chunks of a snapshot
+// Notes:		The collider chunks may be missing, they are empty then
+///////////////////////////////////////////////////////////////////////////////
+BOOL CPhysEnv::LoadSnapshot(const CSnapshotReader& reader)
+{
+	/// Local Variables ///////////////////////////////////////////////////////////
+	CSnapshotCursor	params = reader.Chunk(SNAPSHOT_PARAMS);
+	CSnapshotCursor	particles = reader.Chunk(SNAPSHOT_PARTICLES);
+	CSnapshotCursor	springs = reader.Chunk(SNAPSHOT_SPRINGS);
+	CSnapshotCursor	spheres = reader.Chunk(SNAPSHOT_SPHERES);
+	CSnapshotCursor	planes = reader.Chunk(SNAPSHOT_PLANES);
+	CSnapshotCursor	boxes = reader.Chunk(SNAPSHOT_BOXES);
+	CSnapshotCursor	capsules = reader.Chunk(SNAPSHOT_CAPSULES);
+	int		userPlaneCnt;
+	tCollisionPlane	*userPlanes;
+	///////////////////////////////////////////////////////////////////////////////
+	GetParams(params);
+	m_IntegratorType = params.GetI32();
+	m_Pick[0] = params.GetI32();
+	m_Pick[1] = params.GetI32();
+	if (params.Failed() || springs.Failed() || !GetParticles(particles))
+		return FALSE;
+	free(m_Spring);
+	m_Spring = (tSpring*)GetRecords(springs, sizeof(tSpring), m_SpringCnt);
+	m_SpringCapacity = m_SpringCnt;
+	m_SpringRenderer->Invalidate();
+	m_FrameCapture->Invalidate();
+	free(m_Sphere);
+	m_Sphere = (tCollisionSphere*)GetRecords(spheres, sizeof(tCollisionSphere), m_SphereCnt);
+	userPlanes = (tCollisionPlane*)GetRecords(planes, sizeof(tCollisionPlane), userPlaneCnt);
+	SetUserPlanes(userPlanes, userPlaneCnt);
+	free(userPlanes);
+	free(m_Box);
+	m_Box = (tCollisionBox*)GetRecords(boxes, sizeof(tCollisionBox), m_BoxCnt);
+	free(m_Capsule);
+	m_Capsule = (tCollisionCapsule*)GetRecords(capsules, sizeof(tCollisionCapsule), m_CapsuleCnt);
+	ValidatePicks();
+	return !springs.Failed();
+}
+////// LoadSnapshot ////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Function:	SaveSnapshot
+// Purpose:		Writes the system as snapshot chunks
+// Notes:		The particle buffers are streamed straight from the system,
+//				the world walls are not saved, they come from the world size
+///////////////////////////////////////////////////////////////////////////////
+void CPhysEnv::SaveSnapshot(CSnapshotWriter& writer)
+{
+	writer.BeginChunk(SNAPSHOT_PARAMS, PARAMS_RECORD_SIZE);
+	writer.PutI32(m_UseGravity);
+	writer.PutI32(m_UseDamping);
+	writer.PutI32(m_UserForceActive);
+	writer.PutVector(m_Gravity);
+	writer.PutVector(m_UserForce);
+	writer.PutF32(m_UserForceMag);
+	writer.PutF32(m_Kd);
+	writer.PutF32(m_Kr);
+	writer.PutF32(m_Ksh);
+	writer.PutF32(m_Ksd);
+	writer.PutI32(m_IntegratorType);
+	writer.PutI32(m_Pick[0]);
+	writer.PutI32(m_Pick[1]);
+	writer.EndChunk();
+
+	writer.BeginChunk(SNAPSHOT_PARTICLES, 4 + 3 * (std::uint64_t)sizeof(tParticle) * m_ParticleCnt);
+	writer.PutI32(m_ParticleCnt);
+	for (int i = 0; i < 3; i++)
+		writer.PutWords(m_ParticleSys[i], sizeof(tParticle) * m_ParticleCnt, 4);
+	writer.EndChunk();
+
+	PutRecords(writer, SNAPSHOT_SPRINGS, m_Spring, sizeof(tSpring), m_SpringCnt);
+	PutRecords(writer, SNAPSHOT_SPHERES, m_Sphere, sizeof(tCollisionSphere), m_SphereCnt);
+	PutRecords(writer, SNAPSHOT_PLANES, &m_CollisionPlane[WORLD_PLANE_CNT], sizeof(tCollisionPlane), m_CollisionPlaneCnt - WORLD_PLANE_CNT);
+	PutRecords(writer, SNAPSHOT_BOXES, m_Box, sizeof(tCollisionBox), m_BoxCnt);
+	PutRecords(writer, SNAPSHOT_CAPSULES, m_Capsule, sizeof(tCollisionCapsule), m_CapsuleCnt);
+}
+////// SaveSnapshot ////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Function:	PutBoneRecords
+// Purpose:		Writes the colliders of one kind that follow a bone, each
+//				after the index of its bone
+// Notes:		A collider whose bone left the skeleton is not saved
+///////////////////////////////////////////////////////////////////////////////
+template <typename T, typename Bone, typename Local>
+static void PutBoneRecords(CSnapshotWriter& writer, std::uint32_t tag, t_Bone* skeleton, int count, Bone bone, Local local)
+{
+	/// Local Variables ///////////////////////////////////////////////////////////
+	int		saved = 0;
+	///////////////////////////////////////////////////////////////////////////////
+	for (int loop = 0; loop < count; loop++)
+	{
+		if (BoneIndex(skeleton, bone(loop)) >= 0)
+			saved++;
+	}
+	writer.BeginChunk(tag, 4 + (4 + (std::uint64_t)sizeof(T)) * saved);
+	writer.PutI32(saved);
+	for (int loop = 0; loop < count; loop++)
+	{
+		int index = BoneIndex(skeleton, bone(loop));
+		if (index < 0)
+			continue;
+		writer.PutI32(index);
+		writer.PutWords(&local(loop), sizeof(T), 4);
+	}
+	writer.EndChunk();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Function:	GetBoneRecords
+// Purpose:		Reads the colliders of one kind that follow a bone
+// Returns:		FALSE when the list does not fit in the chunk or names a bone
+//				that is not in the skeleton
+// Notes:		A missing chunk reads as an empty list
+///////////////////////////////////////////////////////////////////////////////
+template <typename T, typename Attach>
+static BOOL GetBoneRecords(CSnapshotCursor cursor, t_Bone* skeleton, Attach attach)
+{
+	/// Local Variables ///////////////////////////////////////////////////////////
+	int		count = cursor.GetI32();
+	t_Bone	*bone;
+	T		local;
+	///////////////////////////////////////////////////////////////////////////////
+	if (count == 0)
+		return TRUE;
+	if (count < 0 || !cursor.Has(count, 4 + sizeof(T)))
+		return FALSE;
+	for (int loop = 0; loop < count; loop++)
+	{
+		bone = BoneAtIndex(skeleton, cursor.GetI32());
+		cursor.GetWords(&local, sizeof(T), 4);
+		if (bone == NULL)
+			return FALSE;
+		attach(bone, &local);
+	}
+	return !cursor.Failed();
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Function:	SaveBoneColliders
+// Purpose:		Writes the colliders that follow the bones, and the collision
+//				meshes, which can follow one too
+// Arguments:	The skeleton their bones belong to, written by the caller
+///////////////////////////////////////////////////////////////////////////////
+void CPhysEnv::SaveBoneColliders(CSnapshotWriter& writer, t_Bone* skeleton)
+{
+	/// Local Variables ///////////////////////////////////////////////////////////
+	const CBoneColliders&	colliders = *m_BoneColliders;
+	///////////////////////////////////////////////////////////////////////////////
+	PutBoneRecords<tCollisionSphere>(writer, SNAPSHOT_BONE_SPHERES, skeleton, colliders.SphereCount(),
+		[&](int at) { return colliders.SphereBone(at); }, [&](int at) -> const tCollisionSphere& { return colliders.LocalSphere(at); });
+	PutBoneRecords<tCollisionBox>(writer, SNAPSHOT_BONE_BOXES, skeleton, colliders.BoxCount(),
+		[&](int at) { return colliders.BoxBone(at); }, [&](int at) -> const tCollisionBox& { return colliders.LocalBox(at); });
+	PutBoneRecords<tCollisionCapsule>(writer, SNAPSHOT_BONE_CAPSULES, skeleton, colliders.CapsuleCount(),
+		[&](int at) { return colliders.CapsuleBone(at); }, [&](int at) -> const tCollisionCapsule& { return colliders.LocalCapsule(at); });
+	SaveCollisionMeshes(writer, skeleton);
+}
+////// SaveBoneColliders ///////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Function:	LoadBoneColliders
+// Purpose:		Attaches the colliders saved by SaveBoneColliders to the
+//				bones of a loaded skeleton
+// Notes:		Files saved before bone colliders were saved have none. The
+//				collision meshes are replaced too
+///////////////////////////////////////////////////////////////////////////////
+BOOL CPhysEnv::LoadBoneColliders(const CSnapshotReader& reader, t_Bone* skeleton)
+{
+	m_BoneColliders->Clear();
+	return LoadCollisionMeshes(reader, skeleton) && GetBoneRecords<tCollisionSphere>(reader.Chunk(SNAPSHOT_BONE_SPHERES), skeleton,
+			[this](t_Bone* bone, tCollisionSphere* local) { AttachCollisionSphere(bone, local); }) &&
+		GetBoneRecords<tCollisionBox>(reader.Chunk(SNAPSHOT_BONE_BOXES), skeleton,
+			[this](t_Bone* bone, tCollisionBox* local) { AttachCollisionBox(bone, local); }) &&
+		GetBoneRecords<tCollisionCapsule>(reader.Chunk(SNAPSHOT_BONE_CAPSULES), skeleton,
+			[this](t_Bone* bone, tCollisionCapsule* local) { AttachCollisionCapsule(bone, local); });
+}
+////// LoadBoneColliders ///////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Function:	SaveCollisionMeshes
+// Purpose:		Writes the collision meshes, each after the index of the bone
+//				it follows, or -1, its vertex and triangle counts, the vertices
+//				and three vertex indices per triangle
+// Notes:		The vertices of a mesh on a bone are in the space of the bone.
+//				A mesh whose bone left the skeleton is saved where it is
+///////////////////////////////////////////////////////////////////////////////
+void CPhysEnv::SaveCollisionMeshes(CSnapshotWriter& writer, t_Bone* skeleton)
+{
+	/// Local Variables ///////////////////////////////////////////////////////////
+	std::vector<int>	attached(m_MeshColliders->MeshCount(), -1);
+	std::vector<int>	boneIndex(m_MeshColliders->MeshCount(), -1);
+	std::uint64_t		size = 4;
+	int					at;
+	///////////////////////////////////////////////////////////////////////////////
+	for (at = 0; at < m_BoneColliders->MeshCount(); at++)
+	{
+		int index = BoneIndex(skeleton, m_BoneColliders->MeshBone(at));
+		if (index < 0)
+			continue;
+		attached[m_BoneColliders->MeshIndex(at)] = at;
+		boneIndex[m_BoneColliders->MeshIndex(at)] = index;
+	}
+	for (at = 0; at < m_MeshColliders->MeshCount(); at++)
+	{
+		const tCollisionMesh& mesh = m_MeshColliders->Mesh(at);
+		size += 12 + sizeof(tVector) * (std::uint64_t)mesh.next.size() + 4 * (std::uint64_t)mesh.triangles.size();
+	}
+	writer.BeginChunk(SNAPSHOT_MESHES, size);
+	writer.PutI32(m_MeshColliders->MeshCount());
+	for (at = 0; at < m_MeshColliders->MeshCount(); at++)
+	{
+		const tCollisionMesh& mesh = m_MeshColliders->Mesh(at);
+		const std::vector<tVector>& vertices = attached[at] >= 0 ? m_BoneColliders->LocalMesh(attached[at]) : mesh.next;
+		writer.PutI32(boneIndex[at]);
+		writer.PutI32((int)vertices.size());
+		writer.PutI32((int)mesh.triangles.size() / 3);
+		writer.PutWords(vertices.data(), sizeof(tVector) * vertices.size(), 4);
+		writer.PutWords(mesh.triangles.data(), 4 * mesh.triangles.size(), 4);
+	}
+	writer.EndChunk();
+}
+////// SaveCollisionMeshes /////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Function:	LoadCollisionMeshes
+// Purpose:		Replaces the collision meshes with the ones saved by
+//				SaveCollisionMeshes, attached to the bones of a loaded skeleton
+// Returns:		FALSE when a mesh does not fit in the chunk, names a bone that
+//				is not in the skeleton or a vertex it does not have
+// Notes:		Files saved before the meshes were saved have none
+///////////////////////////////////////////////////////////////////////////////
+BOOL CPhysEnv::LoadCollisionMeshes(const CSnapshotReader& reader, t_Bone* skeleton)
+{
+	/// Local Variables ///////////////////////////////////////////////////////////
+	CSnapshotCursor		cursor = reader.Chunk(SNAPSHOT_MESHES);
+	int					count = cursor.GetI32();
+	int					bone, vertexCnt, triangleCnt;
+	std::vector<tVector>	vertices;
+	std::vector<int>	triangles;
+	///////////////////////////////////////////////////////////////////////////////
+	m_MeshColliders->Clear();
+	if (count == 0)
+		return TRUE;
+	if (count < 0 || !cursor.Has(count, 12))
+		return FALSE;
+	for (int loop = 0; loop < count; loop++)
+	{
+		bone = cursor.GetI32();
+		vertexCnt = cursor.GetI32();
+		triangleCnt = cursor.GetI32();
+		if (vertexCnt <= 0 || triangleCnt <= 0 || !cursor.Has(vertexCnt, sizeof(tVector)))
+			return FALSE;
+		vertices.resize(vertexCnt);
+		cursor.GetWords(vertices.data(), sizeof(tVector) * vertexCnt, 4);
+		if (!cursor.Has(triangleCnt, 12))
+			return FALSE;
+		triangles.resize(triangleCnt * 3);
+		cursor.GetWords(triangles.data(), 12 * (std::size_t)triangleCnt, 4);
+		for (int index : triangles)
+		{
+			if (index < 0 || index >= vertexCnt)
+				return FALSE;
+		}
+		if (bone < 0)
+			AddCollisionMesh(vertices.data(), vertexCnt, triangles.data(), triangleCnt);
+		else if (BoneAtIndex(skeleton, bone) != NULL)
+			AttachCollisionMesh(BoneAtIndex(skeleton, bone), vertices.data(), vertexCnt, triangles.data(), triangleCnt);
+		else
+			return FALSE;
+	}
+	return !cursor.Failed();
+}
+////// LoadCollisionMeshes /////////////////////////////////////////////////////
+
+// A PICK OUTSIDE THE LOADED PARTICLES WOULD BE DRAGGED OUT OF BOUNDS
+void CPhysEnv::ValidatePicks()
+{
+	for (int i = 0; i < 2; i++)
+	{
+		if (m_Pick[i] < -1 || m_Pick[i] >= m_ParticleCnt)
+			m_Pick[i] = -1;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Function:	ExportScene
+// Purpose:		Points a scene view at the system, for WriteSceneCache
+// Arguments:	View to fill, its visual is left to the caller
+// Notes:		The particles are the reset buffer, so the cache holds the
+//				mesh as it was loaded and not where the simulation got to.
+//				The springs are in the order they were added, the cache
+//				groups them
+///////////////////////////////////////////////////////////////////////////////
+void CPhysEnv::ExportScene(tSceneView* scene)
+{
+	scene->particles = m_ParticleSys[2];
+	scene->particleCnt = m_ParticleCnt;
+	scene->springs = m_Spring;
+	scene->springCnt = m_SpringCnt;
+	scene->visual = NULL;
+}
+////// ExportScene /////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Function:	ImportScene
+// Purpose:		Sets the particles and springs of a mesh from a scene,
+//				usually a mapped cache, like SetWorldParticles does from
+//				the OBJ
+// Arguments:	Scene to copy, it is not needed once this returns
+// Notes:		The settings and colliders are left as they are. Every
+//				array is copied, the simulation steps the particles in
+//				place and the springs grow as they are added to
+///////////////////////////////////////////////////////////////////////////////
+void CPhysEnv::ImportScene(const tSceneView* scene)
+{
+	AllocateSystem(scene->particleCnt);
+	memcpy(m_ParticleSys[0], scene->particles, sizeof(tParticle) * m_ParticleCnt);
+	memcpy(m_ParticleSys[1], scene->particles, sizeof(tParticle) * m_ParticleCnt);
+	memcpy(m_ParticleSys[2], scene->particles, sizeof(tParticle) * m_ParticleCnt);
+	free(m_Spring);
+	m_Spring = NULL;
+	if (scene->springCnt > 0)
+	{
+		m_Spring = (tSpring*)malloc(sizeof(tSpring) * scene->springCnt);
+		memcpy(m_Spring, scene->springs, sizeof(tSpring) * scene->springCnt);
+	}
+	m_SpringCnt = scene->springCnt;
+	m_SpringCapacity = m_SpringCnt;
+	m_SpringRenderer->Invalidate();
+	m_FrameCapture->Invalidate();
+	m_Pick[0] = -1;
+	m_Pick[1] = -1;
+}
+////// ImportScene /////////////////////////////////////////////////////////////
+
 // RESET THE SIM TO INITIAL VALUES
 void CPhysEnv::ResetWorld()
 {
@@ -794,17 +1435,32 @@ void CPhysEnv::SetMouseForce(int deltaX, int deltaY, tVector* localX, tVector* l
 /// SetMouseForce /////////////////////////////////////////////////////////////
 
 
+///////////////////////////////////////////////////////////////////////////////
+// Function:	NewSpring
+// Purpose:		Makes room for one more spring at the end of the list
+// Notes:		The list doubles when it is full, so building a cloth of n
+//				springs copies the list log n times instead of n times
+///////////////////////////////////////////////////////////////////////////////
+tSpring* CPhysEnv::NewSpring()
+{
+	if (m_SpringCnt == m_SpringCapacity)
+	{
+		m_SpringCapacity = m_SpringCapacity > 0 ? m_SpringCapacity * 2 : 64;
+		m_Spring = (tSpring*)realloc(m_Spring, sizeof(tSpring) * m_SpringCapacity);
+	}
+	m_SpringRenderer->Invalidate();
+	m_FrameCapture->Invalidate();
+	return &m_Spring[m_SpringCnt++];
+}
+////// NewSpring ///////////////////////////////////////////////////////////////
+
 void CPhysEnv::AddSpring()
 {
 	tSpring* spring;
 	// MAKE SURE TWO PARTICLES ARE PICKED
 	if (m_Pick[0] > -1 && m_Pick[1] > -1)
 	{
-		spring = (tSpring*)malloc(sizeof(tSpring) * (m_SpringCnt + 1));
-		if (m_Spring != NULL)
-			memcpy(spring, m_Spring, sizeof(tSpring) * m_SpringCnt);
-		m_Spring = spring;
-		spring = &m_Spring[m_SpringCnt++];
+		spring = NewSpring();
 		spring->Ks = m_Ksh;
 		spring->Kd = m_Ksd;
 		spring->p1 = m_Pick[0];
@@ -822,14 +1478,7 @@ void CPhysEnv::AddSpring(int v1, int v2, float Ksh, float Ksd, int type)
 	// MAKE SURE TWO PARTICLES ARE PICKED
 	if (v1 > -1 && v2 > -1)
 	{
-		spring = (tSpring*)malloc(sizeof(tSpring) * (m_SpringCnt + 1));
-		if (m_Spring != NULL)
-		{
-			memcpy(spring, m_Spring, sizeof(tSpring) * m_SpringCnt);
-			free(m_Spring);
-		}
-		m_Spring = spring;
-		spring = &m_Spring[m_SpringCnt++];
+		spring = NewSpring();
 		spring->type = type;
 		spring->Ks = Ksh;
 		spring->Kd = Ksd;
@@ -848,6 +1497,8 @@ void CPhysEnv::ComputeForces(tParticle* system)
 	tSpring* spring;
 	float		dist, Hterm, Dterm;
 	tVector		springForce, deltaV, deltaP;
+	PROFILE_SCOPE(PHASE_FORCES);
+	PROFILE_COUNT(COUNTER_FORCES, 1);
 
 	curParticle = system;
 	for (loop = 0; loop < m_ParticleCnt; loop++)
@@ -1030,17 +1681,31 @@ void CPhysEnv::MidPointIntegrate ( float DeltaTime )
     //IntegrateSysOverTime ( yn , k2 , ynp1 , DeltaTime );
     IntegrateSysOverTime ( m_CurrentSys , m_TempSys [ 0 ] , m_TargetSys , DeltaTime );
 }
+/**
+ * \brief How far apart the positions of two systems are, in percent of the size of the first.
+ *
+ * The RMS distance between matching particles over their RMS distance from the origin. That size is never taken as less than one unit,
+ * so a system at or near the origin is measured absolutely instead of divided by almost nothing.
+ */
 float CPhysEnv::CalculateTwoSystemError ( tParticle * systemOne , tParticle * systemTwo , int particleCount ) const
 {
-    float error = 0.0f;
-    for ( std::size_t i = 0; i < particleCount; ++i )
+    if ( particleCount <= 0 )
     {
-        error += std::abs ( ( systemOne [ i ].pos.x - systemTwo [ i ].pos.x ) / systemOne [ i ].pos.x ) * 100;
-        error += std::abs ( ( systemOne [ i ].pos.y - systemTwo [ i ].pos.y ) / systemOne [ i ].pos.y ) * 100;
-        error += std::abs ( ( systemOne [ i ].pos.z - systemTwo [ i ].pos.z ) / systemOne [ i ].pos.z ) * 100;
+        return 0.0f;
     }
-    error /= ( 3 * particleCount );
-    return error;
+    double difference = 0.0;
+    double size = 0.0;
+    for ( int i = 0; i < particleCount; ++i )
+    {
+        const double dx = systemOne [ i ].pos.x - systemTwo [ i ].pos.x;
+        const double dy = systemOne [ i ].pos.y - systemTwo [ i ].pos.y;
+        const double dz = systemOne [ i ].pos.z - systemTwo [ i ].pos.z;
+        difference += dx * dx + dy * dy + dz * dz;
+        size += static_cast < double > ( systemOne [ i ].pos.x ) * systemOne [ i ].pos.x + static_cast < double > ( systemOne [ i ].pos.y ) * systemOne [ i ].pos.y
+            + static_cast < double > ( systemOne [ i ].pos.z ) * systemOne [ i ].pos.z;
+    }
+    const double scale = std::max ( size / particleCount , 1.0 );
+    return static_cast < float > ( 100.0 * std::sqrt ( difference / particleCount / scale ) );
 }
 /**
  * \brief Uses Heun's method to integrate the system.
@@ -1085,7 +1750,7 @@ void CPhysEnv::HeunIntegrate ( float DeltaTime )
     //The velocities and positions at the end t
     System y_0_1 ( m_ParticleCnt );
     IntegrateSysOverTime ( y_0 , y_prime_0 , y_0_1 , DeltaTime );//Position
-    while ( true )
+    for ( int correction = 0; correction < HEUN_MAX_CORRECTIONS; ++correction )
     {
         //The slope at the end t
         System y_prime_1 ( y_0_1 );
@@ -1096,12 +1761,11 @@ void CPhysEnv::HeunIntegrate ( float DeltaTime )
         System y_i_1 ( m_ParticleCnt );
         IntegrateSysOverTime ( y_0 , y_bar_prime , y_i_1 , DeltaTime ); //Position
         const float error = CalculateTwoSystemError ( y_i_1 , y_0_1 , m_ParticleCnt );
-        if ( error > stoppingCriterion )
+        y_0_1 = y_i_1;
+        if ( error <= stoppingCriterion )
         {
-            y_0_1 = y_i_1;
-            continue;
+            break;
         }
-        break;
     }
     y_0_1.fillOut ( m_TargetSys );
 }
@@ -1264,7 +1928,7 @@ void CPhysEnv::RK4AdaptiveIntegrate ( float DeltaTime )
     System k3_2 ( m_ParticleCnt );
     // 𝑘₃ = 𝑓( 𝑥ᵢ + ( 1 / 2 ) * 𝒉 , 𝑦ᵢ + ( 1 / 2 ) * 𝑘₂ * 𝒉 )
     IntegrateSysOverTime ( y2Half , k2_2 , k3_2 , halfH2 );
-    ComputeForces ( k2_2 );
+    ComputeForces ( k3_2 );
     System k4_2 ( m_ParticleCnt );
     // 𝑘₄ = 𝑓( 𝑥ᵢ + 𝒉 , 𝑦ᵢ + 𝑘₃ * 𝒉 )
     IntegrateSysOverTime ( y2Half , k3_2 , k4_2 , h2 );
@@ -1282,114 +1946,163 @@ void CPhysEnv::RK4AdaptiveIntegrate ( float DeltaTime )
 
 ///////////////////////////////////////////////////////////////////////////////
 
+///////////////////////////////////////////////////////////////////////////////
+// Function:	CheckForCollisions
+// Purpose:		Finds every particle touching or going through a wall or sphere
+// Arguments:	The system to check
+// Notes:		The particles are split into chunks checked by the thread pool.
+//				Each worker writes its contacts to its own stream and the streams
+//				are merged once all chunks are done, so the contacts of a particle
+//				always end up next to each other in m_Contact.
+///////////////////////////////////////////////////////////////////////////////
 int CPhysEnv::CheckForCollisions(tParticle* system)
 {
-	// be optimistic!
-	int collisionState = NOT_COLLIDING;
-	float const depthEpsilon = 0.001f;
+	std::atomic<bool> penetrating(false);
+	std::atomic<bool> colliding(false);
+	CThreadPool& pool = CThreadPool::Instance();
+	int meshState;
+	PROFILE_SCOPE(PHASE_COLLIDE);
+
+	tCollisionScene scene;
+
+	scene.planes = m_CollisionPlane;
+	scene.planeCnt = m_CollisionPlaneCnt;
+	scene.spheres = m_SceneSphere.data();
+	scene.boxes = m_SceneBox.data();
+	scene.capsules = m_SceneCapsule.data();
+	// SPHERES, BOXES AND CAPSULES CAN BE TURNED OFF
+	scene.sphereCnt = m_CollisionActive ? (int)m_SceneSphere.size() : 0;
+	scene.boxCnt = m_CollisionActive ? (int)m_SceneBox.size() : 0;
+	scene.capsuleCnt = m_CollisionActive ? (int)m_SceneCapsule.size() : 0;
+	// THE MOTION IS STORED SPHERES FIRST, THEN BOXES, THEN TWO PER CAPSULE
+	scene.sphereMotion = m_ScenePrevious ? m_SceneMotion.data() : NULL;
+	scene.boxMotion = m_ScenePrevious ? m_SceneMotion.data() + m_SceneSphere.size() : NULL;
+	scene.capsuleMotion = m_ScenePrevious ? m_SceneMotion.data() + m_SceneSphere.size() + m_SceneBox.size() : NULL;
+	scene.previous = m_ScenePrevious;
+	scene.stepTime = m_SceneStepTime;
+	scene.depthEpsilon = COLLISION_DEPTH;
+
+	m_Contact.Reset(pool.WorkerCount());
+	pool.ParallelFor(m_ParticleCnt, COLLISION_GRAIN,
+		[this, system, &scene, &penetrating, &colliding](int begin, int end, int worker)
+		{
+			int collisionState = CheckForCollisions(system, begin, end, scene, m_Contact.Stream(worker), penetrating);
+			if (collisionState == PENETRATING)
+				penetrating = true;
+			else if (collisionState == COLLIDING)
+				colliding = true;
+		});
+
+	// THE MESHES ARE ONLY WORTH TESTING IF NOTHING ELSE PENETRATED
+	m_ImpactTime = 2.0f;
+	meshState = NOT_COLLIDING;
+	if (!penetrating && m_MeshPrevious && m_CollisionActive)
+	{
+		meshState = m_MeshColliders->Collide(m_MeshPrevious, system, m_ParticleCnt, m_Spring, m_SpringCnt,
+			m_SceneStepTime, COLLISION_DEPTH, m_Contact, m_ImpactTime);
+		if (meshState == PENETRATING)
+			penetrating = true;
+	}
 
-	int loop;
-	tParticle* curParticle;
+	if (penetrating)
+	{
+		m_ContactCnt = 0;
+		return PENETRATING;
+	}
+	m_Contact.Merge();
+	m_ContactCnt = m_Contact.Size();
+	PROFILE_COUNT(COUNTER_CONTACTS, m_ContactCnt);
+	// THE MESH CONTACTS CAME AFTER THE OTHERS IN EACH STREAM, SO GATHER THE
+	// CONTACTS OF EACH PARTICLE BACK TOGETHER FOR ResolveCollisions
+	if (meshState == COLLIDING)
+	{
+		std::stable_sort(m_Contact.Data(), m_Contact.Data() + m_ContactCnt,
+			[](const tContact& a, const tContact& b) { return a.particle < b.particle; });
+		colliding = true;
+	}
+	return colliding ? COLLIDING : NOT_COLLIDING;
+}
 
-	m_ContactCnt = 0;		// THERE ARE CURRENTLY NO CONTACTS
+///////////////////////////////////////////////////////////////////////////////
+// Function:	CheckForCollisions
+// Purpose:		Checks a range of particles against the walls and spheres
+// Arguments:	The system, the range [begin, end) to check, the colliders, where
+//				to put the contacts and a flag set as soon as any chunk finds a
+//				penetration
+// Notes:		The real work is done by the batched kernel in CollisionKernel.cpp,
+//				a slice at a time so a penetration found by another chunk stops
+//				this one early.
+///////////////////////////////////////////////////////////////////////////////
+int CPhysEnv::CheckForCollisions(tParticle* system, int begin, int end, const tCollisionScene& scene, std::vector<tContact>& contacts, const std::atomic<bool>& penetrating)
+{
+	// be optimistic!
+	int collisionState = NOT_COLLIDING;
 
-	curParticle = system;
-	for (loop = 0; (loop < m_ParticleCnt) && (collisionState != PENETRATING);
-		loop++, curParticle++)
+	for (int first = begin; first < end; first += COLLISION_SLICE)
 	{
-		// CHECK THE MAIN BOUNDARY PLANES FIRST
-		for (int planeIndex = 0;(planeIndex < m_CollisionPlaneCnt) &&
-			(collisionState != PENETRATING);planeIndex++)
-		{
-			tCollisionPlane* plane = &m_CollisionPlane[planeIndex];
-
-			float axbyczd = DotProduct(&curParticle->pos, &plane->normal) + plane->d;
+		// ANOTHER CHUNK ALREADY PENETRATED SO THIS STEP WILL BE THROWN AWAY
+		if (penetrating.load(std::memory_order_relaxed))
+			return PENETRATING;
 
-			if (axbyczd < -depthEpsilon)
-			{
-				// ONCE ANY PARTICLE PENETRATES, QUIT THE LOOP
-				collisionState = PENETRATING;
-			}
-			else
-				if (axbyczd < depthEpsilon)
-				{
-					float relativeVelocity = DotProduct(&plane->normal, &curParticle->v);
-
-					if (relativeVelocity < 0.0f)
-					{
-						collisionState = COLLIDING;
-						m_Contact[m_ContactCnt].particle = loop;
-						memcpy(&m_Contact[m_ContactCnt].normal, &plane->normal, sizeof(tVector));
-						m_ContactCnt++;
-					}
-				}
-		}
-		if (m_CollisionActive)
+		int last = (end - first < COLLISION_SLICE) ? end : first + COLLISION_SLICE;
+		switch (CollideParticles(system, first, last, scene, contacts))
 		{
-			// THIS IS NEW FROM MARCH - ADDED SPHERE BOUNDARIES
-			// CHECK ANY SPHERE BOUNDARIES
-			for (int sphereIndex = 0;(sphereIndex < m_SphereCnt) &&
-				(collisionState != PENETRATING);sphereIndex++)
-			{
-				tCollisionSphere* sphere = &m_Sphere[sphereIndex];
-
-				tVector	distVect;
-
-				VectorDifference(&curParticle->pos, &sphere->pos, &distVect);
-
-				float radius = VectorSquaredLength(&distVect);
-				// SINCE IT IS TESTING THE SQUARED DISTANCE, SQUARE THE RADIUS ALSO
-				float dist = radius - (sphere->radius * sphere->radius);
-
-				if (dist < -depthEpsilon)
-				{
-					// ONCE ANY PARTICLE PENETRATES, QUIT THE LOOP
-					collisionState = PENETRATING;
-				}
-				else
-					if (dist < depthEpsilon)
-					{
-						// NORMALIZE THE VECTOR
-						NormalizeVector(&distVect);
-
-						float relativeVelocity = DotProduct(&distVect, &curParticle->v);
-
-						if (relativeVelocity < 0.0f)
-						{
-							collisionState = COLLIDING;
-							m_Contact[m_ContactCnt].particle = loop;
-							memcpy(&m_Contact[m_ContactCnt].normal, &distVect, sizeof(tVector));
-							m_ContactCnt++;
-						}
-					}
-			}
+		case PENETRATING:
+			// ONCE ANY PARTICLE PENETRATES, QUIT THE LOOP
+			return PENETRATING;
+		case COLLIDING:
+			collisionState = COLLIDING;
+			break;
 		}
-
 	}
 
 	return collisionState;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Function:	ResolveCollisions
+// Purpose:		Bounces every particle in the contact list
+// Notes:		The contacts are split into batches resolved by the thread pool.
+//				Both ends of a batch are moved forward to the next change of
+//				particle so all the contacts of a particle are applied in order
+//				by the same worker.
+///////////////////////////////////////////////////////////////////////////////
 void CPhysEnv::ResolveCollisions(tParticle* system)
 {
-	tContact* contact;
-	tParticle* particle;		// THE PARTICLE COLLIDING
-	float		VdotN;
-	tVector		Vn, Vt;				// CONTACT RESOLUTION IMPULSE
-	contact = m_Contact;
-	for (int loop = 0; loop < m_ContactCnt; loop++, contact++)
-	{
-		particle = &system[contact->particle];
-		// CALCULATE Vn
-		VdotN = DotProduct(&contact->normal, &particle->v);
-		ScaleVector(&contact->normal, VdotN, &Vn);
-		// CALCULATE Vt
-		VectorDifference(&particle->v, &Vn, &Vt);
-		// SCALE Vn BY COEFFICIENT OF RESTITUTION
-		ScaleVector(&Vn, m_Kr, &Vn);
-		// SET THE VELOCITY TO BE THE NEW IMPULSE
-		VectorDifference(&Vt, &Vn, &particle->v);
-	}
+	tContact* contacts = m_Contact.Data();
+	int contactCnt = m_ContactCnt;
+
+	CThreadPool::Instance().ParallelFor(contactCnt, RESOLVE_GRAIN,
+		[this, system, contacts, contactCnt](int begin, int end, int)
+		{
+			tContact* contact;
+			tParticle* particle;		// THE PARTICLE COLLIDING
+			float		VdotN;
+			tVector		Vr, Vn, Vt;			// CONTACT RESOLUTION IMPULSE
+
+			while (begin > 0 && begin < contactCnt && contacts[begin].particle == contacts[begin - 1].particle)
+				begin++;
+			while (end < contactCnt && contacts[end].particle == contacts[end - 1].particle)
+				end++;
+
+			contact = &contacts[begin];
+			for (int loop = begin; loop < end; loop++, contact++)
+			{
+				particle = &system[contact->particle];
+				// WORK WITH THE VELOCITY RELATIVE TO THE COLLIDER, WHICH MAY BE MOVING
+				VectorDifference(&particle->v, &contact->velocity, &Vr);
+				// CALCULATE Vn
+				VdotN = DotProduct(&contact->normal, &Vr);
+				ScaleVector(&contact->normal, VdotN, &Vn);
+				// CALCULATE Vt
+				VectorDifference(&Vr, &Vn, &Vt);
+				// SCALE Vn BY COEFFICIENT OF RESTITUTION
+				ScaleVector(&Vn, m_Kr, &Vn);
+				// SET THE VELOCITY TO BE THE NEW IMPULSE, BACK IN WORLD SPACE
+				VectorDifference(&Vt, &Vn, &Vr);
+				VectorSum(&Vr, &contact->velocity, &particle->v);
+			}
+		});
 }
 
 void CPhysEnv::Simulate(float DeltaTime, BOOL running)
@@ -1398,12 +2111,23 @@ void CPhysEnv::Simulate(float DeltaTime, BOOL running)
 	float		TargetTime = DeltaTime;
 	tParticle* tempSys;
 	int			collisionState;
+	int			bisections = 0;		// CUTS OF THE STEP UNDER WAY
+
+	// POSE THE BONE COLLIDERS AND MESHES FOR THE END OF THIS FRAME ONCE, THE STEPS BELOW INTERPOLATE
+	if (HasBoneColliders())
+	{
+		m_BoneColliders->Update();
+		m_BoneColliders->MoveMeshes(*m_MeshColliders);
+	}
+	m_MeshColliders->Update();
+	PrepareCollisionScene();
 
 	while (CurrentTime < DeltaTime)
 	{
         if (running)
 		{
 			ComputeForces(m_CurrentSys);
+			PROFILE_SCOPE(PHASE_INTEGRATE);
 			// IN ORDER TO MAKE THINGS RUN FASTER, I HAVE THIS LITTLE TRICK
 			// IF THE SYSTEM IS DOING A BINARY SEARCH FOR THE COLLISION POINT,
 			// I FORCE EULER'S METHOD ON IT. OTHERWISE, LET THE USER CHOOSE.
@@ -1437,14 +2161,34 @@ void CPhysEnv::Simulate(float DeltaTime, BOOL running)
 				}
 			}
 		}
+		m_ScenePrevious = NULL;
+		if (running && !m_BoneColliders->Empty())
+		{
+			PoseBoneColliders(CurrentTime / DeltaTime, TargetTime / DeltaTime, TargetTime - CurrentTime);
+			m_ScenePrevious = m_CurrentSys;
+		}
+		m_MeshPrevious = NULL;
+		if (running && !m_MeshColliders->Empty())
+		{
+			m_MeshColliders->Pose(CurrentTime / DeltaTime, TargetTime / DeltaTime, COLLISION_DEPTH);
+			m_MeshPrevious = m_CurrentSys;
+			m_SceneStepTime = TargetTime - CurrentTime;
+		}
 		collisionState = CheckForCollisions(m_TargetSys);
 
 		if (collisionState == PENETRATING)
 		{
 			// TELL THE SYSTEM I AM LOOKING FOR A COLLISION SO IT WILL USE EULER
 			m_CollisionRootFinding = TRUE;
-			// we simulated too far, so subdivide time and try again
-			TargetTime = (CurrentTime + TargetTime) / 2.0f;
+			PROFILE_COUNT(COUNTER_BISECTIONS, 1);
+			bisections++;
+			// we simulated too far, so subdivide time and try again. a mesh
+			// knows when it was hit so jump close to that instead of halving
+			if (m_ImpactTime <= 1.0f)
+				TargetTime = CurrentTime + (TargetTime - CurrentTime) *
+					std::min(std::max(m_ImpactTime, MIN_IMPACT_STEP), MAX_IMPACT_STEP);
+			else
+				TargetTime = (CurrentTime + TargetTime) / 2.0f;
 
 			// blow up if we aren't moving forward each step, which is
 			// probably caused by interpenetration at the frame start
@@ -1455,6 +2199,7 @@ void CPhysEnv::Simulate(float DeltaTime, BOOL running)
 			// either colliding or clear
 			if (collisionState == COLLIDING)
 			{
+				PROFILE_SCOPE(PHASE_RESOLVE);
 				int Counter = 0;
 				do
 				{
@@ -1462,18 +2207,24 @@ void CPhysEnv::Simulate(float DeltaTime, BOOL running)
 					Counter++;
 				} while ((CheckForCollisions(m_TargetSys) ==
 					COLLIDING) && (Counter < 100));
+				PROFILE_COUNT(COUNTER_RESOLVE_PASSES, Counter);
 
 				assert(Counter < 100);
 				m_CollisionRootFinding = FALSE;  // FOUND THE COLLISION POINT
 			}
 
+			// SAMPLE THE NEW STATE EVERY FEW STEPS, NOT THE ONE IT REPLACES
+			if (m_DiagnosticsInterval > 0 && ++m_StepsSinceDiagnostics >= m_DiagnosticsInterval)
+			{
+				PROFILE_SCOPE(PHASE_LOG);
+				m_Diagnostics->Compute(m_TargetSys, m_ParticleCnt, m_Spring, m_SpringCnt,
+					m_UseGravity ? &m_Gravity : NULL, m_LastDiagnostics);
+				m_StepsSinceDiagnostics = 0;
+			}
 			// we made a successful step, so swap configurations
 			// to "save" the data for the next step
-            if ( OUTPUT_TO_FILE )
-            {
-                auto errors = CalculateError ();
-
-            }
+			PROFILE_PEAK(COUNTER_BISECTION_DEPTH, bisections);
+			bisections = 0;
 			CurrentTime = TargetTime;
 			TargetTime = DeltaTime;
 
@@ -1514,4 +2265,185 @@ void CPhysEnv::AddCollisionSphere()
 		m_Sphere = temparray;
 		m_SphereCnt++;
 	}
-}
\ No newline at end of file
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Function:	AddCollisionPlane
+// Purpose:		Add a plane to the system after the walls of the world
+// Arguments:	Normal pointing to the side the particles stay on and the
+//				plane offset, ax + by + cz + d = 0
+///////////////////////////////////////////////////////////////////////////////
+void CPhysEnv::AddCollisionPlane(tVector* normal, float d)
+{
+	/// Local Variables ///////////////////////////////////////////////////////////
+	tCollisionPlane* plane;
+	float			length = (float)VectorLength(normal);
+	///////////////////////////////////////////////////////////////////////////////
+	if (length <= EPSILON)
+		return;
+	m_CollisionPlane = (tCollisionPlane*)realloc(m_CollisionPlane, sizeof(tCollisionPlane) * (m_CollisionPlaneCnt + 1));
+	plane = &m_CollisionPlane[m_CollisionPlaneCnt];
+	// KEEP THE NORMAL UNIT LENGTH SO ax + by + cz + d IS A DISTANCE
+	ScaleVector(normal, 1.0f / length, &plane->normal);
+	plane->d = d / length;
+	m_CollisionPlaneCnt++;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Function:	AddCollisionBox
+// Purpose:		Add an oriented collision box to the system
+// Arguments:	Center, half size along each local axis and the three local
+//				axes in world space
+// Notes:		The axes are made orthonormal (x is kept, y is made
+//				perpendicular to it and z is x cross y)
+///////////////////////////////////////////////////////////////////////////////
+void CPhysEnv::AddCollisionBox(tVector* center, tVector* halfSize, tVector* axis)
+{
+	/// Local Variables ///////////////////////////////////////////////////////////
+	tCollisionBox*	box;
+	tVector			along;
+	///////////////////////////////////////////////////////////////////////////////
+	m_Box = (tCollisionBox*)realloc(m_Box, sizeof(tCollisionBox) * (m_BoxCnt + 1));
+	box = &m_Box[m_BoxCnt];
+	box->center = *center;
+	box->halfSize = *halfSize;
+	box->axis[0] = axis[0];
+	NormalizeVector(&box->axis[0]);
+	ScaleVector(&box->axis[0], (float)DotProduct(&axis[1], &box->axis[0]), &along);
+	VectorDifference(&axis[1], &along, &box->axis[1]);
+	NormalizeVector(&box->axis[1]);
+	CrossProduct(&box->axis[0], &box->axis[1], &box->axis[2]);
+	m_BoxCnt++;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Function:	AddCollisionCapsule
+// Purpose:		Add a collision capsule to the system
+// Arguments:	Ends of the center segment and the radius around it
+///////////////////////////////////////////////////////////////////////////////
+void CPhysEnv::AddCollisionCapsule(tVector* p1, tVector* p2, float radius)
+{
+	/// Local Variables ///////////////////////////////////////////////////////////
+	tCollisionCapsule* capsule;
+	///////////////////////////////////////////////////////////////////////////////
+	m_Capsule = (tCollisionCapsule*)realloc(m_Capsule, sizeof(tCollisionCapsule) * (m_CapsuleCnt + 1));
+	capsule = &m_Capsule[m_CapsuleCnt];
+	capsule->p1 = *p1;
+	capsule->p2 = *p2;
+	capsule->radius = radius;
+	m_CapsuleCnt++;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Function:	AttachCollisionSphere
+// Purpose:		Add a collision sphere that follows a bone
+// Arguments:	The bone and the sphere in the space of that bone
+// Notes:		The bone must stay alive until FreeSystem
+///////////////////////////////////////////////////////////////////////////////
+void CPhysEnv::AttachCollisionSphere(t_Bone* bone, tCollisionSphere* local)
+{
+	m_BoneColliders->AttachSphere(bone, *local);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Function:	AttachCollisionBox
+// Purpose:		Add an oriented collision box that follows a bone
+// Arguments:	The bone and the box in the space of that bone
+///////////////////////////////////////////////////////////////////////////////
+void CPhysEnv::AttachCollisionBox(t_Bone* bone, tCollisionBox* local)
+{
+	m_BoneColliders->AttachBox(bone, *local);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Function:	AttachCollisionCapsule
+// Purpose:		Add a collision capsule that follows a bone
+// Arguments:	The bone and the capsule in the space of that bone
+///////////////////////////////////////////////////////////////////////////////
+void CPhysEnv::AttachCollisionCapsule(t_Bone* bone, tCollisionCapsule* local)
+{
+	m_BoneColliders->AttachCapsule(bone, *local);
+}
+
+BOOL CPhysEnv::HasBoneColliders()
+{
+	return !m_BoneColliders->Empty() || m_BoneColliders->MeshCount() > 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Function:	AddCollisionMesh
+// Purpose:		Add a triangle mesh the cloth can not pass through
+// Arguments:	The vertices and three vertex indices per triangle
+// Returns:		The index of the mesh
+// Notes:		The mesh is tested continuously, so it stops fast cloth and
+//				thin sheets the other colliders would let tunnel through
+///////////////////////////////////////////////////////////////////////////////
+int CPhysEnv::AddCollisionMesh(tVector* vertices, int vertexCnt, int* triangles, int triangleCnt)
+{
+	return m_MeshColliders->AddMesh(vertices, vertexCnt, triangles, triangleCnt);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Function:	AttachCollisionMesh
+// Purpose:		Add a triangle mesh that follows a bone
+// Arguments:	The bone, the vertices in the space of that bone and three
+//				vertex indices per triangle
+// Returns:		The index of the mesh
+// Notes:		Each frame the vertices move in a straight line from where the
+//				bone was to where it is. The bone must stay alive until
+//				FreeSystem
+///////////////////////////////////////////////////////////////////////////////
+int CPhysEnv::AttachCollisionMesh(t_Bone* bone, tVector* vertices, int vertexCnt, int* triangles, int triangleCnt)
+{
+	/// Local Variables ///////////////////////////////////////////////////////////
+	std::vector<tVector>	posed(vertexCnt);
+	///////////////////////////////////////////////////////////////////////////////
+	m_BoneColliders->AttachMesh(bone, m_MeshColliders->MeshCount(), vertices, vertexCnt, posed.data());
+	return m_MeshColliders->AddMesh(posed.data(), vertexCnt, triangles, triangleCnt);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Function:	PrepareCollisionScene
+// Purpose:		Lays out the colliders tested this frame, the static ones first
+//				and the bone ones after them
+// Notes:		Done once per frame so the static colliders are only copied
+//				once, PoseBoneColliders then only rewrites the tail
+///////////////////////////////////////////////////////////////////////////////
+void CPhysEnv::PrepareCollisionScene()
+{
+	/// Local Variables ///////////////////////////////////////////////////////////
+	tVector		still;
+	///////////////////////////////////////////////////////////////////////////////
+	MAKEVECTOR(still, 0.0f, 0.0f, 0.0f)
+	m_SceneSphere.assign(m_Sphere, m_Sphere + m_SphereCnt);
+	m_SceneBox.assign(m_Box, m_Box + m_BoxCnt);
+	m_SceneCapsule.assign(m_Capsule, m_Capsule + m_CapsuleCnt);
+	m_SceneSphere.resize(m_SphereCnt + m_BoneColliders->SphereCount());
+	m_SceneBox.resize(m_BoxCnt + m_BoneColliders->BoxCount());
+	m_SceneCapsule.resize(m_CapsuleCnt + m_BoneColliders->CapsuleCount());
+	m_SceneMotion.assign(m_SceneSphere.size() + m_SceneBox.size() + (m_SceneCapsule.size() * 2), still);
+	m_ScenePrevious = NULL;
+	// PUT THE BONE COLLIDERS WHERE THE FRAME ENDS UNTIL A STEP POSES THEM
+	if (!m_BoneColliders->Empty())
+		PoseBoneColliders(1.0f, 1.0f, 0.0f);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Function:	PoseBoneColliders
+// Purpose:		Moves the bone colliders of the scene to a point of the frame
+// Arguments:	Fractions of the frame where the step starts and ends, and the
+//				length of the step
+// Notes:		The motion of the static colliders stays zero
+///////////////////////////////////////////////////////////////////////////////
+void CPhysEnv::PoseBoneColliders(float from, float to, float stepTime)
+{
+	/// Local Variables ///////////////////////////////////////////////////////////
+	tVector*	boxMotion = m_SceneMotion.data() + m_SceneSphere.size();
+	tVector*	capsuleMotion = boxMotion + m_SceneBox.size();
+	///////////////////////////////////////////////////////////////////////////////
+	m_BoneColliders->Pose(from, to,
+		m_SceneSphere.data() + m_SphereCnt, m_SceneMotion.data() + m_SphereCnt,
+		m_SceneBox.data() + m_BoxCnt, boxMotion + m_BoxCnt,
+		m_SceneCapsule.data() + m_CapsuleCnt, capsuleMotion + (m_CapsuleCnt * 2));
+	m_SceneStepTime = stepTime;
+}
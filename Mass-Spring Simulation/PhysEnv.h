@@ -10,6 +10,8 @@
 #define EPSILON  0.000001f				// ERROR TERM
 #define DEFAULT_DAMPING		0.002f
 #define OUTPUT_TO_FILE ( ( bool ) true )
+#define OUTPUT_POINT_CACHE ( ( bool ) false )
+#define OUTPUT_FRAMES ( ( bool ) false )
 
 enum tCollisionTypes
 {
@@ -29,6 +31,15 @@ enum tIntegratorTypes
 };
 
 
+// THE SHAPES THE USER CAN ADD NEXT TO THE SPHERES
+enum tColliderShapes
+{
+	COLLIDER_PLANE,
+	COLLIDER_BOX,
+	COLLIDER_CAPSULE,
+	COLLIDER_MESH				// LOADED FROM AN OBJ FILE
+};
+
 // CLASSIFY THE SPRINGS SO I CAN HANDLE THEM SEPARATELY
 enum tSpringTypes
 {
@@ -37,6 +48,7 @@ enum tSpringTypes
 	SHEAR_SPRING,
 	BEND_SPRING
 };
+#define SPRING_TYPE_CNT		( BEND_SPRING + 1 )
 
 // TYPE FOR A PLANE THAT THE SYSTEM WILL COLLIDE WITH
 struct tCollisionPlane
@@ -71,6 +83,7 @@ struct tContact
 {
 	int		particle;	// Particle Index
     tVector normal;		// Normal of Collision plane
+	tVector velocity;	// Velocity of the collider at the contact
 };
 
 // TYPE FOR COLLISION SPHERES IN SYSTEM
@@ -80,6 +93,21 @@ struct tCollisionSphere
     tVector pos;		// POSITION OF SPHERE
 };
 
+// TYPE FOR ORIENTED COLLISION BOXES IN SYSTEM
+struct tCollisionBox
+{
+	tVector center;		// CENTER OF BOX
+	tVector axis[3];	// ORTHONORMAL LOCAL AXES IN WORLD SPACE
+	tVector halfSize;	// HALF THE SIZE ALONG EACH LOCAL AXIS
+};
+
+// TYPE FOR COLLISION CAPSULES IN SYSTEM (A SPHERE SWEPT ALONG A SEGMENT)
+struct tCollisionCapsule
+{
+	tVector p1,p2;		// ENDS OF THE CENTER SEGMENT
+	float	radius;		// RADIUS AROUND THE SEGMENT
+};
+
 // TYPE FOR SPRINGS IN SYSTEM
 struct tSpring
 {
@@ -91,10 +119,38 @@ struct tSpring
 };
 
 #include <tuple>
-#include <fstream>
-#include <sstream>
+#include <atomic>
+#include <vector>
+#include "PerThreadBuffer.h"
+#include "VertexStream.h"
+#include "Diagnostics.h"
 using namespace std;
 
+struct t_Bone;
+struct tCollisionScene;
+class CBoneColliders;
+class CMeshColliders;
+class CTrajectoryRecorder;
+class CTrajectoryPlayer;
+class CPointCacheWriter;
+class CFrameCapture;
+class CSpringRenderer;
+class CPickTree;
+class CDiagnostics;
+struct tSceneView;
+class CSnapshotWriter;
+class CSnapshotReader;
+class CSnapshotCursor;
+
+#define COLLISION_GRAIN		2048		// PARTICLES HANDED TO A WORKER AT A TIME WHEN CHECKING COLLISIONS
+#define COLLISION_SLICE		256			// PARTICLES CHECKED BEFORE LOOKING FOR A PENETRATION IN ANOTHER CHUNK
+#define RESOLVE_GRAIN		1024		// CONTACTS HANDED TO A WORKER AT A TIME WHEN RESOLVING
+#define WORLD_PLANE_CNT		6			// THE WALLS OF THE WORLD BOX COME FIRST IN THE PLANE LIST
+#define COLLISION_DEPTH		0.001f		// HOW CLOSE TO A COLLIDER A PARTICLE IS TOUCHING IT
+#define MIN_IMPACT_STEP		0.05f		// SMALLEST AND LARGEST PART OF A STEP TO BACK UP TO WHEN
+#define MAX_IMPACT_STEP		0.95f		// A MESH GIVES THE TIME OF IMPACT
+#define HEUN_MAX_CORRECTIONS	8			// CORRECTOR PASSES OF A HEUN STEP THAT DOES NOT SETTLE
+
 class CPhysEnv
 {
 // Construction
@@ -107,24 +163,47 @@ public:
 	void Simulate(float DeltaTime,BOOL running);
 	void ApplyUserForce(tVector *force);
 	void SetMouseForce(int deltaX,int deltaY, tVector *localX, tVector *localY);
-	void GetNearestPoint(int x, int y);
+	void GetNearestPoint(int x, int y, tMatrix *modelView, tMatrix *projection, int *viewport);
 	void AddSpring();
 	void AddSpring(int v1, int v2,float Ksh,float Ksd, int type);
 	void SetWorldProperties();
 	void SetVertexProperties();
 	void FreeSystem();
-	void LoadData(FILE *fp);
-	void SaveData(FILE *fp);
+	BOOL LoadLegacy(CSnapshotCursor &cursor);
+	BOOL LoadSnapshot(const CSnapshotReader &reader);
+	void SaveSnapshot(CSnapshotWriter &writer);
+	BOOL LoadBoneColliders(const CSnapshotReader &reader, t_Bone *skeleton);
+	void SaveBoneColliders(CSnapshotWriter &writer, t_Bone *skeleton);
+	void ExportScene(tSceneView *scene);
+	void ImportScene(const tSceneView *scene);
 	void AddCollisionSphere();
-    std::tuple < float , float , float > CalculateError ( bool reverse = false ) const;
-    void OutputErrorToCsV ( std::tuple < float , float , float > error , float time );
+	void AddCollisionPlane(tVector *normal, float d);
+	void AddCollisionBox(tVector *center, tVector *halfSize, tVector *axis);
+	void AddCollisionCapsule(tVector *p1, tVector *p2, float radius);
+	void AttachCollisionSphere(t_Bone *bone, tCollisionSphere *local);
+	void AttachCollisionBox(t_Bone *bone, tCollisionBox *local);
+	void AttachCollisionCapsule(t_Bone *bone, tCollisionCapsule *local);
+	BOOL HasBoneColliders();
+	int AddCollisionMesh(tVector *vertices, int vertexCnt, int *triangles, int triangleCnt);
+	int AttachCollisionMesh(t_Bone *bone, tVector *vertices, int vertexCnt, int *triangles, int triangleCnt);
+    std::tuple < float , float , float > CalculateError () const;
+	const tDiagnostics & Diagnostics() const;
+	void SetDiagnosticsInterval(int steps);
+	void RecordFrame(float time);
+	void StopRecording();
+	const char *RecordingName() const;
+	BOOL ReplayFrame(CTrajectoryPlayer *player, int frame);
+	BOOL ExportParticles(const char *filename);
+	tVertexStream PositionStream() const;
+	int SpringCount() const;
+	void SetCaptureView(tMatrix *modelView);
     BOOL				m_UseGravity;			// SHOULD GRAVITY BE ADDED IN
 	BOOL				m_UseDamping;			// SHOULD DAMPING BE ON
 	BOOL				m_UserForceActive;		// WHEN USER FORCE IS APPLIED
 	BOOL				m_DrawSprings;			// DRAW THE SPRING LINES
 	BOOL				m_DrawVertices;			// DRAW VERTICES
 	BOOL				m_MouseForceActive;		// MOUSE DRAG FORCE
-	BOOL				m_CollisionActive;		// COLLISION SPHERES ACTIVE
+	BOOL				m_CollisionActive;		// COLLISION SPHERES, BOXES, CAPSULES AND MESHES ACTIVE
 	BOOL				m_CollisionRootFinding;	// AM I SEARCHING FOR A COLLISION
 	BOOL				m_DrawStructural;		// DRAW STRUCTURAL CLOTH SPRINGS
 	BOOL				m_DrawShear;			// DRAW SHEAR CLOTH SPRINGS
@@ -142,9 +221,9 @@ private:
 	float				m_Ksh;					// HOOK'S SPRING CONSTANT
 	float				m_Ksd;					// SPRING DAMPING
 	float				m_MouseForceKs;			// MOUSE SPRING COEFFICIENT
-	tCollisionPlane		*m_CollisionPlane;		// LIST OF COLLISION PLANES
+	tCollisionPlane		*m_CollisionPlane;		// LIST OF COLLISION PLANES, WORLD WALLS THEN USER PLANES
 	int					m_CollisionPlaneCnt;			
-	tContact			*m_Contact;				// LIST OF POSSIBLE COLLISIONS
+	CPerThreadBuffer<tContact>	m_Contact;		// LIST OF POSSIBLE COLLISIONS, ONE STREAM PER WORKER
 	int					m_ContactCnt;			// COLLISION COUNT
 	tParticle			*m_ParticleSys[3];		// LIST OF PHYSICAL PARTICLES
 	tParticle			*m_CurrentSys,*m_TargetSys;
@@ -152,10 +231,37 @@ private:
 	int					m_ParticleCnt;
 	tSpring				*m_Spring;				// VALID SPRINGS IN SYSTEM
 	int					m_SpringCnt;		
+	int					m_SpringCapacity;		// SPRINGS ALLOCATED, THE LIST GROWS BY DOUBLING
 	int					m_Pick[2];				// INDEX COUNTERS FOR SELECTING
 	tVector				m_MouseDragPos[2];		// POSITION OF DRAGGED MOUSE VECTOR
 	tCollisionSphere	*m_Sphere;
 	int					m_SphereCnt;
+	tCollisionBox		*m_Box;
+	int					m_BoxCnt;
+	tCollisionCapsule	*m_Capsule;
+	int					m_CapsuleCnt;
+	CBoneColliders		*m_BoneColliders;		// COLLIDERS THAT FOLLOW THE SKELETON
+	std::vector<tCollisionSphere>	m_SceneSphere;	// STATIC SPHERES THEN BONE SPHERES AS TESTED THIS STEP
+	std::vector<tCollisionBox>		m_SceneBox;		// STATIC BOXES THEN BONE BOXES
+	std::vector<tCollisionCapsule>	m_SceneCapsule;	// STATIC CAPSULES THEN BONE CAPSULES
+	std::vector<tVector>			m_SceneMotion;	// HOW FAR EACH SCENE SPHERE, BOX AND CAPSULE END MOVED THIS STEP
+	tParticle			*m_ScenePrevious;		// PARTICLES AT THE START OF THE STEP, NULL WHEN NOTHING MOVES
+	float				m_SceneStepTime;
+	CMeshColliders		*m_MeshColliders;		// TRIANGLE MESHES TESTED ALONG THE WHOLE STEP
+	tParticle			*m_MeshPrevious;		// PARTICLES AT THE START OF THE STEP, NULL WHEN THE MESHES ARE NOT TESTED
+	float				m_ImpactTime;			// EARLIEST MESH IMPACT OF THE LAST PENETRATION, AS A FRACTION OF THE STEP
+	CTrajectoryRecorder	*m_Recorder;			// WRITES THE PARTICLES OF EVERY STEP ON ITS OWN THREAD
+	unsigned int		m_RecordedFrames;
+	int					m_RecordingNumber;		// THE FIRST trajectoryFileName THAT MAY STILL BE FREE
+	char				m_RecordingName[32];
+	CPointCacheWriter	*m_PointCache;			// STREAMS THE CLOTH TO A PC2 CACHE FOR ANIMATION PACKAGES
+	CFrameCapture		*m_FrameCapture;		// DRAWS IMAGES OF THE SIMULATION WITHOUT A WINDOW
+	CSpringRenderer		*m_SpringRenderer;		// DRAWS THE SPRINGS AND PARTICLES FROM BUFFER OBJECTS
+	CPickTree			*m_PickTree;			// FINDS THE PARTICLE UNDER THE MOUSE
+	CDiagnostics		*m_Diagnostics;			// SUMS UP THE ENERGY, MOMENTUM AND STRAIN OF THE SYSTEM
+	tDiagnostics		m_LastDiagnostics;		// THE LAST SAMPLE TAKEN BY SIMULATE
+	int					m_DiagnosticsInterval;	// STEPS BETWEEN TWO SAMPLES, 0 FOR NONE
+	int					m_StepsSinceDiagnostics;
 	int t = 0;
 // Operations
 private:
@@ -167,14 +273,25 @@ private:
 	void									HeunIntegrate ( float DeltaTime );
 	void									EulerIntegrate ( float DeltaTime );
 	void									ComputeForces ( tParticle * system );
+	void									AllocateSystem ( int particleCnt );
+	tSpring *								NewSpring ();
 	int										CheckForCollisions ( tParticle * system );
+	int										CheckForCollisions ( tParticle * system , int begin , int end , const tCollisionScene & scene , std::vector < tContact > & contacts , const std::atomic < bool > & penetrating );
+	void									PrepareCollisionScene ();
+	void									PoseBoneColliders ( float from , float to , float stepTime );
+	void									SaveCollisionMeshes ( CSnapshotWriter & writer , t_Bone * skeleton );
+	BOOL									LoadCollisionMeshes ( const CSnapshotReader & reader , t_Bone * skeleton );
 	void									ResolveCollisions ( tParticle * system );
-	void									CompareBuffer ( int size , float * buffer , float x , float y );
+	void									GetParams ( CSnapshotCursor & cursor );
+	BOOL									GetParticles ( CSnapshotCursor & cursor );
+	void									SetUserPlanes ( tCollisionPlane * planes , int planeCnt );
+	void									ValidatePicks ();
+	const char *							NextRecordingName ();
 	void									Logging ();
-	std::string								ParticleCsvLine ( tParticle * particle );
     float									CalculateTwoSystemError ( tParticle* systemOne , tParticle* systemTwo , int particleCount ) const;
-	std::basic_ofstream < char >			testFile;
-	char *									testFileName = "adaptivetest2.csv";
+	char *									trajectoryFileName = "trajectory%04d.trj";
+	char *									pointCacheFileName = "cloth.pc2";
+	char *									frameFileName = "frame%05d.ppm";
 
 // Implementation
 public:
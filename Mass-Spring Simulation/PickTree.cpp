@@ -0,0 +1,278 @@
+#include "stdafx.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include "PickTree.h"
+#include "ThreadPool.h"
+
+#define MORTON_BITS				10			// BITS PER AXIS OF THE SORT KEY
+
+/**
+ * \brief Projects points from the world to the window.
+ */
+struct CPickTree::tView
+{
+    float m [ 16 ];				// PROJECTION TIMES MODELVIEW, COLUMN MAJOR LIKE OPENGL
+    float viewport [ 4 ];
+    tView ( const tMatrix & modelView , const tMatrix & projection , const int port [ 4 ] )
+    {
+        for ( int column = 0; column < 4; ++column )
+        {
+            for ( int row = 0; row < 4; ++row )
+            {
+                float sum = 0.0f;
+                for ( int k = 0; k < 4; ++k )
+                {
+                    sum += projection.m [ k * 4 + row ] * modelView.m [ column * 4 + k ];
+                }
+                this->m [ column * 4 + row ] = sum;
+            }
+        }
+        for ( int i = 0; i < 4; ++i )
+        {
+            this->viewport [ i ] = static_cast < float > ( port [ i ] );
+        }
+    }
+    void Clip ( const float x , const float y , const float z , float clip [ 4 ] ) const
+    {
+        for ( int row = 0; row < 4; ++row )
+        {
+            clip [ row ] = this->m [ row ] * x + this->m [ 4 + row ] * y + this->m [ 8 + row ] * z + this->m [ 12 + row ];
+        }
+    }
+    float WindowX ( const float clip [ 4 ] ) const { return this->viewport [ 0 ] + ( clip [ 0 ] / clip [ 3 ] + 1.0f ) * 0.5f * this->viewport [ 2 ]; }
+    float WindowY ( const float clip [ 4 ] ) const { return this->viewport [ 1 ] + ( clip [ 1 ] / clip [ 3 ] + 1.0f ) * 0.5f * this->viewport [ 3 ]; }
+    /**
+     * \brief The squared distance in pixels from a point to where a particle is drawn, infinite when the particle is clipped away.
+     */
+    float Distance ( const tVector & position , const float x , const float y ) const
+    {
+        float clip [ 4 ];
+        this->Clip ( position.x , position.y , position.z , clip );
+        const float w = clip [ 3 ];
+        if ( ! ( w > 0.0f && std::fabs ( clip [ 0 ] ) <= w && std::fabs ( clip [ 1 ] ) <= w && std::fabs ( clip [ 2 ] ) <= w ) )
+        {
+            return std::numeric_limits < float >::infinity ();
+        }
+        const float dx = this->WindowX ( clip ) - x , dy = this->WindowY ( clip ) - y;
+        return dx * dx + dy * dy;
+    }
+    /**
+     * \brief The squared distance in pixels from a point to the nearest place anything in a box can be drawn, never more than the truth.
+     */
+    float Bound ( const tVector & min , const tVector & max , const float x , const float y ) const
+    {
+        int outside [ 6 ] = { 0 };
+        bool behind = false;
+        float low [ 2 ] = { std::numeric_limits < float >::max () , std::numeric_limits < float >::max () };
+        float high [ 2 ] = { -std::numeric_limits < float >::max () , -std::numeric_limits < float >::max () };
+        for ( int corner = 0; corner < 8; ++corner )
+        {
+            float clip [ 4 ];
+            this->Clip ( corner & 1 ? max.x : min.x , corner & 2 ? max.y : min.y , corner & 4 ? max.z : min.z , clip );
+            for ( int axis = 0; axis < 3; ++axis )
+            {
+                outside [ 2 * axis ] += clip [ axis ] < -clip [ 3 ];
+                outside [ 2 * axis + 1 ] += clip [ axis ] > clip [ 3 ];
+            }
+            if ( clip [ 3 ] <= 0.0f )
+            {
+                behind = true;
+                continue;
+            }
+            const float window [ 2 ] = { this->WindowX ( clip ) , this->WindowY ( clip ) };
+            for ( int axis = 0; axis < 2; ++axis )
+            {
+                low [ axis ] = std::min ( low [ axis ] , window [ axis ] );
+                high [ axis ] = std::max ( high [ axis ] , window [ axis ] );
+            }
+        }
+        // A BOX ENTIRELY PAST ONE PLANE IS CLIPPED AWAY
+        if ( std::find ( outside , outside + 6 , 8 ) != outside + 6 )
+        {
+            return std::numeric_limits < float >::infinity ();
+        }
+        // A BOX REACHING BEHIND THE EYE CAN BE DRAWN ANYWHERE
+        if ( behind )
+        {
+            return 0.0f;
+        }
+        const float dx = std::max ( std::max ( low [ 0 ] - x , x - high [ 0 ] ) , 0.0f );
+        const float dy = std::max ( std::max ( low [ 1 ] - y , y - high [ 1 ] ) , 0.0f );
+        return dx * dx + dy * dy;
+    }
+};
+
+/**
+ * \brief Spreads the low MORTON_BITS bits of a value three bits apart.
+ */
+static std::uint32_t SpreadBits ( std::uint32_t value )
+{
+    value = ( value | ( value << 16 ) ) & 0x030000FF;
+    value = ( value | ( value << 8 ) ) & 0x0300F00F;
+    value = ( value | ( value << 4 ) ) & 0x030C30C3;
+    value = ( value | ( value << 2 ) ) & 0x09249249;
+    return value;
+}
+
+CPickTree::CPickTree () : particleCnt_ ( 0 )
+{
+}
+
+void CPickTree::Build ( const tParticle * system , const int particleCnt )
+{
+    const int leafCnt = ( particleCnt + PICK_LEAF - 1 ) / PICK_LEAF;
+    std::vector < tVector > centers ( leafCnt );
+    tVector min , max;
+    MAKEVECTOR ( min , std::numeric_limits < float >::max () , std::numeric_limits < float >::max () , std::numeric_limits < float >::max () );
+    MAKEVECTOR ( max , -std::numeric_limits < float >::max () , -std::numeric_limits < float >::max () , -std::numeric_limits < float >::max () );
+    for ( int leaf = 0; leaf < leafCnt; ++leaf )
+    {
+        const int begin = leaf * PICK_LEAF , end = std::min ( begin + PICK_LEAF , particleCnt );
+        tVector & center = centers [ leaf ];
+        MAKEVECTOR ( center , 0.0f , 0.0f , 0.0f );
+        for ( int i = begin; i < end; ++i )
+        {
+            center.x += system [ i ].pos.x; center.y += system [ i ].pos.y; center.z += system [ i ].pos.z;
+        }
+        center.x /= end - begin; center.y /= end - begin; center.z /= end - begin;
+        if ( std::isfinite ( center.x ) && std::isfinite ( center.y ) && std::isfinite ( center.z ) )
+        {
+            min.x = std::min ( min.x , center.x ); min.y = std::min ( min.y , center.y ); min.z = std::min ( min.z , center.z );
+            max.x = std::max ( max.x , center.x ); max.y = std::max ( max.y , center.y ); max.z = std::max ( max.z , center.z );
+        }
+    }
+    const float cells = static_cast < float > ( ( 1 << MORTON_BITS ) - 1 );
+    const float scale [ 3 ] = { max.x > min.x ? cells / ( max.x - min.x ) : 0.0f , max.y > min.y ? cells / ( max.y - min.y ) : 0.0f , max.z > min.z ? cells / ( max.z - min.z ) : 0.0f };
+    std::vector < std::pair < std::uint32_t , int > > keys ( leafCnt );
+    for ( int leaf = 0; leaf < leafCnt; ++leaf )
+    {
+        const tVector & p = centers [ leaf ];
+        std::uint32_t key = 0;
+        if ( std::isfinite ( p.x ) && std::isfinite ( p.y ) && std::isfinite ( p.z ) )
+        {
+            key = SpreadBits ( static_cast < std::uint32_t > ( ( p.x - min.x ) * scale [ 0 ] ) ) | SpreadBits ( static_cast < std::uint32_t > ( ( p.y - min.y ) * scale [ 1 ] ) ) << 1 | SpreadBits ( static_cast < std::uint32_t > ( ( p.z - min.z ) * scale [ 2 ] ) ) << 2;
+        }
+        keys [ leaf ] = std::make_pair ( key , leaf );
+    }
+    std::sort ( keys.begin () , keys.end () );
+    std::vector < int > order ( leafCnt );
+    for ( int i = 0; i < leafCnt; ++i )
+    {
+        order [ i ] = keys [ i ].second;
+    }
+    this->particleCnt_ = particleCnt;
+    this->nodes_.clear ();
+    this->nodes_.reserve ( 2 * static_cast < std::size_t > ( leafCnt ) );
+    this->leaves_.resize ( leafCnt );
+    this->BuildNode ( order , 0 , leafCnt );
+}
+
+int CPickTree::BuildNode ( const std::vector < int > & order , const int begin , const int end )
+{
+    const int self = static_cast < int > ( this->nodes_.size () );
+    tNode node;
+    node.right = -1;
+    node.begin = node.end = 0;
+    this->nodes_.push_back ( node );
+    if ( end - begin == 1 )
+    {
+        const int leaf = order [ begin ];
+        this->nodes_ [ self ].begin = leaf * PICK_LEAF;
+        this->nodes_ [ self ].end = std::min ( ( leaf + 1 ) * PICK_LEAF , this->particleCnt_ );
+        this->leaves_ [ leaf ] = self;
+        return self;
+    }
+    const int middle = begin + ( end - begin ) / 2;
+    this->BuildNode ( order , begin , middle );
+    this->nodes_ [ self ].right = this->BuildNode ( order , middle , end );
+    return self;
+}
+
+void CPickTree::Refit ( const tParticle * system )
+{
+    tNode * nodes = this->nodes_.data ();
+    const int * leaves = this->leaves_.data ();
+    // THE LEAVES ARE IN PARTICLE ORDER, SO THIS READS THE PARTICLES FROM FIRST TO LAST
+    CThreadPool::Instance ().ParallelFor ( static_cast < int > ( this->leaves_.size () ) , PICK_GRAIN , [ nodes , leaves , system ] ( const int begin , const int end , const int )
+    {
+        for ( int leaf = begin; leaf < end; ++leaf )
+        {
+            tNode & node = nodes [ leaves [ leaf ] ];
+            // KEPT IN LOCALS, THE NODE COULD ALIAS THE PARTICLES AS FAR AS THE COMPILER KNOWS
+            tVector min = system [ node.begin ].pos , max = min;
+            for ( int i = node.begin + 1; i < node.end; ++i )
+            {
+                const tVector & p = system [ i ].pos;
+                min.x = std::min ( min.x , p.x ); min.y = std::min ( min.y , p.y ); min.z = std::min ( min.z , p.z );
+                max.x = std::max ( max.x , p.x ); max.y = std::max ( max.y , p.y ); max.z = std::max ( max.z , p.z );
+            }
+            node.min = min;
+            node.max = max;
+        }
+    } );
+    // CHILDREN COME AFTER THEIR PARENT, SO GOING BACKWARDS FITS THEM FIRST
+    for ( int at = static_cast < int > ( this->nodes_.size () ) - 1; at >= 0; --at )
+    {
+        tNode & node = nodes [ at ];
+        if ( node.right >= 0 )
+        {
+            const tNode & left = nodes [ at + 1 ] , & right = nodes [ node.right ];
+            node.min.x = std::min ( left.min.x , right.min.x ); node.min.y = std::min ( left.min.y , right.min.y ); node.min.z = std::min ( left.min.z , right.min.z );
+            node.max.x = std::max ( left.max.x , right.max.x ); node.max.y = std::max ( left.max.y , right.max.y ); node.max.z = std::max ( left.max.z , right.max.z );
+        }
+    }
+}
+
+int CPickTree::Pick ( const tParticle * system , const int particleCnt , const float x , const float y , const tMatrix & modelView , const tMatrix & projection , const int viewport [ 4 ] )
+{
+    if ( particleCnt <= 0 )
+    {
+        return -1;
+    }
+    if ( this->leaves_.empty () || this->particleCnt_ != particleCnt )
+    {
+        this->Build ( system , particleCnt );
+    }
+    this->Refit ( system );
+    const tView view ( modelView , projection , viewport );
+    // THE NEAREST FIRST, THE LOWEST INDEX BETWEEN PARTICLES AT THE SAME DISTANCE
+    float nearest = PICK_RADIUS * PICK_RADIUS;
+    int result = -1;
+    std::vector < std::pair < float , int > > stack;
+    stack.push_back ( std::make_pair ( view.Bound ( this->nodes_ [ 0 ].min , this->nodes_ [ 0 ].max , x , y ) , 0 ) );
+    while ( ! stack.empty () )
+    {
+        const std::pair < float , int > top = stack.back ();
+        stack.pop_back ();
+        if ( ! ( top.first <= nearest ) )
+        {
+            continue;
+        }
+        const tNode & node = this->nodes_ [ top.second ];
+        if ( node.right < 0 )
+        {
+            for ( int particle = node.begin; particle < node.end; ++particle )
+            {
+                const float distance = view.Distance ( system [ particle ].pos , x , y );
+                if ( distance < nearest || ( distance == nearest && result >= 0 && particle < result ) )
+                {
+                    nearest = distance;
+                    result = particle;
+                }
+            }
+            continue;
+        }
+        const tNode & left = this->nodes_ [ top.second + 1 ] , & right = this->nodes_ [ node.right ];
+        std::pair < float , int > closer ( view.Bound ( left.min , left.max , x , y ) , top.second + 1 );
+        std::pair < float , int > farther ( view.Bound ( right.min , right.max , x , y ) , node.right );
+        if ( farther.first < closer.first )
+        {
+            std::swap ( closer , farther );
+        }
+        stack.push_back ( farther );
+        stack.push_back ( closer );
+    }
+    return result;
+}
@@ -0,0 +1,54 @@
+#if !defined(PICKTREE_H__INCLUDED_)
+#define PICKTREE_H__INCLUDED_
+
+#include <cstdint>
+#include <vector>
+#include "PhysEnv.h"
+
+#define PICK_LEAF				16			// PARTICLES IN A LEAF OF THE TREE
+#define PICK_GRAIN				256			// LEAVES REFITTED BY A WORKER AT A TIME
+#define PICK_RADIUS				7.07f		// FARTHEST A PARTICLE CAN BE FROM THE CLICK, IN PIXELS
+
+/**
+ * \brief Finds the particle drawn nearest to a point of the window, on the CPU.
+ *
+ * The particles are grouped into a tree of boxes. Each leaf holds PICK_LEAF particles that follow each other, which are close together in a
+ * cloth or a mesh, and the leaves are sorted along a Morton curve to group them further. The grouping is made once and kept while the cloth
+ * moves: each pick only refits the boxes to the current positions, a single pass over the particles in memory order. The search then
+ * projects the corners of a box with the view matrices, skips every box whose projection is farther from the click than the best particle
+ * found so far and goes down the nearer child first, so it looks at a few leaves instead of every particle.
+ *
+ * A particle counts where the old feedback picking put it: projected with the matrices, in the window and between the clipping planes.
+ */
+class CPickTree
+{
+public:
+    CPickTree ();
+    /**
+     * \brief Groups the particles again at the next pick. Called when the particles are replaced.
+     */
+    void Invalidate () { this->leaves_.clear (); }
+    /**
+     * \param x , y The point in window coordinates, y going up.
+     * \param modelView , projection The matrices the particles are drawn with.
+     * \param viewport The viewport as given to glViewport.
+     * \return The nearest particle within PICK_RADIUS pixels, -1 when there is none.
+     */
+    int Pick ( const tParticle * system , int particleCnt , float x , float y , const tMatrix & modelView , const tMatrix & projection , const int viewport [ 4 ] );
+private:
+    struct tNode
+    {
+        tVector min , max;
+        int begin , end;			// THE PARTICLES OF A LEAF
+        int right;					// THE SECOND CHILD, THE FIRST ONE FOLLOWS THE NODE. -1 FOR A LEAF
+    };
+    struct tView;
+    void Build ( const tParticle * system , int particleCnt );
+    int BuildNode ( const std::vector < int > & order , int begin , int end );
+    void Refit ( const tParticle * system );
+    int particleCnt_;
+    std::vector < tNode > nodes_;	// DEPTH FIRST, SO EVERY CHILD COMES AFTER ITS PARENT
+    std::vector < int > leaves_;		// THE NODE OF EACH RUN OF PICK_LEAF PARTICLES
+};
+
+#endif // !defined(PICKTREE_H__INCLUDED_)
@@ -0,0 +1,211 @@
+#include "stdafx.h"
+#include <algorithm>
+#include <cstring>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+#include "PointCache.h"
+#include "Snapshot.h"
+
+#define PC2_HEADER_SIZE			32
+#define PC2_COUNT_OFFSET		28			// WHERE THE SAMPLE COUNT IS IN THE HEADER
+
+static const char PC2_SIGNATURE [ 12 ] = { 'P' , 'O' , 'I' , 'N' , 'T' , 'C' , 'A' , 'C' , 'H' , 'E' , '2' , '\0' };
+
+/**
+ * \brief Writes 32 bit words little endian whatever the machine.
+ */
+static bool WriteWords ( FILE * fp , void * words , const std::size_t count )
+{
+    if ( ! LittleEndian () )
+    {
+        SwapWords ( static_cast < unsigned char * > ( words ) , count * 4 , 4 );
+    }
+    return fwrite ( words , 4 , count , fp ) == count;
+}
+
+CPointCacheWriter::CPointCacheWriter () : fp_ ( NULL ) , vertexCnt_ ( 0 ) , particleCnt_ ( 0 ) , nextTime_ ( -1.0 ) , samples_ ( 0 ) , held_ ( 0 ) , missed_ ( 0 ) , written_ ( 0 ) , failed_ ( false )
+{
+    this->options_.rate = POINTCACHE_RATE;
+    this->options_.policy = RECORDER_BLOCK;
+    this->options_.sync = POINTCACHE_SYNC_CLOSE;
+    this->options_.syncFrames = POINTCACHE_SYNC_FRAMES;
+}
+
+CPointCacheWriter::~CPointCacheWriter ()
+{
+    this->Close ();
+}
+
+bool CPointCacheWriter::Open ( const char * filename , const int vertexCnt , const int particleCnt , const int * particleOfVertex )
+{
+    this->Close ();
+    if ( particleOfVertex == NULL ? vertexCnt != particleCnt : std::any_of ( particleOfVertex , particleOfVertex + vertexCnt , [ particleCnt ] ( int particle ) { return particle < 0 || particle >= particleCnt; } ) )
+    {
+        return false;
+    }
+    this->fp_ = fopen ( filename , "wb" );
+    if ( this->fp_ == NULL )
+    {
+        return false;
+    }
+    // THE SAMPLE COUNT STAYS ZERO UNTIL THE SAMPLES ARE IN THE FILE
+    std::uint32_t header [ ( PC2_HEADER_SIZE - sizeof ( PC2_SIGNATURE ) ) / 4 ];
+    const float startFrame = 0.0f , sampleRate = 1.0f;
+    header [ 0 ] = 1;
+    header [ 1 ] = static_cast < std::uint32_t > ( vertexCnt );
+    std::memcpy ( &header [ 2 ] , &startFrame , 4 );
+    std::memcpy ( &header [ 3 ] , &sampleRate , 4 );
+    header [ 4 ] = 0;
+    this->failed_ = fwrite ( PC2_SIGNATURE , sizeof ( PC2_SIGNATURE ) , 1 , this->fp_ ) != 1 || ! WriteWords ( this->fp_ , header , 5 );
+    this->vertexCnt_ = vertexCnt;
+    this->particleCnt_ = particleCnt;
+    if ( particleOfVertex != NULL )
+    {
+        this->particleOfVertex_.assign ( particleOfVertex , particleOfVertex + vertexCnt );
+    }
+    else
+    {
+        this->particleOfVertex_.clear ();
+    }
+    this->out_.resize ( 3 * static_cast < std::size_t > ( vertexCnt ) );
+    std::vector < tSample > & slots = this->ring_.Slots ();
+    slots.resize ( POINTCACHE_SLOTS );
+    for ( tSample & slot : slots )
+    {
+        slot.positions.resize ( particleCnt );
+    }
+    this->nextTime_ = -1.0;
+    this->samples_ = 0;
+    this->held_ = 0;
+    this->missed_ = 0;
+    this->written_ = 0;
+    this->ring_.Start ( this->options_.policy , [ this ] ( tSample & sample ) { this->WriteSample ( sample ); } );
+    return true;
+}
+
+int CPointCacheWriter::Capture ( const float time , const tParticle * system )
+{
+    if ( ! this->ring_.Running () )
+    {
+        return 0;
+    }
+    if ( this->nextTime_ < 0.0 )
+    {
+        this->nextTime_ = time;
+    }
+    // A STEP LONGER THAN A SAMPLE GIVES THE SAME STATE TO EACH SAMPLE IT COVERS, SO THE CACHE KEEPS ITS RATE. THE STATE IS COPIED ONCE
+    int covered = 0;
+    while ( time >= this->nextTime_ )
+    {
+        ++covered;
+        this->nextTime_ += 1.0 / this->options_.rate;
+    }
+    if ( covered == 0 )
+    {
+        return 0;
+    }
+    tSample * sample = this->ring_.Acquire ();
+    if ( sample == NULL )
+    {
+        // THE WRITER HOLDS THE SAMPLE BEFORE IN THEIR PLACE
+        this->missed_ += covered;
+        this->held_ += covered;
+    }
+    else
+    {
+        for ( int i = 0; i < this->particleCnt_; ++i )
+        {
+            sample->positions [ i ] = system [ i ].pos;
+        }
+        sample->held = this->missed_;
+        sample->repeats = covered;
+        this->missed_ = 0;
+        this->ring_.Publish ();
+    }
+    this->samples_ += covered;
+    return covered;
+}
+
+/**
+ * \brief Writes the sample in out_ count times.
+ */
+void CPointCacheWriter::WriteOut ( const int count )
+{
+    for ( int at = 0; at < count; ++at )
+    {
+        if ( ! this->failed_ && ! WriteWords ( this->fp_ , this->out_.data () , this->out_.size () ) )
+        {
+            this->failed_ = true;
+        }
+        ++this->written_;
+        if ( this->options_.sync == POINTCACHE_SYNC_PERIODIC && this->written_ % std::max ( this->options_.syncFrames , 1 ) == 0 )
+        {
+            this->failed_ = ! ( this->WriteCount () && this->Sync () ) || this->failed_;
+        }
+    }
+}
+
+void CPointCacheWriter::WriteSample ( const tSample & sample )
+{
+    // THE FIRST SAMPLE HAS NOTHING BEFORE IT TO HOLD, IT STANDS IN FOR THE ONES DROPPED AHEAD OF IT
+    const int held = this->written_ > 0 ? sample.held : 0;
+    this->WriteOut ( held );
+    float * out = this->out_.data ();
+    const bool mapped = ! this->particleOfVertex_.empty ();
+    for ( int v = 0; v < this->vertexCnt_; ++v )
+    {
+        const tVector & position = sample.positions [ mapped ? this->particleOfVertex_ [ v ] : v ];
+        out [ 3 * v ] = position.x;
+        out [ 3 * v + 1 ] = position.y;
+        out [ 3 * v + 2 ] = position.z;
+    }
+    this->WriteOut ( sample.repeats + sample.held - held );
+}
+
+/**
+ * \brief Puts the number of samples written in the header, leaving the file position at the end.
+ */
+bool CPointCacheWriter::WriteCount ()
+{
+    std::uint32_t count = static_cast < std::uint32_t > ( this->written_ );
+    return fseek ( this->fp_ , PC2_COUNT_OFFSET , SEEK_SET ) == 0 && WriteWords ( this->fp_ , &count , 1 ) && fseek ( this->fp_ , 0 , SEEK_END ) == 0;
+}
+
+bool CPointCacheWriter::Sync ()
+{
+    if ( fflush ( this->fp_ ) != 0 )
+    {
+        return false;
+    }
+#ifdef _WIN32
+    return _commit ( _fileno ( this->fp_ ) ) == 0;
+#else
+    return fsync ( fileno ( this->fp_ ) ) == 0;
+#endif
+}
+
+bool CPointCacheWriter::Close ()
+{
+    if ( this->fp_ == NULL )
+    {
+        return true;
+    }
+    this->ring_.Stop ();
+    // THE WRITER HAS STOPPED, THE SAMPLES DROPPED AT THE END ARE HELD HERE. A CACHE THAT NEVER GOT A SAMPLE THROUGH STAYS EMPTY
+    if ( this->written_ > 0 )
+    {
+        this->WriteOut ( this->missed_ );
+    }
+    this->missed_ = 0;
+    bool written = ! this->failed_ && this->WriteCount ();
+    if ( written && this->options_.sync != POINTCACHE_SYNC_NONE )
+    {
+        written = this->Sync ();
+    }
+    written = ( fclose ( this->fp_ ) == 0 ) && written;
+    this->fp_ = NULL;
+    return written;
+}
@@ -0,0 +1,98 @@
+#if !defined(POINTCACHE_H__INCLUDED_)
+#define POINTCACHE_H__INCLUDED_
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "PhysEnv.h"
+#include "SlotRing.h"
+
+#define POINTCACHE_SLOTS		4			// SAMPLES WAITING TO BE WRITTEN AT MOST
+#define POINTCACHE_RATE			60.0f		// SAMPLES PER SECOND OF SIMULATED TIME
+#define POINTCACHE_SYNC_FRAMES	60			// SAMPLES BETWEEN TWO SYNCS OF THE PERIODIC POLICY
+
+enum tPointCacheSyncs
+{
+    POINTCACHE_SYNC_NONE,		// THE SYSTEM WRITES THE FILE WHEN IT LIKES
+    POINTCACHE_SYNC_CLOSE,		// THE FILE IS SYNCED ONCE, WHEN IT IS CLOSED
+    POINTCACHE_SYNC_PERIODIC	// THE HEADER IS UPDATED AND THE FILE SYNCED EVERY FEW SAMPLES, A CRASH LOSES ONLY THE SAMPLES SINCE
+};
+
+struct tPointCacheOptions
+{
+    float rate;					// SAMPLES PER SECOND OF SIMULATED TIME
+    int policy;					// tRecorderPolicies
+    int sync;					// tPointCacheSyncs
+    int syncFrames;				// SAMPLES BETWEEN TWO SYNCS OF POINTCACHE_SYNC_PERIODIC
+};
+
+/**
+ * \brief Streams the cloth into a PC2 point cache, the per-frame vertex cache read by most animation packages.
+ *
+ * A PC2 file is a 32 byte header followed by the position of every vertex for each sample, as little endian floats. Capture samples the
+ * simulation at a fixed rate of simulated time and only copies the positions into a ring of POINTCACHE_SLOTS samples, the file is written
+ * by a thread of its own. A step that covers several samples is copied once and written once for each of them. By default the simulation
+ * waits when the writer falls behind. With RECORDER_DROP it does not, and each sample that finds the ring full is written as a copy of
+ * the sample before it, so the cache keeps the fixed rate its header gives. The vertices are written in the order of the visual, as read by LoadOBJ: when the particles are not in that order
+ * a map from each vertex to its particle puts them back.
+ */
+class CPointCacheWriter
+{
+public:
+    CPointCacheWriter ();
+    ~CPointCacheWriter ();
+    CPointCacheWriter ( const CPointCacheWriter & other ) = delete;
+    CPointCacheWriter & operator= ( const CPointCacheWriter & other ) = delete;
+    /**
+     * \brief Starts a cache, closing the one before.
+     * \param particleOfVertex The particle of each vertex, NULL when particle i is vertex i. Copied.
+     * \return False when the file can not be created or the map points past the particles.
+     */
+    bool Open ( const char * filename , int vertexCnt , int particleCnt , const int * particleOfVertex );
+    /**
+     * \brief Changes the rate, policies and sync, starting with the next cache.
+     */
+    void SetOptions ( const tPointCacheOptions & options ) { this->options_ = options; }
+    /**
+     * \brief Adds a sample for every sampling time reached by time. The first call starts the clock of the cache.
+     * \return The number of samples added, held ones included.
+     */
+    int Capture ( float time , const tParticle * system );
+    /**
+     * \brief Writes the samples still waiting, the sample count in the header, and syncs the file when asked to.
+     * \return False when anything could not be written.
+     */
+    bool Close ();
+    bool IsOpen () const { return this->ring_.Running (); }
+    int Samples () const { return this->samples_; }
+    /**
+     * \brief The samples written as a copy of the one before because the writer was behind.
+     */
+    int Held () const { return this->held_; }
+private:
+    struct tSample
+    {
+        std::vector < tVector > positions;		// IN PARTICLE ORDER
+        int held;								// COPIES OF THE SAMPLE BEFORE TO WRITE FIRST, FOR THE SAMPLES DROPPED SINCE
+        int repeats;							// SAMPLE TIMES THESE POSITIONS COVER
+    };
+    void WriteOut ( int count );
+    void WriteSample ( const tSample & sample );
+    bool WriteCount ();
+    bool Sync ();
+    tPointCacheOptions options_;
+    FILE * fp_;
+    int vertexCnt_;
+    int particleCnt_;
+    std::vector < int > particleOfVertex_;
+    std::vector < float > out_;					// A SAMPLE IN VERTEX ORDER, ONLY USED BY THE WRITER
+    double nextTime_;							// WHEN THE NEXT SAMPLE IS DUE, NEGATIVE BEFORE THE FIRST ONE
+    int samples_;								// SAMPLES HANDED TO THE WRITER, HELD ONES INCLUDED
+    int held_;
+    int missed_;								// SAMPLES DROPPED SINCE THE LAST ONE HANDED TO THE WRITER
+    std::int32_t written_;						// SAMPLES IN THE FILE, ONLY USED BY THE WRITER
+    bool failed_;
+    CSlotRing < tSample > ring_;				// LAST, SO ITS WRITER STOPS BEFORE THE REST GOES
+};
+
+#endif // !defined(POINTCACHE_H__INCLUDED_)
@@ -0,0 +1,460 @@
+#include "stdafx.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include "Profiler.h"
+#include "ThreadPool.h"
+
+static const char * PHASE_NAMES [ PHASE_CNT ] = { "Step" , "Forces" , "Integrate" , "Collide" , "Resolve" , "Log" , "Record" };
+static const char * COUNTER_NAMES [ COUNTER_CNT ] = { "Force evaluations" , "Bisections" , "Bisection depth" , "Contacts" , "Resolve passes" };
+
+/**
+ * \brief The open phases and the totals of the frame under way, one for each thread.
+ */
+struct tProfileThread
+{
+    struct tOpen
+    {
+        int phase;
+        std::int64_t start;
+        std::int64_t children;			// TICKS SPENT IN THE PHASES OPENED INSIDE
+        bool counted;					// WHETHER THE EVENTS WERE READ WHEN IT OPENED
+        std::uint64_t events [ HW_EVENT_CNT ];
+        std::uint64_t childEvents [ HW_EVENT_CNT ];
+    };
+    tOpen open [ PROFILE_DEPTH ];
+    int depth;
+    int skipped;						// PHASES OPENED PAST PROFILE_DEPTH, NOT TIMED
+    std::int64_t total [ PHASE_CNT ];
+    std::int64_t self [ PHASE_CNT ];
+    std::int64_t counters [ COUNTER_CNT ];
+    CHardwareCounters hardware;
+    std::unique_ptr < CHardwareCounters [] > workers;	// THE POOL'S THREADS, ADDED INTO THE EVENTS OF THIS ONE
+    int workerCnt;						// 0 WHEN THEY ARE NOT COUNTED
+    char workerError [ 200 ];
+    bool counting;						// READ THE EVENTS AROUND EACH PHASE
+    bool countedFrame;					// SOME PHASE OF THE FRAME WAS COUNTED
+    std::int64_t eventTotal [ PHASE_CNT ] [ HW_EVENT_CNT ];
+    std::int64_t eventSelf [ PHASE_CNT ] [ HW_EVENT_CNT ];
+};
+
+static thread_local tProfileThread profileThread;
+
+/**
+ * \brief The events of the thread with those of the pool's workers added in, so a phase has the chunks it handed out in it.
+ * \return False when any of the groups could not be read.
+ */
+static bool ReadEvents ( const tProfileThread & thread , std::uint64_t events [ HW_EVENT_CNT ] )
+{
+    if ( ! thread.hardware.Read ( events ) )
+    {
+        return false;
+    }
+    for ( int worker = 0; worker < thread.workerCnt; ++worker )
+    {
+        std::uint64_t counts [ HW_EVENT_CNT ];
+        if ( ! thread.workers [ worker ].Read ( counts ) )
+        {
+            return false;
+        }
+        for ( int event = 0; event < HW_EVENT_CNT; ++event )
+        {
+            events [ event ] += counts [ event ];
+        }
+    }
+    return true;
+}
+
+/**
+ * \brief Opens a group for each worker of the pool, with the same events as the thread's own. All of them or none, so no phase has
+ * some workers in it and not others.
+ */
+static void OpenWorkers ( tProfileThread & thread )
+{
+    const std::vector < long > & ids = CThreadPool::Instance ().ThreadIds ();
+    const int workerCnt = static_cast < int > ( ids.size () );
+    thread.workers.reset ( new CHardwareCounters [ workerCnt ] );
+    thread.workerError [ 0 ] = '\0';
+    for ( int worker = 0; worker < workerCnt; ++worker )
+    {
+        CHardwareCounters & counters = thread.workers [ worker ];
+        bool same = counters.Open ( ids [ worker ] );
+        for ( int event = 0; same && event < HW_EVENT_CNT; ++event )
+        {
+            same = counters.Has ( event ) == thread.hardware.Has ( event );
+        }
+        if ( ! same )
+        {
+            std::snprintf ( thread.workerError , sizeof ( thread.workerError ) , "the pool workers are not counted, only this thread: %s" ,
+                counters.Error () [ 0 ] != '\0' ? counters.Error () : "they do not have the same events" );
+            thread.workers.reset ();
+            thread.workerCnt = 0;
+            return;
+        }
+    }
+    thread.workerCnt = workerCnt;
+}
+
+static double NowMs ()
+{
+    return std::chrono::duration < double , std::milli > ( std::chrono::steady_clock::now ().time_since_epoch () ).count ();
+}
+
+CProfiler & CProfiler::Instance ()
+{
+    static CProfiler profiler;
+    return profiler;
+}
+
+CProfiler::CProfiler ()
+{
+    this->Reset ();
+}
+
+CProfiler::~CProfiler ()
+{
+    if ( this->phases_ [ PHASE_STEP ].frames > 0 )
+    {
+        this->Dump ( PROFILE_FILE );
+    }
+}
+
+void CProfiler::Reset ()
+{
+    std::lock_guard < std::mutex > lock ( this->mutex_ );
+    std::memset ( this->phases_ , 0 , sizeof ( this->phases_ ) );
+    std::memset ( this->counters_ , 0 , sizeof ( this->counters_ ) );
+    std::memset ( &this->hardware_ , 0 , sizeof ( this->hardware_ ) );
+    this->startTicks_ = Ticks ();
+    this->startMs_ = NowMs ();
+}
+
+void CProfiler::Enter ( const int phase )
+{
+    tProfileThread & thread = profileThread;
+    if ( thread.depth == PROFILE_DEPTH )
+    {
+        ++thread.skipped;
+        return;
+    }
+    tProfileThread::tOpen & open = thread.open [ thread.depth++ ];
+    open.phase = phase;
+    open.children = 0;
+    // THE EVENTS ARE READ OUTSIDE OF THE TIMED SPAN, SO THE READ IS LEFT TO THE PHASE AROUND
+    open.counted = thread.counting && ReadEvents ( thread , open.events );
+    if ( open.counted )
+    {
+        std::memset ( open.childEvents , 0 , sizeof ( open.childEvents ) );
+    }
+    open.start = Ticks ();
+}
+
+void CProfiler::Leave ()
+{
+    const std::int64_t now = Ticks ();
+    tProfileThread & thread = profileThread;
+    if ( thread.skipped > 0 )
+    {
+        --thread.skipped;
+        return;
+    }
+    if ( thread.depth == 0 )
+    {
+        return;
+    }
+    const tProfileThread::tOpen & open = thread.open [ --thread.depth ];
+    const std::int64_t elapsed = now - open.start;
+    thread.total [ open.phase ] += elapsed;
+    thread.self [ open.phase ] += elapsed - open.children;
+    if ( thread.depth > 0 )
+    {
+        thread.open [ thread.depth - 1 ].children += elapsed;
+    }
+    std::uint64_t events [ HW_EVENT_CNT ];
+    if ( open.counted && thread.counting && ReadEvents ( thread , events ) )
+    {
+        tProfileThread::tOpen * parent = thread.depth > 0 && thread.open [ thread.depth - 1 ].counted ? &thread.open [ thread.depth - 1 ] : NULL;
+        for ( int event = 0; event < HW_EVENT_CNT; ++event )
+        {
+            const std::uint64_t counted = events [ event ] - open.events [ event ];
+            thread.eventTotal [ open.phase ] [ event ] += static_cast < std::int64_t > ( counted );
+            thread.eventSelf [ open.phase ] [ event ] += static_cast < std::int64_t > ( counted - open.childEvents [ event ] );
+            if ( parent != NULL )
+            {
+                parent->childEvents [ event ] += counted;
+            }
+        }
+        thread.countedFrame = true;
+    }
+}
+
+bool CProfiler::CountHardware ( const bool enable )
+{
+    tProfileThread & thread = profileThread;
+    if ( ! enable )
+    {
+        thread.counting = false;
+        thread.hardware.Close ();
+        thread.workers.reset ();
+        thread.workerCnt = 0;
+        thread.workerError [ 0 ] = '\0';
+        return true;
+    }
+    if ( ! thread.hardware.IsOpen () && thread.hardware.Open () )
+    {
+        OpenWorkers ( thread );
+    }
+    thread.counting = thread.hardware.IsOpen ();
+    return thread.counting;
+}
+
+const char * CProfiler::HardwareError ()
+{
+    const tProfileThread & thread = profileThread;
+    return thread.hardware.Error () [ 0 ] != '\0' || ! thread.hardware.IsOpen () ? thread.hardware.Error () : thread.workerError;
+}
+
+void CProfiler::Count ( const int counter , const std::int64_t n )
+{
+    profileThread.counters [ counter ] += n;
+}
+
+void CProfiler::Peak ( const int counter , const std::int64_t value )
+{
+    std::int64_t & peak = profileThread.counters [ counter ];
+    peak = std::max ( peak , value );
+}
+
+/**
+ * \brief Values under 8 have a bucket each, above that every power of two is cut in 8.
+ */
+static int Bucket ( const std::uint64_t value )
+{
+    if ( value < 8 )
+    {
+        return static_cast < int > ( value );
+    }
+    int octave = 3;
+    while ( ( value >> ( octave + 1 ) ) != 0 )
+    {
+        ++octave;
+    }
+    return 8 + ( octave - 3 ) * 8 + static_cast < int > ( ( value >> ( octave - 3 ) ) & 7 );
+}
+
+/**
+ * \brief The middle of the values that fall into a bucket.
+ */
+static double BucketValue ( const int bucket )
+{
+    if ( bucket < 8 )
+    {
+        return bucket;
+    }
+    const int octave = 3 + ( bucket - 8 ) / 8 , sub = ( bucket - 8 ) % 8;
+    const double width = static_cast < double > ( std::uint64_t ( 1 ) << ( octave - 3 ) );
+    return ( 8 + sub ) * width + ( width - 1.0 ) / 2.0;
+}
+
+void CProfiler::Add ( tSeries & series , const std::int64_t value , const std::int64_t self )
+{
+    const std::int64_t clamped = std::max < std::int64_t > ( value , 0 );
+    ++series.buckets [ Bucket ( static_cast < std::uint64_t > ( clamped ) ) ];
+    ++series.frames;
+    series.sum += static_cast < double > ( clamped );
+    series.selfSum += static_cast < double > ( std::max < std::int64_t > ( self , 0 ) );
+    series.max = std::max ( series.max , clamped );
+}
+
+void CProfiler::EndFrame ()
+{
+    tProfileThread & thread = profileThread;
+    {
+        std::lock_guard < std::mutex > lock ( this->mutex_ );
+        for ( int phase = 0; phase < PHASE_CNT; ++phase )
+        {
+            Add ( this->phases_ [ phase ] , thread.total [ phase ] , thread.self [ phase ] );
+        }
+        for ( int counter = 0; counter < COUNTER_CNT; ++counter )
+        {
+            Add ( this->counters_ [ counter ] , thread.counters [ counter ] , thread.counters [ counter ] );
+        }
+        if ( thread.countedFrame )
+        {
+            ++this->hardware_.frames;
+            this->hardware_.callerOnly += thread.workerCnt < static_cast < int > ( CThreadPool::Instance ().ThreadIds ().size () ) ? 1 : 0;
+            for ( int event = 0; event < HW_EVENT_CNT; ++event )
+            {
+                this->hardware_.events |= thread.hardware.Has ( event ) ? 1u << event : 0u;
+                for ( int phase = 0; phase < PHASE_CNT; ++phase )
+                {
+                    this->hardware_.total [ phase ] [ event ] += static_cast < double > ( thread.eventTotal [ phase ] [ event ] );
+                    this->hardware_.self [ phase ] [ event ] += static_cast < double > ( thread.eventSelf [ phase ] [ event ] );
+                }
+            }
+        }
+    }
+    if ( thread.countedFrame )
+    {
+        std::memset ( thread.eventTotal , 0 , sizeof ( thread.eventTotal ) );
+        std::memset ( thread.eventSelf , 0 , sizeof ( thread.eventSelf ) );
+        thread.countedFrame = false;
+    }
+    std::memset ( thread.total , 0 , sizeof ( thread.total ) );
+    std::memset ( thread.self , 0 , sizeof ( thread.self ) );
+    std::memset ( thread.counters , 0 , sizeof ( thread.counters ) );
+}
+
+double CProfiler::TicksPerMs () const
+{
+#if defined(PROFILER_TSC)
+    // THE COUNTER HAS NO KNOWN RATE, SO IT IS MEASURED AGAINST THE CLOCK OVER THE WHOLE RUN
+    const double ms = NowMs () - this->startMs_;
+    return ms > 0.0 ? static_cast < double > ( Ticks () - this->startTicks_ ) / ms : 1.0;
+#else
+    return static_cast < double > ( std::chrono::steady_clock::period::den ) / std::chrono::steady_clock::period::num / 1000.0;
+#endif
+}
+
+tProfileStats CProfiler::Read ( const tSeries & series , const char * name , const double scale )
+{
+    tProfileStats stats;
+    stats.name = name;
+    stats.frames = series.frames;
+    stats.mean = stats.p50 = stats.p99 = stats.max = stats.selfMean = 0.0;
+    if ( series.frames == 0 )
+    {
+        return stats;
+    }
+    stats.mean = series.sum / series.frames / scale;
+    stats.selfMean = series.selfSum / series.frames / scale;
+    stats.max = series.max / scale;
+    // THE FIRST BUCKET THAT REACHES THE RANK, NEVER MORE THAN THE LARGEST VALUE SEEN
+    const double quantiles [ 2 ] = { 0.5 , 0.99 };
+    double * results [ 2 ] = { &stats.p50 , &stats.p99 };
+    for ( int q = 0; q < 2; ++q )
+    {
+        const double rank = quantiles [ q ] * series.frames;
+        std::int64_t seen = 0;
+        for ( int bucket = 0; bucket < PROFILE_BUCKETS; ++bucket )
+        {
+            seen += series.buckets [ bucket ];
+            if ( seen >= rank && seen > 0 )
+            {
+                *results [ q ] = std::min ( BucketValue ( bucket ) , static_cast < double > ( series.max ) ) / scale;
+                break;
+            }
+        }
+    }
+    return stats;
+}
+
+void CProfiler::Stats ( std::vector < tProfileStats > & phases , std::vector < tProfileStats > & counters ) const
+{
+    const double ticksPerMs = this->TicksPerMs ();
+    std::lock_guard < std::mutex > lock ( this->mutex_ );
+    phases.clear ();
+    for ( int phase = 0; phase < PHASE_CNT; ++phase )
+    {
+        phases.push_back ( Read ( this->phases_ [ phase ] , PHASE_NAMES [ phase ] , ticksPerMs ) );
+    }
+    counters.clear ();
+    for ( int counter = 0; counter < COUNTER_CNT; ++counter )
+    {
+        counters.push_back ( Read ( this->counters_ [ counter ] , COUNTER_NAMES [ counter ] , 1.0 ) );
+    }
+}
+
+void CProfiler::HardwareStats ( std::vector < tProfileHardware > & phases ) const
+{
+    std::lock_guard < std::mutex > lock ( this->mutex_ );
+    phases.clear ();
+    const double frames = static_cast < double > ( std::max < std::int64_t > ( this->hardware_.frames , 1 ) );
+    for ( int phase = 0; phase < PHASE_CNT; ++phase )
+    {
+        tProfileHardware stats;
+        stats.name = PHASE_NAMES [ phase ];
+        stats.frames = this->hardware_.frames;
+        for ( int event = 0; event < HW_EVENT_CNT; ++event )
+        {
+            stats.counted [ event ] = ( ( this->hardware_.events >> event ) & 1 ) != 0;
+            stats.total [ event ] = this->hardware_.total [ phase ] [ event ] / frames;
+            stats.self [ event ] = this->hardware_.self [ phase ] [ event ] / frames;
+        }
+        stats.workers = this->hardware_.callerOnly == 0;
+        phases.push_back ( stats );
+    }
+}
+
+/**
+ * \brief Writes a row of events per frame and the instructions per cycle, with a dash for an event not counted.
+ */
+static void DumpEvents ( FILE * fp , const char * name , const bool counted [ HW_EVENT_CNT ] , const double events [ HW_EVENT_CNT ] )
+{
+    fprintf ( fp , "%-20s" , name );
+    for ( int event = 0; event < HW_EVENT_CNT; ++event )
+    {
+        if ( counted [ event ] )
+        {
+            fprintf ( fp , " %14.0f" , events [ event ] );
+        }
+        else
+        {
+            fprintf ( fp , " %14s" , "-" );
+        }
+    }
+    if ( counted [ HW_CYCLES ] && counted [ HW_INSTRUCTIONS ] && events [ HW_CYCLES ] > 0.0 )
+    {
+        fprintf ( fp , " %8.2f\n" , events [ HW_INSTRUCTIONS ] / events [ HW_CYCLES ] );
+    }
+    else
+    {
+        fprintf ( fp , " %8s\n" , "-" );
+    }
+}
+
+bool CProfiler::Dump ( const char * filename ) const
+{
+    std::vector < tProfileStats > phases , counters;
+    this->Stats ( phases , counters );
+    FILE * fp = fopen ( filename , "w" );
+    if ( fp == NULL )
+    {
+        return false;
+    }
+    fprintf ( fp , "%lld frames\n\n%-20s %12s %12s %12s %12s %12s\n" , static_cast < long long > ( phases [ PHASE_STEP ].frames ) , "Phase (ms)" , "mean" , "self" , "p50" , "p99" , "max" );
+    for ( const tProfileStats & stats : phases )
+    {
+        fprintf ( fp , "%-20s %12.4f %12.4f %12.4f %12.4f %12.4f\n" , stats.name , stats.mean , stats.selfMean , stats.p50 , stats.p99 , stats.max );
+    }
+    fprintf ( fp , "\n%-20s %12s %12s %12s %12s\n" , "Counter" , "mean" , "p50" , "p99" , "max" );
+    for ( const tProfileStats & stats : counters )
+    {
+        fprintf ( fp , "%-20s %12.2f %12.0f %12.0f %12.0f\n" , stats.name , stats.mean , stats.p50 , stats.p99 , stats.max );
+    }
+    std::vector < tProfileHardware > hardware;
+    this->HardwareStats ( hardware );
+    if ( hardware [ PHASE_STEP ].frames > 0 )
+    {
+        const char * titles [ 2 ] = { "Events per frame" , "Self events" };
+        for ( int table = 0; table < 2; ++table )
+        {
+            fprintf ( fp , "\n%-20s" , titles [ table ] );
+            for ( int event = 0; event < HW_EVENT_CNT; ++event )
+            {
+                fprintf ( fp , " %14s" , HW_EVENT_NAMES [ event ] );
+            }
+            fprintf ( fp , " %8s\n" , "IPC" );
+            for ( const tProfileHardware & stats : hardware )
+            {
+                DumpEvents ( fp , stats.name , stats.counted , table == 0 ? stats.total : stats.self );
+            }
+        }
+        if ( ! hardware [ PHASE_STEP ].workers )
+        {
+            fprintf ( fp , "\nThe workers of the pool were not counted, Collide and Resolve are short the chunks they ran.\n" );
+        }
+    }
+    return fclose ( fp ) == 0;
+}
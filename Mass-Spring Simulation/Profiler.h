@@ -0,0 +1,206 @@
+#if !defined(PROFILER_H__INCLUDED_)
+#define PROFILER_H__INCLUDED_
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include "HardwareCounters.h"
+
+// THE TIMERS READ THE TIME STAMP COUNTER, A FEW CYCLES EACH. DEFINE PROFILER_DISABLED
+// TO TAKE EVERY PROFILE_ MACRO OUT OF THE BUILD.
+#if defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define PROFILER_TSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROFILER_TSC
+#endif
+
+#define PROFILE_DEPTH			16			// PHASES OPEN INSIDE EACH OTHER AT MOST
+#define PROFILE_BUCKETS			512			// EIGHT BUCKETS PER POWER OF TWO, ENOUGH FOR ANY 64 BIT VALUE
+#define PROFILE_FILE			"profile.txt"
+
+enum tProfilePhases
+{
+    PHASE_STEP,				// A WHOLE STEP, Simulate AND THE RecordFrame AFTER IT
+    PHASE_FORCES,			// ComputeForces
+    PHASE_INTEGRATE,		// THE INTEGRATOR, WITH THE FORCES IT EVALUATES ITSELF
+    PHASE_COLLIDE,			// CheckForCollisions
+    PHASE_RESOLVE,			// THE ResolveCollisions RETRY LOOP, WITH THE CHECKS IT REPEATS
+    PHASE_LOG,				// THE DIAGNOSTICS SAMPLED EVERY FEW STEPS
+    PHASE_RECORD,			// RecordFrame, THE ERROR AND THE COPIES HANDED TO THE WRITERS
+    PHASE_CNT
+};
+
+enum tProfileCounters
+{
+    COUNTER_FORCES,				// FORCE EVALUATIONS
+    COUNTER_BISECTIONS,			// STEPS CUT SHORT BY A PENETRATION
+    COUNTER_BISECTION_DEPTH,	// MOST CUTS BEFORE A STEP WENT THROUGH
+    COUNTER_CONTACTS,			// CONTACTS FOUND, OVER ALL CHECKS
+    COUNTER_RESOLVE_PASSES,		// PASSES OF THE RESOLVE LOOP
+    COUNTER_CNT
+};
+
+/**
+ * \brief One phase or counter over the frames profiled. Times are in milliseconds.
+ */
+struct tProfileStats
+{
+    const char * name;
+    std::int64_t frames;
+    double mean;
+    double p50;
+    double p99;
+    double max;
+    double selfMean;			// A PHASE WITHOUT THE PHASES OPENED INSIDE IT, THE MEAN AGAIN FOR A COUNTER
+};
+
+/**
+ * \brief The processor events of one phase, as means per frame over the frames they were counted in.
+ */
+struct tProfileHardware
+{
+    const char * name;
+    std::int64_t frames;
+    bool counted [ HW_EVENT_CNT ];		// THE EVENTS THE PROCESSOR OFFERED, THE OTHERS ARE 0
+    double total [ HW_EVENT_CNT ];
+    double self [ HW_EVENT_CNT ];		// WITHOUT THE PHASES OPENED INSIDE
+    bool workers;						// THE POOL'S WORKERS WERE COUNTED IN EVERY FRAME, ELSE THE PHASES THAT HAND THEM WORK ARE SHORT
+};
+
+/**
+ * \brief Times the phases of each step of the simulation and counts what they did, with a histogram per frame for each.
+ *
+ * A phase is timed between PROFILE_SCOPE and the end of the block, and the phases opened inside it are taken out of its self time, so a
+ * phase reached from two places, like the forces evaluated by the integrators, is both on its own and inside the one that called it.
+ * Each thread keeps its open phases and the totals of its frame to itself, so timing takes no lock. PROFILE_FRAME ends the frame of the
+ * thread it is called on: its totals go into histograms of eight buckets per power of two, close to 9% apart, from which the percentiles
+ * are read. The histograms cover the whole run and are written to PROFILE_FILE when the program ends.
+ *
+ * A thread can also count processor events, cycles, instructions, last level cache misses and branch misses, around each phase it times.
+ * They are split into self and total the same way and summed per frame. Reading them is a system call at each end of a phase, a
+ * microsecond or so that lands in the phase around it, so they are off until CountHardware asks for them. The workers of the pool are
+ * counted too, a group each read with the thread that asked, so a phase that runs a parallel loop has the chunks of every worker in it.
+ * That is a read per worker at each end of a phase. Where the workers cannot be counted only the thread that asked is, and the report
+ * says so.
+ */
+class CProfiler
+{
+public:
+    static CProfiler & Instance ();
+    ~CProfiler ();
+    CProfiler ( const CProfiler & other ) = delete;
+    CProfiler & operator= ( const CProfiler & other ) = delete;
+    static void Enter ( int phase );
+    static void Leave ();
+    static void Count ( int counter , std::int64_t n );
+    /**
+     * \brief Keeps the largest value given in the frame.
+     */
+    static void Peak ( int counter , std::int64_t value );
+    /**
+     * \brief Puts the totals of the calling thread into the histograms and starts its next frame.
+     */
+    void EndFrame ();
+    /**
+     * \brief The phases in tProfilePhases order and the counters in tProfileCounters order.
+     */
+    void Stats ( std::vector < tProfileStats > & phases , std::vector < tProfileStats > & counters ) const;
+    /**
+     * \brief Writes the stats as a table.
+     * \return False when the file could not be written.
+     */
+    bool Dump ( const char * filename ) const;
+    void Reset ();
+    /**
+     * \brief Starts or stops counting processor events around the phases timed on the calling thread.
+     * \return False when counting was asked for but no event could be counted, HardwareError says why. The phases are timed anyway.
+     */
+    static bool CountHardware ( bool enable );
+    /**
+     * \brief Why the events of the calling thread could not be counted, which of them were left out, or why the workers of the pool
+     * were not. Empty when all are counted.
+     */
+    static const char * HardwareError ();
+    /**
+     * \brief The events of the phases in tProfilePhases order. They have no frames when no thread counted them.
+     */
+    void HardwareStats ( std::vector < tProfileHardware > & phases ) const;
+    static std::int64_t Ticks ()
+    {
+#if defined(PROFILER_TSC)
+        return static_cast < std::int64_t > ( __rdtsc () );
+#else
+        return std::chrono::steady_clock::now ().time_since_epoch ().count ();
+#endif
+    }
+private:
+    struct tSeries
+    {
+        std::uint32_t buckets [ PROFILE_BUCKETS ];
+        std::int64_t frames;
+        double sum;
+        double selfSum;
+        std::int64_t max;
+    };
+    CProfiler ();
+    static void Add ( tSeries & series , std::int64_t value , std::int64_t self );
+    static tProfileStats Read ( const tSeries & series , const char * name , double scale );
+    double TicksPerMs () const;
+    struct tHardwareSeries
+    {
+        std::int64_t frames;
+        unsigned int events;			// A BIT FOR EACH EVENT COUNTED IN ANY OF THE FRAMES
+        std::int64_t callerOnly;		// FRAMES COUNTED WITHOUT THE POOL'S WORKERS
+        double total [ PHASE_CNT ] [ HW_EVENT_CNT ];
+        double self [ PHASE_CNT ] [ HW_EVENT_CNT ];
+    };
+    mutable std::mutex mutex_;
+    tSeries phases_ [ PHASE_CNT ];
+    tSeries counters_ [ COUNTER_CNT ];
+    tHardwareSeries hardware_;
+    std::int64_t startTicks_;			// WHEN THE PROFILER STARTED, TO MEASURE THE TICKS AGAINST THE CLOCK
+    double startMs_;
+};
+
+/**
+ * \brief Times a phase until the end of the block.
+ */
+class CProfileScope
+{
+public:
+    explicit CProfileScope ( const int phase ) { CProfiler::Enter ( phase ); }
+    ~CProfileScope () { CProfiler::Leave (); }
+    CProfileScope ( const CProfileScope & other ) = delete;
+    CProfileScope & operator= ( const CProfileScope & other ) = delete;
+};
+
+/**
+ * \brief Times a whole step until the end of the block, then ends the frame.
+ */
+class CProfileFrame
+{
+public:
+    CProfileFrame () { CProfiler::Enter ( PHASE_STEP ); }
+    ~CProfileFrame () { CProfiler::Leave (); CProfiler::Instance ().EndFrame (); }
+    CProfileFrame ( const CProfileFrame & other ) = delete;
+    CProfileFrame & operator= ( const CProfileFrame & other ) = delete;
+};
+
+#define PROFILE_JOIN2(a, b)			a##b
+#define PROFILE_JOIN(a, b)			PROFILE_JOIN2(a, b)
+#if !defined(PROFILER_DISABLED)
+#define PROFILE_SCOPE(phase)		CProfileScope PROFILE_JOIN(profileScope, __LINE__) ( phase )
+#define PROFILE_FRAME()				CProfileFrame PROFILE_JOIN(profileFrame, __LINE__)
+#define PROFILE_COUNT(counter, n)	CProfiler::Count ( counter , n )
+#define PROFILE_PEAK(counter, n)	CProfiler::Peak ( counter , n )
+#else
+#define PROFILE_SCOPE(phase)
+#define PROFILE_FRAME()
+#define PROFILE_COUNT(counter, n)
+#define PROFILE_PEAK(counter, n)
+#endif
+
+#endif // !defined(PROFILER_H__INCLUDED_)
@@ -0,0 +1,238 @@
+#include "stdafx.h"
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <vector>
+#include "SceneCache.h"
+#include "IndexBuffer.h"
+
+static const char SCENE_MAGIC [ 4 ] = { 'C' , 'L' , 'S' , 'C' };
+
+enum tSceneSections
+{
+    SECTION_PARTICLES,
+    SECTION_SPRINGS,
+    SECTION_VERTICES,
+    SECTION_INDICES,
+    SECTION_CNT
+};
+
+/**
+ * \brief Where a section starts in the file and how many elements it holds.
+ */
+struct tSceneSection
+{
+    std::uint64_t offset;
+    std::uint64_t count;
+};
+
+struct tSceneHeader
+{
+    char magic [ 4 ];
+    std::int32_t version;
+    /**
+     * \brief The sizes of the structures stored raw, which differ between builds.
+     */
+    std::int32_t layout [ 3 ];
+    tSceneStamp stamp;
+    /**
+     * \brief How many springs there are of each type, in the order of tSpringTypes, which is the order of the section.
+     */
+    std::uint64_t springCnt [ SPRING_TYPE_CNT ];
+    std::int32_t hasVisual;
+    /**
+     * \brief The visual with its pointers cleared, they come from the sections.
+     */
+    t_Visual visual;
+    tSceneSection sections [ SECTION_CNT ];
+};
+
+static void Layout ( std::int32_t layout [ 3 ] )
+{
+    layout [ 0 ] = sizeof ( tParticle );
+    layout [ 1 ] = sizeof ( tSpring );
+    layout [ 2 ] = sizeof ( t_Visual );
+}
+
+/**
+ * \brief The size of one element of each section. The width of the indices depends on the vertex count, like in the visual.
+ */
+static std::size_t ElementSize ( const int section , const t_Visual & visual )
+{
+    switch ( section )
+    {
+    case SECTION_PARTICLES: return sizeof ( tParticle );
+    case SECTION_SPRINGS: return sizeof ( tSpring );
+    case SECTION_VERTICES: return sizeof ( float );
+    default: return IndexSize ( visual.vertexCnt );
+    }
+}
+
+bool SourceStamp ( const char * filename , tSceneStamp & stamp )
+{
+#ifdef _WIN32
+    struct _stat64 status;
+    if ( _stat64 ( filename , &status ) != 0 )
+    {
+        return false;
+    }
+#else
+    struct stat status;
+    if ( stat ( filename , &status ) != 0 )
+    {
+        return false;
+    }
+#endif
+    stamp.size = static_cast < std::int64_t > ( status.st_size );
+    stamp.time = static_cast < std::int64_t > ( status.st_mtime );
+    return true;
+}
+
+/**
+ * \brief Appends a section after padding the file up to the section alignment.
+ */
+static bool WriteSection ( FILE * fp , std::uint64_t & position , tSceneSection & section , const void * data , const std::size_t size , const std::size_t count )
+{
+    static const char padding [ SCENE_CACHE_ALIGN ] = { 0 };
+    const std::size_t pad = static_cast < std::size_t > ( ( SCENE_CACHE_ALIGN - position % SCENE_CACHE_ALIGN ) % SCENE_CACHE_ALIGN );
+    if ( fwrite ( padding , 1 , pad , fp ) != pad )
+    {
+        return false;
+    }
+    position += pad;
+    section.offset = position;
+    section.count = count;
+    if ( count > 0 && fwrite ( data , size , count , fp ) != count )
+    {
+        return false;
+    }
+    position += static_cast < std::uint64_t > ( size ) * count;
+    return true;
+}
+
+bool WriteSceneCache ( const char * filename , const tSceneView & scene , const tSceneStamp & stamp )
+{
+    tSceneHeader header;
+    std::memset ( &header , 0 , sizeof ( header ) );
+    std::memcpy ( header.magic , SCENE_MAGIC , sizeof ( SCENE_MAGIC ) );
+    header.version = SCENE_CACHE_VERSION;
+    Layout ( header.layout );
+    header.stamp = stamp;
+    // GROUP THE SPRINGS BY TYPE WITH A COUNTING SORT, A SPRING OF NO KNOWN TYPE IS NOT KEPT
+    std::vector < tSpring > springs;
+    std::size_t next [ SPRING_TYPE_CNT ] = { 0 };
+    for ( int i = 0; i < scene.springCnt; ++i )
+    {
+        if ( scene.springs [ i ].type >= 0 && scene.springs [ i ].type < SPRING_TYPE_CNT )
+        {
+            ++header.springCnt [ scene.springs [ i ].type ];
+        }
+    }
+    for ( int type = 1; type < SPRING_TYPE_CNT; ++type )
+    {
+        next [ type ] = next [ type - 1 ] + static_cast < std::size_t > ( header.springCnt [ type - 1 ] );
+    }
+    springs.resize ( next [ SPRING_TYPE_CNT - 1 ] + static_cast < std::size_t > ( header.springCnt [ SPRING_TYPE_CNT - 1 ] ) );
+    for ( int i = 0; i < scene.springCnt; ++i )
+    {
+        if ( scene.springs [ i ].type >= 0 && scene.springs [ i ].type < SPRING_TYPE_CNT )
+        {
+            springs [ next [ scene.springs [ i ].type ]++ ] = scene.springs [ i ];
+        }
+    }
+    const float * vertices = NULL;
+    const void * indices = NULL;
+    std::size_t vertexCnt = 0 , indexCnt = 0;
+    if ( scene.visual != NULL )
+    {
+        header.hasVisual = 1;
+        header.visual = *scene.visual;
+        header.visual.vertexData = NULL;
+        header.visual.faceIndex = NULL;
+        header.visual.faceNormal = NULL;
+        vertices = scene.visual->vertexData;
+        indices = scene.visual->faceIndex;
+        vertexCnt = vertices != NULL ? static_cast < std::size_t > ( scene.visual->vSize * scene.visual->vertexCnt ) : 0;
+        indexCnt = indices != NULL ? static_cast < std::size_t > ( scene.visual->faceCnt * scene.visual->vPerFace ) : 0;
+    }
+    FILE * fp = fopen ( filename , "wb" );
+    if ( fp == NULL )
+    {
+        return false;
+    }
+    // THE HEADER IS WRITTEN TWICE, THE SECOND TIME WITH THE SECTIONS FILLED IN
+    std::uint64_t position = sizeof ( header );
+    bool written = fwrite ( &header , sizeof ( header ) , 1 , fp ) == 1
+        && WriteSection ( fp , position , header.sections [ SECTION_PARTICLES ] , scene.particles , sizeof ( tParticle ) , scene.particleCnt )
+        && WriteSection ( fp , position , header.sections [ SECTION_SPRINGS ] , springs.data () , sizeof ( tSpring ) , springs.size () )
+        && WriteSection ( fp , position , header.sections [ SECTION_VERTICES ] , vertices , sizeof ( float ) , vertexCnt )
+        && WriteSection ( fp , position , header.sections [ SECTION_INDICES ] , indices , ElementSize ( SECTION_INDICES , header.visual ) , indexCnt )
+        && fseek ( fp , 0 , SEEK_SET ) == 0
+        && fwrite ( &header , sizeof ( header ) , 1 , fp ) == 1;
+    written = ( fclose ( fp ) == 0 ) && written;
+    if ( ! written )
+    {
+        remove ( filename );
+    }
+    return written;
+}
+
+bool CSceneCache::Open ( const char * filename , const tSceneStamp & stamp )
+{
+    std::int32_t layout [ 3 ];
+    if ( ! this->file_.Open ( filename ) || this->file_.Size () < sizeof ( tSceneHeader ) )
+    {
+        this->file_.Close ();
+        return false;
+    }
+    // THE MAPPING STARTS ON A PAGE, SO THE HEADER AND EVERY ALIGNED SECTION CAN BE USED IN PLACE
+    const char * base = this->file_.Begin ();
+    const tSceneHeader & header = *reinterpret_cast < const tSceneHeader * > ( base );
+    Layout ( layout );
+    bool valid = std::memcmp ( header.magic , SCENE_MAGIC , sizeof ( SCENE_MAGIC ) ) == 0 && header.version == SCENE_CACHE_VERSION
+        && std::memcmp ( header.layout , layout , sizeof ( layout ) ) == 0 && header.stamp.size == stamp.size && header.stamp.time == stamp.time;
+    for ( int section = 0; valid && section < SECTION_CNT; ++section )
+    {
+        const tSceneSection & range = header.sections [ section ];
+        valid = range.offset % SCENE_CACHE_ALIGN == 0 && range.offset <= this->file_.Size ()
+            && range.count <= ( this->file_.Size () - range.offset ) / ElementSize ( section , header.visual );
+    }
+    if ( ! valid )
+    {
+        this->file_.Close ();
+        return false;
+    }
+    tSceneView & view = this->view_;
+    view.particles = reinterpret_cast < const tParticle * > ( base + header.sections [ SECTION_PARTICLES ].offset );
+    view.particleCnt = static_cast < int > ( header.sections [ SECTION_PARTICLES ].count );
+    view.springs = reinterpret_cast < const tSpring * > ( base + header.sections [ SECTION_SPRINGS ].offset );
+    view.springCnt = static_cast < int > ( header.sections [ SECTION_SPRINGS ].count );
+    // THE GROUPS MUST COVER THE SECTION, AND EVERY SPRING HOLD TWO OF THE PARTICLES, OR THE SIMULATION WOULD READ PAST THEM
+    view.springStart [ 0 ] = 0;
+    for ( int type = 0; valid && type < SPRING_TYPE_CNT; ++type )
+    {
+        valid = header.springCnt [ type ] <= header.sections [ SECTION_SPRINGS ].count - view.springStart [ type ];
+        view.springStart [ type + 1 ] = valid ? view.springStart [ type ] + static_cast < int > ( header.springCnt [ type ] ) : 0;
+        for ( int i = view.springStart [ type ]; valid && i < view.springStart [ type + 1 ]; ++i )
+        {
+            const tSpring & spring = view.springs [ i ];
+            valid = spring.type == type && spring.p1 >= 0 && spring.p1 < view.particleCnt && spring.p2 >= 0 && spring.p2 < view.particleCnt;
+        }
+    }
+    if ( ! valid || view.springStart [ SPRING_TYPE_CNT ] != view.springCnt )
+    {
+        this->file_.Close ();
+        return false;
+    }
+    view.visual = NULL;
+    if ( header.hasVisual )
+    {
+        // THE VISUAL POINTS INTO THE MAPPING TOO, IT IS ONLY READ FROM
+        this->visual_ = header.visual;
+        this->visual_.vertexData = header.sections [ SECTION_VERTICES ].count > 0 ? reinterpret_cast < float * > ( const_cast < char * > ( base + header.sections [ SECTION_VERTICES ].offset ) ) : NULL;
+        this->visual_.faceIndex = header.sections [ SECTION_INDICES ].count > 0 ? const_cast < char * > ( base + header.sections [ SECTION_INDICES ].offset ) : NULL;
+        view.visual = &this->visual_;
+    }
+    return true;
+}
@@ -0,0 +1,94 @@
+#if !defined(SCENECACHE_H__INCLUDED_)
+#define SCENECACHE_H__INCLUDED_
+
+#include <cstdint>
+#include "PhysEnv.h"
+#include "Skeleton.h"
+#include "ObjParser.h"
+
+#define SCENE_CACHE_EXT			".scene"	// ADDED TO THE NAME OF THE SOURCE FILE
+#define SCENE_CACHE_VERSION		3
+#define SCENE_CACHE_ALIGN		64			// EVERY SECTION STARTS ON A CACHE LINE
+
+/**
+ * \brief Identifies the file a cache was built from, so a cache is thrown away once its source changes.
+ */
+struct tSceneStamp
+{
+    std::int64_t size;
+    std::int64_t time;
+};
+
+/**
+ * \brief Reads the size and modification time of a file.
+ * \return False when the file does not exist.
+ */
+bool SourceStamp ( const char * filename , tSceneStamp & stamp );
+
+/**
+ * \brief What loading an OBJ file builds, given as plain arrays: what CPhysEnv hands to WriteSceneCache, and what a mapped cache hands back.
+ *
+ * The mesh is kept as it was loaded, with the springs built on it once the system is saved. The settings and colliders belong to the
+ * session and are left alone by a cache hit. Read from a cache, the arrays point straight into the mapped file.
+ */
+struct tSceneView
+{
+    const tParticle * particles;
+    int particleCnt;
+    /**
+     * \brief In any order to be written. Read from a cache they are grouped by type, those of type t from springStart [ t ] up to
+     * springStart [ t + 1 ].
+     */
+    const tSpring * springs;
+    int springCnt;
+    int springStart [ SPRING_TYPE_CNT + 1 ];
+    /**
+     * \brief The visual drawn for the scene, NULL for none. Its vertexData and faceIndex are the arrays of the scene.
+     */
+    const t_Visual * visual;
+};
+
+/**
+ * \brief Writes a scene into a cache file.
+ *
+ * The file is a fixed header followed by one section per array, each aligned to SCENE_CACHE_ALIGN so it can be used in place once mapped.
+ * The springs are grouped by type on the way, with a counting sort, and the header keeps how many there are of each. It also records the
+ * sizes of the structures, so a cache written by a different build is rejected.
+ * \return False when the file can not be written. Nothing is left behind then.
+ */
+bool WriteSceneCache ( const char * filename , const tSceneView & scene , const tSceneStamp & stamp );
+
+/**
+ * \brief A scene cache mapped into memory. Opening it checks the header and the spring ends and points the view at the sections, nothing
+ * is parsed or copied. The mapping is read only.
+ */
+class CSceneCache
+{
+public:
+    /**
+     * \brief Maps a cache.
+     * \param stamp The stamp of the source file now. A cache built from another version of it is refused.
+     * \return False when there is no usable cache.
+     */
+    bool Open ( const char * filename , const tSceneStamp & stamp );
+    /**
+     * \brief The scene, valid until the cache is closed or opened again.
+     */
+    const tSceneView & View () const { return this->view_; }
+    void Close () { this->file_.Close (); }
+    bool IsOpen () const { return this->file_.Begin () != nullptr; }
+    /**
+     * \brief Whether data points into the mapping, so whoever holds it knows not to free it.
+     */
+    bool Maps ( const void * data ) const
+    {
+        return data != nullptr && this->IsOpen () && static_cast < const char * > ( data ) >= this->file_.Begin ()
+            && static_cast < const char * > ( data ) < this->file_.End ();
+    }
+private:
+    CMappedFile file_;
+    tSceneView view_;
+    t_Visual visual_;
+};
+
+#endif // !defined(SCENECACHE_H__INCLUDED_)
@@ -0,0 +1,95 @@
+#if !defined(SIMDLANES_H__INCLUDED_)
+#define SIMDLANES_H__INCLUDED_
+
+// EIGHT FLOAT LANES USED BY THE BATCHED KERNELS. ONE AVX REGISTER WHEN THE COMPILER
+// TARGETS AVX, A PAIR OF SSE REGISTERS OTHERWISE, AND PLAIN ARRAYS WHEN THERE IS NO SSE
+// (OR WHEN SIMD_LANES_SCALAR IS DEFINED, HANDY TO CHECK THE KERNELS AGAINST).
+#if defined(SIMD_LANES_SCALAR)
+#elif defined(__AVX__)
+#include <immintrin.h>
+#define SIMD_LANES_AVX
+#elif defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__) || defined(__x86_64__)
+#include <xmmintrin.h>
+#define SIMD_LANES_SSE
+#endif
+
+#include <cmath>
+
+/**
+ * \brief Eight floats processed together. Comparisons return lanes that are all ones (true) or all zeros (false), which can be combined with And/Or and turned into a bit mask with Mask.
+ *
+ * And8, AndNot8 and Or8 are only meant for comparison results. Use Select8 to pick between values.
+ */
+struct tFloat8
+{
+#if defined(SIMD_LANES_AVX)
+    __m256 v;
+#elif defined(SIMD_LANES_SSE)
+    __m128 lo , hi;
+#else
+    float f [ 8 ];
+#endif
+};
+
+#if defined(SIMD_LANES_AVX)
+
+inline tFloat8 Load8 ( const float * p ) { tFloat8 r; r.v = _mm256_loadu_ps ( p ); return r; }
+inline void Store8 ( float * p , const tFloat8 & a ) { _mm256_storeu_ps ( p , a.v ); }
+inline tFloat8 Set8 ( const float s ) { tFloat8 r; r.v = _mm256_set1_ps ( s ); return r; }
+inline tFloat8 operator + ( const tFloat8 & a , const tFloat8 & b ) { tFloat8 r; r.v = _mm256_add_ps ( a.v , b.v ); return r; }
+inline tFloat8 operator - ( const tFloat8 & a , const tFloat8 & b ) { tFloat8 r; r.v = _mm256_sub_ps ( a.v , b.v ); return r; }
+inline tFloat8 operator * ( const tFloat8 & a , const tFloat8 & b ) { tFloat8 r; r.v = _mm256_mul_ps ( a.v , b.v ); return r; }
+inline tFloat8 operator / ( const tFloat8 & a , const tFloat8 & b ) { tFloat8 r; r.v = _mm256_div_ps ( a.v , b.v ); return r; }
+inline tFloat8 Min8 ( const tFloat8 & a , const tFloat8 & b ) { tFloat8 r; r.v = _mm256_min_ps ( a.v , b.v ); return r; }
+inline tFloat8 Max8 ( const tFloat8 & a , const tFloat8 & b ) { tFloat8 r; r.v = _mm256_max_ps ( a.v , b.v ); return r; }
+inline tFloat8 Sqrt8 ( const tFloat8 & a ) { tFloat8 r; r.v = _mm256_sqrt_ps ( a.v ); return r; }
+inline tFloat8 Less8 ( const tFloat8 & a , const tFloat8 & b ) { tFloat8 r; r.v = _mm256_cmp_ps ( a.v , b.v , _CMP_LT_OQ ); return r; }
+inline tFloat8 And8 ( const tFloat8 & a , const tFloat8 & b ) { tFloat8 r; r.v = _mm256_and_ps ( a.v , b.v ); return r; }
+inline tFloat8 AndNot8 ( const tFloat8 & a , const tFloat8 & b ) { tFloat8 r; r.v = _mm256_andnot_ps ( a.v , b.v ); return r; }
+inline tFloat8 Or8 ( const tFloat8 & a , const tFloat8 & b ) { tFloat8 r; r.v = _mm256_or_ps ( a.v , b.v ); return r; }
+inline tFloat8 Select8 ( const tFloat8 & mask , const tFloat8 & a , const tFloat8 & b ) { tFloat8 r; r.v = _mm256_blendv_ps ( b.v , a.v , mask.v ); return r; }
+inline unsigned int Mask8 ( const tFloat8 & a ) { return static_cast < unsigned int > ( _mm256_movemask_ps ( a.v ) ); }
+
+#elif defined(SIMD_LANES_SSE)
+
+inline tFloat8 Load8 ( const float * p ) { tFloat8 r; r.lo = _mm_loadu_ps ( p ); r.hi = _mm_loadu_ps ( p + 4 ); return r; }
+inline void Store8 ( float * p , const tFloat8 & a ) { _mm_storeu_ps ( p , a.lo ); _mm_storeu_ps ( p + 4 , a.hi ); }
+inline tFloat8 Set8 ( const float s ) { tFloat8 r; r.lo = r.hi = _mm_set1_ps ( s ); return r; }
+inline tFloat8 operator + ( const tFloat8 & a , const tFloat8 & b ) { tFloat8 r; r.lo = _mm_add_ps ( a.lo , b.lo ); r.hi = _mm_add_ps ( a.hi , b.hi ); return r; }
+inline tFloat8 operator - ( const tFloat8 & a , const tFloat8 & b ) { tFloat8 r; r.lo = _mm_sub_ps ( a.lo , b.lo ); r.hi = _mm_sub_ps ( a.hi , b.hi ); return r; }
+inline tFloat8 operator * ( const tFloat8 & a , const tFloat8 & b ) { tFloat8 r; r.lo = _mm_mul_ps ( a.lo , b.lo ); r.hi = _mm_mul_ps ( a.hi , b.hi ); return r; }
+inline tFloat8 operator / ( const tFloat8 & a , const tFloat8 & b ) { tFloat8 r; r.lo = _mm_div_ps ( a.lo , b.lo ); r.hi = _mm_div_ps ( a.hi , b.hi ); return r; }
+inline tFloat8 Min8 ( const tFloat8 & a , const tFloat8 & b ) { tFloat8 r; r.lo = _mm_min_ps ( a.lo , b.lo ); r.hi = _mm_min_ps ( a.hi , b.hi ); return r; }
+inline tFloat8 Max8 ( const tFloat8 & a , const tFloat8 & b ) { tFloat8 r; r.lo = _mm_max_ps ( a.lo , b.lo ); r.hi = _mm_max_ps ( a.hi , b.hi ); return r; }
+inline tFloat8 Sqrt8 ( const tFloat8 & a ) { tFloat8 r; r.lo = _mm_sqrt_ps ( a.lo ); r.hi = _mm_sqrt_ps ( a.hi ); return r; }
+inline tFloat8 Less8 ( const tFloat8 & a , const tFloat8 & b ) { tFloat8 r; r.lo = _mm_cmplt_ps ( a.lo , b.lo ); r.hi = _mm_cmplt_ps ( a.hi , b.hi ); return r; }
+inline tFloat8 And8 ( const tFloat8 & a , const tFloat8 & b ) { tFloat8 r; r.lo = _mm_and_ps ( a.lo , b.lo ); r.hi = _mm_and_ps ( a.hi , b.hi ); return r; }
+inline tFloat8 AndNot8 ( const tFloat8 & a , const tFloat8 & b ) { tFloat8 r; r.lo = _mm_andnot_ps ( a.lo , b.lo ); r.hi = _mm_andnot_ps ( a.hi , b.hi ); return r; }
+inline tFloat8 Or8 ( const tFloat8 & a , const tFloat8 & b ) { tFloat8 r; r.lo = _mm_or_ps ( a.lo , b.lo ); r.hi = _mm_or_ps ( a.hi , b.hi ); return r; }
+inline tFloat8 Select8 ( const tFloat8 & mask , const tFloat8 & a , const tFloat8 & b ) { return Or8 ( And8 ( mask , a ) , AndNot8 ( mask , b ) ); }
+inline unsigned int Mask8 ( const tFloat8 & a ) { return static_cast < unsigned int > ( _mm_movemask_ps ( a.lo ) | ( _mm_movemask_ps ( a.hi ) << 4 ) ); }
+
+#else
+
+#include <cstring>
+inline tFloat8 Load8 ( const float * p ) { tFloat8 r; for ( int i = 0; i < 8; ++i ) r.f [ i ] = p [ i ]; return r; }
+inline void Store8 ( float * p , const tFloat8 & a ) { for ( int i = 0; i < 8; ++i ) p [ i ] = a.f [ i ]; }
+inline tFloat8 Set8 ( const float s ) { tFloat8 r; for ( int i = 0; i < 8; ++i ) r.f [ i ] = s; return r; }
+inline tFloat8 operator + ( const tFloat8 & a , const tFloat8 & b ) { tFloat8 r; for ( int i = 0; i < 8; ++i ) r.f [ i ] = a.f [ i ] + b.f [ i ]; return r; }
+inline tFloat8 operator - ( const tFloat8 & a , const tFloat8 & b ) { tFloat8 r; for ( int i = 0; i < 8; ++i ) r.f [ i ] = a.f [ i ] - b.f [ i ]; return r; }
+inline tFloat8 operator * ( const tFloat8 & a , const tFloat8 & b ) { tFloat8 r; for ( int i = 0; i < 8; ++i ) r.f [ i ] = a.f [ i ] * b.f [ i ]; return r; }
+inline tFloat8 operator / ( const tFloat8 & a , const tFloat8 & b ) { tFloat8 r; for ( int i = 0; i < 8; ++i ) r.f [ i ] = a.f [ i ] / b.f [ i ]; return r; }
+inline tFloat8 Min8 ( const tFloat8 & a , const tFloat8 & b ) { tFloat8 r; for ( int i = 0; i < 8; ++i ) r.f [ i ] = a.f [ i ] < b.f [ i ] ? a.f [ i ] : b.f [ i ]; return r; }
+inline tFloat8 Max8 ( const tFloat8 & a , const tFloat8 & b ) { tFloat8 r; for ( int i = 0; i < 8; ++i ) r.f [ i ] = a.f [ i ] > b.f [ i ] ? a.f [ i ] : b.f [ i ]; return r; }
+inline tFloat8 Sqrt8 ( const tFloat8 & a ) { tFloat8 r; for ( int i = 0; i < 8; ++i ) r.f [ i ] = std::sqrt ( a.f [ i ] ); return r; }
+inline tFloat8 Bits8 ( const bool * b ) { tFloat8 r; const unsigned int all = 0xFFFFFFFFu , none = 0; for ( int i = 0; i < 8; ++i ) std::memcpy ( &r.f [ i ] , b [ i ] ? &all : &none , 4 ); return r; }
+inline tFloat8 Less8 ( const tFloat8 & a , const tFloat8 & b ) { bool t [ 8 ]; for ( int i = 0; i < 8; ++i ) t [ i ] = a.f [ i ] < b.f [ i ]; return Bits8 ( t ); }
+inline unsigned int Mask8 ( const tFloat8 & a ) { unsigned int m = 0; for ( int i = 0; i < 8; ++i ) { unsigned int u; std::memcpy ( &u , &a.f [ i ] , 4 ); if ( u >> 31 ) m |= 1u << i; } return m; }
+inline tFloat8 And8 ( const tFloat8 & a , const tFloat8 & b ) { bool t [ 8 ]; const unsigned int ma = Mask8 ( a ) , mb = Mask8 ( b ); for ( int i = 0; i < 8; ++i ) t [ i ] = ( ( ma & mb ) >> i ) & 1; return Bits8 ( t ); }
+inline tFloat8 AndNot8 ( const tFloat8 & a , const tFloat8 & b ) { bool t [ 8 ]; const unsigned int ma = Mask8 ( a ) , mb = Mask8 ( b ); for ( int i = 0; i < 8; ++i ) t [ i ] = ( ( ~ma & mb ) >> i ) & 1; return Bits8 ( t ); }
+inline tFloat8 Or8 ( const tFloat8 & a , const tFloat8 & b ) { bool t [ 8 ]; const unsigned int ma = Mask8 ( a ) , mb = Mask8 ( b ); for ( int i = 0; i < 8; ++i ) t [ i ] = ( ( ma | mb ) >> i ) & 1; return Bits8 ( t ); }
+inline tFloat8 Select8 ( const tFloat8 & mask , const tFloat8 & a , const tFloat8 & b ) { tFloat8 r; const unsigned int m = Mask8 ( mask ); for ( int i = 0; i < 8; ++i ) r.f [ i ] = ( ( m >> i ) & 1 ) ? a.f [ i ] : b.f [ i ]; return r; }
+
+#endif
+
+#endif // !defined(SIMDLANES_H__INCLUDED_)
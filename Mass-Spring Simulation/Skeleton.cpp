@@ -1,4 +1,5 @@
 #include "stdafx.h"
+#include <math.h>
 #include "skeleton.h"
 
 void DestroySkeleton(t_Bone *root)
@@ -84,6 +85,8 @@ void ResetBone(t_Bone *bone,t_Bone *parent)
 	bone->secCurFrame = 0;
 	bone->primChannel = NULL;
 	bone->secChannel = NULL;
+	bone->primSpeed = 1.0f;
+	bone->secSpeed = 1.0f;
 
 	bone->visualCnt = 0;					// COUNT OF ATTACHED VISUAL ELEMENTS
 	bone->visuals = NULL;					// POINTER TO VISUALS
@@ -144,4 +147,130 @@ void BoneAdvanceFrame(t_Bone *bone,int direction,BOOL doChildren)
 				BoneAdvanceFrame(child,direction,doChildren);	// RECURSE DOWN HIER
 		}
 	}
-}
\ No newline at end of file
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Function:	BoneAdvanceTime
+// Purpose:		Plays the channels of the children of a bone for a stretch
+//				of time
+// Arguments:	Bone, seconds to play and whether to go down the hierarchy
+// Notes:		Each channel plays CHANNEL_FRAME_RATE frames a second times
+//				its speed, so the animation keeps its pace whatever the steps
+///////////////////////////////////////////////////////////////////////////////
+void BoneAdvanceTime(t_Bone *bone,float seconds,BOOL doChildren)
+{
+/// Local Variables ///////////////////////////////////////////////////////////
+	int loop;
+	t_Bone *child;
+///////////////////////////////////////////////////////////////////////////////
+	if (bone->childCnt > 0)
+	{
+		child = bone->children;
+		for (loop = 0; loop < bone->childCnt; loop++,child++)
+		{
+			if (child->primFrameCount > 0)
+			{
+				child->primCurFrame = (float)fmod(child->primCurFrame + (seconds * CHANNEL_FRAME_RATE * child->primSpeed),child->primFrameCount);
+				if (child->primCurFrame < 0)
+					child->primCurFrame += child->primFrameCount;
+				BoneSetFrame(child,(int)child->primCurFrame);
+			}
+			if (doChildren && child->childCnt > 0)				// IF THIS CHILD HAS CHILDREN
+				BoneAdvanceTime(child,seconds,doChildren);		// RECURSE DOWN HIER
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Function:	BoneIndex
+// Purpose:		Numbers a bone in the order of a depth first walk of the
+//				hierarchy, the root being 0
+// Returns:		The number, -1 when the bone is not in the hierarchy
+// Notes:		Used to save which bone something follows
+///////////////////////////////////////////////////////////////////////////////
+static int BoneIndexFrom(t_Bone *bone,t_Bone *find,int &index)
+{
+/// Local Variables ///////////////////////////////////////////////////////////
+	int loop, found;
+///////////////////////////////////////////////////////////////////////////////
+	if (bone == find)
+		return index;
+	for (loop = 0; loop < bone->childCnt; loop++)
+	{
+		index++;
+		found = BoneIndexFrom(&bone->children[loop],find,index);
+		if (found >= 0)
+			return found;
+	}
+	return -1;
+}
+
+int BoneIndex(t_Bone *root,t_Bone *bone)
+{
+/// Local Variables ///////////////////////////////////////////////////////////
+	int index = 0;
+///////////////////////////////////////////////////////////////////////////////
+	return BoneIndexFrom(root,bone,index);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Function:	BoneAtIndex
+// Purpose:		Finds a bone from its BoneIndex
+// Returns:		The bone, NULL past the last one
+///////////////////////////////////////////////////////////////////////////////
+static t_Bone *BoneAtIndexFrom(t_Bone *bone,int &index)
+{
+/// Local Variables ///////////////////////////////////////////////////////////
+	int loop;
+	t_Bone *found;
+///////////////////////////////////////////////////////////////////////////////
+	if (index-- == 0)
+		return bone;
+	for (loop = 0; loop < bone->childCnt; loop++)
+	{
+		found = BoneAtIndexFrom(&bone->children[loop],index);
+		if (found != NULL)
+			return found;
+	}
+	return NULL;
+}
+
+t_Bone *BoneAtIndex(t_Bone *root,int index)
+{
+	if (index < 0)
+		return NULL;
+	return BoneAtIndexFrom(root,index);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Function:	BoneLocalMatrix
+// Purpose:		Builds the matrix taking bone space to the space of its parent
+// Arguments:	Bone and result Matrix in OpenGL Format
+// Notes:		Uses the current trans, rot and scale. Scale is applied first,
+//				then the rotations in X Y Z order (degrees), then translation
+///////////////////////////////////////////////////////////////////////////////
+void BoneLocalMatrix(t_Bone *bone,tMatrix *result)
+{
+/// Local Variables ///////////////////////////////////////////////////////////
+	float cx = (float)cos(DEGTORAD(bone->rot.x)), sx = (float)sin(DEGTORAD(bone->rot.x));
+	float cy = (float)cos(DEGTORAD(bone->rot.y)), sy = (float)sin(DEGTORAD(bone->rot.y));
+	float cz = (float)cos(DEGTORAD(bone->rot.z)), sz = (float)sin(DEGTORAD(bone->rot.z));
+///////////////////////////////////////////////////////////////////////////////
+	// COLUMN 0 IS THE ROTATED X AXIS AND SO ON, EACH SCALED BY ITS FACTOR
+	result->m[0] = cz * cy * bone->scale.x;
+	result->m[1] = sz * cy * bone->scale.x;
+	result->m[2] = -sy * bone->scale.x;
+	result->m[3] = 0.0f;
+	result->m[4] = ((cz * sy * sx) - (sz * cx)) * bone->scale.y;
+	result->m[5] = ((sz * sy * sx) + (cz * cx)) * bone->scale.y;
+	result->m[6] = cy * sx * bone->scale.y;
+	result->m[7] = 0.0f;
+	result->m[8] = ((cz * sy * cx) + (sz * sx)) * bone->scale.z;
+	result->m[9] = ((sz * sy * cx) - (cz * sx)) * bone->scale.z;
+	result->m[10] = cy * cx * bone->scale.z;
+	result->m[11] = 0.0f;
+	result->m[12] = bone->trans.x;
+	result->m[13] = bone->trans.y;
+	result->m[14] = bone->trans.z;
+	result->m[15] = 1.0f;
+}
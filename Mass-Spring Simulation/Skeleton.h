@@ -23,6 +23,8 @@
 #define CHANNEL_TYPE_INTERLEAVED	1024	// THIS DATA STREAM HAS MULTIPLE CHANNELS
 ///////////////////////////////////////////////////////////////////////////////
 
+#define CHANNEL_FRAME_RATE			30.0f	// FRAMES PLAYED PER SECOND AT A SPEED OF 1
+
 // COUNT OF NUMBER OF FLOATS FOR EACH CHANNEL TYPE
 static int s_Channel_Type_Size[] = 
 {
@@ -49,7 +51,7 @@ struct t_Visual
 	float	*vertexData;	// INTERLEAVED VERTEX DATA IN DATAFORMAT
 	long	vertexCnt;		// NUMBER OF VERTICES IN VISUAL
 	BOOL	reuseVertices;	// DO I WANT TO USED INDEXED ARRAYS
-	ushort	*faceIndex;		// INDEXED VERTEX DATA IF VERTICES ARE REUSED
+	void	*faceIndex;		// INDEXED VERTEX DATA IF VERTICES ARE REUSED, 16 OR 32 BIT BY vertexCnt (IndexBuffer.h)
 	int		vSize;			// NUMBER OF FLOATS IN A VERTEX
 	long	faceCnt;		// NUMBER OF FACES IN VISUAL
 	tVector *faceNormal;	// POINTER TO FACE NORMALS
@@ -129,6 +131,10 @@ void DestroySkeleton(t_Bone *root);
 void ResetBone(t_Bone *bone,t_Bone *parent);
 void BoneSetFrame(t_Bone *bone,int frame);
 void BoneAdvanceFrame(t_Bone *bone,int direction,BOOL doChildren);
+void BoneAdvanceTime(t_Bone *bone,float seconds,BOOL doChildren);
+int BoneIndex(t_Bone *root,t_Bone *bone);
+t_Bone *BoneAtIndex(t_Bone *root,int index);
+void BoneLocalMatrix(t_Bone *bone,tMatrix *result);
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -0,0 +1,133 @@
+#if !defined(SLOTRING_H__INCLUDED_)
+#define SLOTRING_H__INCLUDED_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+enum tRecorderPolicies
+{
+    RECORDER_DROP,		// A FRAME THAT FINDS THE RING FULL IS LOST, THE SIMULATION NEVER WAITS
+    RECORDER_BLOCK		// THE SIMULATION WAITS FOR THE WRITER, NO FRAME IS LOST
+};
+
+/**
+ * \brief A fixed ring of slots handed from the simulation thread to a writer thread, so files can be written while the simulation runs.
+ *
+ * The owner sizes the slots before Start, so nothing is allocated while running. The simulation fills the slot Acquire gives it and
+ * publishes it, the writer thread passes every published slot to the write function in order. When the ring is full the policy decides
+ * between dropping the slot and waiting for the writer.
+ *
+ * Acquire and Publish are meant to be called from a single thread.
+ */
+template < typename Slot >
+class CSlotRing
+{
+public:
+    typedef std::function < void ( Slot & slot ) > WriteBody;
+    CSlotRing () : head_ ( 0 ) , tail_ ( 0 ) , full_ ( 0 ) , stop_ ( false ) , policy_ ( RECORDER_DROP ) , dropped_ ( 0 ) {}
+    ~CSlotRing () { this->Stop (); }
+    CSlotRing ( const CSlotRing & other ) = delete;
+    CSlotRing & operator= ( const CSlotRing & other ) = delete;
+    /**
+     * \brief The slots, to be sized while the ring is stopped.
+     */
+    std::vector < Slot > & Slots () { return this->slots_; }
+    void Start ( const int policy , const WriteBody & write )
+    {
+        this->Stop ();
+        this->head_ = this->tail_ = this->full_ = 0;
+        this->stop_ = false;
+        this->policy_ = policy;
+        this->dropped_ = 0;
+        this->write_ = write;
+        this->writer_ = std::thread ( &CSlotRing::WriterLoop , this );
+    }
+    /**
+     * \brief The slot to fill next, NULL when it has to be dropped.
+     */
+    Slot * Acquire ()
+    {
+        std::unique_lock < std::mutex > lock ( this->mutex_ );
+        if ( this->full_ == this->slots_.size () )
+        {
+            if ( this->policy_ == RECORDER_DROP )
+            {
+                ++this->dropped_;
+                return NULL;
+            }
+            this->emptied_.wait ( lock , [ this ] { return this->full_ < this->slots_.size (); } );
+        }
+        // THE WRITER DOES NOT LOOK AT A SLOT UNTIL IT IS PUBLISHED, SO IT IS FILLED WITHOUT THE LOCK
+        return &this->slots_ [ this->head_ ];
+    }
+    void Publish ()
+    {
+        {
+            std::lock_guard < std::mutex > lock ( this->mutex_ );
+            this->head_ = ( this->head_ + 1 ) % this->slots_.size ();
+            ++this->full_;
+        }
+        this->filled_.notify_one ();
+    }
+    /**
+     * \brief Writes the slots still waiting and ends the writer thread.
+     */
+    void Stop ()
+    {
+        if ( ! this->writer_.joinable () )
+        {
+            return;
+        }
+        {
+            std::lock_guard < std::mutex > lock ( this->mutex_ );
+            this->stop_ = true;
+        }
+        this->filled_.notify_one ();
+        this->writer_.join ();
+    }
+    bool Running () const { return this->writer_.joinable (); }
+    int Dropped () const { return this->dropped_.load (); }
+private:
+    void WriterLoop ()
+    {
+        for ( ;; )
+        {
+            std::size_t slot;
+            {
+                std::unique_lock < std::mutex > lock ( this->mutex_ );
+                this->filled_.wait ( lock , [ this ] { return this->full_ > 0 || this->stop_; } );
+                // STOPPING STILL WRITES EVERY SLOT ALREADY PUBLISHED
+                if ( this->full_ == 0 )
+                {
+                    return;
+                }
+                slot = this->tail_;
+            }
+            this->write_ ( this->slots_ [ slot ] );
+            {
+                std::lock_guard < std::mutex > lock ( this->mutex_ );
+                this->tail_ = ( this->tail_ + 1 ) % this->slots_.size ();
+                --this->full_;
+            }
+            this->emptied_.notify_one ();
+        }
+    }
+    std::vector < Slot > slots_;
+    std::size_t head_;					// NEXT SLOT TO FILL
+    std::size_t tail_;					// NEXT SLOT TO WRITE
+    std::size_t full_;
+    std::mutex mutex_;
+    std::condition_variable filled_;
+    std::condition_variable emptied_;
+    bool stop_;
+    int policy_;
+    std::atomic < int > dropped_;
+    WriteBody write_;
+    std::thread writer_;
+};
+
+#endif // !defined(SLOTRING_H__INCLUDED_)
@@ -0,0 +1,583 @@
+#include "stdafx.h"
+#include <algorithm>
+#include <cstring>
+#include "Snapshot.h"
+
+static const char SNAPSHOT_MAGIC [ 4 ] = { 'C' , 'L' , 'S' , 'N' };
+
+#define SNAPSHOT_HEADER_SIZE	16
+#define CHUNK_HEADER_SIZE		16		// TAG, FLAGS, 64 BIT SIZE
+#define CHUNK_TRAILER_SIZE		4		// CRC OF THE PAYLOAD
+#define BONE_RECORD_SIZE		( 4 + 80 + 4 + 6 * 12 + 16 + 64 )
+#define VISUAL_RECORD_SIZE		( 6 * 4 + 3 * 12 + 4 + 255 + 16 * 12 )
+#define LEGACY_BONE_SIZE		412		// sizeof(t_Bone) IN A 32 BIT BUILD
+#define LEGACY_VISUAL_SIZE		528		// sizeof(t_Visual) IN A 32 BIT BUILD
+
+bool LittleEndian ()
+{
+    const std::uint16_t one = 1;
+    unsigned char first;
+    std::memcpy ( &first , &one , 1 );
+    return first == 1;
+}
+
+void SwapWords ( unsigned char * data , const std::size_t size , const std::size_t wordSize )
+{
+    for ( std::size_t at = 0; at + wordSize <= size; at += wordSize )
+    {
+        std::reverse ( data + at , data + at + wordSize );
+    }
+}
+
+/**
+ * \brief The tables of the slicing by 8 CRC, which handles 8 bytes per step instead of one.
+ */
+struct tCrcTables
+{
+    std::uint32_t table [ 8 ] [ 256 ];
+    tCrcTables ()
+    {
+        for ( std::uint32_t byte = 0; byte < 256; ++byte )
+        {
+            std::uint32_t crc = byte;
+            for ( int bit = 0; bit < 8; ++bit )
+            {
+                crc = ( crc >> 1 ) ^ ( ( crc & 1 ) ? 0xEDB88320u : 0 );
+            }
+            this->table [ 0 ] [ byte ] = crc;
+        }
+        for ( int slice = 1; slice < 8; ++slice )
+        {
+            for ( int byte = 0; byte < 256; ++byte )
+            {
+                const std::uint32_t previous = this->table [ slice - 1 ] [ byte ];
+                this->table [ slice ] [ byte ] = ( previous >> 8 ) ^ this->table [ 0 ] [ previous & 0xFF ];
+            }
+        }
+    }
+};
+
+std::uint32_t Crc32 ( const void * data , std::size_t size , std::uint32_t crc )
+{
+    static const tCrcTables tables;
+    const std::uint32_t ( & table ) [ 8 ] [ 256 ] = tables.table;
+    const unsigned char * at = static_cast < const unsigned char * > ( data );
+    crc = ~crc;
+    for ( ; size >= 8; size -= 8 , at += 8 )
+    {
+        const std::uint32_t low = crc ^ ( at [ 0 ] | ( at [ 1 ] << 8 ) | ( at [ 2 ] << 16 ) | ( static_cast < std::uint32_t > ( at [ 3 ] ) << 24 ) );
+        const std::uint32_t high = at [ 4 ] | ( at [ 5 ] << 8 ) | ( at [ 6 ] << 16 ) | ( static_cast < std::uint32_t > ( at [ 7 ] ) << 24 );
+        crc = table [ 7 ] [ low & 0xFF ] ^ table [ 6 ] [ ( low >> 8 ) & 0xFF ] ^ table [ 5 ] [ ( low >> 16 ) & 0xFF ] ^ table [ 4 ] [ low >> 24 ]
+            ^ table [ 3 ] [ high & 0xFF ] ^ table [ 2 ] [ ( high >> 8 ) & 0xFF ] ^ table [ 1 ] [ ( high >> 16 ) & 0xFF ] ^ table [ 0 ] [ high >> 24 ];
+    }
+    for ( ; size > 0; --size , ++at )
+    {
+        crc = ( crc >> 8 ) ^ table [ 0 ] [ ( crc ^ *at ) & 0xFF ];
+    }
+    return ~crc;
+}
+
+CSnapshotWriter::CSnapshotWriter () : fp_ ( nullptr ) , payloadStart_ ( 0 ) , left_ ( 0 ) , crc_ ( 0 ) , failed_ ( false ) , inChunk_ ( false ) , keepPartial_ ( false ) , position_ ( 0 )
+{
+}
+
+CSnapshotWriter::~CSnapshotWriter ()
+{
+    // A WRITER THAT WAS NEVER CLOSED LEFT AN INCOMPLETE FILE, WHICH IS ONLY KEPT WHEN ITS WHOLE CHUNKS ARE WORTH READING
+    if ( this->fp_ != nullptr )
+    {
+        if ( this->keepPartial_ )
+        {
+            this->Flush ();
+        }
+        fclose ( this->fp_ );
+        if ( ! this->keepPartial_ )
+        {
+            remove ( this->filename_.c_str () );
+        }
+    }
+}
+
+bool CSnapshotWriter::Open ( const char * filename , bool keepPartial )
+{
+    unsigned char header [ SNAPSHOT_HEADER_SIZE ] = { 0 };
+    this->fp_ = fopen ( filename , "wb" );
+    if ( this->fp_ == nullptr )
+    {
+        return false;
+    }
+    this->filename_ = filename;
+    this->buffer_.clear ();
+    this->buffer_.reserve ( SNAPSHOT_BUFFER );
+    this->failed_ = false;
+    this->inChunk_ = false;
+    this->keepPartial_ = keepPartial;
+    this->position_ = 0;
+    std::memcpy ( header , SNAPSHOT_MAGIC , sizeof ( SNAPSHOT_MAGIC ) );
+    header [ 4 ] = SNAPSHOT_VERSION & 0xFF;
+    header [ 5 ] = ( SNAPSHOT_VERSION >> 8 ) & 0xFF;
+    this->Append ( header , sizeof ( header ) );
+    return true;
+}
+
+void CSnapshotWriter::Append ( const void * data , std::size_t size )
+{
+    const unsigned char * at = static_cast < const unsigned char * > ( data );
+    this->position_ += size;
+    while ( size > 0 )
+    {
+        const std::size_t room = std::min ( size , static_cast < std::size_t > ( SNAPSHOT_BUFFER ) - this->buffer_.size () );
+        this->buffer_.insert ( this->buffer_.end () , at , at + room );
+        at += room;
+        size -= room;
+        if ( this->buffer_.size () == SNAPSHOT_BUFFER )
+        {
+            this->Flush ();
+        }
+    }
+}
+
+void CSnapshotWriter::Flush ()
+{
+    if ( this->inChunk_ )
+    {
+        this->crc_ = Crc32 ( this->buffer_.data () + this->payloadStart_ , this->buffer_.size () - this->payloadStart_ , this->crc_ );
+    }
+    this->payloadStart_ = 0;
+    if ( ! this->buffer_.empty () && fwrite ( this->buffer_.data () , 1 , this->buffer_.size () , this->fp_ ) != this->buffer_.size () )
+    {
+        this->failed_ = true;
+    }
+    this->buffer_.clear ();
+}
+
+void CSnapshotWriter::BeginChunk ( std::uint32_t tag , std::uint64_t size )
+{
+    unsigned char header [ CHUNK_HEADER_SIZE ];
+    if ( this->inChunk_ )
+    {
+        this->failed_ = true;
+        this->EndChunk ();
+    }
+    for ( int byte = 0; byte < 4; ++byte )
+    {
+        header [ byte ] = static_cast < unsigned char > ( tag >> ( 8 * byte ) );
+        header [ 4 + byte ] = 0;
+    }
+    for ( int byte = 0; byte < 8; ++byte )
+    {
+        header [ 8 + byte ] = static_cast < unsigned char > ( size >> ( 8 * byte ) );
+    }
+    this->Append ( header , sizeof ( header ) );
+    this->inChunk_ = true;
+    this->payloadStart_ = this->buffer_.size ();
+    this->left_ = size;
+    this->crc_ = 0;
+}
+
+void CSnapshotWriter::PutU32 ( std::uint32_t value )
+{
+    const unsigned char bytes [ 4 ] = { static_cast < unsigned char > ( value ) , static_cast < unsigned char > ( value >> 8 ) ,
+        static_cast < unsigned char > ( value >> 16 ) , static_cast < unsigned char > ( value >> 24 ) };
+    this->PutBytes ( bytes , sizeof ( bytes ) );
+}
+
+void CSnapshotWriter::PutF32 ( float value )
+{
+    std::uint32_t bits;
+    std::memcpy ( &bits , &value , sizeof ( bits ) );
+    this->PutU32 ( bits );
+}
+
+void CSnapshotWriter::PutVector ( const tVector & value )
+{
+    this->PutF32 ( value.x );
+    this->PutF32 ( value.y );
+    this->PutF32 ( value.z );
+}
+
+void CSnapshotWriter::PutBytes ( const void * data , std::size_t size )
+{
+    if ( ! this->inChunk_ || size > this->left_ )
+    {
+        this->failed_ = true;
+        return;
+    }
+    this->left_ -= size;
+    this->Append ( data , size );
+}
+
+void CSnapshotWriter::PutWords ( const void * data , std::size_t size , std::size_t wordSize )
+{
+    unsigned char swapped [ 4096 ];
+    if ( LittleEndian () )
+    {
+        this->PutBytes ( data , size );
+        return;
+    }
+    const unsigned char * at = static_cast < const unsigned char * > ( data );
+    while ( size > 0 )
+    {
+        const std::size_t piece = std::min ( size , sizeof ( swapped ) );
+        std::memcpy ( swapped , at , piece );
+        SwapWords ( swapped , piece , wordSize );
+        this->PutBytes ( swapped , piece );
+        at += piece;
+        size -= piece;
+    }
+}
+
+void CSnapshotWriter::EndChunk ()
+{
+    static const unsigned char padding [ SNAPSHOT_ALIGN ] = { 0 };
+    if ( ! this->inChunk_ )
+    {
+        this->failed_ = true;
+        return;
+    }
+    // A CHUNK SHORTER THAN ANNOUNCED WOULD THROW OFF EVERY CHUNK AFTER IT
+    if ( this->left_ != 0 )
+    {
+        this->failed_ = true;
+    }
+    this->crc_ = Crc32 ( this->buffer_.data () + this->payloadStart_ , this->buffer_.size () - this->payloadStart_ , this->crc_ );
+    this->inChunk_ = false;
+    const unsigned char trailer [ CHUNK_TRAILER_SIZE ] = { static_cast < unsigned char > ( this->crc_ ) , static_cast < unsigned char > ( this->crc_ >> 8 ) ,
+        static_cast < unsigned char > ( this->crc_ >> 16 ) , static_cast < unsigned char > ( this->crc_ >> 24 ) };
+    this->Append ( trailer , sizeof ( trailer ) );
+    this->Append ( padding , static_cast < std::size_t > ( ( SNAPSHOT_ALIGN - this->position_ % SNAPSHOT_ALIGN ) % SNAPSHOT_ALIGN ) );
+}
+
+bool CSnapshotWriter::Sync ()
+{
+    if ( this->fp_ == nullptr || this->inChunk_ )
+    {
+        return false;
+    }
+    this->Flush ();
+    if ( fflush ( this->fp_ ) != 0 )
+    {
+        this->failed_ = true;
+    }
+    return ! this->failed_;
+}
+
+bool CSnapshotWriter::Close ()
+{
+    if ( this->fp_ == nullptr )
+    {
+        return false;
+    }
+    if ( this->inChunk_ )
+    {
+        this->failed_ = true;
+        this->EndChunk ();
+    }
+    this->BeginChunk ( SNAPSHOT_END , 0 );
+    this->EndChunk ();
+    this->Flush ();
+    if ( fclose ( this->fp_ ) != 0 )
+    {
+        this->failed_ = true;
+    }
+    this->fp_ = nullptr;
+    if ( this->failed_ && ! this->keepPartial_ )
+    {
+        remove ( this->filename_.c_str () );
+    }
+    return ! this->failed_;
+}
+
+bool CSnapshotCursor::Take ( std::size_t size )
+{
+    if ( this->failed_ || size > this->Left () )
+    {
+        this->failed_ = true;
+        this->at_ = this->end_;
+        return false;
+    }
+    return true;
+}
+
+std::uint32_t CSnapshotCursor::GetU32 ()
+{
+    if ( ! this->Take ( 4 ) )
+    {
+        return 0;
+    }
+    const std::uint32_t value = this->at_ [ 0 ] | ( this->at_ [ 1 ] << 8 ) | ( this->at_ [ 2 ] << 16 ) | ( static_cast < std::uint32_t > ( this->at_ [ 3 ] ) << 24 );
+    this->at_ += 4;
+    return value;
+}
+
+float CSnapshotCursor::GetF32 ()
+{
+    const std::uint32_t bits = this->GetU32 ();
+    float value;
+    std::memcpy ( &value , &bits , sizeof ( value ) );
+    return value;
+}
+
+tVector CSnapshotCursor::GetVector ()
+{
+    tVector value;
+    value.x = this->GetF32 ();
+    value.y = this->GetF32 ();
+    value.z = this->GetF32 ();
+    return value;
+}
+
+void CSnapshotCursor::GetBytes ( void * data , std::size_t size )
+{
+    if ( ! this->Take ( size ) )
+    {
+        std::memset ( data , 0 , size );
+        return;
+    }
+    std::memcpy ( data , this->at_ , size );
+    this->at_ += size;
+}
+
+void CSnapshotCursor::GetWords ( void * data , std::size_t size , std::size_t wordSize )
+{
+    this->GetBytes ( data , size );
+    if ( ! LittleEndian () )
+    {
+        SwapWords ( static_cast < unsigned char * > ( data ) , size , wordSize );
+    }
+}
+
+void CSnapshotCursor::Skip ( std::size_t size )
+{
+    if ( this->Take ( size ) )
+    {
+        this->at_ += size;
+    }
+}
+
+int CSnapshotReader::Open ( const char * filename )
+{
+    this->chunks_.clear ();
+    this->damaged_ = false;
+    if ( ! this->file_.Open ( filename ) )
+    {
+        return SNAPSHOT_INVALID;
+    }
+    if ( this->file_.Size () < SNAPSHOT_HEADER_SIZE || std::memcmp ( this->file_.Begin () , SNAPSHOT_MAGIC , sizeof ( SNAPSHOT_MAGIC ) ) != 0 )
+    {
+        return SNAPSHOT_LEGACY;
+    }
+    CSnapshotCursor cursor ( this->file_.Begin () , this->file_.Size () );
+    cursor.Skip ( sizeof ( SNAPSHOT_MAGIC ) );
+    const std::uint32_t version = cursor.GetU32 ();
+    cursor.Skip ( SNAPSHOT_HEADER_SIZE - 8 );
+    if ( version == 0 || version > SNAPSHOT_VERSION )
+    {
+        return SNAPSHOT_INVALID;
+    }
+    // WALK THE CHUNK HEADERS, THE CRCS ARE LEFT FOR WHEN A CHUNK IS READ. ONLY A FILE THAT REACHES ITS END CHUNK IS COMPLETE, ONE CUT
+    // SHORT KEEPS THE CHUNKS BEFORE THE CUT
+    while ( cursor.Has ( 1 , CHUNK_HEADER_SIZE ) )
+    {
+        tChunk chunk;
+        chunk.tag = cursor.GetU32 ();
+        cursor.Skip ( 4 );
+        const std::uint64_t low = cursor.GetU32 ();
+        const std::uint64_t size = low | ( static_cast < std::uint64_t > ( cursor.GetU32 () ) << 32 );
+        if ( size > cursor.Left () || cursor.Left () - size < CHUNK_TRAILER_SIZE )
+        {
+            break;
+        }
+        chunk.size = static_cast < std::size_t > ( size );
+        chunk.data = reinterpret_cast < const unsigned char * > ( this->file_.End () ) - cursor.Left ();
+        cursor.Skip ( chunk.size );
+        chunk.crc = cursor.GetU32 ();
+        chunk.checked = 0;
+        if ( chunk.tag == SNAPSHOT_END )
+        {
+            return SNAPSHOT_CHUNKED;
+        }
+        this->chunks_.push_back ( chunk );
+        const std::size_t offset = this->file_.Size () - cursor.Left ();
+        cursor.Skip ( std::min ( cursor.Left () , static_cast < std::size_t > ( ( SNAPSHOT_ALIGN - offset % SNAPSHOT_ALIGN ) % SNAPSHOT_ALIGN ) ) );
+    }
+    return SNAPSHOT_PARTIAL;
+}
+
+CSnapshotCursor CSnapshotReader::Chunk ( std::uint32_t tag ) const
+{
+    for ( const tChunk & chunk : this->chunks_ )
+    {
+        if ( chunk.tag == tag )
+        {
+            return this->Checked ( chunk );
+        }
+    }
+    return CSnapshotCursor ();
+}
+
+CSnapshotCursor CSnapshotReader::ChunkAt ( std::size_t at ) const
+{
+    return this->Checked ( this->chunks_ [ at ] );
+}
+
+CSnapshotCursor CSnapshotReader::Checked ( const tChunk & chunk ) const
+{
+    if ( chunk.checked == 0 )
+    {
+        chunk.checked = Crc32 ( chunk.data , chunk.size ) == chunk.crc ? 1 : -1;
+    }
+    this->damaged_ = this->damaged_ || chunk.checked < 0;
+    return chunk.checked > 0 ? CSnapshotCursor ( chunk.data , chunk.size ) : CSnapshotCursor ();
+}
+
+void CSnapshotReader::Close ()
+{
+    this->chunks_.clear ();
+    this->file_.Close ();
+}
+
+void PutBone ( CSnapshotWriter & writer , std::uint32_t tag , const t_Bone & bone )
+{
+    writer.BeginChunk ( tag , BONE_RECORD_SIZE );
+    writer.PutI32 ( bone.id );
+    writer.PutBytes ( bone.name , sizeof ( bone.name ) );
+    writer.PutI32 ( bone.flags );
+    writer.PutVector ( bone.b_scale );
+    writer.PutVector ( bone.b_rot );
+    writer.PutVector ( bone.b_trans );
+    writer.PutVector ( bone.scale );
+    writer.PutVector ( bone.rot );
+    writer.PutVector ( bone.trans );
+    writer.PutWords ( &bone.quat , sizeof ( bone.quat ) , 4 );
+    writer.PutWords ( &bone.matrix , sizeof ( bone.matrix ) , 4 );
+    writer.EndChunk ();
+}
+
+void GetBone ( CSnapshotCursor & cursor , t_Bone & bone )
+{
+    bone.id = cursor.GetI32 ();
+    cursor.GetBytes ( bone.name , sizeof ( bone.name ) );
+    bone.name [ sizeof ( bone.name ) - 1 ] = '\0';
+    bone.flags = cursor.GetI32 ();
+    bone.b_scale = cursor.GetVector ();
+    bone.b_rot = cursor.GetVector ();
+    bone.b_trans = cursor.GetVector ();
+    bone.scale = cursor.GetVector ();
+    bone.rot = cursor.GetVector ();
+    bone.trans = cursor.GetVector ();
+    cursor.GetWords ( &bone.quat , sizeof ( bone.quat ) , 4 );
+    cursor.GetWords ( &bone.matrix , sizeof ( bone.matrix ) , 4 );
+}
+
+void PutVisual ( CSnapshotWriter & writer , const t_Visual & visual )
+{
+    writer.BeginChunk ( SNAPSHOT_VISUAL , VISUAL_RECORD_SIZE );
+    writer.PutI32 ( visual.dataFormat );
+    writer.PutI32 ( visual.vertexCnt );
+    writer.PutI32 ( visual.reuseVertices );
+    writer.PutI32 ( visual.vSize );
+    writer.PutI32 ( visual.faceCnt );
+    writer.PutI32 ( visual.vPerFace );
+    writer.PutVector ( visual.Ka );
+    writer.PutVector ( visual.Kd );
+    writer.PutVector ( visual.Ks );
+    writer.PutF32 ( visual.Ns );
+    writer.PutBytes ( visual.map , sizeof ( visual.map ) );
+    for ( int corner = 0; corner < 8; ++corner )
+    {
+        writer.PutVector ( visual.bbox [ corner ] );
+    }
+    for ( int corner = 0; corner < 8; ++corner )
+    {
+        writer.PutVector ( visual.transBBox [ corner ] );
+    }
+    writer.EndChunk ();
+}
+
+void GetVisual ( CSnapshotCursor & cursor , t_Visual & visual )
+{
+    std::memset ( &visual , 0 , sizeof ( visual ) );
+    visual.dataFormat = cursor.GetI32 ();
+    visual.vertexCnt = cursor.GetI32 ();
+    visual.reuseVertices = cursor.GetI32 ();
+    visual.vSize = cursor.GetI32 ();
+    visual.faceCnt = cursor.GetI32 ();
+    visual.vPerFace = cursor.GetI32 ();
+    visual.Ka = cursor.GetVector ();
+    visual.Kd = cursor.GetVector ();
+    visual.Ks = cursor.GetVector ();
+    visual.Ns = cursor.GetF32 ();
+    cursor.GetBytes ( visual.map , sizeof ( visual.map ) );
+    visual.map [ sizeof ( visual.map ) - 1 ] = '\0';
+    for ( int corner = 0; corner < 8; ++corner )
+    {
+        visual.bbox [ corner ] = cursor.GetVector ();
+    }
+    for ( int corner = 0; corner < 8; ++corner )
+    {
+        visual.transBBox [ corner ] = cursor.GetVector ();
+    }
+}
+
+bool GetLegacyBones ( CSnapshotCursor & cursor , t_Bone & root )
+{
+    if ( ! cursor.Has ( 2 , LEGACY_BONE_SIZE ) )
+    {
+        cursor.Skip ( 2 * LEGACY_BONE_SIZE );
+        return false;
+    }
+    // THE FIELDS UP TO THE MATRIX, WITH THE THREE HIERARCHY POINTERS AND COUNT AFTER THE FLAGS
+    root.id = cursor.GetI32 ();
+    cursor.GetBytes ( root.name , sizeof ( root.name ) );
+    root.name [ sizeof ( root.name ) - 1 ] = '\0';
+    root.flags = cursor.GetI32 ();
+    cursor.Skip ( 4 );
+    const std::int32_t childCnt = cursor.GetI32 ();
+    cursor.Skip ( 4 );
+    root.b_scale = cursor.GetVector ();
+    root.b_rot = cursor.GetVector ();
+    root.b_trans = cursor.GetVector ();
+    root.scale = cursor.GetVector ();
+    root.rot = cursor.GetVector ();
+    root.trans = cursor.GetVector ();
+    cursor.GetWords ( &root.quat , sizeof ( root.quat ) , 4 );
+    cursor.GetWords ( &root.matrix , sizeof ( root.matrix ) , 4 );
+    cursor.Skip ( LEGACY_BONE_SIZE - 252 + LEGACY_BONE_SIZE );
+    return childCnt > 0;
+}
+
+void GetLegacyVisual ( CSnapshotCursor & cursor , t_Visual & visual )
+{
+    std::memset ( &visual , 0 , sizeof ( visual ) );
+    if ( ! cursor.Has ( 1 , LEGACY_VISUAL_SIZE ) )
+    {
+        cursor.Skip ( LEGACY_VISUAL_SIZE );
+        return;
+    }
+    // EVERY POINTER IN THE RECORD WAS 4 BYTES AND IS SKIPPED
+    visual.dataFormat = cursor.GetI32 ();
+    cursor.Skip ( 4 );
+    visual.vertexCnt = cursor.GetI32 ();
+    visual.reuseVertices = cursor.GetI32 ();
+    cursor.Skip ( 4 );
+    visual.vSize = cursor.GetI32 ();
+    visual.faceCnt = cursor.GetI32 ();
+    cursor.Skip ( 4 );
+    visual.vPerFace = cursor.GetI32 ();
+    visual.Ka = cursor.GetVector ();
+    visual.Kd = cursor.GetVector ();
+    visual.Ks = cursor.GetVector ();
+    visual.Ns = cursor.GetF32 ();
+    cursor.GetBytes ( visual.map , sizeof ( visual.map ) );
+    visual.map [ sizeof ( visual.map ) - 1 ] = '\0';
+    cursor.Skip ( 1 + 4 );		// PADDING AFTER THE MAP, THEN THE TEXTURE NAME OF THAT SESSION
+    for ( int corner = 0; corner < 8; ++corner )
+    {
+        visual.bbox [ corner ] = cursor.GetVector ();
+    }
+    for ( int corner = 0; corner < 8; ++corner )
+    {
+        visual.transBBox [ corner ] = cursor.GetVector ();
+    }
+}
@@ -0,0 +1,222 @@
+#if !defined(SNAPSHOT_H__INCLUDED_)
+#define SNAPSHOT_H__INCLUDED_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "MathDefs.h"
+#include "Skeleton.h"
+#include "ObjParser.h"
+
+#define SNAPSHOT_VERSION		1
+#define SNAPSHOT_ALIGN			8				// EVERY CHUNK STARTS ON 8 BYTES
+#define SNAPSHOT_BUFFER			( 1 << 16 )		// BYTES GATHERED BEFORE EACH WRITE
+#define SNAPSHOT_TAG(a,b,c,d)	( (std::uint32_t)(a) | ((std::uint32_t)(b) << 8) | ((std::uint32_t)(c) << 16) | ((std::uint32_t)(d) << 24) )
+
+// CHUNKS OF A SIMULATION FILE
+#define SNAPSHOT_ROOT			SNAPSHOT_TAG('R','O','O','T')	// THE SKELETON (CAMERA) BONE
+#define SNAPSHOT_BONE			SNAPSHOT_TAG('B','O','N','E')	// THE BONE HOLDING THE CLOTH
+#define SNAPSHOT_VISUAL			SNAPSHOT_TAG('V','I','S','L')
+#define SNAPSHOT_VERTICES		SNAPSHOT_TAG('V','E','R','T')
+#define SNAPSHOT_INDICES		SNAPSHOT_TAG('I','N','D','X')
+#define SNAPSHOT_PARAMS			SNAPSHOT_TAG('P','A','R','M')
+#define SNAPSHOT_PARTICLES		SNAPSHOT_TAG('P','A','R','T')
+#define SNAPSHOT_SPRINGS		SNAPSHOT_TAG('S','P','R','G')
+#define SNAPSHOT_SPHERES		SNAPSHOT_TAG('S','P','H','R')
+#define SNAPSHOT_PLANES			SNAPSHOT_TAG('P','L','A','N')
+#define SNAPSHOT_BOXES			SNAPSHOT_TAG('B','O','X','S')
+#define SNAPSHOT_CAPSULES		SNAPSHOT_TAG('C','A','P','S')
+#define SNAPSHOT_BONE_SPHERES	SNAPSHOT_TAG('B','S','P','H')	// COLLIDERS FOLLOWING A BONE, EACH AFTER
+#define SNAPSHOT_BONE_BOXES		SNAPSHOT_TAG('B','B','O','X')	// THE DEPTH FIRST INDEX OF ITS BONE
+#define SNAPSHOT_BONE_CAPSULES	SNAPSHOT_TAG('B','C','A','P')
+#define SNAPSHOT_MESHES			SNAPSHOT_TAG('M','E','S','H')	// TRIANGLE MESHES, EACH AFTER ITS BONE OR -1
+#define SNAPSHOT_END			SNAPSHOT_TAG('E','N','D',' ')
+
+/**
+ * \brief The CRC-32 (IEEE) of a block, continued from the CRC of the blocks before it.
+ */
+std::uint32_t Crc32 ( const void * data , std::size_t size , std::uint32_t crc = 0 );
+bool LittleEndian ();
+/**
+ * \brief Reverses the bytes of every word of a block in place.
+ */
+void SwapWords ( unsigned char * data , std::size_t size , std::size_t wordSize );
+
+/**
+ * \brief Writes a chunked snapshot.
+ *
+ * A snapshot is a 16 byte header (magic, version) followed by chunks. A chunk is its tag and payload size, the payload, and the CRC-32 of the
+ * payload, padded to SNAPSHOT_ALIGN. Everything is little endian whatever the machine. The size of a chunk is given up front, so its payload can
+ * be streamed in any number of Put calls: it goes out through a fixed buffer and large arrays are never copied whole.
+ * Errors are sticky and reported by Close, which also removes a file that was not written completely, unless it was opened to keep partial files.
+ */
+class CSnapshotWriter
+{
+public:
+    CSnapshotWriter ();
+    ~CSnapshotWriter ();
+    CSnapshotWriter ( const CSnapshotWriter & other ) = delete;
+    CSnapshotWriter & operator= ( const CSnapshotWriter & other ) = delete;
+    /**
+     * \param keepPartial Leave what was written when writing fails or the writer is never closed, for files read in order like recordings.
+     * The chunks written before the failure can still be read, see SNAPSHOT_PARTIAL.
+     */
+    bool Open ( const char * filename , bool keepPartial = false );
+    void BeginChunk ( std::uint32_t tag , std::uint64_t size );
+    void PutU32 ( std::uint32_t value );
+    void PutI32 ( std::int32_t value ) { this->PutU32 ( static_cast < std::uint32_t > ( value ) ); }
+    void PutF32 ( float value );
+    void PutVector ( const tVector & value );
+    void PutBytes ( const void * data , std::size_t size );
+    /**
+     * \brief Writes records made only of 2 or 4 byte fields, swapping each field on a big endian machine.
+     */
+    void PutWords ( const void * data , std::size_t size , std::size_t wordSize );
+    void EndChunk ();
+    /**
+     * \brief Hands every chunk ended so far to the system, so they are in the file even if the program stops before Close. Only between chunks.
+     * \return False when anything failed since Open.
+     */
+    bool Sync ();
+    /**
+     * \brief Ends the file.
+     * \return False when anything failed since Open.
+     */
+    bool Close ();
+private:
+    void Append ( const void * data , std::size_t size );
+    void Flush ();
+    FILE * fp_;
+    std::string filename_;
+    std::vector < unsigned char > buffer_;
+    std::size_t payloadStart_;		// WHERE THE PAYLOAD OF THE OPEN CHUNK STARTS IN THE BUFFER
+    std::uint64_t left_;			// BYTES THE OPEN CHUNK STILL EXPECTS
+    std::uint32_t crc_;
+    bool failed_;
+    bool inChunk_;
+    bool keepPartial_;
+    std::uint64_t position_;		// BYTES WRITTEN SO FAR, FOR THE PADDING
+};
+
+/**
+ * \brief Reads little endian fields from a block of memory. Reading past the end gives zeros and marks the cursor failed.
+ */
+class CSnapshotCursor
+{
+public:
+    CSnapshotCursor () : at_ ( nullptr ) , end_ ( nullptr ) , failed_ ( true ) {}
+    CSnapshotCursor ( const void * data , std::size_t size ) : at_ ( static_cast < const unsigned char * > ( data ) ) , end_ ( at_ + size ) , failed_ ( false ) {}
+    std::uint32_t GetU32 ();
+    std::int32_t GetI32 () { return static_cast < std::int32_t > ( this->GetU32 () ); }
+    float GetF32 ();
+    tVector GetVector ();
+    void GetBytes ( void * data , std::size_t size );
+    void GetWords ( void * data , std::size_t size , std::size_t wordSize );
+    void Skip ( std::size_t size );
+    /**
+     * \brief Marks the cursor failed, for a field read fine but holding a value that can not be right.
+     */
+    void Fail () { this->failed_ = true; this->at_ = this->end_; }
+    /**
+     * \brief True when count records of a size are left, checked before allocating for them.
+     */
+    bool Has ( std::uint64_t count , std::size_t size ) const { return ! this->failed_ && count <= this->Left () / size; }
+    std::size_t Left () const { return static_cast < std::size_t > ( this->end_ - this->at_ ); }
+    /**
+     * \brief Where the next field starts, for data that is used in place.
+     */
+    const unsigned char * Peek () const { return this->at_; }
+    bool Failed () const { return this->failed_; }
+private:
+    bool Take ( std::size_t size );
+    const unsigned char * at_;
+    const unsigned char * end_;
+    bool failed_;
+};
+
+enum tSnapshotFormats
+{
+    SNAPSHOT_INVALID,
+    SNAPSHOT_LEGACY,		// THE OLD .dps LAYOUT, RAW 32 BIT STRUCTURES
+    SNAPSHOT_CHUNKED,
+    SNAPSHOT_PARTIAL		// CHUNKED BUT CUT SHORT BEFORE ITS END CHUNK, LIKE A RECORDING THAT WAS NEVER CLOSED
+};
+
+/**
+ * \brief Maps a simulation file and finds its chunks, which are read in place.
+ *
+ * Open only walks the chunk headers. The CRC of a chunk is checked the first time it is read through Chunk or ChunkAt, so opening a long
+ * recording does not read all of it, and a damaged chunk fails on its own instead of the whole file.
+ */
+class CSnapshotReader
+{
+public:
+    /**
+     * \return SNAPSHOT_CHUNKED for a complete snapshot of a known version, SNAPSHOT_LEGACY for a file without the magic, SNAPSHOT_PARTIAL for
+     * a snapshot that stops before its end chunk, else SNAPSHOT_INVALID. The chunks of a partial snapshot are the whole ones before the cut.
+     */
+    int Open ( const char * filename );
+    /**
+     * \brief The payload of the first chunk with a tag. The cursor is failed when there is no such chunk or it is damaged.
+     */
+    CSnapshotCursor Chunk ( std::uint32_t tag ) const;
+    /**
+     * \brief The chunks in file order, for files holding many chunks of a tag.
+     */
+    std::size_t ChunkCount () const { return this->chunks_.size (); }
+    std::uint32_t ChunkTag ( std::size_t at ) const { return this->chunks_ [ at ].tag; }
+    CSnapshotCursor ChunkAt ( std::size_t at ) const;
+    /**
+     * \brief The payload of a chunk without checking its CRC, for an index that only looks at the first bytes of many chunks. What it
+     * reads is only a hint until the chunk is read again through ChunkAt.
+     */
+    CSnapshotCursor ChunkUnchecked ( std::size_t at ) const { return CSnapshotCursor ( this->chunks_ [ at ].data , this->chunks_ [ at ].size ); }
+    /**
+     * \brief Whether a chunk read since Open failed its CRC. A damaged chunk reads like a missing one, so a loader that takes missing
+     * chunks as empty checks this once it is done.
+     */
+    bool Damaged () const { return this->damaged_; }
+    /**
+     * \brief The whole file, for the legacy reader.
+     */
+    CSnapshotCursor Whole () const { return CSnapshotCursor ( this->file_.Begin () , this->file_.Size () ); }
+    void Close ();
+private:
+    struct tChunk
+    {
+        std::uint32_t tag;
+        const unsigned char * data;
+        std::size_t size;
+        std::uint32_t crc;
+        mutable int checked;		// 0 UNTIL THE CRC IS CHECKED, THEN 1 WHEN IT MATCHED AND -1 WHEN IT DID NOT
+    };
+    CSnapshotCursor Checked ( const tChunk & chunk ) const;
+    CMappedFile file_;
+    std::vector < tChunk > chunks_;
+    mutable bool damaged_ = false;
+};
+
+/**
+ * \brief A bone as stored in a snapshot: identity and transforms. Hierarchy, animation channels and visuals are rebuilt by the loader.
+ */
+void PutBone ( CSnapshotWriter & writer , std::uint32_t tag , const t_Bone & bone );
+void GetBone ( CSnapshotCursor & cursor , t_Bone & bone );
+/**
+ * \brief The fields of a visual, without its arrays and texture, which go in their own chunks.
+ */
+void PutVisual ( CSnapshotWriter & writer , const t_Visual & visual );
+void GetVisual ( CSnapshotCursor & cursor , t_Visual & visual );
+
+/**
+ * \brief The old .dps layout: the two bones, then the visual, as written by a 32 bit build.
+ *
+ * The second bone was written from the address of the children pointer instead of the child, so it holds nothing useful and is skipped.
+ * The cursor is left on the vertex data of the visual.
+ * \return True when the root had a child, so a visual and the simulation follow.
+ */
+bool GetLegacyBones ( CSnapshotCursor & cursor , t_Bone & root );
+void GetLegacyVisual ( CSnapshotCursor & cursor , t_Visual & visual );
+
+#endif // !defined(SNAPSHOT_H__INCLUDED_)
@@ -0,0 +1,205 @@
+#include "stdafx.h"
+#include <algorithm>
+#include <type_traits>
+#include "SpringRenderer.h"
+#include "IndexBuffer.h"
+
+// OPENGL 1.5, THE HEADERS THAT COME WITH WINDOWS STOP AT 1.1
+#ifndef GL_ARRAY_BUFFER
+#define GL_ARRAY_BUFFER			0x8892
+#endif
+#ifndef GL_ELEMENT_ARRAY_BUFFER
+#define GL_ELEMENT_ARRAY_BUFFER	0x8893
+#endif
+#ifndef GL_STREAM_DRAW
+#define GL_STREAM_DRAW			0x88E0
+#endif
+#ifndef GL_STATIC_DRAW
+#define GL_STATIC_DRAW			0x88E4
+#endif
+
+/**
+ * \brief An entry point under its OpenGL 1.5 name, else under its ARB one.
+ */
+template < typename Entry >
+static Entry GetEntry ( const char * name , const char * arbName )
+{
+    PROC entry = wglGetProcAddress ( name );
+    if ( entry == NULL )
+    {
+        entry = wglGetProcAddress ( arbName );
+    }
+    // PROC AND THE ENTRY TAKE DIFFERENT ARGUMENTS, SO THE CAST GOES THROUGH THE GENERIC FUNCTION POINTER
+    return reinterpret_cast < Entry > ( reinterpret_cast < void ( * ) () > ( entry ) );
+}
+
+CSpringRenderer::CSpringRenderer () : loaded_ ( false ) , genBuffers_ ( NULL ) , bindBuffer_ ( NULL ) , bufferData_ ( NULL ) , vertexBuffer_ ( 0 ) , indexBuffer_ ( 0 ) , particleCnt_ ( 0 ) , groupedParticleCnt_ ( -1 ) , dirty_ ( true )
+{
+    std::fill ( this->start_ , this->start_ + SPRING_TYPE_CNT + 1 , 0 );
+    this->stream_.positions = NULL;
+    this->stream_.stride = sizeof ( float ) * 3;
+    this->stream_.count = 0;
+}
+
+bool CSpringRenderer::LoadBuffers ()
+{
+    if ( ! this->loaded_ )
+    {
+        this->loaded_ = true;
+        this->genBuffers_ = GetEntry < tGenBuffers > ( "glGenBuffers" , "glGenBuffersARB" );
+        this->bindBuffer_ = GetEntry < tBindBuffer > ( "glBindBuffer" , "glBindBufferARB" );
+        this->bufferData_ = GetEntry < tBufferData > ( "glBufferData" , "glBufferDataARB" );
+        if ( this->genBuffers_ == NULL || this->bindBuffer_ == NULL || this->bufferData_ == NULL )
+        {
+            this->genBuffers_ = NULL;
+        }
+        else
+        {
+            GLuint buffers [ 2 ];
+            this->genBuffers_ ( 2 , buffers );
+            this->vertexBuffer_ = buffers [ 0 ];
+            this->indexBuffer_ = buffers [ 1 ];
+        }
+    }
+    return this->genBuffers_ != NULL;
+}
+
+void CSpringRenderer::Upload ( const tVertexStream & stream )
+{
+    this->stream_ = stream;
+    this->particleCnt_ = stream.count;
+    if ( stream.count > 0 && this->LoadBuffers () )
+    {
+        // ONLY THE POSITIONS GO TO THE CARD, NOT THE VELOCITY AND FORCE STRIDED BETWEEN THEM
+        const float * positions = stream.positions;
+        if ( stream.stride != sizeof ( float ) * 3 )
+        {
+            this->packed_.resize ( static_cast < std::size_t > ( stream.count ) * 3 );
+            float * packed = this->packed_.data ();
+            for ( int i = 0; i < stream.count; ++i , packed += 3 )
+            {
+                const float * position = stream.At ( i );
+                packed [ 0 ] = position [ 0 ];
+                packed [ 1 ] = position [ 1 ];
+                packed [ 2 ] = position [ 2 ];
+            }
+            positions = this->packed_.data ();
+        }
+        // NEW STORAGE EVERY FRAME, SO THE UPLOAD NEVER WAITS FOR THE CARD TO FINISH WITH THE LAST ONE
+        this->bindBuffer_ ( GL_ARRAY_BUFFER , this->vertexBuffer_ );
+        this->bufferData_ ( GL_ARRAY_BUFFER , static_cast < tBufferSize > ( stream.count ) * 3 * sizeof ( float ) , positions , GL_STREAM_DRAW );
+        this->bindBuffer_ ( GL_ARRAY_BUFFER , 0 );
+    }
+}
+
+void CSpringRenderer::Regroup ( const tSpring * springs , const int springCnt )
+{
+    // GROUP THE SPRINGS BY TYPE WITH A COUNTING SORT, A SPRING OF NO KNOWN TYPE IS NOT DRAWN
+    std::size_t count [ SPRING_TYPE_CNT ] = { 0 };
+    for ( int i = 0; i < springCnt; ++i )
+    {
+        if ( springs [ i ].type >= 0 && springs [ i ].type < SPRING_TYPE_CNT )
+        {
+            ++count [ springs [ i ].type ];
+        }
+    }
+    std::size_t next [ SPRING_TYPE_CNT ];
+    this->start_ [ 0 ] = 0;
+    for ( int type = 0; type < SPRING_TYPE_CNT; ++type )
+    {
+        next [ type ] = this->start_ [ type ];
+        this->start_ [ type + 1 ] = this->start_ [ type ] + 2 * count [ type ];
+    }
+    const long particleCnt = this->particleCnt_;
+    this->indices_.resize ( IndexSize ( particleCnt ) * this->start_ [ SPRING_TYPE_CNT ] );
+    VisitIndices ( this->indices_.data () , particleCnt , [ springs , springCnt , &next ] ( auto * indices )
+    {
+        typedef typename std::remove_pointer < decltype ( indices ) >::type tIndex;
+        for ( int i = 0; i < springCnt; ++i )
+        {
+            const int type = springs [ i ].type;
+            if ( type >= 0 && type < SPRING_TYPE_CNT )
+            {
+                indices [ next [ type ]++ ] = static_cast < tIndex > ( springs [ i ].p1 );
+                indices [ next [ type ]++ ] = static_cast < tIndex > ( springs [ i ].p2 );
+            }
+        }
+    } );
+    if ( this->LoadBuffers () )
+    {
+        this->bindBuffer_ ( GL_ELEMENT_ARRAY_BUFFER , this->indexBuffer_ );
+        this->bufferData_ ( GL_ELEMENT_ARRAY_BUFFER , this->indices_.size () , this->indices_.data () , GL_STATIC_DRAW );
+        this->bindBuffer_ ( GL_ELEMENT_ARRAY_BUFFER , 0 );
+    }
+    this->groupedParticleCnt_ = this->particleCnt_;
+    this->dirty_ = false;
+}
+
+void CSpringRenderer::BeginArrays ()
+{
+    if ( this->LoadBuffers () )
+    {
+        this->bindBuffer_ ( GL_ARRAY_BUFFER , this->vertexBuffer_ );
+        glVertexPointer ( 3 , GL_FLOAT , 0 , NULL );
+    }
+    else
+    {
+        glVertexPointer ( 3 , GL_FLOAT , this->stream_.stride , this->stream_.positions );
+    }
+    glEnableClientState ( GL_VERTEX_ARRAY );
+}
+
+void CSpringRenderer::EndArrays ()
+{
+    glDisableClientState ( GL_VERTEX_ARRAY );
+    // THE MODEL IS DRAWN FROM ARRAYS IN MEMORY, WHICH ONLY WORKS WITH NO BUFFER BOUND
+    if ( this->LoadBuffers () )
+    {
+        this->bindBuffer_ ( GL_ARRAY_BUFFER , 0 );
+        this->bindBuffer_ ( GL_ELEMENT_ARRAY_BUFFER , 0 );
+    }
+}
+
+void CSpringRenderer::DrawSprings ( const tSpring * springs , const int springCnt , const bool show [ SPRING_TYPE_CNT ] )
+{
+    if ( this->particleCnt_ <= 0 || springCnt <= 0 )
+    {
+        return;
+    }
+    if ( this->dirty_ || this->groupedParticleCnt_ != this->particleCnt_ )
+    {
+        this->Regroup ( springs , springCnt );
+    }
+    this->BeginArrays ();
+    const char * base = NULL;
+    if ( this->LoadBuffers () )
+    {
+        this->bindBuffer_ ( GL_ELEMENT_ARRAY_BUFFER , this->indexBuffer_ );
+    }
+    else
+    {
+        base = reinterpret_cast < const char * > ( this->indices_.data () );
+    }
+    const std::size_t indexSize = IndexSize ( this->particleCnt_ );
+    const GLenum indexType = IndexType ( this->particleCnt_ );
+    for ( int type = 0; type < SPRING_TYPE_CNT; ++type )
+    {
+        const std::size_t count = this->start_ [ type + 1 ] - this->start_ [ type ];
+        if ( show [ type ] && count > 0 )
+        {
+            glDrawElements ( GL_LINES , static_cast < GLsizei > ( count ) , indexType , base + indexSize * this->start_ [ type ] );
+        }
+    }
+    this->EndArrays ();
+}
+
+void CSpringRenderer::DrawPoints ()
+{
+    if ( this->particleCnt_ <= 0 )
+    {
+        return;
+    }
+    this->BeginArrays ();
+    glDrawArrays ( GL_POINTS , 0 , this->particleCnt_ );
+    this->EndArrays ();
+}
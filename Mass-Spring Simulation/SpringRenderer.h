@@ -0,0 +1,68 @@
+#if !defined(SPRINGRENDERER_H__INCLUDED_)
+#define SPRINGRENDERER_H__INCLUDED_
+
+#include <cstddef>
+#include <vector>
+#include <GL/gl.h>
+#include "PhysEnv.h"
+#include "VertexStream.h"
+
+/**
+ * \brief Draws the springs and particles from buffer objects.
+ *
+ * The positions are read where the simulation keeps them, as a strided attribute over the particles. For the card they are packed
+ * into twelve bytes each, so only the positions cross the bus and not the whole particle, and sent in a single upload per frame into a
+ * vertex buffer that is orphaned each time so the driver never waits for the frame before. Without buffer objects the strided particles
+ * are drawn from where they are. The springs are grouped by type once, with a counting sort, into a static index
+ * buffer, and each type shown is then a single glDrawElements over its range. The indices are 16 bits up to INDEX16_VERTEX_LIMIT particles.
+ *
+ * The buffer entry points are those of OpenGL 1.5 or ARB_vertex_buffer_object, looked up the first time anything is drawn. Without them the
+ * same arrays are drawn from memory. The buffers belong to the context that was current then, and go with it.
+ */
+class CSpringRenderer
+{
+public:
+    CSpringRenderer ();
+    CSpringRenderer ( const CSpringRenderer & other ) = delete;
+    CSpringRenderer & operator= ( const CSpringRenderer & other ) = delete;
+    /**
+     * \brief Regroups the springs before the next draw. Called whenever a spring is added, removed or changed.
+     */
+    void Invalidate () { this->dirty_ = true; }
+    /**
+     * \brief Sends the positions of this frame. Called once per frame before DrawSprings and DrawPoints.
+     */
+    void Upload ( const tVertexStream & stream );
+    /**
+     * \brief Draws the springs of every type with show set, in the current color.
+     */
+    void DrawSprings ( const tSpring * springs , int springCnt , const bool show [ SPRING_TYPE_CNT ] );
+    /**
+     * \brief Draws every particle as a point, in the current color.
+     */
+    void DrawPoints ();
+private:
+    typedef std::ptrdiff_t tBufferSize;
+    typedef void ( APIENTRY * tGenBuffers ) ( GLsizei n , GLuint * buffers );
+    typedef void ( APIENTRY * tBindBuffer ) ( GLenum target , GLuint buffer );
+    typedef void ( APIENTRY * tBufferData ) ( GLenum target , tBufferSize size , const void * data , GLenum usage );
+    bool LoadBuffers ();
+    void Regroup ( const tSpring * springs , int springCnt );
+    void BeginArrays ();
+    void EndArrays ();
+    bool loaded_;
+    tGenBuffers genBuffers_;					// NULL WHEN THE CARD HAS NO BUFFER OBJECTS
+    tBindBuffer bindBuffer_;
+    tBufferData bufferData_;
+    GLuint vertexBuffer_;
+    GLuint indexBuffer_;
+    tVertexStream stream_;						// THE POSITIONS OF THIS FRAME
+    std::vector < float > packed_;				// THE SAME POSITIONS, THREE FLOATS EACH, AS THE VERTEX BUFFER HOLDS THEM
+    std::vector < unsigned char > indices_;		// TWO INDICES PER SPRING, GROUPED BY TYPE, 16 OR 32 BITS WIDE
+    std::size_t start_ [ SPRING_TYPE_CNT + 1 ];	// FIRST INDEX OF EACH TYPE
+    int particleCnt_;
+    int groupedParticleCnt_;					// THE PARTICLE COUNT THE INDICES WERE BUILT FOR
+    bool dirty_;
+};
+
+#endif // !defined(SPRINGRENDERER_H__INCLUDED_)
@@ -11,6 +11,7 @@
 #endif // _MSC_VER >= 1000
 
 #define VC_EXTRALEAN		// Exclude rarely-used stuff from Windows headers
+#define NOMINMAX			// std::min AND std::max, NOT THE WINDOWS MACROS
 
 #include <afxwin.h>         // MFC core and standard components
 #include <afxext.h>         // MFC extensions
@@ -0,0 +1,223 @@
+#include "stdafx.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include "TextExporter.h"
+#include "PhysEnv.h"
+#include "Skeleton.h"
+#include "IndexBuffer.h"
+#include "ThreadPool.h"
+
+#define INDEX_TEXT_SIZE			11				// AN UNSIGNED 32 BIT INDEX AND ITS SEPARATOR
+
+/**
+ * \brief Writes a float the way the CSV always had it, with its sign. The caller has TEXT_FLOAT_SIZE bytes of room.
+ */
+static char * PutFloat ( char * at , const float value )
+{
+    // signbit AND NOT A COMPARISON, -0 IS WRITTEN -0 AND NOT +-0
+    if ( ! std::signbit ( value ) )
+    {
+        *at++ = '+';
+    }
+    return std::to_chars ( at , at + TEXT_FLOAT_SIZE - 1 , value ).ptr;
+}
+
+static char * PutVector ( char * at , const tVector & value , const char separator )
+{
+    at = PutFloat ( at , value.x );
+    *at++ = separator;
+    at = PutFloat ( at , value.y );
+    *at++ = separator;
+    return PutFloat ( at , value.z );
+}
+
+CTextExporter::CTextExporter () : fp_ ( NULL ) , used_ ( 0 ) , failed_ ( false )
+{
+}
+
+CTextExporter::~CTextExporter ()
+{
+    this->Close ();
+}
+
+bool CTextExporter::Open ( const char * filename )
+{
+    this->Close ();
+    this->fp_ = fopen ( filename , "wb" );
+    if ( this->fp_ == NULL )
+    {
+        return false;
+    }
+    // THE BLOCKS ARE ALREADY LARGE, A STDIO BUFFER WOULD ONLY ADD A COPY
+    setvbuf ( this->fp_ , NULL , _IONBF , 0 );
+    this->block_.resize ( TEXT_BLOCK );
+    this->used_ = 0;
+    this->failed_ = false;
+    return true;
+}
+
+void CTextExporter::Write ( const char * data , const std::size_t size )
+{
+    if ( ! this->failed_ && size > 0 && fwrite ( data , 1 , size , this->fp_ ) != size )
+    {
+        this->failed_ = true;
+    }
+}
+
+char * CTextExporter::Reserve ( const std::size_t size )
+{
+    if ( this->used_ + size > this->block_.size () )
+    {
+        this->Flush ();
+        if ( size > this->block_.size () )
+        {
+            this->block_.resize ( size );
+        }
+    }
+    return this->block_.data () + this->used_;
+}
+
+bool CTextExporter::Flush ()
+{
+    if ( this->fp_ == NULL )
+    {
+        return false;
+    }
+    this->Write ( this->block_.data () , this->used_ );
+    this->used_ = 0;
+    return ! this->failed_;
+}
+
+bool CTextExporter::Close ()
+{
+    if ( this->fp_ == NULL )
+    {
+        return true;
+    }
+    const bool written = this->Flush ();
+    const bool closed = fclose ( this->fp_ ) == 0;
+    this->fp_ = NULL;
+    return written && closed;
+}
+
+void CTextExporter::PutLine ( const float * values , const int count , const char * tail )
+{
+    if ( this->fp_ == NULL )
+    {
+        return;
+    }
+    const std::size_t tailSize = tail != NULL ? std::strlen ( tail ) : 0;
+    char * start = this->Reserve ( count * ( TEXT_FLOAT_SIZE + 1 ) + tailSize + 2 );
+    char * at = start;
+    for ( int i = 0; i < count; ++i )
+    {
+        if ( i > 0 )
+        {
+            *at++ = ',';
+        }
+        at = PutFloat ( at , values [ i ] );
+    }
+    if ( tail != NULL )
+    {
+        *at++ = ',';
+        std::memcpy ( at , tail , tailSize );
+        at += tailSize;
+    }
+    *at++ = '\n';
+    this->used_ += at - start;
+}
+
+template < typename Format >
+void CTextExporter::PutSlices ( const int count , const std::size_t lineSize , Format format )
+{
+    const int sliceCnt = ( count + TEXT_LINES - 1 ) / TEXT_LINES;
+    if ( static_cast < int > ( this->slices_.size () ) < sliceCnt )
+    {
+        this->slices_.resize ( sliceCnt );
+    }
+    this->sliceSizes_.resize ( sliceCnt );
+    CThreadPool::Instance ().ParallelFor ( sliceCnt , 1 , [ & ] ( int begin , int end , int )
+    {
+        for ( int slice = begin; slice < end; ++slice )
+        {
+            std::vector < char > & text = this->slices_ [ slice ];
+            const int first = slice * TEXT_LINES;
+            const int last = std::min ( first + TEXT_LINES , count );
+            if ( text.size () < lineSize * TEXT_LINES )
+            {
+                text.resize ( lineSize * TEXT_LINES );
+            }
+            this->sliceSizes_ [ slice ] = format ( text.data () , first , last ) - text.data ();
+        }
+    } );
+    // WHAT WAS GATHERED BEFORE GOES FIRST, THEN EACH SLICE IN ONE WRITE
+    this->Flush ();
+    for ( int slice = 0; slice < sliceCnt; ++slice )
+    {
+        this->Write ( this->slices_ [ slice ].data () , this->sliceSizes_ [ slice ] );
+    }
+}
+
+void CTextExporter::PutParticles ( const tParticle * particles , const int count )
+{
+    if ( this->fp_ == NULL )
+    {
+        return;
+    }
+    this->PutSlices ( count , 9 * ( TEXT_FLOAT_SIZE + 1 ) , [ particles ] ( char * at , int first , int last )
+    {
+        for ( int i = first; i < last; ++i )
+        {
+            at = PutVector ( at , particles [ i ].pos , ',' );
+            *at++ = ',';
+            at = PutVector ( at , particles [ i ].v , ',' );
+            *at++ = ',';
+            at = PutVector ( at , particles [ i ].f , ',' );
+            *at++ = '\n';
+        }
+        return at;
+    } );
+}
+
+void CTextExporter::PutObj ( const tParticle * particles , const int count , const t_Visual * visual )
+{
+    if ( this->fp_ == NULL )
+    {
+        return;
+    }
+    this->PutSlices ( count , 2 + 3 * ( TEXT_FLOAT_SIZE + 1 ) , [ particles ] ( char * at , int first , int last )
+    {
+        for ( int i = first; i < last; ++i )
+        {
+            *at++ = 'v';
+            *at++ = ' ';
+            at = PutVector ( at , particles [ i ].pos , ' ' );
+            *at++ = '\n';
+        }
+        return at;
+    } );
+    if ( visual == NULL || visual->faceIndex == NULL || visual->vertexCnt != count )
+    {
+        return;
+    }
+    const long vertexCnt = visual->vertexCnt;
+    const long vPerFace = visual->vPerFace;
+    const void * indices = visual->faceIndex;
+    this->PutSlices ( visual->faceCnt , 2 + vPerFace * INDEX_TEXT_SIZE , [ indices , vertexCnt , vPerFace ] ( char * at , int first , int last )
+    {
+        for ( int face = first; face < last; ++face )
+        {
+            *at++ = 'f';
+            for ( long corner = 0; corner < vPerFace; ++corner )
+            {
+                // OBJ COUNTS ITS VERTICES FROM ONE
+                *at++ = ' ';
+                at = std::to_chars ( at , at + INDEX_TEXT_SIZE , GetIndex ( indices , vertexCnt , face * vPerFace + corner ) + 1 ).ptr;
+            }
+            *at++ = '\n';
+        }
+        return at;
+    } );
+}
@@ -0,0 +1,71 @@
+#if !defined(TEXTEXPORTER_H__INCLUDED_)
+#define TEXTEXPORTER_H__INCLUDED_
+
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+
+struct tParticle;
+struct t_Visual;
+
+#define TEXT_BLOCK				( 1 << 20 )		// BYTES GATHERED BEFORE EACH WRITE
+#define TEXT_LINES				4096			// PARTICLES FORMATTED BY A WORKER AT A TIME
+#define TEXT_FLOAT_SIZE			16				// LONGEST FLOAT WITH ITS SIGN, -1.17549435E-38
+
+/**
+ * \brief Writes CSV and OBJ text quickly.
+ *
+ * Numbers are formatted with std::to_chars, which gives the shortest text that reads back to the same float, into buffers that are kept
+ * from one call to the next. Small lines are gathered into a block of TEXT_BLOCK bytes, and the particle dumps are formatted by the thread
+ * pool in slices of TEXT_LINES particles, each slice into its own buffer so the lines stay in order. The file is unbuffered, every block or
+ * slice goes out in a single write.
+ *
+ * Errors are sticky and reported by Flush and Close.
+ */
+class CTextExporter
+{
+public:
+    CTextExporter ();
+    ~CTextExporter ();
+    CTextExporter ( const CTextExporter & other ) = delete;
+    CTextExporter & operator= ( const CTextExporter & other ) = delete;
+    bool Open ( const char * filename );
+    bool IsOpen () const { return this->fp_ != NULL; }
+    /**
+     * \brief Adds a line of values separated by commas, each with its sign, followed by a last text field when tail is not NULL.
+     */
+    void PutLine ( const float * values , int count , const char * tail );
+    /**
+     * \brief Adds one line per particle: position, velocity and force.
+     */
+    void PutParticles ( const tParticle * particles , int count );
+    /**
+     * \brief Adds an OBJ frame: a vertex per particle, then the faces of the visual when there is one, its vertices being the particles.
+     */
+    void PutObj ( const tParticle * particles , int count , const t_Visual * visual );
+    /**
+     * \brief Writes the block gathered so far.
+     * \return False when anything failed since Open.
+     */
+    bool Flush ();
+    bool Close ();
+private:
+    /**
+     * \brief Room for size bytes at the end of the block, writing the block first when it is too full.
+     */
+    char * Reserve ( std::size_t size );
+    void Write ( const char * data , std::size_t size );
+    /**
+     * \brief Formats [0, count) in slices on the thread pool and writes the slices in order. format fills a slice and returns where it ended.
+     */
+    template < typename Format >
+    void PutSlices ( int count , std::size_t lineSize , Format format );
+    FILE * fp_;
+    std::vector < char > block_;
+    std::size_t used_;
+    std::vector < std::vector < char > > slices_;
+    std::vector < std::size_t > sliceSizes_;
+    bool failed_;
+};
+
+#endif // !defined(TEXTEXPORTER_H__INCLUDED_)
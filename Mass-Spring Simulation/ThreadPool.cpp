@@ -0,0 +1,114 @@
+#include "stdafx.h"
+#include <algorithm>
+#include "HardwareCounters.h"
+#include "ThreadPool.h"
+
+// SET WHILE A THREAD IS RUNNING A CHUNK SO NESTED LOOPS RUN INLINE INSTEAD OF DEADLOCKING
+static thread_local bool s_InsidePool = false;
+
+CThreadPool & CThreadPool::Instance ()
+{
+    static CThreadPool pool ( std::max ( 1 , static_cast < int > ( std::thread::hardware_concurrency () ) ) - 1 );
+    return pool;
+}
+
+CThreadPool::CThreadPool ( const int threadCount ) : threadIds_ ( threadCount , 0 ) , body_ ( nullptr ) , count_ ( 0 ) , grain_ ( 1 ) , next_ ( 0 ) , pending_ ( threadCount ) , generation_ ( 0 ) , stop_ ( false )
+{
+    for ( int i = 0; i < threadCount; ++i )
+    {
+        this->threads_.emplace_back ( &CThreadPool::WorkerLoop , this , i + 1 );
+    }
+    // THE IDS ARE ONLY KNOWN ON THE THREADS, SO THEY ARE WAITED FOR BEFORE ANYONE CAN ASK
+    std::unique_lock < std::mutex > lock ( this->mutex_ );
+    this->done_.wait ( lock , [ this ] { return this->pending_ == 0; } );
+}
+
+CThreadPool::~CThreadPool ()
+{
+    {
+        std::lock_guard < std::mutex > lock ( this->mutex_ );
+        this->stop_ = true;
+    }
+    this->wake_.notify_all ();
+    for ( std::thread & thread : this->threads_ )
+    {
+        thread.join ();
+    }
+}
+
+void CThreadPool::ParallelFor ( const int count , int grain , const RangeBody & body )
+{
+    if ( count <= 0 )
+    {
+        return;
+    }
+    grain = std::max ( grain , 1 );
+    std::unique_lock < std::mutex > job ( this->jobMutex_ , std::defer_lock );
+    if ( count <= grain || this->threads_.empty () || s_InsidePool || ! job.try_lock () )
+    {
+        body ( 0 , count , 0 );
+        return;
+    }
+    {
+        std::lock_guard < std::mutex > lock ( this->mutex_ );
+        this->body_ = &body;
+        this->count_ = count;
+        this->grain_ = grain;
+        this->next_.store ( 0 );
+        this->pending_ = static_cast < int > ( this->threads_.size () );
+        ++this->generation_;
+    }
+    this->wake_.notify_all ();
+    this->RunChunks ( 0 );
+    std::unique_lock < std::mutex > lock ( this->mutex_ );
+    this->done_.wait ( lock , [ this ] { return this->pending_ == 0; } );
+    this->body_ = nullptr;
+}
+
+void CThreadPool::RunChunks ( const int worker )
+{
+    s_InsidePool = true;
+    for ( ;; )
+    {
+        const int begin = this->next_.fetch_add ( this->grain_ );
+        if ( begin >= this->count_ )
+        {
+            break;
+        }
+        ( *this->body_ ) ( begin , std::min ( begin + this->grain_ , this->count_ ) , worker );
+    }
+    s_InsidePool = false;
+}
+
+void CThreadPool::WorkerLoop ( const int worker )
+{
+    {
+        std::lock_guard < std::mutex > lock ( this->mutex_ );
+        this->threadIds_ [ worker - 1 ] = CHardwareCounters::ThreadId ();
+        if ( --this->pending_ == 0 )
+        {
+            this->done_.notify_one ();
+        }
+    }
+    unsigned int seen = 0;
+    for ( ;; )
+    {
+        {
+            std::unique_lock < std::mutex > lock ( this->mutex_ );
+            this->wake_.wait ( lock , [ this , seen ] { return this->stop_ || this->generation_ != seen; } );
+            if ( this->stop_ )
+            {
+                return;
+            }
+            seen = this->generation_;
+        }
+        this->RunChunks ( worker );
+        {
+            std::lock_guard < std::mutex > lock ( this->mutex_ );
+            if ( --this->pending_ == 0 )
+            {
+                this->done_.notify_one ();
+            }
+        }
+    }
+}
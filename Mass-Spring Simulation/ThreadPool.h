@@ -0,0 +1,73 @@
+#if !defined(THREADPOOL_H__INCLUDED_)
+#define THREADPOOL_H__INCLUDED_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * \brief A small persistent pool of worker threads used to split the per-step loops of the simulation (collision detection, resolution...) into chunks.
+ *
+ * The threads are created once and sleep between jobs, so handing out a job costs a wake up rather than a thread creation.
+ * The calling thread always takes part in the job as worker 0, which means a job with a single chunk never leaves the calling thread.
+ */
+class CThreadPool
+{
+public:
+    /**
+     * \brief The body of a parallel loop. Called with a half open range [begin, end) and the index of the worker running it.
+     */
+    typedef std::function < void ( int begin , int end , int worker ) > RangeBody;
+    /**
+     * \brief The pool shared by the whole application. Sized to the number of hardware threads.
+     */
+    static CThreadPool & Instance ();
+    /**
+     * \brief The number of workers that can run a job at the same time, counting the calling thread. Worker indices passed to a RangeBody are always less than this.
+     */
+    int WorkerCount () const
+    {
+        return static_cast < int > ( this->threads_.size () ) + 1;
+    }
+    /**
+     * \brief The system ids of the pool's own threads, as CHardwareCounters::ThreadId gives them, worker i at i - 1. Worker 0 is whichever thread calls.
+     */
+    const std::vector < long > & ThreadIds () const
+    {
+        return this->threadIds_;
+    }
+    /**
+     * \brief Runs body over [0, count) in chunks of grain items. Returns once every chunk is done.
+     *
+     * If the range fits in a single chunk, or the pool is already busy (a nested call or a call from another thread), the whole range runs on the calling thread as worker 0.
+     * \param count The number of items in the range.
+     * \param grain The number of items handed to a worker at a time.
+     * \param body The function to run on each chunk.
+     */
+    void ParallelFor ( int count , int grain , const RangeBody & body );
+    ~CThreadPool ();
+private:
+    explicit CThreadPool ( int threadCount );
+    CThreadPool ( const CThreadPool & other ) = delete;
+    CThreadPool & operator= ( const CThreadPool & other ) = delete;
+    void WorkerLoop ( int worker );
+    void RunChunks ( int worker );
+    std::vector < std::thread >     threads_;
+    std::vector < long >            threadIds_;
+    std::mutex                      jobMutex_;      // ONLY ONE JOB AT A TIME
+    std::mutex                      mutex_;
+    std::condition_variable         wake_;
+    std::condition_variable         done_;
+    const RangeBody *               body_;
+    int                             count_;
+    int                             grain_;
+    std::atomic < int >             next_;
+    int                             pending_;
+    unsigned int                    generation_;
+    bool                            stop_;
+};
+
+#endif // !defined(THREADPOOL_H__INCLUDED_)
@@ -0,0 +1,508 @@
+#include "stdafx.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include "TrajectoryCodec.h"
+#include "ThreadPool.h"
+
+#define CODEC_KEYFRAME			1			// FLAG OF A KEYFRAME PAYLOAD
+#define CODEC_COLUMN_SIZE		16			// BYTES OF A tCodecColumn IN THE PAYLOAD
+#define CODEC_SAMPLE			64			// ONE VALUE IN THIS MANY IS LOOKED AT TO PICK A PREDICTOR
+#define PROB_BITS				11
+#define PROB_MOVE				5			// HOW FAST THE MODELS ADAPT
+#define RANGE_TOP				( 1u << 24 )
+#define LENGTH_BITS				6			// THE BIT LENGTH OF A RESIDUAL, 0 TO 32, IS CODED ON 6 BITS
+#define LENGTH_CONTEXTS			16			// THE LENGTH IS CODED KNOWING THE LENGTH OF THE RESIDUAL BEFORE IT
+#define MAX_LENGTH				32
+
+/**
+ * \brief The adaptive models of one segment. Every segment starts from the same models, so each one can be decoded alone.
+ */
+struct tResidualModel
+{
+    std::uint16_t length [ LENGTH_CONTEXTS ] [ 1 << LENGTH_BITS ];
+    std::uint16_t high [ MAX_LENGTH + 1 ];		// THE BIT BELOW THE LEADING ONE, THE OTHERS ARE CLOSE TO UNIFORM
+    tResidualModel ()
+    {
+        std::fill ( &this->length [ 0 ] [ 0 ] , &this->length [ 0 ] [ 0 ] + LENGTH_CONTEXTS * ( 1 << LENGTH_BITS ) , static_cast < std::uint16_t > ( 1 << ( PROB_BITS - 1 ) ) );
+        std::fill ( this->high , this->high + MAX_LENGTH + 1 , static_cast < std::uint16_t > ( 1 << ( PROB_BITS - 1 ) ) );
+    }
+};
+
+/**
+ * \brief A binary range coder with carry propagation, in the manner of LZMA.
+ */
+class CRangeEncoder
+{
+public:
+    explicit CRangeEncoder ( std::vector < unsigned char > & out ) : out_ ( out ) , low_ ( 0 ) , range_ ( 0xFFFFFFFFu ) , cache_ ( 0 ) , cacheSize_ ( 1 ) {}
+    void EncodeBit ( std::uint16_t & prob , const unsigned bit )
+    {
+        const std::uint32_t bound = ( this->range_ >> PROB_BITS ) * prob;
+        if ( bit == 0 )
+        {
+            this->range_ = bound;
+            prob += ( ( 1 << PROB_BITS ) - prob ) >> PROB_MOVE;
+        }
+        else
+        {
+            this->low_ += bound;
+            this->range_ -= bound;
+            prob -= prob >> PROB_MOVE;
+        }
+        this->Normalize ();
+    }
+    void EncodeDirect ( const std::uint32_t value , int bits )
+    {
+        while ( bits-- > 0 )
+        {
+            this->range_ >>= 1;
+            if ( ( value >> bits ) & 1 )
+            {
+                this->low_ += this->range_;
+            }
+            this->Normalize ();
+        }
+    }
+    void Flush ()
+    {
+        for ( int i = 0; i < 5; ++i )
+        {
+            this->ShiftLow ();
+        }
+    }
+private:
+    void Normalize ()
+    {
+        while ( this->range_ < RANGE_TOP )
+        {
+            this->range_ <<= 8;
+            this->ShiftLow ();
+        }
+    }
+    void ShiftLow ()
+    {
+        // A BYTE IS HELD BACK WHILE A CARRY CAN STILL REACH IT
+        if ( static_cast < std::uint32_t > ( this->low_ ) < 0xFF000000u || ( this->low_ >> 32 ) != 0 )
+        {
+            const unsigned char carry = static_cast < unsigned char > ( this->low_ >> 32 );
+            unsigned char byte = this->cache_;
+            do
+            {
+                this->out_.push_back ( static_cast < unsigned char > ( byte + carry ) );
+                byte = 0xFF;
+            }
+            while ( --this->cacheSize_ != 0 );
+            this->cache_ = static_cast < unsigned char > ( this->low_ >> 24 );
+        }
+        ++this->cacheSize_;
+        this->low_ = ( this->low_ & 0x00FFFFFFu ) << 8;
+    }
+    std::vector < unsigned char > & out_;
+    std::uint64_t low_;
+    std::uint32_t range_;
+    unsigned char cache_;
+    std::uint64_t cacheSize_;
+};
+
+/**
+ * \brief Reads what CRangeEncoder wrote. Reading past the end gives zeros, the caller checks the values it gets.
+ */
+class CRangeDecoder
+{
+public:
+    CRangeDecoder ( const unsigned char * data , const std::size_t size ) : at_ ( data ) , end_ ( data + size ) , range_ ( 0xFFFFFFFFu ) , code_ ( 0 )
+    {
+        for ( int i = 0; i < 5; ++i )
+        {
+            this->code_ = ( this->code_ << 8 ) | this->Next ();
+        }
+    }
+    unsigned DecodeBit ( std::uint16_t & prob )
+    {
+        const std::uint32_t bound = ( this->range_ >> PROB_BITS ) * prob;
+        unsigned bit;
+        if ( this->code_ < bound )
+        {
+            this->range_ = bound;
+            prob += ( ( 1 << PROB_BITS ) - prob ) >> PROB_MOVE;
+            bit = 0;
+        }
+        else
+        {
+            this->code_ -= bound;
+            this->range_ -= bound;
+            prob -= prob >> PROB_MOVE;
+            bit = 1;
+        }
+        this->Normalize ();
+        return bit;
+    }
+    std::uint32_t DecodeDirect ( int bits )
+    {
+        std::uint32_t value = 0;
+        while ( bits-- > 0 )
+        {
+            this->range_ >>= 1;
+            unsigned bit = 0;
+            if ( this->code_ >= this->range_ )
+            {
+                this->code_ -= this->range_;
+                bit = 1;
+            }
+            value = ( value << 1 ) | bit;
+            this->Normalize ();
+        }
+        return value;
+    }
+private:
+    std::uint32_t Next ()
+    {
+        return this->at_ < this->end_ ? *this->at_++ : 0;
+    }
+    void Normalize ()
+    {
+        while ( this->range_ < RANGE_TOP )
+        {
+            this->range_ <<= 8;
+            this->code_ = ( this->code_ << 8 ) | this->Next ();
+        }
+    }
+    const unsigned char * at_;
+    const unsigned char * end_;
+    std::uint32_t range_;
+    std::uint32_t code_;
+};
+
+static int BitLength ( std::uint32_t value )
+{
+    int length = 0;
+    while ( value != 0 )
+    {
+        ++length;
+        value >>= 1;
+    }
+    return length;
+}
+
+/**
+ * \brief Codes a residual as its bit length, then the bits below the leading one.
+ */
+static void EncodeResidual ( CRangeEncoder & coder , tResidualModel & model , int & context , const std::int64_t residual )
+{
+    // ZIGZAG, SMALL RESIDUALS OF EITHER SIGN GET SMALL CODES
+    const std::uint32_t value = static_cast < std::uint32_t > ( residual >= 0 ? 2 * residual : -2 * residual - 1 );
+    const int length = BitLength ( value );
+    std::uint16_t * tree = model.length [ context ];
+    unsigned node = 1;
+    for ( int bit = LENGTH_BITS - 1; bit >= 0; --bit )
+    {
+        const unsigned b = ( length >> bit ) & 1;
+        coder.EncodeBit ( tree [ node ] , b );
+        node = ( node << 1 ) | b;
+    }
+    if ( length >= 2 )
+    {
+        coder.EncodeBit ( model.high [ length ] , ( value >> ( length - 2 ) ) & 1 );
+        coder.EncodeDirect ( value , length - 2 );
+    }
+    context = std::min ( length , LENGTH_CONTEXTS - 1 );
+}
+
+/**
+ * \return False for a length that no encoder writes.
+ */
+static bool DecodeResidual ( CRangeDecoder & coder , tResidualModel & model , int & context , std::int64_t & residual )
+{
+    std::uint16_t * tree = model.length [ context ];
+    unsigned node = 1;
+    for ( int bit = 0; bit < LENGTH_BITS; ++bit )
+    {
+        node = ( node << 1 ) | coder.DecodeBit ( tree [ node ] );
+    }
+    const int length = static_cast < int > ( node - ( 1 << LENGTH_BITS ) );
+    if ( length > MAX_LENGTH )
+    {
+        return false;
+    }
+    std::uint32_t value = length > 0 ? 1 : 0;
+    if ( length >= 2 )
+    {
+        value = ( value << 1 ) | coder.DecodeBit ( model.high [ length ] );
+        value = ( value << ( length - 2 ) ) | coder.DecodeDirect ( length - 2 );
+    }
+    residual = ( value & 1 ) ? -static_cast < std::int64_t > ( value >> 1 ) - 1 : static_cast < std::int64_t > ( value >> 1 );
+    context = std::min ( length , LENGTH_CONTEXTS - 1 );
+    return true;
+}
+
+/**
+ * \brief The level a value falls on, computed the same way by the encoder and the decoder so their predictions agree to the bit.
+ */
+static std::int64_t Level ( const double value , const tCodecColumn & column , const double inverseStep )
+{
+    const double level = std::floor ( ( value - column.origin ) * inverseStep + 0.5 );
+    return static_cast < std::int64_t > ( std::min ( std::max ( level , 0.0 ) , static_cast < double > ( column.levels ) ) );
+}
+
+static double Predict ( const int predictor , const float * previous , const float * older , const int i )
+{
+    return predictor == PREDICT_LINEAR ? 2.0 * previous [ i ] - older [ i ] : static_cast < double > ( previous [ i ] );
+}
+
+CTrajectoryEncoder::CTrajectoryEncoder () : columnCnt_ ( 0 ) , valueCnt_ ( 0 ) , segmentsPerColumn_ ( 0 ) , keyframeInterval_ ( 1 ) , sinceKeyframe_ ( -1 ) , keyframe_ ( true ) , frame_ ( nullptr )
+{
+}
+
+void CTrajectoryEncoder::Reset ( const int columnCnt , const int valueCnt , const float * tolerance , const int keyframeInterval )
+{
+    this->columnCnt_ = columnCnt;
+    this->valueCnt_ = valueCnt;
+    this->segmentsPerColumn_ = ( valueCnt + CODEC_SEGMENT - 1 ) / CODEC_SEGMENT;
+    this->keyframeInterval_ = std::max ( keyframeInterval , 1 );
+    this->sinceKeyframe_ = -1;
+    this->tolerance_.assign ( tolerance , tolerance + columnCnt );
+    this->columns_.resize ( columnCnt );
+    const std::size_t size = static_cast < std::size_t > ( columnCnt ) * valueCnt;
+    this->current_.resize ( size );
+    this->previous_.resize ( size );
+    this->older_.resize ( size );
+    this->segments_.resize ( static_cast < std::size_t > ( columnCnt ) * this->segmentsPerColumn_ );
+}
+
+bool CTrajectoryEncoder::Encode ( const float * frame )
+{
+    // A KEYFRAME EVERY INTERVAL, THE OTHERS PREDICT FROM ONE OR TWO FRAMES BEFORE THEM
+    const int history = std::min ( this->sinceKeyframe_ + 1 , 2 );
+    this->keyframe_ = this->sinceKeyframe_ < 0 || this->sinceKeyframe_ + 1 >= this->keyframeInterval_;
+    for ( int c = 0; c < this->columnCnt_; ++c )
+    {
+        const float * values = frame + static_cast < std::size_t > ( c ) * this->valueCnt_;
+        float low = this->valueCnt_ > 0 ? values [ 0 ] : 0.0f , high = low;
+        for ( int i = 0; i < this->valueCnt_; ++i )
+        {
+            if ( ! std::isfinite ( values [ i ] ) )
+            {
+                this->sinceKeyframe_ = -1;
+                return false;
+            }
+            low = std::min ( low , values [ i ] );
+            high = std::max ( high , values [ i ] );
+        }
+        tCodecColumn & column = this->columns_ [ c ];
+        column.origin = low;
+        column.step = 2.0f * this->tolerance_ [ c ];
+        const double span = static_cast < double > ( high ) - low;
+        if ( span / column.step > CODEC_MAX_LEVEL )
+        {
+            // TOO WIDE TO KEEP THE TOLERANCE, A COARSER STEP WOULD BREAK THE PROMISED ERROR SO THE FRAME IS LEFT TO THE CALLER
+            this->sinceKeyframe_ = -1;
+            return false;
+        }
+        column.levels = static_cast < std::uint32_t > ( std::ceil ( span / column.step ) );
+        column.predictor = PREDICT_SPATIAL;
+        if ( ! this->keyframe_ )
+        {
+            column.predictor = PREDICT_PREVIOUS;
+            if ( history >= 2 )
+            {
+                // PICK THE PREDICTOR THAT MISSES LESS ON A SAMPLE OF THE COLUMN
+                const float * previous = this->previous_.data () + static_cast < std::size_t > ( c ) * this->valueCnt_;
+                const float * older = this->older_.data () + static_cast < std::size_t > ( c ) * this->valueCnt_;
+                double missPrevious = 0.0 , missLinear = 0.0;
+                for ( int i = 0; i < this->valueCnt_; i += CODEC_SAMPLE )
+                {
+                    missPrevious += std::fabs ( values [ i ] - Predict ( PREDICT_PREVIOUS , previous , older , i ) );
+                    missLinear += std::fabs ( values [ i ] - Predict ( PREDICT_LINEAR , previous , older , i ) );
+                }
+                if ( missLinear < missPrevious )
+                {
+                    column.predictor = PREDICT_LINEAR;
+                }
+            }
+        }
+    }
+    this->frame_ = frame;
+    for ( int segment = 0; segment < static_cast < int > ( this->segments_.size () ); ++segment )
+    {
+        this->EncodeSegment ( segment );
+    }
+    this->frame_ = nullptr;
+    this->sinceKeyframe_ = this->keyframe_ ? 0 : this->sinceKeyframe_ + 1;
+    this->older_.swap ( this->previous_ );
+    this->previous_.swap ( this->current_ );
+    return true;
+}
+
+void CTrajectoryEncoder::EncodeSegment ( const int segment )
+{
+    const int c = segment / this->segmentsPerColumn_;
+    const int begin = ( segment % this->segmentsPerColumn_ ) * CODEC_SEGMENT;
+    const int end = std::min ( begin + CODEC_SEGMENT , this->valueCnt_ );
+    const std::size_t offset = static_cast < std::size_t > ( c ) * this->valueCnt_;
+    const tCodecColumn & column = this->columns_ [ c ];
+    const double inverseStep = 1.0 / column.step;
+    const float * values = this->frame_ + offset;
+    const float * previous = this->previous_.data () + offset;
+    const float * older = this->older_.data () + offset;
+    float * current = this->current_.data () + offset;
+    std::vector < unsigned char > & out = this->segments_ [ segment ];
+    out.clear ();
+    tResidualModel model;
+    CRangeEncoder coder ( out );
+    int context = 0;
+    std::int64_t last = 0;
+    for ( int i = begin; i < end; ++i )
+    {
+        const std::int64_t level = Level ( values [ i ] , column , inverseStep );
+        const std::int64_t predicted = column.predictor == PREDICT_SPATIAL ? last : Level ( Predict ( column.predictor , previous , older , i ) , column , inverseStep );
+        EncodeResidual ( coder , model , context , level - predicted );
+        current [ i ] = static_cast < float > ( column.origin + static_cast < double > ( level ) * column.step );
+        last = level;
+    }
+    coder.Flush ();
+}
+
+std::uint64_t CTrajectoryEncoder::PayloadSize () const
+{
+    std::uint64_t size = 4 + CODEC_COLUMN_SIZE * this->columns_.size () + 4 * this->segments_.size ();
+    for ( const std::vector < unsigned char > & segment : this->segments_ )
+    {
+        size += segment.size ();
+    }
+    return size;
+}
+
+void CTrajectoryEncoder::Put ( CSnapshotWriter & writer ) const
+{
+    writer.PutU32 ( this->keyframe_ ? CODEC_KEYFRAME : 0 );
+    for ( const tCodecColumn & column : this->columns_ )
+    {
+        writer.PutF32 ( column.origin );
+        writer.PutF32 ( column.step );
+        writer.PutU32 ( column.levels );
+        writer.PutU32 ( column.predictor );
+    }
+    for ( const std::vector < unsigned char > & segment : this->segments_ )
+    {
+        writer.PutU32 ( static_cast < std::uint32_t > ( segment.size () ) );
+    }
+    for ( const std::vector < unsigned char > & segment : this->segments_ )
+    {
+        writer.PutBytes ( segment.data () , segment.size () );
+    }
+}
+
+CTrajectoryDecoder::CTrajectoryDecoder () : columnCnt_ ( 0 ) , valueCnt_ ( 0 ) , segmentsPerColumn_ ( 0 ) , history_ ( 0 )
+{
+}
+
+void CTrajectoryDecoder::Reset ( const int columnCnt , const int valueCnt )
+{
+    this->columnCnt_ = columnCnt;
+    this->valueCnt_ = valueCnt;
+    this->segmentsPerColumn_ = ( valueCnt + CODEC_SEGMENT - 1 ) / CODEC_SEGMENT;
+    this->history_ = 0;
+    this->columns_.resize ( columnCnt );
+    const std::size_t size = static_cast < std::size_t > ( columnCnt ) * valueCnt;
+    this->previous_.resize ( size );
+    this->older_.resize ( size );
+}
+
+bool CTrajectoryDecoder::IsKeyframe ( CSnapshotCursor cursor )
+{
+    return ( cursor.GetU32 () & CODEC_KEYFRAME ) != 0 && ! cursor.Failed ();
+}
+
+bool CTrajectoryDecoder::Decode ( CSnapshotCursor & cursor , float * frame )
+{
+    const bool keyframe = ( cursor.GetU32 () & CODEC_KEYFRAME ) != 0;
+    for ( tCodecColumn & column : this->columns_ )
+    {
+        column.origin = cursor.GetF32 ();
+        column.step = cursor.GetF32 ();
+        column.levels = cursor.GetU32 ();
+        column.predictor = cursor.GetU32 ();
+        const bool known = keyframe ? column.predictor == PREDICT_SPATIAL : ( column.predictor == PREDICT_PREVIOUS && this->history_ >= 1 ) || ( column.predictor == PREDICT_LINEAR && this->history_ >= 2 );
+        if ( ! known || ! ( column.step > 0.0f ) || column.levels > CODEC_MAX_LEVEL )
+        {
+            cursor.Fail ();
+        }
+    }
+    const int segmentCnt = this->columnCnt_ * this->segmentsPerColumn_;
+    std::vector < std::size_t > sizes ( segmentCnt );
+    std::vector < const unsigned char * > starts ( segmentCnt );
+    std::uint64_t total = 0;
+    for ( std::size_t & size : sizes )
+    {
+        size = cursor.GetU32 ();
+        total += size;
+    }
+    if ( ! cursor.Has ( total , 1 ) )
+    {
+        cursor.Fail ();
+        this->history_ = 0;
+        return false;
+    }
+    // THE SEGMENTS ARE READ IN PLACE, THE CURSOR ONLY HANDS OUT WHERE EACH ONE STARTS
+    for ( int segment = 0; segment < segmentCnt; ++segment )
+    {
+        starts [ segment ] = cursor.Peek ();
+        cursor.Skip ( sizes [ segment ] );
+    }
+    std::atomic < bool > valid ( true );
+    CThreadPool::Instance ().ParallelFor ( segmentCnt , 1 , [ & ] ( int begin , int end , int )
+    {
+        for ( int segment = begin; segment < end; ++segment )
+        {
+            if ( ! this->DecodeSegment ( segment , starts [ segment ] , sizes [ segment ] , keyframe , frame ) )
+            {
+                valid = false;
+            }
+        }
+    } );
+    if ( ! valid )
+    {
+        this->history_ = 0;
+        return false;
+    }
+    this->history_ = keyframe ? 1 : std::min ( this->history_ + 1 , 2 );
+    this->older_.swap ( this->previous_ );
+    std::copy ( frame , frame + this->previous_.size () , this->previous_.begin () );
+    return true;
+}
+
+bool CTrajectoryDecoder::DecodeSegment ( const int segment , const unsigned char * data , const std::size_t size , const bool keyframe , float * frame )
+{
+    const int c = segment / this->segmentsPerColumn_;
+    const int begin = ( segment % this->segmentsPerColumn_ ) * CODEC_SEGMENT;
+    const int end = std::min ( begin + CODEC_SEGMENT , this->valueCnt_ );
+    const std::size_t offset = static_cast < std::size_t > ( c ) * this->valueCnt_;
+    const tCodecColumn & column = this->columns_ [ c ];
+    const double inverseStep = 1.0 / column.step;
+    const float * previous = this->previous_.data () + offset;
+    const float * older = this->older_.data () + offset;
+    float * current = frame + offset;
+    tResidualModel model;
+    CRangeDecoder coder ( data , size );
+    int context = 0;
+    std::int64_t last = 0;
+    for ( int i = begin; i < end; ++i )
+    {
+        std::int64_t residual;
+        if ( ! DecodeResidual ( coder , model , context , residual ) )
+        {
+            return false;
+        }
+        const std::int64_t predicted = keyframe ? last : Level ( Predict ( column.predictor , previous , older , i ) , column , inverseStep );
+        const std::int64_t level = predicted + residual;
+        if ( level < 0 || level > static_cast < std::int64_t > ( column.levels ) )
+        {
+            return false;
+        }
+        current [ i ] = static_cast < float > ( column.origin + static_cast < double > ( level ) * column.step );
+        last = level;
+    }
+    return true;
+}
@@ -0,0 +1,113 @@
+#if !defined(TRAJECTORYCODEC_H__INCLUDED_)
+#define TRAJECTORYCODEC_H__INCLUDED_
+
+#include <cstdint>
+#include <vector>
+#include "Snapshot.h"
+
+#define CODEC_SEGMENT			( 1 << 16 )		// VALUES CODED INDEPENDENTLY, THE UNIT OF WORK OF THE THREAD POOL WHEN DECODING
+#define CODEC_MAX_LEVEL			( 1 << 30 )		// QUANTIZATION LEVELS OF A COLUMN AT MOST, SO RESIDUALS FIT 32 BITS
+
+enum tCodecPredictors
+{
+    PREDICT_SPATIAL,		// THE PREVIOUS VALUE OF THE COLUMN IN THE SAME FRAME, USED BY KEYFRAMES
+    PREDICT_PREVIOUS,		// THE SAME VALUE IN THE PREVIOUS FRAME
+    PREDICT_LINEAR			// EXTRAPOLATED FROM THE TWO PREVIOUS FRAMES
+};
+
+/**
+ * \brief How one column of a frame was quantized: value = origin + level * step, with level in [0, levels].
+ */
+struct tCodecColumn
+{
+    float origin;
+    float step;
+    std::uint32_t levels;
+    std::uint32_t predictor;
+};
+
+/**
+ * \brief Compresses frames of float columns with a bounded error.
+ *
+ * Each column is quantized on a grid anchored at the bounding box of the column in that frame, with a step of twice its tolerance, so
+ * every value comes back within its tolerance, give or take the rounding of a float. Keyframes predict each level from the value before it in the column, the frames after a
+ * keyframe predict it from the frames already decoded, picking per column whichever of the previous frame and the linear extrapolation
+ * of the last two fits better. The residuals are range coded with adaptive binary models, in segments of CODEC_SEGMENT values that are
+ * decoded in parallel. The encoder codes them one after the other on the calling thread, which is the writer of a recording, so it never
+ * takes the thread pool from the simulation.
+ *
+ * The prediction uses the reconstructed frames, not the originals, so the error never builds up from one frame to the next. A frame can be
+ * decoded from the last keyframe before it and every frame in between.
+ */
+class CTrajectoryEncoder
+{
+public:
+    CTrajectoryEncoder ();
+    /**
+     * \brief Starts a new sequence, the next frame is a keyframe.
+     * \param tolerance The largest error allowed on each column, greater than zero.
+     * \param keyframeInterval The number of frames from one keyframe to the next.
+     */
+    void Reset ( int columnCnt , int valueCnt , const float * tolerance , int keyframeInterval );
+    /**
+     * \brief Compresses a frame, given as columnCnt columns of valueCnt floats one after the other.
+     * \return False when the frame holds values that are not finite, or a column spreads over more than CODEC_MAX_LEVEL steps of its
+     * tolerance. Such a frame has to be stored some other way and the next one is a keyframe.
+     */
+    bool Encode ( const float * frame );
+    bool Keyframe () const { return this->keyframe_; }
+    /**
+     * \brief The size of what Put writes for the last frame encoded.
+     */
+    std::uint64_t PayloadSize () const;
+    void Put ( CSnapshotWriter & writer ) const;
+private:
+    void EncodeSegment ( int segment );
+    int columnCnt_;
+    int valueCnt_;
+    int segmentsPerColumn_;
+    int keyframeInterval_;
+    int sinceKeyframe_;				// FRAMES ENCODED SINCE THE LAST KEYFRAME, -1 BEFORE THE FIRST ONE
+    bool keyframe_;
+    const float * frame_;
+    std::vector < float > tolerance_;
+    std::vector < tCodecColumn > columns_;
+    std::vector < float > current_;		// THE FRAME BEING ENCODED AS THE DECODER WILL SEE IT
+    std::vector < float > previous_;
+    std::vector < float > older_;
+    std::vector < std::vector < unsigned char > > segments_;
+};
+
+/**
+ * \brief Reads back the frames of a CTrajectoryEncoder, in the order they were encoded, starting from a keyframe.
+ */
+class CTrajectoryDecoder
+{
+public:
+    CTrajectoryDecoder ();
+    void Reset ( int columnCnt , int valueCnt );
+    /**
+     * \brief Decodes a frame written by CTrajectoryEncoder::Put.
+     * \return False when the payload is damaged, or is not a keyframe and the frame before it was not decoded.
+     */
+    bool Decode ( CSnapshotCursor & cursor , float * frame );
+    /**
+     * \brief Forgets the frames decoded so far, for a frame that was stored uncompressed or a jump to another keyframe.
+     */
+    void Forget () { this->history_ = 0; }
+    /**
+     * \brief Whether a payload is a keyframe, without decoding it.
+     */
+    static bool IsKeyframe ( CSnapshotCursor cursor );
+private:
+    bool DecodeSegment ( int segment , const unsigned char * data , std::size_t size , bool keyframe , float * frame );
+    int columnCnt_;
+    int valueCnt_;
+    int segmentsPerColumn_;
+    int history_;					// FRAMES AVAILABLE FOR THE PREDICTION, 0 TO 2
+    std::vector < tCodecColumn > columns_;
+    std::vector < float > previous_;
+    std::vector < float > older_;
+};
+
+#endif // !defined(TRAJECTORYCODEC_H__INCLUDED_)
@@ -0,0 +1,223 @@
+#include "stdafx.h"
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include "TrajectoryPlayer.h"
+#include "TextExporter.h"
+
+// IN tIntegratorTypes ORDER, AS THE CSV ALWAYS NAMED THEM
+static const char * CSV_INTEGRATOR_NAMES [] = { "EULER" , "MIDPOINT" , "RK4" , "RK5" , "RK4_ADAPTIVE" , "HEUN" };
+
+CTrajectoryPlayer::CTrajectoryPlayer () : particleCnt_ ( 0 ) , current_ ( -1 )
+{
+}
+
+bool CTrajectoryPlayer::Open ( const char * filename )
+{
+    this->Close ();
+    const int format = this->reader_.Open ( filename );
+    if ( format != SNAPSHOT_CHUNKED && format != SNAPSHOT_PARTIAL )
+    {
+        this->reader_.Close ();
+        return false;
+    }
+    CSnapshotCursor header = this->reader_.Chunk ( TRAJECTORY_HEADER );
+    const std::uint32_t version = header.GetU32 ();
+    const int particleCnt = header.GetI32 ();
+    const std::uint32_t columnCnt = header.GetU32 ();
+    if ( header.Failed () || version == 0 || version > TRAJECTORY_VERSION || particleCnt <= 0 || columnCnt != TRAJECTORY_COLUMN_CNT )
+    {
+        this->reader_.Close ();
+        return false;
+    }
+    // ONE ENTRY PER FRAME, ONLY THE FRAME HEADERS AND THE KEYFRAME FLAGS ARE TOUCHED AND NO CRC IS CHECKED YET
+    std::int32_t start = -1;
+    for ( std::size_t chunk = 0; chunk < this->reader_.ChunkCount (); ++chunk )
+    {
+        const std::uint32_t tag = this->reader_.ChunkTag ( chunk );
+        if ( tag != TRAJECTORY_FRAME && tag != TRAJECTORY_PACKED )
+        {
+            continue;
+        }
+        CSnapshotCursor cursor = this->reader_.ChunkUnchecked ( chunk );
+        tFrameEntry entry;
+        entry.chunk = static_cast < std::uint32_t > ( chunk );
+        cursor.Skip ( 4 );
+        entry.time = cursor.GetF32 ();
+        cursor.Skip ( TRAJECTORY_FRAME_SIZE - 8 );
+        entry.packed = tag == TRAJECTORY_PACKED;
+        const std::int32_t self = static_cast < std::int32_t > ( this->frames_.size () );
+        if ( ! entry.packed || CTrajectoryDecoder::IsKeyframe ( cursor ) )
+        {
+            start = self;
+        }
+        entry.start = start;
+        // A FRAME STORED AS IT IS BREAKS THE PREDICTION, THE ENCODER STARTS AGAIN WITH A KEYFRAME
+        if ( ! entry.packed )
+        {
+            start = -1;
+        }
+        this->frames_.push_back ( entry );
+    }
+    if ( this->frames_.empty () )
+    {
+        this->reader_.Close ();
+        return false;
+    }
+    this->particleCnt_ = particleCnt;
+    this->columns_.resize ( static_cast < std::size_t > ( TRAJECTORY_COLUMN_CNT ) * particleCnt );
+    this->decoder_.Reset ( TRAJECTORY_COLUMN_CNT , particleCnt );
+    return true;
+}
+
+void CTrajectoryPlayer::Close ()
+{
+    this->reader_.Close ();
+    this->frames_.clear ();
+    this->particleCnt_ = 0;
+    this->current_ = -1;
+}
+
+int CTrajectoryPlayer::FrameAt ( const float time ) const
+{
+    const auto after = std::upper_bound ( this->frames_.begin () , this->frames_.end () , time , [] ( float t , const tFrameEntry & entry ) { return t < entry.time; } );
+    return std::max ( static_cast < int > ( after - this->frames_.begin () ) - 1 , 0 );
+}
+
+bool CTrajectoryPlayer::Seek ( const int frame )
+{
+    if ( frame < 0 || frame >= this->FrameCount () || this->frames_ [ frame ].start < 0 )
+    {
+        return false;
+    }
+    if ( frame == this->current_ )
+    {
+        return true;
+    }
+    // GOING FORWARD WITHIN THE SAME RUN OF DELTAS CONTINUES FROM THE FRAME SHOWN, ANYTHING ELSE STARTS FROM THE KEYFRAME
+    int from = this->frames_ [ frame ].start;
+    if ( this->current_ >= from && this->current_ < frame )
+    {
+        from = this->current_ + 1;
+    }
+    for ( int at = from; at <= frame; ++at )
+    {
+        if ( ! this->DecodeFrame ( at ) )
+        {
+            this->current_ = -1;
+            this->decoder_.Forget ();
+            return false;
+        }
+    }
+    this->current_ = frame;
+    return true;
+}
+
+void CTrajectoryPlayer::GetHeader ( CSnapshotCursor & cursor , tTrajectoryFrame & header )
+{
+    header.index = cursor.GetU32 ();
+    header.time = cursor.GetF32 ();
+    header.integrator = cursor.GetI32 ();
+    for ( int i = 0; i < 3; ++i )
+    {
+        header.error [ i ] = cursor.GetF32 ();
+    }
+}
+
+bool CTrajectoryPlayer::Header ( const int frame , tTrajectoryFrame & header ) const
+{
+    if ( frame < 0 || frame >= this->FrameCount () )
+    {
+        return false;
+    }
+    CSnapshotCursor cursor = this->reader_.ChunkAt ( this->frames_ [ frame ].chunk );
+    GetHeader ( cursor , header );
+    return ! cursor.Failed ();
+}
+
+bool CTrajectoryPlayer::DecodeFrame ( const int frame )
+{
+    const tFrameEntry & entry = this->frames_ [ frame ];
+    CSnapshotCursor cursor = this->reader_.ChunkAt ( entry.chunk );
+    GetHeader ( cursor , this->frame_ );
+    if ( entry.packed )
+    {
+        return this->decoder_.Decode ( cursor , this->columns_.data () ) && ! cursor.Failed ();
+    }
+    this->decoder_.Forget ();
+    if ( cursor.Left () != sizeof ( float ) * this->columns_.size () )
+    {
+        return false;
+    }
+    cursor.GetWords ( this->columns_.data () , sizeof ( float ) * this->columns_.size () , sizeof ( float ) );
+    return ! cursor.Failed ();
+}
+
+void CTrajectoryPlayer::Apply ( tParticle * system ) const
+{
+    const int particleCnt = this->particleCnt_;
+    const float * columns = this->columns_.data ();
+    for ( int i = 0; i < particleCnt; ++i )
+    {
+        MAKEVECTOR ( system [ i ].pos , columns [ i ] , columns [ particleCnt + i ] , columns [ 2 * particleCnt + i ] );
+        MAKEVECTOR ( system [ i ].v , columns [ 3 * particleCnt + i ] , columns [ 4 * particleCnt + i ] , columns [ 5 * particleCnt + i ] );
+    }
+}
+
+bool ExportTrajectoryCsv ( const char * trajectory , const char * csv )
+{
+    CTrajectoryPlayer player;
+    CTextExporter exporter;
+    if ( ! player.Open ( trajectory ) || ! exporter.Open ( csv ) )
+    {
+        return false;
+    }
+    const int integratorCnt = static_cast < int > ( sizeof ( CSV_INTEGRATOR_NAMES ) / sizeof ( CSV_INTEGRATOR_NAMES [ 0 ] ) );
+    tTrajectoryFrame header;
+    bool whole = true;
+    for ( int frame = 0; frame < player.FrameCount (); ++frame )
+    {
+        if ( ! player.Header ( frame , header ) )
+        {
+            whole = false;
+            break;
+        }
+        const float values [ 4 ] = { header.error [ 0 ] , header.error [ 1 ] , header.error [ 2 ] , header.time };
+        const bool named = header.integrator >= 0 && header.integrator < integratorCnt;
+        exporter.PutLine ( values , 4 , named ? CSV_INTEGRATOR_NAMES [ header.integrator ] : "DEFAULT" );
+    }
+    return exporter.Close () && whole;
+}
+
+bool ExportTrajectoryObj ( const char * trajectory , const char * baseName , const t_Visual * visual )
+{
+    CTrajectoryPlayer player;
+    CTextExporter exporter;
+    if ( ! player.Open ( trajectory ) )
+    {
+        return false;
+    }
+    // ONLY THE POSITIONS ARE WRITTEN, THE REST OF EACH PARTICLE IS LEFT CLEAR
+    std::vector < tParticle > particles ( player.ParticleCount () );
+    for ( int frame = 0; frame < player.FrameCount (); ++frame )
+    {
+        // IN ORDER, SO EACH FRAME DECODES FROM THE ONE BEFORE
+        if ( ! player.Seek ( frame ) )
+        {
+            return false;
+        }
+        player.Apply ( particles.data () );
+        char suffix [ 24 ];
+        std::snprintf ( suffix , sizeof ( suffix ) , "_%04d.obj" , frame );
+        if ( ! exporter.Open ( ( std::string ( baseName ) + suffix ).c_str () ) )
+        {
+            return false;
+        }
+        exporter.PutObj ( particles.data () , player.ParticleCount () , visual );
+        if ( ! exporter.Close () )
+        {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,90 @@
+#if !defined(TRAJECTORYPLAYER_H__INCLUDED_)
+#define TRAJECTORYPLAYER_H__INCLUDED_
+
+#include <cstdint>
+#include <vector>
+#include "TrajectoryRecorder.h"
+
+struct t_Visual;
+
+/**
+ * \brief Plays back a file written by CTrajectoryRecorder, in order or jumping to any frame.
+ *
+ * Open builds an index with one entry per frame, holding where its chunk is and which frame decoding has to start from: the frame itself
+ * when it is a keyframe or stored as it is, else the keyframe before it. Seeking is then a lookup in the index followed by decoding at most
+ * a keyframe interval of frames, and stepping forward from the frame shown decodes a single frame. The file is mapped, nothing but the
+ * frame headers is read until a frame is decoded, which is also when its CRC is checked.
+ */
+class CTrajectoryPlayer
+{
+public:
+    CTrajectoryPlayer ();
+    /**
+     * \return False when the file is not a trajectory. A recording that was never closed plays the frames written before it stopped.
+     */
+    bool Open ( const char * filename );
+    void Close ();
+    bool IsOpen () const { return ! this->frames_.empty (); }
+    int ParticleCount () const { return this->particleCnt_; }
+    int FrameCount () const { return static_cast < int > ( this->frames_.size () ); }
+    float FrameTime ( int frame ) const { return this->frames_ [ frame ].time; }
+    /**
+     * \brief The last frame recorded at or before a time, 0 before the first one.
+     */
+    int FrameAt ( float time ) const;
+    /**
+     * \brief Decodes a frame, starting from the frame shown when it is on the way.
+     * \return False when the frame is damaged.
+     */
+    bool Seek ( int frame );
+    /**
+     * \brief The frame Seek decoded last, -1 before the first one.
+     */
+    int Current () const { return this->current_; }
+    const tTrajectoryFrame & Frame () const { return this->frame_; }
+    /**
+     * \brief Reads what was recorded with a frame besides the particles, without decoding it.
+     * \return False when the frame is damaged.
+     */
+    bool Header ( int frame , tTrajectoryFrame & header ) const;
+    /**
+     * \brief Copies the positions and velocities of the current frame into a system of ParticleCount particles.
+     */
+    void Apply ( tParticle * system ) const;
+private:
+    struct tFrameEntry
+    {
+        std::uint32_t chunk;
+        std::int32_t start;			// THE FRAME DECODING STARTS FROM TO GET THIS ONE
+        float time;
+        bool packed;
+    };
+    bool DecodeFrame ( int frame );
+    static void GetHeader ( CSnapshotCursor & cursor , tTrajectoryFrame & header );
+    CSnapshotReader reader_;
+    std::vector < tFrameEntry > frames_;
+    int particleCnt_;
+    int current_;
+    tTrajectoryFrame frame_;
+    std::vector < float > columns_;		// THE CURRENT FRAME, ONE COLUMN PER COMPONENT
+    CTrajectoryDecoder decoder_;
+};
+
+/**
+ * \brief Writes the frame headers of a recording as CSV, a line per frame: the position, velocity and force errors, the time and the integrator.
+ *
+ * These are the lines the simulation wrote to adaptivetest2.csv while it ran, taken from the recording afterwards instead.
+ * \return False when the recording can not be read, a frame is damaged or the CSV can not be written. The frames before a damaged one are written.
+ */
+bool ExportTrajectoryCsv ( const char * trajectory , const char * csv );
+
+/**
+ * \brief Writes each frame of a recording as an OBJ file named baseName_0000.obj on, a vertex per particle followed by the faces of visual.
+ *
+ * visual is the cloth the recording was made of, its vertices being the particles. Without one, or with one of another vertex count, the
+ * files only have the vertices.
+ * \return False when the recording can not be read, a frame is damaged or a file can not be written. The frames before are written.
+ */
+bool ExportTrajectoryObj ( const char * trajectory , const char * baseName , const t_Visual * visual );
+
+#endif // !defined(TRAJECTORYPLAYER_H__INCLUDED_)
@@ -0,0 +1,128 @@
+#include "stdafx.h"
+#include <cstring>
+#include "TrajectoryRecorder.h"
+
+CTrajectoryRecorder::CTrajectoryRecorder () : compress_ ( false ) , particleCnt_ ( 0 ) , unsynced_ ( 0 )
+{
+    this->compression_.positionTolerance = TRAJECTORY_POS_TOLERANCE;
+    this->compression_.velocityTolerance = TRAJECTORY_VEL_TOLERANCE;
+    this->compression_.keyframeInterval = TRAJECTORY_KEYFRAMES;
+}
+
+CTrajectoryRecorder::~CTrajectoryRecorder ()
+{
+    this->Close ();
+}
+
+bool CTrajectoryRecorder::Open ( const char * filename , int particleCnt , int policy , int slotCnt )
+{
+    this->Close ();
+    if ( ! this->file_.Open ( filename , true ) )
+    {
+        return false;
+    }
+    float tolerance [ TRAJECTORY_COLUMN_CNT ];
+    for ( int column = 0; column < TRAJECTORY_COLUMN_CNT; ++column )
+    {
+        tolerance [ column ] = column < 3 ? this->compression_.positionTolerance : this->compression_.velocityTolerance;
+    }
+    this->compress_ = this->compression_.positionTolerance > 0.0f && this->compression_.velocityTolerance > 0.0f;
+    if ( this->compress_ )
+    {
+        this->encoder_.Reset ( TRAJECTORY_COLUMN_CNT , particleCnt , tolerance , this->compression_.keyframeInterval );
+    }
+    // THE TOLERANCES AND INTERVAL ARE ZERO FOR A RECORDING THAT IS NOT COMPRESSED
+    this->file_.BeginChunk ( TRAJECTORY_HEADER , ( 4 + TRAJECTORY_COLUMN_CNT ) * 4 );
+    this->file_.PutU32 ( TRAJECTORY_VERSION );
+    this->file_.PutI32 ( particleCnt );
+    this->file_.PutU32 ( TRAJECTORY_COLUMN_CNT );
+    this->file_.PutI32 ( this->compress_ ? this->compression_.keyframeInterval : 0 );
+    for ( int column = 0; column < TRAJECTORY_COLUMN_CNT; ++column )
+    {
+        this->file_.PutF32 ( this->compress_ ? tolerance [ column ] : 0.0f );
+    }
+    this->file_.EndChunk ();
+    this->file_.Sync ();
+    this->unsynced_ = 0;
+    // EVERY SLOT IS SIZED NOW SO RECORDING NEVER ALLOCATES
+    std::vector < tSlot > & slots = this->ring_.Slots ();
+    slots.resize ( slotCnt > 0 ? slotCnt : 1 );
+    for ( tSlot & slot : slots )
+    {
+        slot.particles.resize ( particleCnt );
+    }
+    this->frame_.resize ( static_cast < std::size_t > ( TRAJECTORY_COLUMN_CNT ) * particleCnt );
+    this->particleCnt_ = particleCnt;
+    this->ring_.Start ( policy , [ this ] ( tSlot & slot ) { this->WriteFrame ( slot ); } );
+    return true;
+}
+
+bool CTrajectoryRecorder::Record ( const tTrajectoryFrame & frame , const tParticle * system )
+{
+    tSlot * slot = this->ring_.Acquire ();
+    if ( slot == NULL )
+    {
+        return false;
+    }
+    slot->frame = frame;
+    std::memcpy ( slot->particles.data () , system , sizeof ( tParticle ) * this->particleCnt_ );
+    this->ring_.Publish ();
+    return true;
+}
+
+bool CTrajectoryRecorder::Close ()
+{
+    if ( ! this->ring_.Running () )
+    {
+        return true;
+    }
+    this->ring_.Stop ();
+    return this->file_.Close ();
+}
+
+void CTrajectoryRecorder::WriteFrame ( const tSlot & slot )
+{
+    const int particleCnt = this->particleCnt_;
+    const tParticle * particles = slot.particles.data ();
+    for ( int column = 0; column < TRAJECTORY_COLUMN_CNT; ++column )
+    {
+        // COLUMNS 0 TO 2 ARE THE POSITION, 3 TO 5 THE VELOCITY, GATHERED WITH THE STRIDE OF A PARTICLE
+        const float * source = column < 3 ? &particles [ 0 ].pos.x + column : &particles [ 0 ].v.x + ( column - 3 );
+        const std::size_t stride = sizeof ( tParticle ) / sizeof ( float );
+        float * target = this->frame_.data () + static_cast < std::size_t > ( column ) * particleCnt;
+        for ( int i = 0; i < particleCnt; ++i )
+        {
+            target [ i ] = source [ i * stride ];
+        }
+    }
+    const bool packed = this->compress_ && this->encoder_.Encode ( this->frame_.data () );
+    if ( packed )
+    {
+        this->file_.BeginChunk ( TRAJECTORY_PACKED , TRAJECTORY_FRAME_SIZE + this->encoder_.PayloadSize () );
+    }
+    else
+    {
+        this->file_.BeginChunk ( TRAJECTORY_FRAME , TRAJECTORY_FRAME_SIZE + sizeof ( float ) * this->frame_.size () );
+    }
+    this->file_.PutU32 ( slot.frame.index );
+    this->file_.PutF32 ( slot.frame.time );
+    this->file_.PutI32 ( slot.frame.integrator );
+    for ( int i = 0; i < 3; ++i )
+    {
+        this->file_.PutF32 ( slot.frame.error [ i ] );
+    }
+    if ( packed )
+    {
+        this->encoder_.Put ( this->file_ );
+    }
+    else
+    {
+        this->file_.PutWords ( this->frame_.data () , sizeof ( float ) * this->frame_.size () , sizeof ( float ) );
+    }
+    this->file_.EndChunk ();
+    if ( ++this->unsynced_ >= TRAJECTORY_SYNC )
+    {
+        this->file_.Sync ();
+        this->unsynced_ = 0;
+    }
+}
@@ -0,0 +1,109 @@
+#if !defined(TRAJECTORYRECORDER_H__INCLUDED_)
+#define TRAJECTORYRECORDER_H__INCLUDED_
+
+#include <cstdint>
+#include <vector>
+#include "PhysEnv.h"
+#include "Snapshot.h"
+#include "SlotRing.h"
+#include "TrajectoryCodec.h"
+
+#define RECORDER_SLOTS			8		// FRAMES WAITING TO BE WRITTEN AT MOST
+#define TRAJECTORY_VERSION		2
+#define TRAJECTORY_COLUMN_CNT	6		// POSITION X Y Z, THEN VELOCITY X Y Z
+#define TRAJECTORY_POS_TOLERANCE	1.0e-4f	// LARGEST ERROR ON A COMPRESSED POSITION
+#define TRAJECTORY_VEL_TOLERANCE	1.0e-3f	// LARGEST ERROR ON A COMPRESSED VELOCITY
+#define TRAJECTORY_KEYFRAMES	64		// FRAMES FROM ONE KEYFRAME TO THE NEXT
+#define TRAJECTORY_SYNC			16		// FRAMES HANDED TO THE SYSTEM AT A TIME, WHAT A CRASH MAY LOSE AT MOST
+#define TRAJECTORY_FRAME_SIZE	( 6 * 4 )	// THE tTrajectoryFrame AT THE START OF EVERY FRAME CHUNK
+
+// CHUNKS OF A TRAJECTORY FILE, A SNAPSHOT WITH ONE HEADER THEN ONE CHUNK PER FRAME
+#define TRAJECTORY_HEADER		SNAPSHOT_TAG('T','R','H','D')
+#define TRAJECTORY_FRAME		SNAPSHOT_TAG('F','R','A','M')	// A FRAME STORED AS IT IS
+#define TRAJECTORY_PACKED		SNAPSHOT_TAG('F','R','M','Z')	// A FRAME COMPRESSED BY CTrajectoryEncoder
+
+/**
+ * \brief What is recorded with each frame besides the particles.
+ */
+struct tTrajectoryFrame
+{
+    std::uint32_t index;
+    float time;
+    std::int32_t integrator;
+    /**
+     * \brief The position, velocity and force measures of CPhysEnv::CalculateError.
+     */
+    float error [ 3 ];
+};
+
+/**
+ * \brief How the frames are compressed. A tolerance of zero stores the frames as they are.
+ */
+struct tTrajectoryCompression
+{
+    float positionTolerance;
+    float velocityTolerance;
+    int keyframeInterval;
+};
+
+/**
+ * \brief Records the particles of every step into a file without doing any I/O on the simulation thread.
+ *
+ * Record copies the particles into a ring of RECORDER_SLOTS frames, which is all the memory the recorder ever uses. A background thread takes
+ * the frames in order, splits them into one column per component and writes each frame as a chunk of a snapshot: the frame header, then the
+ * TRAJECTORY_COLUMN_CNT columns of particleCnt floats, compressed into a TRAJECTORY_PACKED chunk or as they are in a TRAJECTORY_FRAME one.
+ * Frames the codec can not take, because the simulation blew up or spread too wide for the tolerance, are stored as they are. When the
+ * writer falls behind the policy decides between dropping frames and making the simulation wait.
+ *
+ * The file is handed to the system after the header and every TRAJECTORY_SYNC frames, and is kept when it is never closed, so a recording
+ * cut short by a crash still opens as a SNAPSHOT_PARTIAL snapshot holding the frames before the cut.
+ *
+ * Record is meant to be called from a single thread.
+ */
+class CTrajectoryRecorder
+{
+public:
+    CTrajectoryRecorder ();
+    ~CTrajectoryRecorder ();
+    CTrajectoryRecorder ( const CTrajectoryRecorder & other ) = delete;
+    CTrajectoryRecorder & operator= ( const CTrajectoryRecorder & other ) = delete;
+    /**
+     * \brief Starts a recording, closing the one before.
+     * \return False when the file can not be created.
+     */
+    bool Open ( const char * filename , int particleCnt , int policy = RECORDER_DROP , int slotCnt = RECORDER_SLOTS );
+    /**
+     * \brief Changes the compression, starting with the next recording.
+     */
+    void SetCompression ( const tTrajectoryCompression & compression ) { this->compression_ = compression; }
+    /**
+     * \brief Hands a frame to the writer. The particles are copied before this returns.
+     * \return False when the frame was dropped.
+     */
+    bool Record ( const tTrajectoryFrame & frame , const tParticle * system );
+    /**
+     * \brief Writes the frames still waiting and ends the file.
+     * \return False when anything could not be written.
+     */
+    bool Close ();
+    bool IsOpen () const { return this->ring_.Running (); }
+    int ParticleCount () const { return this->particleCnt_; }
+    int Dropped () const { return this->ring_.Dropped (); }
+private:
+    struct tSlot
+    {
+        tTrajectoryFrame frame;
+        std::vector < tParticle > particles;
+    };
+    void WriteFrame ( const tSlot & slot );
+    std::vector < float > frame_;		// THE FRAME BEING WRITTEN SPLIT IN COLUMNS, ONLY USED BY THE WRITER
+    tTrajectoryCompression compression_;
+    bool compress_;						// FOR THE RECORDING UNDER WAY
+    CTrajectoryEncoder encoder_;
+    int particleCnt_;
+    int unsynced_;						// FRAMES WRITTEN SINCE THE LAST SYNC, ONLY USED BY THE WRITER
+    CSnapshotWriter file_;
+    CSlotRing < tSlot > ring_;				// LAST, SO ITS WRITER STOPS BEFORE THE REST GOES
+};
+
+#endif // !defined(TRAJECTORYRECORDER_H__INCLUDED_)
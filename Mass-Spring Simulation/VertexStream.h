@@ -0,0 +1,22 @@
+#if !defined(VERTEXSTREAM_H__INCLUDED_)
+#define VERTEXSTREAM_H__INCLUDED_
+
+/**
+ * \brief Positions as the producer keeps them, for the renderers to read in place, or to pack what they send to the card.
+ *
+ * Vertex i is the three floats at positions + i * stride bytes. The stream is only good until the producer changes its arrays, so it is
+ * asked for again every frame.
+ */
+struct tVertexStream
+{
+    const float * positions;	// X, Y AND Z OF THE FIRST VERTEX
+    int stride;					// BYTES FROM ONE VERTEX TO THE NEXT
+    int count;
+
+    const float * At ( const int vertex ) const
+    {
+        return reinterpret_cast < const float * > ( reinterpret_cast < const char * > ( this->positions ) + static_cast < long long > ( vertex ) * this->stride );
+    }
+};
+
+#endif // !defined(VERTEXSTREAM_H__INCLUDED_)
@@ -23,6 +23,7 @@
 #define IDD_MAKECLOTH                   137
 #define IDB_VDNP                        138
 #define IDD_ADDSPHERE                   138
+#define IDD_ADDCOLLIDER                 139
 #define IDC_XAXIS                       1000
 #define IDC_YAXIS                       1001
 #define IDC_BUTTON1                     1001
@@ -61,6 +62,16 @@
 #define IDC_USESTRUCT                   1014
 #define IDC_USESHEAR                    1015
 #define IDC_USEBEND                     1016
+#define IDC_XPOS2                       1017
+#define IDC_YPOS2                       1018
+#define IDC_ZPOS2                       1019
+#define IDC_ANGLE                       1020
+#define IDC_POINTLABEL                  1021
+#define IDC_SECONDLABEL                 1022
+#define IDC_SIZELABEL                   1023
+#define IDC_ANGLELABEL                  1024
+#define IDC_BONE                        1025
+#define IDC_BONELABEL                   1026
 #define ID_VIEW_GEOMETRY                32771
 #define ID_VIEW_USEQUATERNIONS          32772
 #define ID_HELP_WHICHOPENGL             32774
@@ -89,6 +100,13 @@
 #define ID_INTEGRATOR_HEUN              32798
 #define ID_INTEGRATOR_ADAPTIVERK4       32799
 #define ID_INTRK5                       32800
+#define ID_SIMULATION_ADDCOLLISIONPLANE 32801
+#define ID_SIMULATION_ADDCOLLISIONBOX   32802
+#define ID_SIMULATION_ADDCOLLISIONCAPSULE 32803
+#define ID_FILE_EXPORTTRAJECTORY        32804
+#define ID_FILE_EXPORTRECORDINGOBJ      32805
+#define ID_FILE_EXPORTPARTICLES         32806
+#define ID_SIMULATION_ADDCOLLISIONMESH  32807
 #define ID_INDICATOR_ROT2               59142
 #define ID_INDICATOR_QUAT               59143
 #define ID_INDICATOR_ROT                59144
@@ -99,9 +117,9 @@
 #ifdef APSTUDIO_INVOKED
 #ifndef APSTUDIO_READONLY_SYMBOLS
 #define _APS_3D_CONTROLS                     1
-#define _APS_NEXT_RESOURCE_VALUE        139
-#define _APS_NEXT_COMMAND_VALUE         32800
-#define _APS_NEXT_CONTROL_VALUE         1015
+#define _APS_NEXT_RESOURCE_VALUE        140
+#define _APS_NEXT_COMMAND_VALUE         32808
+#define _APS_NEXT_CONTROL_VALUE         1027
 #define _APS_NEXT_SYMED_VALUE           101
 #endif
 #endif